@@ -0,0 +1,67 @@
+#ifndef _ENVIRONMENTMAP_H
+#define _ENVIRONMENTMAP_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "mappedfile.h"
+
+// Versão do formato binário do cache de mapas de ambiente. Deve ser
+// incrementada sempre que o conteúdo gerado por BuildEnvironmentMap() mudar.
+#define ENVCACHE_VERSION 1
+
+// Lado máximo, em texels, de cada face do cubemap
+#define ENVIRONMENT_MAX_FACE_SIZE 1024
+
+// Número máximo de níveis de mipmap (suficiente para ENVIRONMENT_MAX_FACE_SIZE)
+#define ENVIRONMENT_MAX_LEVELS 11
+
+// Cubemap HDR com a sua cadeia de mipmaps. Os texels estão no formato
+// GL_RGB9_E5 (três mantissas de 9 bits com um expoente compartilhado de 5
+// bits, veja GL_UNSIGNED_INT_5_9_9_9_REV), em espaço de cor linear. As faces
+// seguem a ordem de GL_TEXTURE_CUBE_MAP_POSITIVE_X em diante (+X, -X, +Y,
+// -Y, +Z, -Z).
+struct EnvironmentLevels
+{
+    int             num_levels;
+    int             size[ENVIRONMENT_MAX_LEVELS];
+    const uint32_t* faces[ENVIRONMENT_MAX_LEVELS][6];
+};
+
+// Converte uma imagem HDR equirretangular (RGB em float, linear, linhas de
+// baixo para cima) em um cubemap. A direção (x,y,z) do cubemap corresponde ao
+// ponto (u,v) = ((atan(x,z) + pi)/(2 pi), (asin(y) + pi/2)/pi) da imagem, a
+// mesma parametrização esférica usada antes para desenhar o céu sobre uma
+// esfera. As faces têm a maior potência de 2 que não ultrapassa 1/4 da largura
+// da imagem (limitada a ENVIRONMENT_MAX_FACE_SIZE) e cada texel é a média de
+// 2x2 amostras da imagem. Os níveis seguintes são pré-filtrados com um filtro
+// de caixa 2x2 em float, até 1x1. Os texels de todos os níveis são guardados
+// em "storage", para o qual apontam os ponteiros de "levels".
+void BuildEnvironmentMap(const float* pixels, int width, int height, std::vector<uint32_t>* storage, EnvironmentLevels* levels);
+
+// Cache aberto com EnvironmentCache_Load(). Os texels continuam no arquivo
+// mapeado em memória e podem ser enviados diretamente para a GPU.
+struct EnvironmentCache
+{
+    MappedFile        file;
+    EnvironmentLevels levels;
+};
+
+// Nome do arquivo de cache correspondente a uma imagem HDR.
+std::string EnvironmentCache_Filename(const char* image_filename);
+
+// Abre o cache da imagem "image_filename". Retorna false se ele não existir,
+// se a imagem tiver sido modificada depois da sua criação (veja FileStamp) ou
+// se o arquivo estiver corrompido.
+bool EnvironmentCache_Load(const char* image_filename, EnvironmentCache* cache);
+
+// Libera o mapeamento de um cache aberto com EnvironmentCache_Load().
+void EnvironmentCache_Close(EnvironmentCache* cache);
+
+// Grava o cache da imagem "image_filename". Falhas de escrita não são fatais:
+// a imagem apenas continuará sendo convertida na próxima execução.
+bool EnvironmentCache_Save(const char* image_filename, const EnvironmentLevels& levels);
+
+#endif // _ENVIRONMENTMAP_H
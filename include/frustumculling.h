@@ -0,0 +1,102 @@
+#ifndef _FRUSTUMCULLING_H
+#define _FRUSTUMCULLING_H
+
+#include <cstddef>
+#include <vector>
+
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+
+// Descarte dos objetos que estão fora do campo de visão da câmera (view
+// frustum culling), testando caixas alinhadas aos eixos no sistema de
+// coordenadas global. Os objetos estáticos ficam em uma hierarquia de volumes
+// envolventes (BVH) construída uma única vez; os dinâmicos são testados um a
+// um com Culling_TestBox().
+
+// Caixa alinhada aos eixos no sistema de coordenadas global
+struct CullBox
+{
+    glm::vec3 bbox_min;
+    glm::vec3 bbox_max;
+};
+
+// Caixa global que envolve a bounding box "bbox_min"/"bbox_max" de um modelo
+// transformada pela matriz de modelagem "model".
+CullBox Culling_TransformBox(const glm::vec3& bbox_min, const glm::vec3& bbox_max, const glm::mat4& model);
+
+// Menor caixa que contém "a" e "b".
+CullBox Culling_MergeBoxes(const CullBox& a, const CullBox& b);
+
+// Planos do frustum (esquerda, direita, baixo, cima, near e far), na forma
+// (n, d) com n apontando para dentro: um ponto p está do lado de dentro do
+// plano se dot(n, p) + d >= 0.
+struct Frustum
+{
+    glm::vec4 planes[6];
+};
+
+// Extrai os planos do frustum da matriz projection*view (veja Gribb e
+// Hartmann, "Fast Extraction of Viewing Frustum Planes from the
+// World-View-Projection Matrix").
+Frustum Culling_ExtractFrustum(const glm::mat4& view_projection);
+
+// Máscara com todos os planos do frustum. O bit i indica que o plano i ainda
+// precisa ser testado.
+#define CULL_ALL_PLANES 0x3Fu
+
+enum CullResult
+{
+    CULL_OUTSIDE,    // Fora de algum plano
+    CULL_INTERSECTS, // Cruza algum plano da máscara
+    CULL_INSIDE      // Dentro de todos os planos da máscara
+};
+
+// Testa uma caixa contra os planos de "*plane_mask", removendo da máscara os
+// planos que contêm a caixa inteira: os filhos de um nó da BVH só precisam
+// ser testados contra os planos restantes. Se "last_plane" não for NULL, o
+// plano que descartou a caixa no teste anterior é testado primeiro e
+// "*last_plane" é atualizado (ou -1 se o plano estiver fora da máscara).
+CullResult Culling_TestBox(const Frustum& frustum, const CullBox& box, unsigned* plane_mask, int* last_plane);
+
+// Número máximo de objetos em uma folha da BVH
+#define CULL_BVH_LEAF_SIZE 4
+
+// Nó da BVH. Cada nó cobre o intervalo [first_item, first_item + num_items)
+// de CullBvh::items; os filhos de um nó interno são "left" e "left" + 1.
+struct CullBvhNode
+{
+    CullBox box;
+    int     first_item;
+    int     num_items;
+    int     left;        // -1 nas folhas
+    int     last_plane;  // Plano que descartou o nó no último teste, ou -1
+};
+
+struct CullBvh
+{
+    std::vector<CullBvhNode> nodes;       // nodes[0] é a raiz
+    std::vector<int>         items;       // Índices dos objetos, na ordem das folhas
+    std::vector<CullBox>     boxes;       // Caixa de cada objeto
+    std::vector<int>         last_planes; // Plano que descartou cada objeto no último teste
+};
+
+// Contadores do descarte: objetos desenhados e descartados, e caixas (nós da
+// BVH e objetos) testadas contra o frustum.
+struct CullStats
+{
+    size_t visible;
+    size_t culled;
+    size_t boxes_tested;
+};
+
+// Constrói a BVH das caixas "boxes", dividindo cada nó na mediana dos centros
+// das caixas ao longo do seu eixo mais longo.
+void Culling_BuildBvh(CullBvh* bvh, const std::vector<CullBox>& boxes);
+
+// Marca em "visible" (redimensionado para o número de objetos) os objetos da
+// BVH que estão, ao menos em parte, dentro do frustum, somando os contadores
+// em "stats".
+void Culling_CullBvh(CullBvh* bvh, const Frustum& frustum, std::vector<char>* visible, CullStats* stats);
+
+#endif // _FRUSTUMCULLING_H
@@ -0,0 +1,124 @@
+#ifndef _LIGHTCLUSTERS_H
+#define _LIGHTCLUSTERS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <glad/glad.h>
+
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+
+// Iluminação "clustered forward" das luzes dinâmicas (clarão dos tiros,
+// olhos dos fantasmas, faróis do carro). O frustum da câmera é dividido em
+// LIGHT_CLUSTERS_X x LIGHT_CLUSTERS_Y blocos na tela e LIGHT_CLUSTERS_Z
+// fatias em profundidade, com espessura crescente (exponencial) com a
+// distância. A cada quadro o jogo adiciona as luzes com LightClusters_Add*()
+// e LightClusters_Build() testa a esfera de alcance de cada luz contra as
+// caixas dos clusters, montando a lista de luzes de cada cluster.
+//
+// As luzes ficam no bloco de uniforms "LightBlock" e as listas em dois
+// texture buffers (GL 3.3 não tem shader storage buffers): "cluster_grid"
+// guarda, para cada cluster, a posição da sua lista e o número de luzes, e
+// "cluster_lights" guarda as listas, com um índice de luz por texel. Cada
+// fragmento de "shader_fragment.glsl" percorre apenas as luzes do seu
+// cluster, de forma que o custo por fragmento depende das luzes que o
+// alcançam e não do número total de luzes.
+
+// Número máximo de luzes por quadro; deve ser igual a MAX_LIGHTS em
+// "shader_fragment.glsl". Os índices das luzes são guardados em 8 bits.
+#define LIGHT_CLUSTERS_MAX_LIGHTS 64
+
+// Divisões do frustum em blocos na tela e em fatias de profundidade
+#define LIGHT_CLUSTERS_X 16
+#define LIGHT_CLUSTERS_Y 9
+#define LIGHT_CLUSTERS_Z 24
+#define LIGHT_CLUSTERS_COUNT (LIGHT_CLUSTERS_X * LIGHT_CLUSTERS_Y * LIGHT_CLUSTERS_Z)
+
+// Número máximo de índices de luz somando as listas de todos os clusters. As
+// luzes excedentes são ignoradas (veja LightClusterStats::dropped).
+#define LIGHT_CLUSTERS_MAX_INDICES (32*1024)
+
+// Ponto de ligação do bloco "LightBlock". Os pontos 0 a 2 são usados por
+// "renderqueue.h".
+#define LIGHT_CLUSTERS_BINDING 3
+
+// Unidades de textura dos texture buffers. As unidades 0 a 15 são usadas
+// pelas texturas de "main.cpp", a 28 por "shadowmap.h" e a 31 por
+// "textrendering.cpp".
+#define LIGHT_CLUSTERS_GRID_UNIT    29
+#define LIGHT_CLUSTERS_INDICES_UNIT 30
+
+// Elemento do bloco "LightBlock" (std140)
+struct ClusterLight
+{
+    glm::vec4 position;  // Posição global (xyz) e alcance (w)
+    glm::vec4 color;     // Cor multiplicada pela intensidade (rgb)
+    glm::vec4 spot;      // Direção do cone (xyz) e cosseno do seu ângulo (w); w = -2 em luzes pontuais
+};
+
+// Bloco "LightBlock" (std140)
+struct LightBlock
+{
+    glm::vec4    cluster_scale; // x,y: clusters por pixel; z,w: fatia = log(profundidade)*z + w
+    GLint        num_lights;
+    GLint        padding[3];
+    ClusterLight lights[LIGHT_CLUSTERS_MAX_LIGHTS];
+};
+
+// Contadores do último LightClusters_Build()
+struct LightClusterStats
+{
+    size_t lights;
+    size_t lit_clusters; // Clusters alcançados por ao menos uma luz
+    size_t indices;      // Tamanho total das listas
+    size_t dropped;      // Índices que não couberam em LIGHT_CLUSTERS_MAX_INDICES
+};
+
+struct LightClusters
+{
+    LightBlock             block;
+    std::vector<glm::vec4> boxes;            // Caixas dos clusters no sistema da câmera (mínimo e máximo)
+    glm::mat4              boxes_projection; // Projeção, near e far usados no cálculo de "boxes"
+    float                  boxes_near;
+    float                  boxes_far;
+    std::vector<uint32_t>  hits;             // Pares (cluster, luz) do quadro
+    std::vector<GLuint>    grid;             // Posição e tamanho da lista de cada cluster
+    std::vector<GLubyte>   indices;
+    GLuint                 uniform_buffer_id;
+    GLuint                 grid_buffer_id;
+    GLuint                 grid_texture_id;
+    GLuint                 indices_buffer_id;
+    GLuint                 indices_texture_id;
+    LightClusterStats      stats;
+};
+
+// Cria os buffers e as texturas. Deve ser chamada após a criação do
+// contexto OpenGL.
+void LightClusters_Init(LightClusters* clusters);
+
+// Liga o bloco "LightBlock" e os samplers "cluster_grid" e "cluster_lights"
+// do programa, se existirem. Deve ser chamada para cada programa que usa
+// as luzes.
+void LightClusters_BindProgram(GLuint program_id);
+
+// Remove as luzes do quadro anterior.
+void LightClusters_Clear(LightClusters* clusters);
+
+// Adiciona uma luz pontual de alcance "radius", ou uma luz spot com cone de
+// direção "direction" e meio ângulo "angle" (em radianos). Retorna false se
+// já houver LIGHT_CLUSTERS_MAX_LIGHTS luzes.
+bool LightClusters_AddPoint(LightClusters* clusters, const glm::vec4& position, float radius, const glm::vec3& color);
+bool LightClusters_AddSpot(LightClusters* clusters, const glm::vec4& position, const glm::vec4& direction, float angle,
+                           float radius, const glm::vec3& color);
+
+// Distribui as luzes adicionadas entre os clusters da câmera "view" /
+// "projection" (perspectiva), com planos near e far às distâncias
+// "near_distance" e "far_distance", e envia as luzes e as listas para a
+// GPU. "width" e "height" são as dimensões do framebuffer em pixels.
+void LightClusters_Build(LightClusters* clusters, const glm::mat4& view, const glm::mat4& projection,
+                         float near_distance, float far_distance, int width, int height);
+
+#endif // _LIGHTCLUSTERS_H
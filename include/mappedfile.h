@@ -0,0 +1,43 @@
+#ifndef _MAPPEDFILE_H
+#define _MAPPEDFILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Arquivo mapeado em memória (somente leitura). Usado pelos caches binários
+// de assets, que são lidos diretamente do mapeamento sem cópias adicionais.
+struct MappedFile
+{
+    const unsigned char* data; // Início do conteúdo do arquivo
+    size_t               size; // Tamanho do arquivo em bytes
+    void*                handle; // Detalhes específicos do sistema operacional
+
+    MappedFile() : data(NULL), size(0), handle(NULL) {}
+};
+
+// Mapeia o arquivo "filename" em memória. Retorna false se o arquivo não
+// existir ou não puder ser mapeado.
+bool MapFile(const char* filename, MappedFile* file);
+
+// Desfaz o mapeamento criado por MapFile().
+void UnmapFile(MappedFile* file);
+
+// "Carimbo" de um arquivo no disco, usado para detectar quando um cache
+// ficou desatualizado em relação ao arquivo original.
+struct FileStamp
+{
+    uint64_t size;  // Tamanho em bytes
+    int64_t  mtime; // Data da última modificação
+};
+
+// Obtém o carimbo do arquivo "filename". Retorna false se ele não existir.
+bool GetFileStamp(const char* filename, FileStamp* stamp);
+
+// Grava no arquivo "filename" a concatenação dos "count" blocos "chunks",
+// com tamanhos "sizes" em bytes. O arquivo é substituído apenas se todo o
+// conteúdo for gravado; caso contrário retorna false e o arquivo anterior,
+// se existir, é mantido.
+bool WriteFileAtomically(const std::string& filename, const void* const* chunks, const size_t* sizes, int count);
+
+#endif // _MAPPEDFILE_H
@@ -252,6 +252,46 @@ glm::mat4 Matrix_Camera_View(glm::vec4 position_c, glm::vec4 view_vector, glm::v
     );
 }
 
+// Posição do centro da câmera no sistema de coordenadas global, igual a
+// inverse(view)*[0,0,0,1], para uma matriz "view" computada por
+// Matrix_Camera_View(). A parte linear R dessa matriz é ortonormal, portanto
+// a sua inversa é a transposta, e o centro é c = -R^T*t, onde t é a última
+// coluna da matriz.
+glm::vec4 Matrix_Camera_Position(glm::mat4 view)
+{
+    glm::vec4 t = view[3];
+    return glm::vec4(
+        -(view[0][0]*t.x + view[0][1]*t.y + view[0][2]*t.z),
+        -(view[1][0]*t.x + view[1][1]*t.y + view[1][2]*t.z),
+        -(view[2][0]*t.x + view[2][1]*t.y + view[2][2]*t.z),
+        1.0f
+    );
+}
+
+// Matriz que transforma as normais de um modelo desenhado com a matriz de
+// modelagem "model": a inversa da transposta da parte linear de "model". Se
+// a, b e c são as colunas dessa parte, as colunas da inversa da transposta
+// são (b x c), (c x a) e (a x b), divididas pelo determinante a . (b x c).
+// A translação não afeta as normais.
+glm::mat4 Matrix_Normal(glm::mat4 model)
+{
+    glm::vec4 a = glm::vec4(model[0].x, model[0].y, model[0].z, 0.0f);
+    glm::vec4 b = glm::vec4(model[1].x, model[1].y, model[1].z, 0.0f);
+    glm::vec4 c = glm::vec4(model[2].x, model[2].y, model[2].z, 0.0f);
+
+    glm::vec4 bc = crossproduct(b, c);
+    glm::vec4 ca = crossproduct(c, a);
+    glm::vec4 ab = crossproduct(a, b);
+
+    float det = dotproduct(a, bc);
+
+    glm::mat4 N = Matrix_Identity();
+    N[0] = bc / det;
+    N[1] = ca / det;
+    N[2] = ab / det;
+    return N;
+}
+
 // Matriz de projeção paralela ortográfica
 glm::mat4 Matrix_Orthographic(float l, float r, float b, float t, float n, float f)
 {
@@ -0,0 +1,104 @@
+#ifndef _MESHCACHE_H
+#define _MESHCACHE_H
+
+#include <string>
+#include <vector>
+
+#include <glad/glad.h>
+
+#include <glm/vec3.hpp>
+
+#include "mappedfile.h"
+#include "vertexformat.h"
+
+// Versão do formato binário do cache. Deve ser incrementada sempre que a
+// representação dos vértices gerada por BuildTriangles() mudar, para que
+// caches antigos sejam descartados automaticamente.
+#define MESHCACHE_VERSION 5
+
+// Número máximo de níveis de detalhe (LODs) de um objeto, incluindo a malha
+// original. Veja "meshlod.h".
+#define MESH_MAX_LODS 4
+
+// Nível de detalhe de um objeto: intervalo de índices da versão simplificada
+// e o seu erro geométrico em relação à malha original, nas unidades do modelo.
+struct MeshLod
+{
+    size_t first_index;
+    size_t num_indices;
+    float  error;
+};
+
+// Intervalo de índices de um objeto nomeado dentro de uma malha. Cada
+// MeshObject dá origem a um SceneObject em g_VirtualScene. O nível de detalhe
+// lods[0] é o próprio objeto (first_index, num_indices e erro zero).
+struct MeshObject
+{
+    std::string name;
+    size_t      first_index;
+    size_t      num_indices;
+    glm::vec3   bbox_min;
+    glm::vec3   bbox_max;
+    int         num_lods;
+    MeshLod     lods[MESH_MAX_LODS];
+};
+
+// Malha de triângulos construída a partir de um ObjModel pela função
+// BuildTriangles() em "main.cpp". Os vetores de floats são usados durante a
+// construção e otimização da malha; MeshData_Pack() gera a partir deles os
+// vértices compactados que são enviados à GPU.
+struct MeshData
+{
+    std::vector<GLuint>       indices;
+    std::vector<float>        model_coefficients;
+    std::vector<float>        normal_coefficients;
+    std::vector<float>        texture_coefficients;
+    std::vector<PackedVertex> vertices;
+    PositionQuantization      quantization;
+    std::vector<MeshObject>   objects;
+};
+
+// Visão somente-leitura de uma malha. Os ponteiros podem apontar tanto para
+// os vetores de um MeshData quanto diretamente para um cache mapeado em
+// memória, de forma que o envio à GPU não depende da origem dos dados.
+struct MeshView
+{
+    const GLuint*       indices;
+    size_t              num_indices;
+    const PackedVertex* vertices;
+    size_t              num_vertices;
+    PositionQuantization quantization;
+    const MeshObject*   objects;
+    size_t              num_objects;
+};
+
+// Gera mesh->vertices e mesh->quantization a partir dos vetores de floats.
+void MeshData_Pack(MeshData* mesh);
+
+MeshView MeshData_View(const MeshData& mesh);
+
+// Cache aberto com MeshCache_Load(). Os vértices e índices continuam no
+// arquivo mapeado; somente a lista de objetos é copiada.
+struct MeshCache
+{
+    MappedFile              file;
+    std::vector<MeshObject> objects;
+    MeshView                view;
+};
+
+// Nome do arquivo de cache correspondente a um arquivo ".obj".
+std::string MeshCache_Filename(const char* obj_filename);
+
+// Abre o cache do modelo "obj_filename". Retorna false se o cache não existir
+// ou estiver desatualizado (OBJ modificado, versão de formato diferente ou
+// arquivo corrompido); neste caso o modelo deve ser carregado do OBJ.
+bool MeshCache_Load(const char* obj_filename, MeshCache* cache);
+
+// Libera o mapeamento de um cache aberto com MeshCache_Load().
+void MeshCache_Close(MeshCache* cache);
+
+// Grava o cache do modelo "obj_filename". Falhas de escrita não são fatais:
+// o modelo apenas continuará sendo carregado do OBJ na próxima execução.
+bool MeshCache_Save(const char* obj_filename, const MeshView& mesh);
+
+#endif // _MESHCACHE_H
@@ -0,0 +1,45 @@
+#ifndef _MESHLOD_H
+#define _MESHLOD_H
+
+#include <cstddef>
+
+#include "meshcache.h"
+
+// Objetos com menos triângulos do que isso não recebem níveis de detalhe.
+#define MESH_LOD_MIN_TRIANGLES 256
+
+// Erro geométrico máximo de um nível de detalhe, como fração da diagonal da
+// bounding box do objeto. Os níveis que precisariam de um erro maior não são
+// gerados.
+#define MESH_LOD_MAX_ERROR 0.05f
+
+// Simplifica uma malha de triângulos por colapsos de arestas guiados por
+// quádricas de erro (Garland e Heckbert, "Surface Simplification Using Quadric
+// Error Metrics"). Cada colapso move um vértice para a posição de um vizinho,
+// de forma que o resultado usa apenas vértices já existentes e pode ser
+// desenhado com o mesmo VBO da malha original.
+//
+// "positions" guarda "position_stride" floats por vértice (x,y,z primeiro) e
+// é indexado diretamente pelos valores de "indices". O resultado, com no
+// máximo num_indices índices, é escrito em "destination" e a função retorna
+// quantos índices foram escritos. A simplificação para ao atingir
+// "target_num_indices" ou quando o próximo colapso tiver erro maior que
+// "target_error" (nas unidades das posições). Em "result_error" é retornado
+// o maior erro entre os colapsos realizados.
+//
+// Vértices na borda da malha não são removidos, preservando a silhueta de
+// malhas abertas. Em costuras (posições com mais de uma combinação de normal
+// e coordenada de textura) todos os vértices da posição são movidos juntos,
+// cada um para o vértice do destino que está do mesmo lado da costura.
+size_t SimplifyMesh(GLuint* destination, const GLuint* indices, size_t num_indices,
+                    const float* positions, size_t position_stride,
+                    size_t target_num_indices, float target_error, float* result_error);
+
+// Gera até MESH_MAX_LODS-1 níveis de detalhe para cada objeto de uma malha
+// construída e otimizada por BuildTriangles(), cada um com cerca de metade dos
+// triângulos do anterior. Os índices dos novos níveis são acrescentados ao
+// final de mesh->indices, já ordenados com OptimizeVertexCache(), e
+// registrados em MeshObject::lods.
+void GenerateMeshLods(MeshData* mesh);
+
+#endif // _MESHLOD_H
@@ -0,0 +1,42 @@
+#ifndef _MESHOPTIMIZER_H
+#define _MESHOPTIMIZER_H
+
+#include <cstddef>
+
+#include "meshcache.h"
+
+// Tamanho da cache de vértices pós-transformação simulada para o cálculo do
+// ACMR (average cache miss ratio: vértices processados por triângulo).
+#define MESHOPT_ACMR_CACHE_SIZE 16
+
+// Estatísticas da otimização de uma malha, impressas durante o carregamento.
+struct MeshOptimizationStats
+{
+    bool   optimized; // false se a malha precisou ser mantida como estava
+    size_t num_triangles;
+    size_t vertices_before;
+    size_t vertices_after;
+    float  acmr_before;
+    float  acmr_after;
+};
+
+// Simula uma cache FIFO de MESHOPT_ACMR_CACHE_SIZE vértices e retorna o
+// número médio de vértices transformados por triângulo (entre ~0.5 e 3.0).
+float ComputeACMR(const GLuint* indices, size_t num_indices, size_t num_vertices);
+
+// Reordena os triângulos para aproveitar a cache de vértices
+// pós-transformação da GPU (algoritmo de Tom Forsyth, "Linear-Speed Vertex
+// Cache Optimisation"). Os índices devem estar no intervalo [0, num_vertices).
+void OptimizeVertexCache(GLuint* indices, size_t num_indices, size_t num_vertices);
+
+// Otimiza uma malha construída por BuildTriangles(), objeto por objeto:
+//  1. solda vértices com mesma posição, normal e coordenada de textura;
+//  2. reordena os triângulos com OptimizeVertexCache();
+//  3. renumera os vértices na ordem em que são usados pelos triângulos, para
+//     melhorar a localidade dos acessos ao VBO.
+// Os vértices de cada objeto continuam ocupando um intervalo contínuo.
+// Malhas onde só parte dos vértices possui normais ou coordenadas de textura
+// (os vetores ficam desalinhados) não são alteradas.
+void OptimizeMesh(MeshData* mesh, MeshOptimizationStats* stats);
+
+#endif // _MESHOPTIMIZER_H
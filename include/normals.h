@@ -0,0 +1,28 @@
+#ifndef _NORMALS_H
+#define _NORMALS_H
+
+#include <cstddef>
+
+// Número mínimo de triângulos por thread em ComputeVertexNormals(). Malhas
+// menores são processadas inteiramente na thread que chamou a função.
+#define NORMALS_MIN_TRIANGLES_PER_THREAD 16384
+
+// Computa as normais dos vértices de uma malha de triângulos pelo método de
+// Gouraud: a normal de cada vértice é a soma das normais das faces que o
+// compartilham, ponderadas pela área de cada face (o produto vetorial das
+// arestas, sem normalização, tem módulo igual ao dobro da área), e então
+// normalizada. Vértices sem nenhuma face de área não nula recebem (0,0,0).
+//
+// "positions" e "normals" guardam 3 floats (x,y,z) por vértice e "triangles"
+// guarda 3 índices de vértice por triângulo. Internamente as posições são
+// convertidas para o layout SoA (vetores x[], y[] e z[] separados), os
+// produtos vetoriais são calculados com SIMD, quatro triângulos por vez, e os
+// triângulos são divididos entre até "num_threads" threads (num_threads <= 0
+// usa o número de núcleos do processador). Cada thread acumula em vetores
+// próprios, que depois são somados por faixas de vértices, sem conflitos de
+// escrita entre as threads.
+void ComputeVertexNormals(const float* positions, size_t num_vertices,
+                          const unsigned int* triangles, size_t num_triangles,
+                          float* normals, int num_threads);
+
+#endif // _NORMALS_H
@@ -0,0 +1,35 @@
+#ifndef _OBJREADER_H
+#define _OBJREADER_H
+
+#include <string>
+#include <vector>
+
+#include <tiny_obj_loader.h>
+
+// Tamanho mínimo, em bytes, do trecho do arquivo lido por cada thread em
+// ReadObj(). Arquivos menores são lidos inteiramente na thread que chamou a
+// função.
+#define OBJ_MIN_BYTES_PER_THREAD (256*1024)
+
+// Lê um arquivo ".obj" e produz as mesmas estruturas que
+// tinyobj::LoadObj(..., triangulate = true): posições, normais, coordenadas
+// de textura e cores em "attrib", um shape_t por objeto ("o") ou grupo ("g")
+// e os materiais das bibliotecas "mtllib", procuradas em "mtl_basedir".
+//
+// O arquivo é mapeado em memória (veja "mappedfile.h") e dividido em trechos
+// que terminam em quebras de linha. Cada trecho é interpretado por uma thread
+// (até "num_threads", ou o número de núcleos se num_threads <= 0), com um
+// parser de números próprio, sem std::istream nem cópias das linhas. Índices
+// relativos (negativos) são resolvidos depois, quando se sabe quantos
+// vértices cada trecho anterior definiu.
+//
+// Triângulos e quadriláteros são tratados exatamente como na tinyobjloader
+// (o quadrilátero é dividido pela diagonal mais curta); polígonos com mais
+// vértices são divididos em leque. Linhas ("l"), pontos ("p"), tags ("t") e
+// pesos ("vw") são ignorados. Retorna false em caso de erro, descrito em "err".
+bool ReadObj(const char* filename, const char* mtl_basedir,
+             tinyobj::attrib_t* attrib, std::vector<tinyobj::shape_t>* shapes,
+             std::vector<tinyobj::material_t>* materials,
+             std::string* warn, std::string* err, int num_threads = 0);
+
+#endif // _OBJREADER_H
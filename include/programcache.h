@@ -0,0 +1,46 @@
+#ifndef _PROGRAMCACHE_H
+#define _PROGRAMCACHE_H
+
+#include <string>
+
+#include <glad/glad.h>
+
+// Versão do formato do cache de programas de GPU
+#define PROGRAMCACHE_VERSION 1
+
+// Cache dos binários dos programas de GPU (extensão ARB_get_program_binary,
+// parte do OpenGL 4.1). Depois da primeira execução, os programas são
+// criados a partir do binário gerado pelo driver, sem compilar o código GLSL.
+//
+// Cada arquivo ".progcache" guarda um hash do código-fonte dos shaders e a
+// identificação do driver (GL_VENDOR, GL_RENDERER e GL_VERSION). Se um deles
+// mudar, ou se o driver recusar o binário, o cache é ignorado e o programa
+// deve ser compilado a partir do código-fonte.
+
+// Indica se o driver oferece a extensão "name" (por exemplo
+// "GL_ARB_get_program_binary"). Usada também por "shadermanager.cpp".
+bool HasGLExtension(const char* name);
+
+// Carrega as funções da extensão com "load" (por exemplo glfwGetProcAddress).
+// Se o driver não oferecer a extensão ou nenhum formato de binário, o cache
+// fica desativado e ProgramCache_Load() sempre retorna false.
+void ProgramCache_Init(GLADloadproc load);
+
+// Nome do arquivo de cache do programa "name", no diretório de trabalho
+// (o diretório do executável), já que o binário só vale para esta máquina.
+std::string ProgramCache_Filename(const char* name);
+
+// Cria em "program_id" o programa "name" a partir do cache. Retorna false se
+// o cache não existir, estiver desatualizado em relação a "vertex_source",
+// "fragment_source" ou ao driver, ou se o binário for recusado.
+bool ProgramCache_Load(const char* name, const std::string& vertex_source, const std::string& fragment_source, GLuint* program_id);
+
+// Deve ser chamada antes de glLinkProgram(), para que o driver mantenha o
+// binário do programa disponível para ProgramCache_Save().
+void ProgramCache_PrepareLink(GLuint program_id);
+
+// Grava o binário do programa "program_id", já linkado. Falhas de escrita não
+// são fatais: o programa apenas continuará sendo compilado.
+bool ProgramCache_Save(const char* name, const std::string& vertex_source, const std::string& fragment_source, GLuint program_id);
+
+#endif // _PROGRAMCACHE_H
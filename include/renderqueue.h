@@ -0,0 +1,209 @@
+#ifndef _RENDERQUEUE_H
+#define _RENDERQUEUE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <glad/glad.h>
+
+#include <glm/mat3x3.hpp>
+#include <glm/mat4x4.hpp>
+#include <glm/vec4.hpp>
+
+#include "sceneregistry.h"
+
+// Fila de desenhos de um quadro. Em vez de desenhar cada objeto na ordem em
+// que o código do jogo o visita, o quadro submete "pacotes" de desenho
+// (objeto, material, matriz de modelagem e passo) com RenderQueue_Submit().
+// RenderQueue_Flush() ordena os pacotes por uma chave de 64 bits (passo,
+// programa, material, VAO e primeiro índice desenhado) e os desenha
+// alterando o estado do OpenGL apenas quando ele muda de um pacote para o
+// seguinte.
+//
+// Pacotes consecutivos (após a ordenação) que desenham o mesmo objeto com o
+// mesmo estado são desenhados com uma única chamada instanciada
+// (glDrawElementsInstancedBaseVertex()): a matriz de modelagem e o valor
+// "instance_data" de cada pacote são lidos em "shader_vertex.glsl" como
+// atributos por instância.
+//
+// As variáveis "uniform" dos shaders ficam em três blocos std140, enviados
+// uma única vez por RenderQueue_Flush() para um buffer de uniforms (UBO)
+// circular: "FrameUniforms" (valores do quadro), "PassUniforms" (matrizes de
+// cada passo) e "DrawUniforms" (bounding box e quantização de cada
+// desenho). O índice do desenho no bloco "DrawUniforms" é lido como
+// atributo por instância, portanto nenhuma variável "uniform" é alterada
+// entre os desenhos.
+
+// Número máximo de passos de renderização
+#define RENDER_QUEUE_MAX_PASSES 16
+
+// Programa de GPU usado pela fila. Os seus blocos de uniforms devem ser
+// ligados com RenderQueue_BindUniformBlocks().
+struct RenderProgram
+{
+    GLuint program_id;
+};
+
+// Pontos de ligação (veja glUniformBlockBinding()) dos blocos de uniforms
+#define RENDER_QUEUE_FRAME_BINDING 0
+#define RENDER_QUEUE_PASS_BINDING  1
+#define RENDER_QUEUE_DRAW_BINDING  2
+
+// Número de desenhos no bloco "DrawUniforms"; deve ser igual a MAX_DRAWS em
+// "shader_vertex.glsl" e "shader_fragment.glsl". Uma fila com mais desenhos
+// liga as janelas seguintes do buffer com glBindBufferRange().
+#define RENDER_QUEUE_DRAWS_PER_BLOCK 128
+
+// Número de quadros no buffer circular de uniforms. O quadro atual escreve
+// na sua região do buffer enquanto a GPU ainda lê as regiões dos anteriores.
+#define RENDER_QUEUE_UNIFORM_FRAMES 3
+
+// Bloco "FrameUniforms" (std140), com valores iguais em todos os desenhos do
+// quadro. Preenchido pelo jogo antes de RenderQueue_Flush().
+struct FrameUniforms
+{
+    GLint     lanterna_ligada; // Lanterna do jogador ligada
+    GLint     nozzle_flash;    // Flash do tiro do revólver
+    GLint     tela_de_menu;    // Iluminação do menu
+    GLint     sombra_lanterna; // Mapa de sombras da lanterna válido no quadro (veja "shadowmap.h")
+    glm::mat4 shadow_matrix;   // Sistema global -> mapa de sombras (veja ShadowMap_Matrix())
+};
+
+// Bloco "PassUniforms" (std140)
+struct PassUniforms
+{
+    glm::mat4 view;
+    glm::mat4 projection;
+    glm::vec4 camera_position; // Centro da câmera no sistema global (veja Matrix_Camera_Position())
+};
+
+// Elemento do bloco "DrawUniforms" (std140)
+struct DrawUniforms
+{
+    glm::vec4 bbox_min;
+    glm::vec4 bbox_max;
+    glm::vec4 position_offset;
+    glm::vec4 position_scale;
+};
+
+// Estado do OpenGL de um passo de renderização (combinação dos valores
+// RENDER_PASS_*). Os passos são desenhados em ordem crescente de índice.
+#define RENDER_PASS_CLEAR_DEPTH 0x01 // Limpa o Z-buffer antes do passo
+#define RENDER_PASS_DEPTH_TEST  0x02
+#define RENDER_PASS_CULL_FACE   0x04
+#define RENDER_PASS_BLEND       0x08 // Transparência com GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA
+#define RENDER_PASS_ORDERED     0x10 // Desenha na ordem de submissão, sem ordenar por estado (objetos transparentes)
+
+struct RenderPassState
+{
+    glm::mat4 view;
+    glm::mat4 projection;
+    glm::vec4 camera_position;
+    unsigned  flags;
+};
+
+// Intervalo de índices desenhado por um pacote (veja glDrawElementsBaseVertex())
+struct DrawRange
+{
+    GLsizei count;
+    size_t  first_index;
+    GLint   base_vertex;
+};
+
+// Atributos por instância, na ordem em que são lidos por "shader_vertex.glsl"
+// (posições 3 a 6 para a matriz de modelagem, 7 para "data", 8 para "draw",
+// o índice do desenho no bloco "DrawUniforms" ligado, e 9 a 11 para a matriz
+// das normais).
+struct InstanceData
+{
+    glm::mat4 model;
+    float     data;
+    GLint     draw;
+    glm::mat3 normal_matrix;
+};
+
+// Pacote de desenho. "material" identifica as texturas e o modelo de
+// iluminação do objeto; cada material tem o seu próprio "program" (veja
+// LoadShadersFromFiles() em "main.cpp"). "normal_matrix" é a inversa da
+// transposta de "model" (veja Matrix_Normal() em "matrices.h").
+// "instance_data" é um valor adicional do objeto, como o tempo de vida de uma
+// partícula de fumaça. "mesh" fornece a bounding box e a quantização das
+// posições (veja "vertexformat.h"), que devem ser as mesmas em todos os
+// intervalos do pacote.
+struct DrawPacket
+{
+    int                pass;
+    int                program;       // Índice retornado por RenderQueue_AddProgram()
+    int                material;
+    const SceneObject* mesh;
+    glm::mat4          model;
+    glm::mat3          normal_matrix;
+    float              instance_data;
+};
+
+// Contadores do último quadro. "state_changes" são as trocas de programa,
+// de VAO, de atributos por instância, de estado dos passos e de blocos de
+// uniforms efetivamente feitas; "state_changes_saved" são as que um desenho
+// na ordem de submissão, que definisse todo o estado de cada pacote com
+// glUniform*(), faria a mais.
+struct RenderQueueStats
+{
+    size_t packets;
+    size_t instanced_packets; // Pacotes desenhados como instâncias de outro
+    size_t draw_calls;
+    size_t state_changes;
+    size_t state_changes_saved;
+};
+
+struct RenderQueue
+{
+    std::vector<RenderProgram> programs;
+    RenderPassState            passes[RENDER_QUEUE_MAX_PASSES];
+    std::vector<DrawPacket>    packets;
+    std::vector<size_t>        first_range; // Intervalos de cada pacote em "ranges"
+    std::vector<size_t>        num_ranges;
+    std::vector<DrawRange>     ranges;
+    std::vector<InstanceData>  instances;   // Atributos por instância, na ordem de desenho
+    GLuint                     instance_buffer_id;
+    size_t                     instance_capacity;
+    FrameUniforms              frame;
+    std::vector<unsigned char> uniforms;    // Conteúdo da região do quadro no buffer de uniforms
+    GLuint                     uniform_buffer_id;
+    size_t                     uniform_frame_size; // Tamanho, em bytes, da região de cada quadro
+    size_t                     uniform_frame;      // Região usada pelo próximo RenderQueue_Flush()
+    GLsync                     uniform_fences[RENDER_QUEUE_UNIFORM_FRAMES];
+    GLint                      uniform_alignment;  // GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT
+    RenderQueueStats           stats;
+};
+
+// Cria os buffers de atributos por instância e de uniforms. Deve ser chamada
+// após a criação do contexto OpenGL.
+void RenderQueue_Init(RenderQueue* queue);
+
+// Liga os blocos "FrameUniforms", "PassUniforms" e "DrawUniforms" do
+// programa aos pontos RENDER_QUEUE_*_BINDING. Deve ser chamada para cada
+// programa registrado com RenderQueue_AddProgram().
+void RenderQueue_BindUniformBlocks(GLuint program_id);
+
+// Registra um programa de GPU e retorna o seu índice, usado nos pacotes.
+// Um programa recriado (veja "shadermanager.h") pode ser atualizado com
+// RenderQueue_SetProgram().
+int RenderQueue_AddProgram(RenderQueue* queue, const RenderProgram& program);
+void RenderQueue_SetProgram(RenderQueue* queue, int index, const RenderProgram& program);
+
+// Define as matrizes, a posição da câmera e o estado do passo "pass" para o
+// quadro atual. Deve ser chamada antes da submissão dos pacotes do passo.
+void RenderQueue_SetPass(RenderQueue* queue, int pass, const glm::mat4& view, const glm::mat4& projection,
+                         const glm::vec4& camera_position, unsigned flags);
+
+// Adiciona um pacote que desenha os intervalos "ranges".
+void RenderQueue_Submit(RenderQueue* queue, const DrawPacket& packet, const DrawRange* ranges, size_t num_ranges);
+
+// Ordena e desenha os pacotes submetidos, esvaziando a fila e atualizando
+// queue->stats. Ao final ficam ligados o último programa e o último VAO
+// usados, com GL_DEPTH_TEST e GL_CULL_FACE habilitados e GL_BLEND
+// desabilitado.
+void RenderQueue_Flush(RenderQueue* queue);
+
+#endif // _RENDERQUEUE_H
@@ -0,0 +1,45 @@
+#ifndef _SCENEGEOMETRY_H
+#define _SCENEGEOMETRY_H
+
+#include <cstddef>
+
+#include <glad/glad.h>
+
+#include "meshcache.h"
+
+// Buffers de geometria compartilhados por todos os modelos da cena: um único
+// VAO, um único VBO de vértices compactados (veja "vertexformat.h") e um
+// único buffer de índices. Cada modelo ocupa um intervalo destes buffers; os
+// seus índices continuam relativos ao primeiro vértice do modelo e são
+// deslocados no momento do desenho através do parâmetro "basevertex" de
+// glDrawElementsBaseVertex() e glMultiDrawElementsBaseVertex().
+struct SceneGeometry
+{
+    GLuint vertex_array_object_id;
+    GLuint vertex_buffer_id;
+    GLuint index_buffer_id;
+    size_t num_vertices;    // Vértices em uso
+    size_t vertex_capacity; // Vértices alocados na GPU
+    size_t num_indices;
+    size_t index_capacity;
+};
+
+// Cria o VAO e os buffers (inicialmente vazios).
+void SceneGeometry_Init(SceneGeometry* geometry);
+
+// Copia os vértices e índices de uma malha para o final dos buffers, que
+// crescem conforme necessário. Retorna em "base_vertex" a posição do primeiro
+// vértice da malha e em "first_index" a posição do seu primeiro índice.
+void SceneGeometry_Append(SceneGeometry* geometry, const MeshView& mesh, GLint* base_vertex, size_t* first_index);
+
+// Copia "count" índices, relativos a um "base_vertex" já existente, para o
+// final do buffer de índices e retorna em "first_index" a posição do
+// primeiro. Usada para juntar em um único intervalo objetos que são sempre
+// desenhados juntos.
+void SceneGeometry_AppendIndices(SceneGeometry* geometry, const GLuint* indices, size_t count, size_t* first_index);
+
+// Lê de volta da GPU os índices [first_index, first_index + count). Faz o
+// programa esperar pela GPU; deve ser usada apenas durante o carregamento.
+void SceneGeometry_ReadIndices(const SceneGeometry& geometry, size_t first_index, size_t count, GLuint* indices);
+
+#endif // _SCENEGEOMETRY_H
@@ -0,0 +1,68 @@
+#ifndef _SCENEREGISTRY_H
+#define _SCENEREGISTRY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include <glad/glad.h>
+
+#include <glm/vec3.hpp>
+
+#include "meshcache.h"
+
+// Objeto da cena virtual, criado a partir de um MeshObject por
+// AddMeshToVirtualScene() em "main.cpp".
+struct SceneObject
+{
+    std::string  name;        // Nome do objeto
+    size_t       first_index; // Índice do primeiro vértice dentro do vetor indices[] definido em BuildTrianglesAndAddToVirtualScene()
+    size_t       num_indices; // Número de índices do objeto dentro do vetor indices[] definido em BuildTrianglesAndAddToVirtualScene()
+    GLenum       rendering_mode; // Modo de rasterização (GL_TRIANGLES, GL_TRIANGLE_STRIP, etc.)
+    GLuint       vertex_array_object_id; // ID do VAO onde estão armazenados os atributos do modelo
+    glm::vec3    bbox_min; // Axis-Aligned Bounding Box do objeto
+    glm::vec3    bbox_max;
+    glm::vec3    position_offset; // Intervalo de quantização das posições dos vértices (veja "vertexformat.h")
+    glm::vec3    position_scale;
+    GLint        base_vertex; // Posição do primeiro vértice do modelo em g_SceneGeometry
+    int          num_lods; // Níveis de detalhe (veja "meshlod.h"); lods[0] é o próprio objeto
+    MeshLod      lods[MESH_MAX_LODS]; // first_index já inclui a posição da malha em g_SceneGeometry
+};
+
+// Identificador de um objeto da cena: a sua posição em SceneRegistry::objects.
+// Os nomes são convertidos em identificadores uma única vez, após o
+// carregamento, e o desenho acessa os objetos diretamente pelo índice.
+typedef int SceneObjectHandle;
+
+const SceneObjectHandle INVALID_SCENE_OBJECT = -1;
+
+// Hash FNV-1a de 64 bits do nome de um objeto. Para literais, use
+// SCENE_NAME(), que garante o cálculo em tempo de compilação.
+constexpr uint64_t SceneName(const char* name, uint64_t hash = 14695981039346656037ull)
+{
+    return (*name == '\0') ? hash : SceneName(name + 1, (hash ^ (unsigned char)*name) * 1099511628211ull);
+}
+
+#define SCENE_NAME(literal) (std::integral_constant<uint64_t, SceneName(literal)>::value)
+
+// Objetos da cena, guardados de forma contígua na ordem em que foram
+// adicionados, com um índice dos hashes dos seus nomes.
+struct SceneRegistry
+{
+    std::vector<SceneObject>                objects;
+    std::map<uint64_t, SceneObjectHandle>   names;
+};
+
+// Adiciona um objeto e retorna o seu identificador. Um objeto com o mesmo
+// nome de outro já existente o substitui, mantendo o identificador. O
+// programa é encerrado se dois nomes diferentes tiverem o mesmo hash.
+SceneObjectHandle SceneRegistry_Add(SceneRegistry* registry, const SceneObject& object);
+
+// Identificador do objeto com nome de hash "name" (veja SceneName()), ou
+// INVALID_SCENE_OBJECT se ele não existir.
+SceneObjectHandle SceneRegistry_Find(const SceneRegistry& registry, uint64_t name);
+
+#endif // _SCENEREGISTRY_H
@@ -0,0 +1,64 @@
+#ifndef _SHADERMANAGER_H
+#define _SHADERMANAGER_H
+
+#include <string>
+
+#include <glad/glad.h>
+
+// Compilação assíncrona dos programas de GPU. Todos os programas são
+// submetidos no início da execução (glCompileShader() e glLinkProgram() sem
+// nenhuma consulta de estado em seguida, o que forçaria a espera pelo
+// compilador) e ficam prontos enquanto as texturas e os modelos são
+// carregados.
+//
+// Se o driver oferecer KHR_parallel_shader_compile (ou a extensão ARB
+// equivalente), os shaders são compilados em threads do próprio driver e
+// ShaderManager_Update() consulta GL_COMPLETION_STATUS_KHR, que nunca
+// bloqueia. Caso contrário, ShaderManager_Update() finaliza no máximo um
+// programa por chamada.
+//
+// Os programas vêm do cache de binários sempre que possível (veja
+// "programcache.h"), que deve ser inicializado antes deste módulo.
+
+// Função chamada quando um programa fica pronto, para buscar as posições das
+// suas variáveis "uniform" e definir os seus valores iniciais. "permutation"
+// é o valor passado para ShaderManager_Submit().
+typedef void (*ShaderProgramReady)(GLuint program_id, int permutation);
+
+// Carrega as funções de compilação paralela com "load" (por exemplo
+// glfwGetProcAddress), se o driver as oferecer, e pede ao driver que use
+// quantas threads de compilação quiser.
+void ShaderManager_Init(GLADloadproc load);
+
+// Submete a compilação do programa "name" com os códigos "vertex_source" e
+// "fragment_source", lidos dos arquivos "vertex_filename" e
+// "fragment_filename" (usados nas mensagens de erro). Retorna um
+// identificador do programa, válido até o fim da execução. "on_ready" (que
+// pode ser NULL) é chamada na thread do contexto OpenGL, de dentro de
+// ShaderManager_Update() ou ShaderManager_Wait(), recebendo "permutation".
+int ShaderManager_Submit(const char* name, const char* vertex_filename, const std::string& vertex_source,
+                         const char* fragment_filename, const std::string& fragment_source, ShaderProgramReady on_ready,
+                         int permutation = 0);
+
+// Permutação de um shader: o código "source" com as linhas "defines" (por
+// exemplo "#define MATERIAL 2\n") inseridas logo após a diretiva "#version".
+// Cada permutação deve ser submetida com um nome próprio, que identifica o
+// seu binário no cache (veja "programcache.h").
+std::string ShaderManager_AddDefines(const std::string& source, const std::string& defines);
+
+// Finaliza os programas cuja compilação terminou: imprime os erros e avisos
+// do compilador, grava o binário no cache e chama "on_ready". Deve ser
+// chamada regularmente enquanto ShaderManager_Busy() retornar true.
+void ShaderManager_Update();
+
+// Espera a compilação do programa "program" terminar e o finaliza. Usada
+// quando o programa é necessário imediatamente.
+void ShaderManager_Wait(int program);
+
+// Retorna true enquanto houver programas não finalizados.
+bool ShaderManager_Busy();
+
+// Programa OpenGL de "program", ou 0 enquanto ele não estiver finalizado.
+GLuint ShaderManager_Program(int program);
+
+#endif // _SHADERMANAGER_H
@@ -0,0 +1,84 @@
+#ifndef _SHADOWMAP_H
+#define _SHADOWMAP_H
+
+#include <glad/glad.h>
+
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+
+// Mapa de sombras de uma luz spot (a lanterna), em duas camadas de
+// profundidade desenhadas com a mesma câmera da luz:
+//
+//  - A camada estática, com o cenário que não se move, é guardada e só é
+//    redesenhada quando a luz se afasta mais de SHADOW_MAP_MAX_DISTANCE da
+//    posição, ou gira mais de SHADOW_MAP_MAX_ANGLE da direção, em que ela foi
+//    desenhada. O frustum da luz é mais largo que o cone por esta margem,
+//    para que o cone continue dentro do mapa enquanto a camada é reusada.
+//
+//  - A camada final, lida pelos shaders, é a cópia da camada estática com os
+//    objetos que se movem desenhados por cima, a cada quadro. O custo por
+//    quadro depende apenas dos objetos que se movem.
+//
+// Enquanto a camada estática é reusada, as sombras são projetadas a partir
+// da posição e da direção em que ela foi desenhada, e não das atuais.
+
+// Afastamento e rotação máximos da luz antes de redesenhar a camada estática
+#define SHADOW_MAP_MAX_DISTANCE 0.5f
+#define SHADOW_MAP_MAX_ANGLE    0.26f // Em radianos (cerca de 15 graus)
+
+// Unidade de textura da camada final. As unidades 0 a 15 são usadas pelas
+// texturas de "main.cpp", a 29 e a 30 por "lightclusters.h" e a 31 por
+// "textrendering.cpp".
+#define SHADOW_MAP_TEXTURE_UNIT 28
+
+struct ShadowMap
+{
+    GLsizei   size;                  // Largura e altura das camadas, em texels
+    GLuint    static_texture_id;     // Camada estática
+    GLuint    static_framebuffer_id;
+    GLuint    texture_id;            // Camada final
+    GLuint    framebuffer_id;
+    glm::mat4 view;                  // Câmera da luz das duas camadas
+    glm::mat4 projection;
+    glm::vec3 static_position;       // Posição e direção da luz na camada estática
+    glm::vec3 static_direction;
+    bool      static_valid;
+    size_t    static_renders;        // Número de vezes que a camada estática foi desenhada
+};
+
+// Cria as duas camadas com "size" x "size" texels. A camada final fica
+// ligada à unidade SHADOW_MAP_TEXTURE_UNIT, com comparação de profundidade
+// habilitada (sampler2DShadow nos shaders). Deve ser chamada após a criação
+// do contexto OpenGL.
+void ShadowMap_Init(ShadowMap* shadow_map, GLsizei size);
+
+// Informa a posição e a direção atuais da luz e a câmera "view" /
+// "projection" correspondente. Retorna true se a camada estática precisa ser
+// redesenhada; neste caso a câmera da luz passa a ser "view" / "projection".
+// O campo de visão da câmera deve ser mais largo que o cone da luz por
+// SHADOW_MAP_MAX_ANGLE em cada lado.
+bool ShadowMap_Update(ShadowMap* shadow_map, const glm::vec4& position, const glm::vec4& direction,
+                      const glm::mat4& view, const glm::mat4& projection);
+
+// Marca a camada estática para ser redesenhada no próximo ShadowMap_Update().
+// Deve ser chamada quando os objetos da camada ou o programa que os desenha
+// mudam.
+void ShadowMap_Invalidate(ShadowMap* shadow_map);
+
+// Direcionam os desenhos para a camada estática (que é limpa) ou para a
+// camada final (que recebe uma cópia da camada estática). Os desenhos
+// seguintes devem usar a câmera "view" / "projection" da luz. A profundidade
+// gravada é deslocada com glPolygonOffset() para evitar que as superfícies
+// façam sombra sobre si mesmas.
+void ShadowMap_BeginStatic(ShadowMap* shadow_map);
+void ShadowMap_BeginDynamic(const ShadowMap& shadow_map);
+
+// Volta a desenhar no framebuffer da janela, com dimensões "width" x "height".
+void ShadowMap_End(int width, int height);
+
+// Matriz que leva um ponto do sistema global às coordenadas de textura (x,y)
+// e à profundidade (z) do mapa, em [0,1], após a divisão por w.
+glm::mat4 ShadowMap_Matrix(const ShadowMap& shadow_map);
+
+#endif // _SHADOWMAP_H
@@ -0,0 +1,60 @@
+#ifndef _TEXTUREATLAS_H
+#define _TEXTUREATLAS_H
+
+#include <cstddef>
+#include <vector>
+
+#include "meshcache.h"
+#include "texturecache.h"
+
+// Maior lado, em texels, de uma imagem dentro do atlas. Imagens maiores são
+// substituídas pelo primeiro nível da sua cadeia de mipmaps que couber.
+#define ATLAS_MAX_IMAGE_SIZE 512
+
+// Número de níveis de mipmap do atlas (além do nível 0) em que as imagens não
+// se misturam. Cada imagem é cercada por uma borda de 2^ATLAS_PADDING_LEVELS
+// texels, que repete os texels da sua borda (como GL_CLAMP_TO_EDGE), e todos
+// os retângulos começam e terminam em múltiplos desse valor. Assim, até o
+// nível ATLAS_PADDING_LEVELS cada texel do mipmap é calculado a partir de uma
+// única imagem e a filtragem bilinear nas bordas só alcança a própria borda.
+// Os níveis menores são descartados.
+#define ATLAS_PADDING_LEVELS 4
+
+// Imagem RGB (3 bytes por texel, linhas sem preenchimento) a ser empacotada
+struct AtlasImage
+{
+    const unsigned char* pixels;
+    int                  width;
+    int                  height;
+};
+
+// Posição de uma imagem no atlas: as coordenadas de textura (u,v) da imagem,
+// em [0,1], correspondem a offset + (u,v)*scale no atlas.
+struct AtlasRegion
+{
+    float offset[2];
+    float scale[2];
+};
+
+// Atlas RGB em espaço sRGB, com a sua cadeia de mipmaps (ATLAS_PADDING_LEVELS
+// + 1 níveis no máximo) e uma região por imagem, na ordem de entrada.
+struct TextureAtlas
+{
+    std::vector<unsigned char> storage;
+    TextureLevels              levels;
+    std::vector<AtlasRegion>   regions;
+};
+
+// Empacota as imagens em prateleiras (shelf packing), da mais alta para a
+// mais baixa, escolhendo as dimensões (potências de 2) de menor área.
+void BuildTextureAtlas(const std::vector<AtlasImage>& images, TextureAtlas* atlas);
+
+// Copia a malha "mesh" para "remapped", transformando as coordenadas de
+// textura de cada objeto i para a região object_regions[i] (NULL mantém as
+// coordenadas originais). As coordenadas são limitadas a [0,1] antes da
+// transformação, como GL_CLAMP_TO_EDGE. Vértices compartilhados por objetos
+// com regiões diferentes são duplicados; todos os níveis de detalhe dos
+// objetos são atualizados.
+void RemapMeshToAtlas(const MeshView& mesh, const AtlasRegion* const* object_regions, MeshData* remapped);
+
+#endif // _TEXTUREATLAS_H
@@ -0,0 +1,83 @@
+#ifndef _TEXTURECACHE_H
+#define _TEXTURECACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "mappedfile.h"
+
+// Versão do formato binário do cache de texturas. Deve ser incrementada
+// sempre que o conteúdo gerado por BuildMipChain() mudar.
+#define TEXCACHE_VERSION 2
+
+// Número máximo de níveis de mipmap (suficiente para texturas de até 32768 texels)
+#define TEXCACHE_MAX_LEVELS 16
+
+// Formato dos texels de uma textura, escolhido de acordo com o seu uso.
+enum TextureFormat
+{
+    TEXTURE_SRGB,       // Cor RGB em espaço sRGB
+    TEXTURE_SRGB_ALPHA, // Cor RGB em espaço sRGB e opacidade linear
+    TEXTURE_NORMAL_MAP, // Componentes x e y de um mapa de normais (z é reconstruído no shader)
+    TEXTURE_MASK,       // Um único canal linear (máscaras, mapas especulares)
+};
+
+// Número de bytes por texel de cada formato (um por canal).
+int TextureChannels(TextureFormat format);
+
+// Cadeia de mipmaps de uma imagem (TextureChannels(format) bytes por texel,
+// linhas sem preenchimento), do nível 0 (imagem original) até o nível 1x1.
+struct TextureLevels
+{
+    TextureFormat        format;
+    int                  num_levels;
+    int                  width[TEXCACHE_MAX_LEVELS];
+    int                  height[TEXCACHE_MAX_LEVELS];
+    const unsigned char* pixels[TEXCACHE_MAX_LEVELS];
+};
+
+// Converte uma intensidade linear em [0,1] para um valor sRGB de 8 bits.
+unsigned char LinearToSrgb(float c);
+
+// Gera a cadeia de mipmaps de uma imagem no formato "format". Cada nível é
+// calculado a partir do anterior com um filtro de caixa 2x2: as cores sRGB
+// são filtradas em espaço de cor linear (como esperado para texturas
+// GL_SRGB8) e ponderadas pela opacidade, os canais lineares são filtrados
+// diretamente e as normais são somadas como vetores e normalizadas. Os
+// texels de todos os níveis (inclusive uma cópia do nível 0) são guardados
+// em "storage", para o qual apontam os ponteiros de "levels".
+//
+// "pixels" tem TextureChannels(format) canais, exceto para
+// TEXTURE_NORMAL_MAP, em que tem 3 canais (x, y, z), dos quais apenas x e y
+// são guardados.
+void BuildMipChain(const unsigned char* pixels, int width, int height, TextureFormat format,
+                   std::vector<unsigned char>* storage, TextureLevels* levels);
+
+// Cache aberto com TextureCache_Load(). Os texels continuam no arquivo
+// mapeado em memória e podem ser enviados diretamente para a GPU.
+struct TextureCache
+{
+    MappedFile    file;
+    TextureLevels levels;
+};
+
+// Nome do arquivo de cache correspondente a um arquivo de imagem.
+std::string TextureCache_Filename(const char* image_filename);
+
+// Abre o cache da imagem "image_filename", no formato "format". O cache é
+// identificado pelo hash do conteúdo da imagem original; retorna false se ele
+// não existir, se a imagem tiver sido modificada, se o formato for outro ou
+// se o arquivo estiver corrompido.
+bool TextureCache_Load(const char* image_filename, TextureFormat format, TextureCache* cache);
+
+// Libera o mapeamento de um cache aberto com TextureCache_Load().
+void TextureCache_Close(TextureCache* cache);
+
+// Grava o cache da imagem "image_filename" com a cadeia de mipmaps "levels".
+// Falhas de escrita não são fatais: a imagem apenas continuará sendo
+// decodificada na próxima execução.
+bool TextureCache_Save(const char* image_filename, const TextureLevels& levels);
+
+#endif // _TEXTURECACHE_H
@@ -0,0 +1,72 @@
+#ifndef _TEXTURESTREAMER_H
+#define _TEXTURESTREAMER_H
+
+#include <cstddef>
+#include <vector>
+
+#include <glad/glad.h>
+
+#include "texturecache.h"
+
+// Envio gradual dos níveis de mipmap das texturas para a GPU. Ao ser
+// carregada, cada textura recebe imediatamente apenas os seus níveis menores
+// (veja TextureStreamer_Add()); os demais são enviados a cada quadro por
+// TextureStreamer_Update(), do menor para o maior, através de pixel buffer
+// objects (PBOs), sem bloquear a thread de renderização.
+//
+// Um nível só passa a ser amostrado (GL_TEXTURE_BASE_LEVEL) depois que a
+// fence criada com glFenceSync() logo após o seu envio é sinalizada, isto é,
+// quando a cópia para a GPU terminou. Até lá os objetos são desenhados com os
+// níveis menores, que já estão residentes.
+//
+// O módulo também escolhe o formato de cada textura na GPU e controla a
+// memória ocupada por elas: antes de enviar os níveis maiores, descarta os
+// que não cabem no orçamento, começando pelas texturas de menor prioridade.
+
+// Prioridade de uma textura no orçamento de memória. Os níveis maiores das
+// texturas TEXTURE_TIER_DETAIL são descartados primeiro, depois os das
+// texturas TEXTURE_TIER_COLOR. As texturas TEXTURE_TIER_UI nunca perdem
+// níveis nem são comprimidas.
+enum TextureTier
+{
+    TEXTURE_TIER_DETAIL, // Mapas de normais, especulares e máscaras
+    TEXTURE_TIER_COLOR,  // Cores dos objetos da cena
+    TEXTURE_TIER_UI,     // Telas e elementos da interface
+};
+
+// Inicializa o módulo. "bytes_per_frame" limita a quantidade de texels
+// copiados para PBOs em cada quadro (pelo menos um nível é enviado por
+// quadro) e "budget_bytes" limita a memória ocupada pelas texturas na GPU.
+// Se "compression" for true, as texturas que não são de interface usam
+// formatos comprimidos pelo driver no envio: RGTC para mapas de normais e
+// máscaras (sempre disponível no OpenGL 3.3) e S3TC para cores, se o driver
+// o listar em GL_COMPRESSED_TEXTURE_FORMATS.
+void TextureStreamer_Init(size_t bytes_per_frame, size_t budget_bytes, bool compression);
+
+// Envia para a textura "texture_id" os níveis de "levels" com até
+// "resident_size" texels de lado, do menor para o maior, e agenda o envio dos
+// demais. O módulo assume a posse dos texels: do mapeamento "cache" se
+// from_cache == true, ou do vetor "storage" (que é esvaziado) caso contrário.
+void TextureStreamer_Add(GLuint texture_id, const TextureLevels& levels, TextureTier tier, int resident_size,
+                         bool from_cache, TextureCache* cache, std::vector<unsigned char>* storage);
+
+// Verifica as fences dos envios em andamento e inicia novos envios, dentro
+// do limite de bytes por quadro. Deve ser chamada uma vez por quadro, na
+// thread do contexto OpenGL.
+void TextureStreamer_Update();
+
+// Retorna true enquanto houver níveis a enviar ou envios em andamento.
+bool TextureStreamer_Busy();
+
+// Memória ocupada pelos níveis já enviados para a GPU, e a que estará
+// ocupada quando todos os níveis que cabem no orçamento forem enviados. As
+// texturas RGB não comprimidas são contadas com 4 bytes por texel, como são
+// armazenadas pela maioria dos drivers.
+size_t TextureStreamer_ResidentBytes();
+size_t TextureStreamer_PlannedBytes();
+
+// Soma "bytes" à memória residente, para texturas enviadas para a GPU sem
+// passar pelo módulo (como o cubemap do céu).
+void TextureStreamer_AddResidentBytes(size_t bytes);
+
+#endif // _TEXTURESTREAMER_H
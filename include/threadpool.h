@@ -0,0 +1,25 @@
+#ifndef _THREADPOOL_H
+#define _THREADPOOL_H
+
+#include <functional>
+
+// Conjunto de threads de trabalho que executam tarefas de uma fila comum.
+// Usado para carregar assets (decodificação de imagens, leitura de modelos)
+// em paralelo, enquanto a thread principal mantém o contexto OpenGL.
+// As tarefas não podem fazer chamadas OpenGL.
+struct ThreadPool;
+
+// Cria "num_threads" threads de trabalho. Se num_threads <= 0, usa o número
+// de núcleos do processador.
+ThreadPool* ThreadPool_Create(int num_threads);
+
+// Número de threads de trabalho do pool.
+int ThreadPool_Size(const ThreadPool* pool);
+
+// Adiciona uma tarefa ao final da fila.
+void ThreadPool_Submit(ThreadPool* pool, const std::function<void()>& task);
+
+// Espera todas as tarefas terminarem e destrói o pool.
+void ThreadPool_Destroy(ThreadPool* pool);
+
+#endif // _THREADPOOL_H
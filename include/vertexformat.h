@@ -0,0 +1,54 @@
+#ifndef _VERTEXFORMAT_H
+#define _VERTEXFORMAT_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include <glad/glad.h>
+
+#include <glm/vec3.hpp>
+
+// Vértice compactado e intercalado armazenado nos VBOs da cena. Ocupa 16
+// bytes, contra 40 bytes do formato anterior (vec4 posição + vec4 normal +
+// vec2 coordenadas de textura, em três VBOs separados).
+//
+//    position  : XYZ em GL_UNSIGNED_SHORT normalizado, relativos ao intervalo
+//                PositionQuantization do modelo (+ 2 bytes de preenchimento)
+//    normal    : XYZ em GL_INT_2_10_10_10_REV normalizado (W = 0)
+//    texcoords : UV em GL_HALF_FLOAT
+//
+// Veja AddMeshToVirtualScene() em "main.cpp" e a decodificação em
+// "shader_vertex.glsl".
+struct PackedVertex
+{
+    GLushort position[4];
+    GLuint   normal;
+    GLushort texcoords[2];
+};
+
+// Intervalo usado na quantização das posições de um modelo. A posição
+// original é recuperada no vertex shader como offset + q*scale, onde q está
+// em [0,1]. Todos os objetos de um mesmo modelo compartilham o intervalo.
+struct PositionQuantization
+{
+    glm::vec3 offset;
+    glm::vec3 scale;
+};
+
+// Calcula o intervalo de quantização que contém todas as posições (vec4,
+// como geradas por BuildTriangles()) de um modelo.
+PositionQuantization ComputePositionQuantization(const float* model_coefficients, size_t num_vertices);
+
+// Converte os vetores de floats de um modelo para o formato PackedVertex.
+// "normal_coefficients" (vec4) e "texture_coefficients" (vec2) podem ser NULL.
+void PackVertices(const float* model_coefficients, const float* normal_coefficients, const float* texture_coefficients,
+                  size_t num_vertices, const PositionQuantization& quantization, PackedVertex* vertices);
+
+// Conversão de float para half float (IEEE 754 binary16), com arredondamento
+// para o mais próximo.
+GLushort FloatToHalf(float value);
+
+// Conversão inversa de FloatToHalf() (exata).
+float HalfToFloat(GLushort half);
+
+#endif // _VERTEXFORMAT_H
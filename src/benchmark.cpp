@@ -0,0 +1,358 @@
+// Benchmarks das etapas de carregamento que rodam na CPU. Não depende de
+// OpenGL nem de janela; compile e execute com "make benchmark".
+//
+//    ./benchmark [arquivo.obj ...]
+//
+// Sem argumentos, usa os modelos mais pesados do jogo para ComputeNormals e
+// todos os modelos de "data/Objects" para ReadObj.
+//
+// O custo dos shaders na GPU é medido pelo próprio jogo, com "make fillrate"
+// (veja RunFillRateBenchmark() em "main.cpp").
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include <algorithm>
+
+#include <glm/vec4.hpp>
+#include <glm/geometric.hpp>
+#include <tiny_obj_loader.h>
+
+#include "normals.h"
+#include "objreader.h"
+#include "mappedfile.h"
+
+namespace
+{
+    // Número de repetições de cada medida; reportamos o menor tempo.
+    const int NUM_RUNS = 20;
+
+    double Now()
+    {
+        using namespace std::chrono;
+        return duration<double>(steady_clock::now().time_since_epoch()).count();
+    }
+
+    // Implementação anterior de ComputeNormals(), mantida aqui como
+    // referência: média das normais das faces com glm::vec4, contador de
+    // triângulos e divisão por vértice.
+    void ComputeNormalsReference(const tinyobj::attrib_t& attrib, const std::vector<tinyobj::shape_t>& shapes, std::vector<float>* normals)
+    {
+        size_t num_vertices = attrib.vertices.size() / 3;
+
+        std::vector<int> num_triangles_per_vertex(num_vertices, 0);
+        std::vector<glm::vec4> vertex_normals(num_vertices, glm::vec4(0.0f,0.0f,0.0f,0.0f));
+
+        for (size_t shape = 0; shape < shapes.size(); ++shape)
+        {
+            size_t num_triangles = shapes[shape].mesh.num_face_vertices.size();
+
+            for (size_t triangle = 0; triangle < num_triangles; ++triangle)
+            {
+                glm::vec4  vertices[3];
+                for (size_t vertex = 0; vertex < 3; ++vertex)
+                {
+                    tinyobj::index_t idx = shapes[shape].mesh.indices[3*triangle + vertex];
+                    const float vx = attrib.vertices[3*idx.vertex_index + 0];
+                    const float vy = attrib.vertices[3*idx.vertex_index + 1];
+                    const float vz = attrib.vertices[3*idx.vertex_index + 2];
+                    vertices[vertex] = glm::vec4(vx,vy,vz,1.0);
+                }
+
+                const glm::vec4  u = vertices[1] - vertices[0];
+                const glm::vec4  v = vertices[2] - vertices[0];
+                const glm::vec4  n = glm::vec4(u.y*v.z - u.z*v.y, u.z*v.x - u.x*v.z, u.x*v.y - u.y*v.x, 0.0f);
+
+                for (size_t vertex = 0; vertex < 3; ++vertex)
+                {
+                    tinyobj::index_t idx = shapes[shape].mesh.indices[3*triangle + vertex];
+                    num_triangles_per_vertex[idx.vertex_index] += 1;
+                    vertex_normals[idx.vertex_index] += n;
+                }
+            }
+        }
+
+        normals->resize(3*num_vertices);
+        for (size_t i = 0; i < vertex_normals.size(); ++i)
+        {
+            glm::vec4 n = vertex_normals[i] / (float)num_triangles_per_vertex[i];
+            n /= glm::length(n);
+            (*normals)[3*i + 0] = n.x;
+            (*normals)[3*i + 1] = n.y;
+            (*normals)[3*i + 2] = n.z;
+        }
+    }
+
+    // Maior ângulo (em graus) entre as normais das duas versões
+    double MaxAngleDifference(const std::vector<float>& a, const std::vector<float>& b)
+    {
+        double max_angle = 0.0;
+        for (size_t i = 0; i + 2 < a.size(); i += 3)
+        {
+            double dot = a[i]*b[i] + a[i+1]*b[i+1] + a[i+2]*b[i+2];
+            if ( dot != dot )
+                continue; // Vértice não usado por nenhum triângulo
+            dot = std::min(1.0, std::max(-1.0, dot));
+            max_angle = std::max(max_angle, acos(dot) * 180.0 / 3.14159265358979);
+        }
+        return max_angle;
+    }
+
+    void BenchmarkNormals(const char* filename)
+    {
+        tinyobj::attrib_t                attrib;
+        std::vector<tinyobj::shape_t>    shapes;
+        std::vector<tinyobj::material_t> materials;
+        std::string                      warn;
+        std::string                      err;
+
+        if ( !tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, filename, NULL, true) )
+        {
+            fprintf(stderr, "ERROR: Cannot load \"%s\": %s\n", filename, err.c_str());
+            std::exit(EXIT_FAILURE);
+        }
+
+        size_t num_vertices = attrib.vertices.size() / 3;
+        std::vector<unsigned int> triangles;
+        for (size_t shape = 0; shape < shapes.size(); ++shape)
+            for (size_t i = 0; i < shapes[shape].mesh.indices.size(); ++i)
+                triangles.push_back(shapes[shape].mesh.indices[i].vertex_index);
+        size_t num_triangles = triangles.size() / 3;
+
+        std::vector<float> reference;
+        std::vector<float> normals(3*num_vertices);
+
+        double best_reference = 1e30;
+        for (int run = 0; run < NUM_RUNS; ++run)
+        {
+            double start = Now();
+            ComputeNormalsReference(attrib, shapes, &reference);
+            best_reference = std::min(best_reference, Now() - start);
+        }
+
+        printf("%s: %zu vértices, %zu triângulos\n", filename, num_vertices, num_triangles);
+        printf("    referência (glm::vec4, AoS)   %8.3f ms\n", 1000.0*best_reference);
+
+        int max_threads = std::max(1, (int)std::thread::hardware_concurrency());
+        for (int threads = 1; threads <= max_threads; threads *= 2)
+        {
+            double best = 1e30;
+            for (int run = 0; run < NUM_RUNS; ++run)
+            {
+                double start = Now();
+                ComputeVertexNormals(attrib.vertices.data(), num_vertices, triangles.data(), num_triangles, normals.data(), threads);
+                best = std::min(best, Now() - start);
+            }
+
+            printf("    ComputeVertexNormals, %2d thr %8.3f ms  (%.2fx, desvio máximo %.4f graus)\n",
+                threads, 1000.0*best, best_reference / best, MaxAngleDifference(reference, normals));
+        }
+
+        // Malhas do jogo são pequenas e ficam abaixo do limite de triângulos
+        // por thread; medimos também uma versão repetida da malha para ver o
+        // ganho da divisão entre threads.
+        if ( num_triangles < (size_t)NORMALS_MIN_TRIANGLES_PER_THREAD * max_threads && max_threads > 1 )
+        {
+            size_t copies = (size_t)NORMALS_MIN_TRIANGLES_PER_THREAD * max_threads / num_triangles + 1;
+            std::vector<float> big_positions;
+            std::vector<unsigned int> big_triangles;
+            for (size_t c = 0; c < copies; ++c)
+            {
+                big_positions.insert(big_positions.end(), attrib.vertices.begin(), attrib.vertices.end());
+                for (size_t i = 0; i < triangles.size(); ++i)
+                    big_triangles.push_back((unsigned int)(triangles[i] + c*num_vertices));
+            }
+            std::vector<float> big_normals(big_positions.size());
+
+            for (int threads = 1; threads <= max_threads; threads *= 2)
+            {
+                double best = 1e30;
+                for (int run = 0; run < NUM_RUNS; ++run)
+                {
+                    double start = Now();
+                    ComputeVertexNormals(big_positions.data(), big_positions.size() / 3, big_triangles.data(), big_triangles.size() / 3, big_normals.data(), threads);
+                    best = std::min(best, Now() - start);
+                }
+                printf("    %zux a malha, %2d thr          %8.3f ms\n", copies, threads, 1000.0*best);
+            }
+        }
+    }
+
+    // Lê "filename" com a tinyobjloader (reference == true) ou com ReadObj()
+    bool LoadModel(const char* filename, bool reference, int threads, tinyobj::attrib_t* attrib,
+                   std::vector<tinyobj::shape_t>* shapes, std::vector<tinyobj::material_t>* materials)
+    {
+        std::string warn;
+        std::string err;
+        std::string basedir(filename);
+        basedir = basedir.substr(0, basedir.find_last_of("/") + 1);
+
+        materials->clear();
+        bool ok = reference
+            ? tinyobj::LoadObj(attrib, shapes, materials, &warn, &err, filename, basedir.c_str(), true)
+            : ReadObj(filename, basedir.c_str(), attrib, shapes, materials, &warn, &err, threads);
+        if ( !ok )
+            fprintf(stderr, "ERROR: Cannot load \"%s\": %s\n", filename, err.c_str());
+        return ok;
+    }
+
+    // Compara o resultado de ReadObj() com o da tinyobjloader. Retorna uma
+    // descrição da primeira diferença, ou uma string vazia.
+    std::string CompareModels(const tinyobj::attrib_t& a, const std::vector<tinyobj::shape_t>& a_shapes,
+                              const tinyobj::attrib_t& b, const std::vector<tinyobj::shape_t>& b_shapes)
+    {
+        if ( a.vertices != b.vertices )   return "posições diferentes";
+        if ( a.normals != b.normals )     return "normais diferentes";
+        if ( a.texcoords != b.texcoords ) return "coordenadas de textura diferentes";
+        if ( a.colors != b.colors )       return "cores diferentes";
+        if ( a_shapes.size() != b_shapes.size() )
+            return "número de shapes diferente";
+
+        for (size_t s = 0; s < a_shapes.size(); ++s)
+        {
+            const tinyobj::mesh_t& ma = a_shapes[s].mesh;
+            const tinyobj::mesh_t& mb = b_shapes[s].mesh;
+            if ( a_shapes[s].name != b_shapes[s].name )
+                return "nome do shape \"" + a_shapes[s].name + "\" diferente";
+            if ( ma.indices.size() != mb.indices.size()
+              || ma.num_face_vertices != mb.num_face_vertices
+              || ma.material_ids != mb.material_ids
+              || ma.smoothing_group_ids != mb.smoothing_group_ids )
+                return "faces do shape \"" + a_shapes[s].name + "\" diferentes";
+            for (size_t i = 0; i < ma.indices.size(); ++i)
+            {
+                if ( ma.indices[i].vertex_index   != mb.indices[i].vertex_index
+                  || ma.indices[i].normal_index   != mb.indices[i].normal_index
+                  || ma.indices[i].texcoord_index != mb.indices[i].texcoord_index )
+                    return "índices do shape \"" + a_shapes[s].name + "\" diferentes";
+            }
+        }
+        return std::string();
+    }
+
+    // Menor tempo de leitura de "filename" em NUM_RUNS repetições
+    double TimeLoadModel(const char* filename, bool reference, int threads)
+    {
+        double best = 1e30;
+        for (int run = 0; run < NUM_RUNS; ++run)
+        {
+            tinyobj::attrib_t                attrib;
+            std::vector<tinyobj::shape_t>    shapes;
+            std::vector<tinyobj::material_t> materials;
+
+            double start = Now();
+            if ( !LoadModel(filename, reference, threads, &attrib, &shapes, &materials) )
+                std::exit(EXIT_FAILURE);
+            best = std::min(best, Now() - start);
+        }
+        return best;
+    }
+
+    void BenchmarkObjReader(const char* filename)
+    {
+        FileStamp stamp;
+        if ( !GetFileStamp(filename, &stamp) )
+        {
+            fprintf(stderr, "ERROR: Cannot open \"%s\"\n", filename);
+            std::exit(EXIT_FAILURE);
+        }
+        double megabytes = stamp.size / (1024.0 * 1024.0);
+
+        tinyobj::attrib_t                reference_attrib, attrib;
+        std::vector<tinyobj::shape_t>    reference_shapes, shapes;
+        std::vector<tinyobj::material_t> materials;
+        if ( !LoadModel(filename, true, 0, &reference_attrib, &reference_shapes, &materials)
+          || !LoadModel(filename, false, 0, &attrib, &shapes, &materials) )
+            std::exit(EXIT_FAILURE);
+        std::string difference = CompareModels(attrib, shapes, reference_attrib, reference_shapes);
+
+        double reference = TimeLoadModel(filename, true, 0);
+
+        printf("%s: %.1f KB, %zu shapes, %s\n", filename, 1024.0*megabytes, shapes.size(),
+            difference.empty() ? "resultado idêntico à tinyobjloader" : ("DIFERENÇA: " + difference).c_str());
+        printf("    tinyobj::LoadObj              %8.3f ms  (%7.1f MB/s)\n", 1000.0*reference, megabytes / reference);
+
+        int max_threads = std::max(1, (int)std::thread::hardware_concurrency());
+        for (int threads = 1; threads <= max_threads; threads *= 2)
+        {
+            double best = TimeLoadModel(filename, false, threads);
+            printf("    ReadObj, %2d thr               %8.3f ms  (%7.1f MB/s, %.2fx)\n",
+                threads, 1000.0*best, megabytes / best, reference / best);
+        }
+
+        // Assim como as malhas em BenchmarkNormals(), os arquivos do jogo são
+        // pequenos demais para serem divididos entre todas as threads; medimos
+        // também um arquivo temporário com o conteúdo repetido.
+        size_t min_size = (size_t)OBJ_MIN_BYTES_PER_THREAD * max_threads;
+        if ( stamp.size < min_size && max_threads > 1 )
+        {
+            MappedFile file;
+            if ( !MapFile(filename, &file) )
+                return;
+
+            const char* big_filename = "objreader_benchmark.obj";
+            FILE* big_file = fopen(big_filename, "wb");
+            if ( big_file == NULL )
+            {
+                UnmapFile(&file);
+                return;
+            }
+            size_t copies = min_size / file.size + 1;
+            for (size_t c = 0; c < copies; ++c)
+            {
+                fwrite(file.data, 1, file.size, big_file);
+                fputc('\n', big_file);
+            }
+            fclose(big_file);
+            UnmapFile(&file);
+
+            double big_megabytes = copies * (stamp.size + 1) / (1024.0 * 1024.0);
+            double big_reference = TimeLoadModel(big_filename, true, 0);
+            printf("    %zux o arquivo, tinyobj      %8.3f ms  (%7.1f MB/s)\n", copies, 1000.0*big_reference, big_megabytes / big_reference);
+            for (int threads = 1; threads <= max_threads; threads *= 2)
+            {
+                double best = TimeLoadModel(big_filename, false, threads);
+                printf("    %zux o arquivo, %2d thr       %8.3f ms  (%7.1f MB/s, %.2fx)\n",
+                    copies, threads, 1000.0*best, big_megabytes / best, big_reference / best);
+            }
+            remove(big_filename);
+        }
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    std::vector<const char*> files;
+    for (int i = 1; i < argc; ++i)
+        files.push_back(argv[i]);
+
+    std::vector<const char*> normals_files = files;
+    std::vector<const char*> obj_files = files;
+    if ( files.empty() )
+    {
+        normals_files.push_back("../../data/Objects/skull.OBJ");
+        normals_files.push_back("../../data/Objects/cabin.obj");
+
+        const char* objects[] = { "skull.OBJ", "cabin.obj", "car.obj", "flashlight.obj", "carglass.obj",
+                                  "bullet.obj", "sphere.obj", "eye.obj", "plane.obj", "screen.obj",
+                                  "tela_fim_de_jogo.obj" };
+        static std::vector<std::string> paths;
+        for (size_t i = 0; i < sizeof(objects) / sizeof(objects[0]); ++i)
+            paths.push_back(std::string("../../data/Objects/") + objects[i]);
+        for (size_t i = 0; i < paths.size(); ++i)
+            obj_files.push_back(paths[i].c_str());
+    }
+
+    printf("== ComputeNormals ==\n");
+    for (size_t i = 0; i < normals_files.size(); ++i)
+        BenchmarkNormals(normals_files[i]);
+
+    printf("\n== ReadObj ==\n");
+    for (size_t i = 0; i < obj_files.size(); ++i)
+        BenchmarkObjReader(obj_files[i]);
+
+    return 0;
+}
@@ -0,0 +1,298 @@
+// Conversão de imagens HDR equirretangulares em cubemaps e cache binário do
+// resultado. O arquivo ".envcache" guarda todos os níveis do cubemap já no
+// formato GL_RGB9_E5, de forma que nas execuções seguintes não é necessário
+// decodificar a imagem HDR nem reamostrá-la: o arquivo é mapeado em memória e
+// cada face é enviada diretamente com glTexImage2D().
+//
+// Layout do arquivo:
+//
+//    EnvCacheHeader
+//    faces do nível 0      (+X, -X, +Y, -Y, +Z, -Z, alinhado em 16 bytes)
+//    faces do nível 1      (+X, -X, +Y, -Y, +Z, -Z, alinhado em 16 bytes)
+//    ...
+//
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+#include "environmentmap.h"
+
+namespace
+{
+    const char ENVCACHE_MAGIC[8] = "FCGENV";
+
+    struct EnvCacheHeader
+    {
+        char     magic[8];
+        uint32_t version;
+        uint32_t num_levels;
+        uint64_t source_size;  // Carimbo da imagem HDR de origem
+        int64_t  source_mtime;
+        uint32_t size[ENVIRONMENT_MAX_LEVELS];
+        uint64_t offset[ENVIRONMENT_MAX_LEVELS];
+    };
+
+    const float PI = 3.14159265358979323846f;
+
+    uint64_t Align16(uint64_t offset)
+    {
+        return (offset + 15) & ~(uint64_t)15;
+    }
+
+    size_t LevelTexels(int size)
+    {
+        return 6 * (size_t)size * (size_t)size;
+    }
+
+    // Codifica uma cor linear no formato RGB9_E5, seguindo a especificação
+    // de EXT_texture_shared_exponent.
+    uint32_t EncodeRgb9e5(const float* rgb)
+    {
+        const int   MANTISSA_BITS = 9;
+        const int   EXP_BIAS      = 15;
+        const int   MAX_EXP       = 31;
+        const float MAX_VALUE     = (float)((1 << MANTISSA_BITS) - 1) / (1 << MANTISSA_BITS) * (float)(1 << (MAX_EXP - EXP_BIAS));
+
+        float c[3];
+        for (int k = 0; k < 3; ++k)
+            c[k] = (rgb[k] > 0.0f) ? std::min(rgb[k], MAX_VALUE) : 0.0f; // Também descarta NaN
+        float max_c = std::max(c[0], std::max(c[1], c[2]));
+
+        int exponent = std::max(-EXP_BIAS - 1, (int)floorf(log2f(std::max(max_c, 1e-30f)))) + 1 + EXP_BIAS;
+        float scale = ldexpf(1.0f, exponent - EXP_BIAS - MANTISSA_BITS);
+        if ( (int)floorf(max_c / scale + 0.5f) == (1 << MANTISSA_BITS) )
+        {
+            exponent += 1;
+            scale *= 2.0f;
+        }
+
+        uint32_t m[3];
+        for (int k = 0; k < 3; ++k)
+            m[k] = std::min((uint32_t)floorf(c[k] / scale + 0.5f), (uint32_t)(1 << MANTISSA_BITS) - 1);
+
+        return m[0] | (m[1] << 9) | (m[2] << 18) | ((uint32_t)exponent << 27);
+    }
+
+    // Direção do centro do ponto (s,t) em [0,1]² da face "face", seguindo a
+    // convenção de faces do OpenGL.
+    void FaceDirection(int face, float s, float t, float* d)
+    {
+        float a = 2.0f*s - 1.0f;
+        float b = 2.0f*t - 1.0f;
+        switch ( face )
+        {
+        case 0: d[0] =  1.0f; d[1] = -b;    d[2] = -a;    break; // +X
+        case 1: d[0] = -1.0f; d[1] = -b;    d[2] =  a;    break; // -X
+        case 2: d[0] =  a;    d[1] =  1.0f; d[2] =  b;    break; // +Y
+        case 3: d[0] =  a;    d[1] = -1.0f; d[2] = -b;    break; // -Y
+        case 4: d[0] =  a;    d[1] = -b;    d[2] =  1.0f; break; // +Z
+        default: d[0] = -a;   d[1] = -b;    d[2] = -1.0f; break; // -Z
+        }
+    }
+
+    // Amostra bilinear da imagem equirretangular na direção "d", repetindo a
+    // imagem na horizontal e limitando-a na vertical.
+    void SampleEquirect(const float* pixels, int width, int height, const float* d, float* rgb)
+    {
+        float length = sqrtf(d[0]*d[0] + d[1]*d[1] + d[2]*d[2]);
+        float theta  = atan2f(d[0], d[2]);
+        float phi    = asinf(std::min(std::max(d[1] / length, -1.0f), 1.0f));
+        float u = (theta + PI) / (2.0f*PI);
+        float v = (phi + 0.5f*PI) / PI;
+
+        float x = u*width  - 0.5f;
+        float y = v*height - 0.5f;
+        int x0 = (int)floorf(x);
+        int y0 = (int)floorf(y);
+        float fx = x - x0;
+        float fy = y - y0;
+
+        int xs[2] = { ((x0 % width) + width) % width, ((x0 + 1) % width + width) % width };
+        int ys[2] = { std::min(std::max(y0, 0), height - 1), std::min(std::max(y0 + 1, 0), height - 1) };
+        float wx[2] = { 1.0f - fx, fx };
+        float wy[2] = { 1.0f - fy, fy };
+
+        rgb[0] = rgb[1] = rgb[2] = 0.0f;
+        for (int j = 0; j < 2; ++j)
+        {
+            for (int i = 0; i < 2; ++i)
+            {
+                const float* texel = pixels + ((size_t)ys[j]*width + xs[i])*3;
+                float w = wx[i]*wy[j];
+                for (int k = 0; k < 3; ++k)
+                    rgb[k] += w * texel[k];
+            }
+        }
+    }
+}
+
+void BuildEnvironmentMap(const float* pixels, int width, int height, std::vector<uint32_t>* storage, EnvironmentLevels* levels)
+{
+    int face_size = 1;
+    while ( face_size * 2 <= width / 4 && face_size * 2 <= ENVIRONMENT_MAX_FACE_SIZE )
+        face_size *= 2;
+
+    levels->num_levels = 0;
+    size_t offsets[ENVIRONMENT_MAX_LEVELS];
+    size_t total_texels = 0;
+    for (int size = face_size; ; size /= 2)
+    {
+        int level = levels->num_levels++;
+        levels->size[level] = size;
+        offsets[level] = total_texels;
+        total_texels += LevelTexels(size);
+        if ( size == 1 )
+            break;
+    }
+
+    // Nível 0: média de 2x2 amostras por texel
+    std::vector<float> current(LevelTexels(face_size) * 3);
+    for (int face = 0; face < 6; ++face)
+    {
+        for (int y = 0; y < face_size; ++y)
+        {
+            for (int x = 0; x < face_size; ++x)
+            {
+                float* dst = &current[(((size_t)face*face_size + y)*face_size + x)*3];
+                dst[0] = dst[1] = dst[2] = 0.0f;
+                for (int sy = 0; sy < 2; ++sy)
+                {
+                    for (int sx = 0; sx < 2; ++sx)
+                    {
+                        float d[3], rgb[3];
+                        FaceDirection(face, (x + 0.25f + 0.5f*sx) / face_size, (y + 0.25f + 0.5f*sy) / face_size, d);
+                        SampleEquirect(pixels, width, height, d, rgb);
+                        for (int k = 0; k < 3; ++k)
+                            dst[k] += 0.25f * rgb[k];
+                    }
+                }
+            }
+        }
+    }
+
+    storage->resize(total_texels);
+    uint32_t* data = storage->data();
+    for (int level = 0; level < levels->num_levels; ++level)
+    {
+        int size = levels->size[level];
+        uint32_t* dst = data + offsets[level];
+        for (size_t i = 0; i < LevelTexels(size); ++i)
+            dst[i] = EncodeRgb9e5(&current[3*i]);
+
+        if ( level + 1 == levels->num_levels )
+            break;
+
+        // Filtro de caixa 2x2 em float para o próximo nível
+        int next_size = levels->size[level+1];
+        std::vector<float> next(LevelTexels(next_size) * 3);
+        for (int face = 0; face < 6; ++face)
+        {
+            const float* src = &current[(size_t)face*size*size*3];
+            float*       out = &next[(size_t)face*next_size*next_size*3];
+            for (int y = 0; y < next_size; ++y)
+                for (int x = 0; x < next_size; ++x)
+                    for (int k = 0; k < 3; ++k)
+                        out[(y*next_size + x)*3 + k] = 0.25f * (src[((2*y)*size + 2*x)*3 + k] + src[((2*y)*size + 2*x+1)*3 + k]
+                                                              + src[((2*y+1)*size + 2*x)*3 + k] + src[((2*y+1)*size + 2*x+1)*3 + k]);
+        }
+        current.swap(next);
+    }
+
+    for (int level = 0; level < levels->num_levels; ++level)
+        for (int face = 0; face < 6; ++face)
+            levels->faces[level][face] = data + offsets[level] + (size_t)face*levels->size[level]*levels->size[level];
+}
+
+std::string EnvironmentCache_Filename(const char* image_filename)
+{
+    return std::string(image_filename) + ".envcache";
+}
+
+bool EnvironmentCache_Load(const char* image_filename, EnvironmentCache* cache)
+{
+    FileStamp stamp;
+    if ( !GetFileStamp(image_filename, &stamp) )
+        return false;
+
+    std::string filename = EnvironmentCache_Filename(image_filename);
+    if ( !MapFile(filename.c_str(), &cache->file) )
+        return false;
+
+    const MappedFile& file = cache->file;
+    const EnvCacheHeader* header = (const EnvCacheHeader*)file.data;
+
+    bool valid = file.size >= sizeof(EnvCacheHeader)
+              && memcmp(header->magic, ENVCACHE_MAGIC, sizeof(header->magic)) == 0
+              && header->version == ENVCACHE_VERSION
+              && header->source_size == stamp.size
+              && header->source_mtime == stamp.mtime
+              && header->num_levels >= 1
+              && header->num_levels <= ENVIRONMENT_MAX_LEVELS;
+
+    for (uint32_t level = 0; valid && level < header->num_levels; ++level)
+    {
+        uint32_t size  = header->size[level];
+        uint64_t bytes = LevelTexels(size) * sizeof(uint32_t);
+        valid = size >= 1 && size <= ENVIRONMENT_MAX_FACE_SIZE
+             && header->offset[level] % sizeof(uint32_t) == 0
+             && header->offset[level] <= file.size && bytes <= file.size - header->offset[level];
+        if ( !valid )
+            break;
+
+        const uint32_t* texels = (const uint32_t*)(file.data + header->offset[level]);
+        cache->levels.size[level] = size;
+        for (int face = 0; face < 6; ++face)
+            cache->levels.faces[level][face] = texels + (size_t)face*size*size;
+    }
+
+    if ( !valid )
+    {
+        EnvironmentCache_Close(cache);
+        return false;
+    }
+
+    cache->levels.num_levels = header->num_levels;
+    return true;
+}
+
+void EnvironmentCache_Close(EnvironmentCache* cache)
+{
+    UnmapFile(&cache->file);
+    memset(&cache->levels, 0, sizeof(cache->levels));
+}
+
+bool EnvironmentCache_Save(const char* image_filename, const EnvironmentLevels& levels)
+{
+    FileStamp stamp;
+    if ( !GetFileStamp(image_filename, &stamp) )
+        return false;
+
+    EnvCacheHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, ENVCACHE_MAGIC, sizeof(header.magic));
+    header.version      = ENVCACHE_VERSION;
+    header.num_levels   = levels.num_levels;
+    header.source_size  = stamp.size;
+    header.source_mtime = stamp.mtime;
+
+    uint64_t file_size = sizeof(EnvCacheHeader);
+    for (int level = 0; level < levels.num_levels; ++level)
+    {
+        header.size[level]   = levels.size[level];
+        header.offset[level] = Align16(file_size);
+        file_size = header.offset[level] + LevelTexels(levels.size[level]) * sizeof(uint32_t);
+    }
+
+    std::vector<unsigned char> buffer(file_size, 0);
+    memcpy(&buffer[0], &header, sizeof(header));
+    for (int level = 0; level < levels.num_levels; ++level)
+    {
+        size_t face_bytes = (size_t)levels.size[level] * levels.size[level] * sizeof(uint32_t);
+        for (int face = 0; face < 6; ++face)
+            memcpy(&buffer[header.offset[level] + face*face_bytes], levels.faces[level][face], face_bytes);
+    }
+
+    const void* chunks[1] = { buffer.data() };
+    size_t      sizes[1]  = { buffer.size() };
+    return WriteFileAtomically(EnvironmentCache_Filename(image_filename), chunks, sizes, 1);
+}
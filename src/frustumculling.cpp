@@ -0,0 +1,218 @@
+#include <cmath>
+#include <algorithm>
+
+#include <glm/geometric.hpp>
+
+#include "frustumculling.h"
+
+namespace
+{
+    glm::vec3 Center(const CullBox& box)
+    {
+        return 0.5f * (box.bbox_min + box.bbox_max);
+    }
+
+    // Constrói o nó "node" com os objetos items[begin, end)
+    void BuildNode(CullBvh* bvh, int node, int begin, int end)
+    {
+        CullBox box = bvh->boxes[bvh->items[begin]];
+        glm::vec3 center_min = Center(box);
+        glm::vec3 center_max = center_min;
+        for (int i = begin + 1; i < end; ++i)
+        {
+            const CullBox& item = bvh->boxes[bvh->items[i]];
+            box = Culling_MergeBoxes(box, item);
+            center_min = glm::min(center_min, Center(item));
+            center_max = glm::max(center_max, Center(item));
+        }
+
+        bvh->nodes[node].box        = box;
+        bvh->nodes[node].first_item = begin;
+        bvh->nodes[node].num_items  = end - begin;
+        bvh->nodes[node].left       = -1;
+        bvh->nodes[node].last_plane = -1;
+
+        if ( end - begin <= CULL_BVH_LEAF_SIZE )
+            return;
+
+        // Eixo em que os centros das caixas estão mais espalhados
+        glm::vec3 extent = center_max - center_min;
+        int axis = 0;
+        if ( extent.y > extent[axis] ) axis = 1;
+        if ( extent.z > extent[axis] ) axis = 2;
+
+        int middle = begin + (end - begin) / 2;
+        const std::vector<CullBox>& boxes = bvh->boxes;
+        std::nth_element(bvh->items.begin() + begin, bvh->items.begin() + middle, bvh->items.begin() + end,
+                         [&boxes, axis](int a, int b) { return Center(boxes[a])[axis] < Center(boxes[b])[axis]; });
+
+        // Os filhos são alocados juntos; "bvh->nodes" pode ser realocado
+        int left = (int)bvh->nodes.size();
+        bvh->nodes.resize(left + 2);
+        bvh->nodes[node].left = left;
+
+        BuildNode(bvh, left, begin, middle);
+        BuildNode(bvh, left + 1, middle, end);
+    }
+
+    void MarkVisible(const CullBvh& bvh, const CullBvhNode& node, std::vector<char>* visible, CullStats* stats)
+    {
+        for (int i = node.first_item; i < node.first_item + node.num_items; ++i)
+            (*visible)[bvh.items[i]] = 1;
+        stats->visible += node.num_items;
+    }
+
+    void CullNode(CullBvh* bvh, int index, unsigned plane_mask, const Frustum& frustum, std::vector<char>* visible, CullStats* stats)
+    {
+        CullBvhNode& node = bvh->nodes[index];
+
+        stats->boxes_tested += 1;
+        CullResult result = Culling_TestBox(frustum, node.box, &plane_mask, &node.last_plane);
+        if ( result == CULL_OUTSIDE )
+        {
+            stats->culled += node.num_items;
+            return;
+        }
+        if ( result == CULL_INSIDE )
+        {
+            MarkVisible(*bvh, node, visible, stats);
+            return;
+        }
+
+        if ( node.left >= 0 )
+        {
+            int left = node.left;
+            CullNode(bvh, left, plane_mask, frustum, visible, stats);
+            CullNode(bvh, left + 1, plane_mask, frustum, visible, stats);
+            return;
+        }
+
+        // Folha que cruza o frustum: testamos os objetos contra os planos
+        // que o nó cruza.
+        for (int i = node.first_item; i < node.first_item + node.num_items; ++i)
+        {
+            int item = bvh->items[i];
+            unsigned item_mask = plane_mask;
+            stats->boxes_tested += 1;
+            if ( Culling_TestBox(frustum, bvh->boxes[item], &item_mask, &bvh->last_planes[item]) == CULL_OUTSIDE )
+            {
+                stats->culled += 1;
+            }
+            else
+            {
+                (*visible)[item] = 1;
+                stats->visible += 1;
+            }
+        }
+    }
+}
+
+CullBox Culling_TransformBox(const glm::vec3& bbox_min, const glm::vec3& bbox_max, const glm::mat4& model)
+{
+    // O centro é transformado normalmente e a meia-extensão pelo valor
+    // absoluto da parte linear da matriz (veja Arvo, "Transforming
+    // Axis-Aligned Bounding Boxes", Graphics Gems).
+    glm::vec3 center = 0.5f * (bbox_min + bbox_max);
+    glm::vec3 half   = 0.5f * (bbox_max - bbox_min);
+
+    glm::vec3 world_center = glm::vec3(model * glm::vec4(center, 1.0f));
+    glm::vec3 world_half;
+    for (int row = 0; row < 3; ++row)
+        world_half[row] = std::fabs(model[0][row]) * half.x + std::fabs(model[1][row]) * half.y + std::fabs(model[2][row]) * half.z;
+
+    CullBox box;
+    box.bbox_min = world_center - world_half;
+    box.bbox_max = world_center + world_half;
+    return box;
+}
+
+CullBox Culling_MergeBoxes(const CullBox& a, const CullBox& b)
+{
+    CullBox box;
+    box.bbox_min = glm::min(a.bbox_min, b.bbox_min);
+    box.bbox_max = glm::max(a.bbox_max, b.bbox_max);
+    return box;
+}
+
+Frustum Culling_ExtractFrustum(const glm::mat4& view_projection)
+{
+    // Linhas da matriz (a GLM guarda as matrizes por colunas)
+    glm::vec4 rows[4];
+    for (int i = 0; i < 4; ++i)
+        rows[i] = glm::vec4(view_projection[0][i], view_projection[1][i], view_projection[2][i], view_projection[3][i]);
+
+    Frustum frustum;
+    frustum.planes[0] = rows[3] + rows[0]; // Esquerda
+    frustum.planes[1] = rows[3] - rows[0]; // Direita
+    frustum.planes[2] = rows[3] + rows[1]; // Baixo
+    frustum.planes[3] = rows[3] - rows[1]; // Cima
+    frustum.planes[4] = rows[3] + rows[2]; // Near
+    frustum.planes[5] = rows[3] - rows[2]; // Far
+
+    for (int i = 0; i < 6; ++i)
+        frustum.planes[i] /= glm::length(glm::vec3(frustum.planes[i]));
+
+    return frustum;
+}
+
+CullResult Culling_TestBox(const Frustum& frustum, const CullBox& box, unsigned* plane_mask, int* last_plane)
+{
+    glm::vec3 center = 0.5f * (box.bbox_min + box.bbox_max);
+    glm::vec3 half   = 0.5f * (box.bbox_max - box.bbox_min);
+
+    // Começamos pelo plano que descartou a caixa no último teste: de um
+    // quadro para o outro ele costuma descartá-la novamente.
+    int first = (last_plane != NULL && *last_plane >= 0) ? *last_plane : 0;
+
+    for (int k = 0; k < 6; ++k)
+    {
+        int i = (first + k) % 6;
+        unsigned bit = 1u << i;
+        if ( (*plane_mask & bit) == 0 )
+            continue;
+
+        const glm::vec4& plane = frustum.planes[i];
+        glm::vec3 normal = glm::vec3(plane);
+
+        // Distância do centro ao plano e raio da caixa na direção da normal
+        float distance = glm::dot(normal, center) + plane.w;
+        float radius   = glm::dot(half, glm::abs(normal));
+
+        if ( distance + radius < 0.0f )
+        {
+            if ( last_plane != NULL )
+                *last_plane = i;
+            return CULL_OUTSIDE;
+        }
+        if ( distance - radius >= 0.0f )
+            *plane_mask &= ~bit;
+    }
+
+    if ( last_plane != NULL )
+        *last_plane = -1;
+
+    return (*plane_mask == 0) ? CULL_INSIDE : CULL_INTERSECTS;
+}
+
+void Culling_BuildBvh(CullBvh* bvh, const std::vector<CullBox>& boxes)
+{
+    bvh->boxes = boxes;
+    bvh->last_planes.assign(boxes.size(), -1);
+    bvh->items.resize(boxes.size());
+    for (size_t i = 0; i < boxes.size(); ++i)
+        bvh->items[i] = (int)i;
+
+    bvh->nodes.clear();
+    if ( boxes.empty() )
+        return;
+
+    bvh->nodes.resize(1);
+    BuildNode(bvh, 0, 0, (int)boxes.size());
+}
+
+void Culling_CullBvh(CullBvh* bvh, const Frustum& frustum, std::vector<char>* visible, CullStats* stats)
+{
+    visible->assign(bvh->boxes.size(), 0);
+    if ( !bvh->nodes.empty() )
+        CullNode(bvh, 0, CULL_ALL_PLANES, frustum, visible, stats);
+}
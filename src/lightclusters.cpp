@@ -0,0 +1,282 @@
+// Listas de luzes por cluster. Cada cluster é identificado por
+//
+//    cluster = (fatia * LIGHT_CLUSTERS_Y + bloco_y) * LIGHT_CLUSTERS_X + bloco_x
+//
+// com os blocos contados a partir do canto inferior esquerdo da tela (como
+// gl_FragCoord) e as fatias a partir do plano near. A profundidade d de uma
+// fatia f satisfaz d = near * (far/near)^(f/LIGHT_CLUSTERS_Z).
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+#include <glm/geometric.hpp>
+#include <glm/matrix.hpp>
+
+#include "lightclusters.h"
+
+namespace
+{
+    // Os pares (cluster, luz) são guardados em 32 bits, com a luz nos 8
+    // bits menos significativos, de forma que a ordenação agrupa as luzes de
+    // cada cluster.
+    const int HIT_LIGHT_BITS = 8;
+
+    // Ponto no sistema da câmera, com profundidade 1, na direção do ponto
+    // (x,y) em NDC.
+    glm::vec3 ClusterRay(const glm::mat4& inverse_projection, float x, float y)
+    {
+        glm::vec4 p = inverse_projection * glm::vec4(x, y, 0.0f, 1.0f);
+        glm::vec3 point = glm::vec3(p) / p.w;
+        return point / -point.z;
+    }
+
+    // Recalcula as caixas dos clusters no sistema da câmera. Cada caixa
+    // envolve os quatro raios dos cantos do seu bloco entre as profundidades
+    // da sua fatia.
+    void ComputeClusterBoxes(LightClusters* clusters, const glm::mat4& projection, float near_distance, float far_distance)
+    {
+        clusters->boxes.resize(2 * LIGHT_CLUSTERS_COUNT);
+        clusters->boxes_projection = projection;
+        clusters->boxes_near       = near_distance;
+        clusters->boxes_far        = far_distance;
+
+        glm::mat4 inverse_projection = glm::inverse(projection);
+
+        for (int z = 0; z < LIGHT_CLUSTERS_Z; ++z)
+        {
+            float depth_near = near_distance * std::pow(far_distance / near_distance, (float)z / LIGHT_CLUSTERS_Z);
+            float depth_far  = near_distance * std::pow(far_distance / near_distance, (float)(z + 1) / LIGHT_CLUSTERS_Z);
+
+            for (int y = 0; y < LIGHT_CLUSTERS_Y; ++y)
+            for (int x = 0; x < LIGHT_CLUSTERS_X; ++x)
+            {
+                float x0 = -1.0f + 2.0f * x / LIGHT_CLUSTERS_X;
+                float x1 = -1.0f + 2.0f * (x + 1) / LIGHT_CLUSTERS_X;
+                float y0 = -1.0f + 2.0f * y / LIGHT_CLUSTERS_Y;
+                float y1 = -1.0f + 2.0f * (y + 1) / LIGHT_CLUSTERS_Y;
+
+                glm::vec3 rays[4] = { ClusterRay(inverse_projection, x0, y0), ClusterRay(inverse_projection, x1, y0),
+                                      ClusterRay(inverse_projection, x0, y1), ClusterRay(inverse_projection, x1, y1) };
+
+                glm::vec3 box_min = rays[0] * depth_near;
+                glm::vec3 box_max = box_min;
+                for (int i = 0; i < 4; ++i)
+                {
+                    box_min = glm::min(box_min, glm::min(rays[i] * depth_near, rays[i] * depth_far));
+                    box_max = glm::max(box_max, glm::max(rays[i] * depth_near, rays[i] * depth_far));
+                }
+
+                int cluster = (z * LIGHT_CLUSTERS_Y + y) * LIGHT_CLUSTERS_X + x;
+                clusters->boxes[2*cluster]     = glm::vec4(box_min, 0.0f);
+                clusters->boxes[2*cluster + 1] = glm::vec4(box_max, 0.0f);
+            }
+        }
+    }
+
+    // Fatia que contém a profundidade "depth" (sem limitar ao intervalo válido)
+    int SliceOf(const glm::vec4& cluster_scale, float depth)
+    {
+        return (int)std::floor(std::log(depth) * cluster_scale.z + cluster_scale.w);
+    }
+
+    // Menor esfera que contém o cone de uma luz spot (veja Wronski, "Cull
+    // that cone!"): para cones estreitos, a esfera que passa pelo vértice e
+    // pela borda da base; para os largos, a esfera da base.
+    void SpotBoundingSphere(const ClusterLight& light, glm::vec3* center, float* radius)
+    {
+        float range     = light.position.w;
+        float cos_angle = light.spot.w;
+        glm::vec3 direction = glm::vec3(light.spot);
+
+        if ( cos_angle > 0.70710678f )
+        {
+            *radius = range / (2.0f * cos_angle);
+            *center = glm::vec3(light.position) + direction * *radius;
+        }
+        else if ( cos_angle > 0.0f )
+        {
+            *radius = range * std::sqrt(1.0f - cos_angle * cos_angle);
+            *center = glm::vec3(light.position) + direction * (range * cos_angle);
+        }
+    }
+
+    bool SphereTouchesBox(const glm::vec3& center, float radius, const glm::vec4& box_min, const glm::vec4& box_max)
+    {
+        glm::vec3 closest = glm::clamp(center, glm::vec3(box_min), glm::vec3(box_max));
+        glm::vec3 d = center - closest;
+        return glm::dot(d, d) <= radius * radius;
+    }
+
+    void CreateTextureBuffer(GLuint* buffer, GLuint* texture, GLenum format, size_t size_bytes, GLuint unit)
+    {
+        glGenBuffers(1, buffer);
+        glBindBuffer(GL_TEXTURE_BUFFER, *buffer);
+        glBufferData(GL_TEXTURE_BUFFER, size_bytes, NULL, GL_STREAM_DRAW);
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+        // A textura fica ligada à sua unidade durante toda a execução
+        glGenTextures(1, texture);
+        glActiveTexture(GL_TEXTURE0 + unit);
+        glBindTexture(GL_TEXTURE_BUFFER, *texture);
+        glTexBuffer(GL_TEXTURE_BUFFER, format, *buffer);
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+    // Substitui o conteúdo de um buffer. O buffer é realocado
+    // ("orphaning"), de forma que o driver não precisa esperar que a GPU
+    // termine os desenhos que leem o conteúdo anterior.
+    void UploadBuffer(GLenum target, GLuint buffer, size_t capacity_bytes, const void* data, size_t size_bytes)
+    {
+        glBindBuffer(target, buffer);
+        glBufferData(target, capacity_bytes, NULL, GL_STREAM_DRAW);
+        if ( size_bytes > 0 )
+            glBufferSubData(target, 0, size_bytes, data);
+        glBindBuffer(target, 0);
+    }
+}
+
+void LightClusters_Init(LightClusters* clusters)
+{
+    memset(&clusters->block, 0, sizeof(clusters->block));
+    clusters->boxes.clear();
+    clusters->boxes_near = 0.0f;
+    clusters->boxes_far  = 0.0f;
+    clusters->grid.assign(2 * LIGHT_CLUSTERS_COUNT, 0);
+    clusters->stats = LightClusterStats();
+
+    glGenBuffers(1, &clusters->uniform_buffer_id);
+    glBindBuffer(GL_UNIFORM_BUFFER, clusters->uniform_buffer_id);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(LightBlock), &clusters->block, GL_STREAM_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    glBindBufferBase(GL_UNIFORM_BUFFER, LIGHT_CLUSTERS_BINDING, clusters->uniform_buffer_id);
+
+    CreateTextureBuffer(&clusters->grid_buffer_id, &clusters->grid_texture_id, GL_RG32UI,
+                        clusters->grid.size() * sizeof(GLuint), LIGHT_CLUSTERS_GRID_UNIT);
+    CreateTextureBuffer(&clusters->indices_buffer_id, &clusters->indices_texture_id, GL_R8UI,
+                        LIGHT_CLUSTERS_MAX_INDICES * sizeof(GLubyte), LIGHT_CLUSTERS_INDICES_UNIT);
+
+    // Listas vazias até o primeiro LightClusters_Build()
+    UploadBuffer(GL_TEXTURE_BUFFER, clusters->grid_buffer_id, clusters->grid.size() * sizeof(GLuint),
+                 clusters->grid.data(), clusters->grid.size() * sizeof(GLuint));
+}
+
+void LightClusters_BindProgram(GLuint program_id)
+{
+    GLuint block_index = glGetUniformBlockIndex(program_id, "LightBlock");
+    if ( block_index != GL_INVALID_INDEX )
+        glUniformBlockBinding(program_id, block_index, LIGHT_CLUSTERS_BINDING);
+
+    // Os samplers que o programa não usa não existem (glGetUniformLocation()
+    // retorna -1) e são ignorados.
+    GLint current_program;
+    glGetIntegerv(GL_CURRENT_PROGRAM, &current_program);
+    glUseProgram(program_id);
+    glUniform1i(glGetUniformLocation(program_id, "cluster_grid"), LIGHT_CLUSTERS_GRID_UNIT);
+    glUniform1i(glGetUniformLocation(program_id, "cluster_lights"), LIGHT_CLUSTERS_INDICES_UNIT);
+    glUseProgram(current_program);
+}
+
+void LightClusters_Clear(LightClusters* clusters)
+{
+    clusters->block.num_lights = 0;
+}
+
+bool LightClusters_AddSpot(LightClusters* clusters, const glm::vec4& position, const glm::vec4& direction, float angle,
+                           float radius, const glm::vec3& color)
+{
+    if ( clusters->block.num_lights >= LIGHT_CLUSTERS_MAX_LIGHTS )
+        return false;
+
+    ClusterLight& light = clusters->block.lights[clusters->block.num_lights++];
+    light.position = glm::vec4(glm::vec3(position), radius);
+    light.color    = glm::vec4(color, 0.0f);
+    light.spot     = glm::vec4(glm::normalize(glm::vec3(direction)), std::cos(angle));
+    return true;
+}
+
+bool LightClusters_AddPoint(LightClusters* clusters, const glm::vec4& position, float radius, const glm::vec3& color)
+{
+    if ( clusters->block.num_lights >= LIGHT_CLUSTERS_MAX_LIGHTS )
+        return false;
+
+    ClusterLight& light = clusters->block.lights[clusters->block.num_lights++];
+    light.position = glm::vec4(glm::vec3(position), radius);
+    light.color    = glm::vec4(color, 0.0f);
+    light.spot     = glm::vec4(0.0f, 0.0f, 0.0f, -2.0f);
+    return true;
+}
+
+void LightClusters_Build(LightClusters* clusters, const glm::mat4& view, const glm::mat4& projection,
+                         float near_distance, float far_distance, int width, int height)
+{
+    if ( clusters->boxes.empty() || projection != clusters->boxes_projection
+         || near_distance != clusters->boxes_near || far_distance != clusters->boxes_far )
+        ComputeClusterBoxes(clusters, projection, near_distance, far_distance);
+
+    LightBlock& block = clusters->block;
+    float slices_per_log = LIGHT_CLUSTERS_Z / std::log(far_distance / near_distance);
+    block.cluster_scale = glm::vec4((float)LIGHT_CLUSTERS_X / std::max(width, 1), (float)LIGHT_CLUSTERS_Y / std::max(height, 1),
+                                    slices_per_log, -std::log(near_distance) * slices_per_log);
+
+    // Clusters alcançados pela esfera de cada luz, testando apenas as fatias
+    // entre as profundidades da esfera.
+    clusters->hits.clear();
+    for (int i = 0; i < block.num_lights; ++i)
+    {
+        const ClusterLight& light = block.lights[i];
+        glm::vec3 center = glm::vec3(light.position);
+        float radius = light.position.w;
+        if ( light.spot.w >= -1.0f )
+            SpotBoundingSphere(light, &center, &radius);
+        center = glm::vec3(view * glm::vec4(center, 1.0f));
+
+        float depth = -center.z;
+        if ( depth + radius < near_distance || depth - radius > far_distance )
+            continue;
+
+        int first_slice = std::max(SliceOf(block.cluster_scale, std::max(depth - radius, near_distance)), 0);
+        int last_slice  = std::min(SliceOf(block.cluster_scale, std::min(depth + radius, far_distance)), LIGHT_CLUSTERS_Z - 1);
+
+        for (int z = first_slice; z <= last_slice; ++z)
+        for (int cluster = z * LIGHT_CLUSTERS_X * LIGHT_CLUSTERS_Y; cluster < (z + 1) * LIGHT_CLUSTERS_X * LIGHT_CLUSTERS_Y; ++cluster)
+        {
+            if ( SphereTouchesBox(center, radius, clusters->boxes[2*cluster], clusters->boxes[2*cluster + 1]) )
+                clusters->hits.push_back(((uint32_t)cluster << HIT_LIGHT_BITS) | (uint32_t)i);
+        }
+    }
+
+    std::sort(clusters->hits.begin(), clusters->hits.end());
+
+    // Listas de luzes, na ordem dos clusters
+    clusters->stats = LightClusterStats();
+    clusters->stats.lights = block.num_lights;
+    std::fill(clusters->grid.begin(), clusters->grid.end(), 0);
+    clusters->indices.clear();
+
+    for (size_t begin = 0, end; begin < clusters->hits.size(); begin = end)
+    {
+        uint32_t cluster = clusters->hits[begin] >> HIT_LIGHT_BITS;
+        for (end = begin; end < clusters->hits.size() && (clusters->hits[end] >> HIT_LIGHT_BITS) == cluster; ++end)
+            ;
+
+        size_t count = std::min(end - begin, (size_t)LIGHT_CLUSTERS_MAX_INDICES - clusters->indices.size());
+        clusters->stats.dropped += (end - begin) - count;
+        if ( count == 0 )
+            continue;
+
+        clusters->grid[2*cluster]     = (GLuint)clusters->indices.size();
+        clusters->grid[2*cluster + 1] = (GLuint)count;
+        for (size_t i = begin; i < begin + count; ++i)
+            clusters->indices.push_back((GLubyte)(clusters->hits[i] & ((1u << HIT_LIGHT_BITS) - 1)));
+
+        clusters->stats.lit_clusters += 1;
+    }
+    clusters->stats.indices = clusters->indices.size();
+
+    UploadBuffer(GL_UNIFORM_BUFFER, clusters->uniform_buffer_id, sizeof(LightBlock),
+                 &block, offsetof(LightBlock, lights) + block.num_lights * sizeof(ClusterLight));
+    UploadBuffer(GL_TEXTURE_BUFFER, clusters->grid_buffer_id, clusters->grid.size() * sizeof(GLuint),
+                 clusters->grid.data(), clusters->grid.size() * sizeof(GLuint));
+    UploadBuffer(GL_TEXTURE_BUFFER, clusters->indices_buffer_id, LIGHT_CLUSTERS_MAX_INDICES * sizeof(GLubyte),
+                 clusters->indices.data(), clusters->indices.size() * sizeof(GLubyte));
+}
@@ -19,6 +19,7 @@
 #include <cmath>
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
 #include <stdlib.h>     /* srand, rand */
 #include <time.h>       /* time */
 
@@ -32,6 +33,9 @@
 #include <sstream>
 #include <stdexcept>
 #include <algorithm>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
 
 // Headers das bibliotecas OpenGL
 #include <glad/glad.h>   // Criação de contexto OpenGL 3.3
@@ -39,6 +43,7 @@
 
 // Headers da biblioteca GLM: criação de matrizes e vetores.
 #include <glm/mat4x4.hpp>
+#include <glm/matrix.hpp>
 #include <glm/vec4.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
@@ -49,6 +54,25 @@
 // Headers locais, definidos na pasta "include/"
 #include "utils.h"
 #include "matrices.h"
+#include "meshcache.h"
+#include "programcache.h"
+#include "shadermanager.h"
+#include "objreader.h"
+#include "meshoptimizer.h"
+#include "vertexformat.h"
+#include "scenegeometry.h"
+#include "sceneregistry.h"
+#include "renderqueue.h"
+#include "frustumculling.h"
+#include "lightclusters.h"
+#include "shadowmap.h"
+#include "threadpool.h"
+#include "texturecache.h"
+#include "texturestreamer.h"
+#include "textureatlas.h"
+#include "environmentmap.h"
+#include "normals.h"
+#include "meshlod.h"
 
 // Incluimos o arquivo de testes de colisões
 #include "collisions.h"
@@ -56,6 +80,24 @@
 
 #define PI 3.14159265359f
 
+// Lado máximo dos níveis de mipmap enviados durante o carregamento; os níveis
+// maiores são enviados nos quadros seguintes (veja "texturestreamer.h").
+#define TEXTURE_RESIDENT_SIZE 128
+
+// Quantidade máxima de texels copiados para a GPU por quadro pelo streamer.
+#define TEXTURE_STREAM_BYTES_PER_FRAME (8*1024*1024)
+
+// Memória máxima ocupada pelas texturas na GPU. Os níveis de mipmap maiores
+// que não couberem são descartados (veja "texturestreamer.h").
+#define TEXTURE_MEMORY_BUDGET (64*1024*1024)
+
+// Se true, as texturas da cena usam formatos comprimidos pelo driver.
+#define TEXTURE_COMPRESSION true
+
+// Erro máximo, em pixels, aceito na escolha do nível de detalhe dos objetos.
+// Veja SelectLod().
+#define LOD_MAX_PIXEL_ERROR 1.0f
+
 inline const char * const BoolToString(bool b)
 {
   return b ? "true" : "false";
@@ -69,9 +111,11 @@ struct ObjModel
     std::vector<tinyobj::shape_t>     shapes;
     std::vector<tinyobj::material_t>  materials;
 
-    // Este construtor lê o modelo de um arquivo utilizando a biblioteca tinyobjloader.
-    // Veja: https://github.com/syoyo/tinyobjloader
-    ObjModel(const char* filename, const char* basepath = NULL, bool triangulate = true)
+    // Este construtor lê o modelo de um arquivo utilizando ReadObj() (veja
+    // "objreader.h"), que produz as mesmas estruturas da biblioteca
+    // tinyobjloader. Veja: https://github.com/syoyo/tinyobjloader
+    // Faces são sempre trianguladas.
+    ObjModel(const char* filename, const char* basepath = NULL)
     {
         printf("Carregando objetos do arquivo \"%s\"...\n", filename);
 
@@ -92,7 +136,7 @@ struct ObjModel
 
         std::string warn;
         std::string err;
-        bool ret = tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, filename, basepath, triangulate);
+        bool ret = ReadObj(filename, basepath, &attrib, &shapes, &materials, &warn, &err);
 
         if (!err.empty())
             fprintf(stderr, "\n%s\n", err.c_str());
@@ -119,6 +163,79 @@ struct ObjModel
     }
 };
 
+// Imagem de textura decodificada por uma thread de trabalho, aguardando o
+// envio para a GPU. Veja LoadAssets().
+struct TextureAsset
+{
+    std::string    filename;
+    GLuint         textureunit; // Unidade de textura reservada por AddTextureAsset()
+    TextureFormat  format;
+    TextureTier    tier;
+    bool           from_cache;
+    TextureCache   cache;       // Válido se from_cache == true
+    std::vector<unsigned char> storage; // Texels decodificados, se from_cache == false
+    TextureLevels  levels;      // Cadeia de mipmaps (num_levels == 0 em caso de erro)
+    double         decode_time; // Tempo gasto na thread de trabalho (segundos)
+    bool           ready;       // Protegido pelo mutex de LoadAssets()
+};
+
+// Modelo lido por uma thread de trabalho (do cache binário ou do arquivo
+// ".obj"), aguardando o envio para a GPU. Veja LoadAssets().
+struct ModelAsset
+{
+    std::string           filename;
+    bool                  from_cache;
+    MeshCache             cache; // Válido se from_cache == true
+    MeshData              mesh;  // Válido se from_cache == false
+    MeshOptimizationStats stats;
+    double                read_time; // Tempo gasto na thread de trabalho (segundos)
+    bool                  ready;     // Protegido pelo mutex de LoadAssets()
+};
+
+// Imagem (ou cor sólida, se image.filename estiver vazio) que ocupa uma região
+// de um atlas de texturas.
+struct AtlasSource
+{
+    TextureAsset             image;
+    glm::vec3                color;   // Cor em espaço linear
+    std::vector<std::string> objects; // Objetos que usam esta região
+};
+
+// Atlas de texturas montado por LoadAssets() a partir de várias imagens
+// pequenas (veja "textureatlas.h"). As coordenadas de textura dos objetos de
+// cada fonte são transformadas para a sua região do atlas quando o modelo é
+// enviado para a GPU, de forma que todos são desenhados com uma única textura.
+struct AtlasAsset
+{
+    GLuint                   textureunit; // Unidade de textura reservada por AddAtlasAsset()
+    std::vector<AtlasSource> sources;
+    TextureAtlas             atlas;
+    bool                     built;
+};
+
+// Céu HDR lido por uma thread de trabalho (do cache ou da imagem, convertida
+// em cubemap), aguardando o envio para a GPU. Veja "environmentmap.h".
+struct SkyAsset
+{
+    std::string           filename;
+    GLuint                textureunit; // Unidade de textura reservada por AddSkyAsset()
+    bool                  from_cache;
+    EnvironmentCache      cache;       // Válido se from_cache == true
+    std::vector<uint32_t> storage;     // Texels convertidos, se from_cache == false
+    EnvironmentLevels     levels;      // Níveis do cubemap (num_levels == 0 em caso de erro)
+    double                decode_time; // Tempo gasto na thread de trabalho (segundos)
+    bool                  ready;       // Protegido pelo mutex de LoadAssets()
+};
+
+// Lista de assets carregados em paralelo por LoadAssets().
+struct AssetList
+{
+    std::vector<TextureAsset> textures;
+    std::vector<AtlasAsset>   atlases;
+    std::vector<SkyAsset>     skies;
+    std::vector<ModelAsset>   models;
+};
+
 typedef struct ammo
 {
     // Variáveis que definem a posição, orientação, tempo de atividade e rotação das balas.
@@ -197,14 +314,47 @@ void PopMatrix(glm::mat4& M);
 // Declaração de várias funções utilizadas em main().  Essas estão definidas
 // logo após a definição de main() neste arquivo.
 void BuildTrianglesAndAddToVirtualScene(ObjModel*); // Constrói representação de um ObjModel como malha de triângulos para renderização
+void BuildTriangles(ObjModel* model, MeshData* mesh, MeshOptimizationStats* stats); // Constrói a malha de triângulos de um ObjModel, sem enviá-la para a GPU
+void PrintMeshStats(const MeshData& mesh, const MeshOptimizationStats& stats); // Imprime as estatísticas de otimização e compactação de uma malha
+void AddMeshToVirtualScene(const MeshView& mesh); // Envia uma malha para a GPU e adiciona seus objetos em g_VirtualScene
+void ReadModel(ModelAsset* asset); // Lê um modelo sem fazer chamadas OpenGL (executada nas threads de trabalho)
+void UploadModel(ModelAsset* asset); // Envia para a GPU um modelo lido por ReadModel()
+void AddTextureAsset(AssetList* assets, const char* filename, TextureFormat format, TextureTier tier); // Adiciona uma textura na lista, reservando sua unidade de textura
+void AddModelAsset(AssetList* assets, const char* filename); // Adiciona um modelo na lista
+void AddAtlasAsset(AssetList* assets); // Adiciona um atlas de texturas na lista, reservando sua unidade de textura
+void AddAtlasImage(AssetList* assets, const char* filename, std::initializer_list<const char*> objects); // Adiciona uma imagem ao último atlas da lista
+void AddAtlasColor(AssetList* assets, const glm::vec3& color, std::initializer_list<const char*> objects); // Adiciona uma cor sólida ao último atlas da lista
+void BuildAndUploadAtlas(AtlasAsset* asset); // Monta um atlas com as imagens lidas por LoadAssets() e o envia para a GPU
+bool ModelWaitsForAtlas(const AssetList& assets, const ModelAsset& model); // Indica se algum objeto do modelo usa um atlas ainda não montado
+void AddSkyAsset(AssetList* assets, const char* filename); // Adiciona um céu HDR na lista, reservando sua unidade de textura
+void DecodeSkyImage(SkyAsset* asset); // Lê um céu HDR e o converte em cubemap sem fazer chamadas OpenGL (executada nas threads de trabalho)
+void UploadSky(SkyAsset* asset); // Envia para a GPU o cubemap lido por DecodeSkyImage()
+void DrawSky(const glm::mat4& view, const glm::mat4& projection, bool menu); // Desenha o céu com uma consulta ao cubemap por pixel
+void LoadAssets(GLFWwindow* window, AssetList* assets); // Carrega em paralelo os assets da lista, mostrando uma tela de progresso
 void ComputeNormals(ObjModel* model); // Computa normais de um ObjModel, caso não existam.
-void LoadShadersFromFiles(); // Carrega os shaders de vértice e fragmento, criando um programa de GPU
-void LoadTextureImage(const char* filename); // Função que carrega imagens de textura
-void DrawVirtualObject(const char* object_name); // Desenha um objeto armazenado em g_VirtualScene
-GLuint LoadShader_Vertex(const char* filename);   // Carrega um vertex shader
-GLuint LoadShader_Fragment(const char* filename); // Carrega um fragment shader
-void LoadShader(const char* filename, GLuint shader_id); // Função utilizada pelas duas acima
-GLuint CreateGpuProgram(GLuint vertex_shader_id, GLuint fragment_shader_id); // Cria um programa de GPU
+void LoadShadersFromFiles(); // Submete a compilação dos shaders de vértice e fragmento dos programas de GPU
+void SetupMainProgram(GLuint program_id, int material); // Registra a permutação do programa principal de um material quando ela fica pronta
+void SetupSkyProgram(GLuint program_id, int permutation); // Busca as variáveis do programa do céu quando ele fica pronto
+void SetupShadowProgram(GLuint program_id, int permutation); // Registra uma permutação do programa do mapa de sombras quando ela fica pronta
+void DecodeTextureImage(TextureAsset* asset); // Lê uma imagem e seus mipmaps sem fazer chamadas OpenGL (executada nas threads de trabalho)
+void UploadTextureImage(TextureAsset* asset); // Envia para a GPU uma imagem lida por DecodeTextureImage()
+void ResolveSceneObjects(); // Converte os nomes dos objetos desenhados pelo jogo em identificadores de g_VirtualScene
+SceneObjectHandle MergeSceneObjects(const char* name, const std::vector<SceneObjectHandle>& parts); // Junta partes de um modelo em um único objeto
+void QueueVirtualObject(int pass, SceneObjectHandle object, int material, const glm::mat4& model, float instance_data = 0.0f); // Submete um objeto de g_VirtualScene para g_RenderQueue
+void QueueVirtualObjects(int pass, const std::vector<SceneObjectHandle>& objects, int material, const glm::mat4& model); // Submete vários objetos de um mesmo modelo como um único desenho
+CullBox ObjectBox(SceneObjectHandle object, const glm::mat4& model); // Caixa global de um objeto de g_VirtualScene desenhado com a matriz "model"
+void BuildStaticScene(const arvore* arvores, int num_arvores, const CAR& carro); // Monta a lista de objetos estáticos e a sua BVH
+void QueueStaticObjects(int pass, const Frustum& frustum); // Submete os objetos estáticos que estão dentro do frustum
+bool CullDynamicObject(const Frustum& frustum, const CullBox& box); // Testa um objeto que se move contra o frustum
+void QueueMonster(const Frustum& frustum, const Frustum* shadow_frustum, glm::mat4 model, float eye_rotation); // Submete a caveira e os olhos de um monstro, se visível, e a sombra da caveira
+void QueueShadowCaster(SceneObjectHandle object, int program, const glm::mat4& model); // Submete um objeto para g_ShadowQueue
+Frustum UpdateFlashlightShadows(const glm::vec4& position, const glm::vec4& direction); // Redesenha a camada estática do mapa de sombras, se necessário
+void AddDynamicLights(const glm::mat4& view, bool nozzle_flash); // Adiciona a g_LightClusters o clarão do tiro e os faróis do carro
+int SelectLod(const SceneObject& object, const glm::mat4& model_view, const glm::mat4& projection, int target_height); // Escolhe o nível de detalhe de um objeto de acordo com o seu tamanho na tela
+void RunFillRateBenchmark(); // Mede o tempo de GPU da cena estática em 1200x800 e 4K (opção "--fillrate")
+int LoadGpuProgram(const char* name, const char* vertex_filename, const char* fragment_filename, ShaderProgramReady on_ready,
+                   const std::string& defines = "", int permutation = 0); // Submete a criação de um programa de GPU
+std::string LoadShaderSource(const char* filename); // Lê o código de um arquivo GLSL
 void PrintObjModelInfo(ObjModel*); // Função para debugging
 
 // Declaração de funções auxiliares para renderizar texto dentro da janela
@@ -225,7 +375,12 @@ void TextRendering_PrintMatrixVectorProductDivW(GLFWwindow* window, glm::mat4 M,
 void TextRendering_ShowModelViewProjection(GLFWwindow* window, glm::mat4 projection, glm::mat4 view, glm::mat4 model, glm::vec4 p_model);
 void TextRendering_ShowProjection(GLFWwindow* window);
 void TextRendering_ShowFramesPerSecond(GLFWwindow* window);
+void TextRendering_ShowRenderQueueStats(GLFWwindow* window);
+void TextRendering_ShowCullingStats(GLFWwindow* window);
+void TextRendering_ShowLightStats(GLFWwindow* window);
+void TextRendering_ShowShadowStats(GLFWwindow* window);
 void TextRendering_ShowCarTip(GLFWwindow* window, float estado_carro);
+void TextRendering_ShowLoadingProgress(GLFWwindow* window, size_t loaded, size_t total);
 
 // Funções callback para comunicação com o sistema operacional e interação do
 // usuário. Veja mais comentários nas definições das mesmas, abaixo.
@@ -249,11 +404,111 @@ glm::vec4 calculateBezierPoint(const glm::vec4& P0, const glm::vec4& P1, const g
 
 // Abaixo definimos variáveis globais utilizadas em várias funções do código.
 
-// A cena virtual é uma lista de objetos nomeados, guardados em um dicionário
-// (map).  Veja dentro da função BuildTrianglesAndAddToVirtualScene() como que são incluídos
-// objetos dentro da variável g_VirtualScene, e veja na função main() como
-// estes são acessados.
-std::map<std::string, SceneObject> g_VirtualScene;
+// A cena virtual é uma lista de objetos nomeados, guardados de forma contígua
+// (veja "sceneregistry.h"). Veja dentro da função AddMeshToVirtualScene() como
+// que são incluídos objetos dentro da variável g_VirtualScene, e veja na
+// função ResolveSceneObjects() como estes são acessados.
+SceneRegistry g_VirtualScene;
+
+// Objetos de g_VirtualScene desenhados pelo jogo. Os nomes são convertidos em
+// identificadores uma única vez, por ResolveSceneObjects(), de forma que o
+// desenho não faz nenhuma busca por nome. As partes da cabine e do carro são
+// juntadas em um único objeto por MergeSceneObjects(); as do revólver são
+// desenhadas com uma única chamada, submetidas por QueueVirtualObjects().
+struct SceneObjects
+{
+    SceneObjectHandle plane;
+    SceneObjectHandle screen;
+    SceneObjectHandle light;
+    SceneObjectHandle bullet;
+    SceneObjectHandle bark;
+    SceneObjectHandle leaves;
+    SceneObjectHandle skull;
+    SceneObjectHandle eye;
+    SceneObjectHandle end_screen;
+    SceneObjectHandle cabin;
+    SceneObjectHandle car;
+    std::vector<SceneObjectHandle> revolver;
+};
+SceneObjects g_Objects;
+
+// Passos de renderização de g_RenderQueue, desenhados nesta ordem. O céu e o
+// texto são desenhados fora da fila, antes e depois dela.
+enum RenderPass
+{
+    PASS_OPAQUE,           // Cenário e projéteis
+    PASS_TRANSLUCENT,      // Monstros
+    PASS_HELD_OPAQUE,      // Lanterna e revólver, sobre a cena (limpa o Z-buffer)
+    PASS_HELD_TRANSLUCENT, // Fumaça do tiro
+    PASS_SCREEN,           // Mira, em projeção ortográfica
+    PASS_END_SCREEN        // Tela de fim de jogo
+};
+
+// Número de materiais: valores de "object_id" de 1 a NUM_MATERIALS-1 (veja
+// "shader_fragment.glsl").
+#define NUM_MATERIALS 15
+
+// Fila de desenhos do quadro (veja "renderqueue.h") e índice nela da
+// permutação do programa principal de cada material, registrada por
+// LoadShadersFromFiles().
+RenderQueue g_RenderQueue;
+int g_MaterialPrograms[NUM_MATERIALS];
+
+// Objeto do cenário que não se move após a inicialização. Veja
+// BuildStaticScene().
+struct StaticObject
+{
+    SceneObjectHandle object;
+    int               material;
+    glm::mat4         model;
+    float             instance_data;
+};
+
+// Objetos estáticos, a BVH das suas caixas globais e os objetos visíveis no
+// quadro atual (veja "frustumculling.h"). Os objetos que se movem (monstros e
+// projéteis) são testados um a um por CullDynamicObject().
+std::vector<StaticObject> g_StaticObjects;
+CullBvh                   g_StaticBvh;
+std::vector<char>         g_StaticVisible;
+
+// Contadores do descarte de objetos no quadro atual
+CullStats g_CullStats;
+
+// Luzes dinâmicas do quadro, distribuídas nos clusters do frustum da câmera
+// (veja "lightclusters.h"), e os faróis do carro, calculados por
+// BuildStaticScene().
+LightClusters g_LightClusters;
+glm::vec4     g_CarHeadlights[2];
+glm::vec4     g_CarHeadlightDirection;
+
+// Mapa de sombras da lanterna (veja "shadowmap.h") e a fila que desenha as
+// suas camadas, com um único passo na câmera da luz. Os objetos opacos e as
+// folhas das árvores, que descartam os fragmentos transparentes da textura,
+// usam permutações diferentes do programa do mapa de sombras.
+#define SHADOW_MAP_SIZE 1024
+enum ShadowProgram
+{
+    SHADOW_PROGRAM_OPACO,
+    SHADOW_PROGRAM_RECORTE,
+    NUM_SHADOW_PROGRAMS
+};
+ShadowMap   g_ShadowMap;
+RenderQueue g_ShadowQueue;
+int         g_ShadowPrograms[NUM_SHADOW_PROGRAMS];
+GLuint      g_ShadowProgramIDs[NUM_SHADOW_PROGRAMS];
+std::vector<char> g_ShadowVisible;
+
+// Meio ângulo do cone da lanterna (veja luz_lanterna() em
+// "shader_fragment.glsl")
+#define FLASHLIGHT_CONE_ANGLE (25.0f * PI / 180.0f)
+
+// Buffers de vértices e índices compartilhados por todos os objetos de
+// g_VirtualScene. Veja AddMeshToVirtualScene().
+SceneGeometry g_SceneGeometry;
+
+// Região do atlas de texturas usada por cada objeto, preenchida por
+// BuildAndUploadAtlas() e aplicada por UploadModel().
+std::map<std::string, AtlasRegion> g_AtlasRegions;
 
 
 // Pilha que guardará as matrizes de modelagem.
@@ -262,6 +517,10 @@ std::stack<glm::mat4>  g_MatrixStack;
 // Razão de proporção da janela (largura/altura). Veja função FramebufferSizeCallback().
 float g_ScreenRatio = 1.0f;
 
+// Dimensões do framebuffer em pixels. Veja função FramebufferSizeCallback().
+int g_ScreenWidth = 800;
+int g_ScreenHeight = 800;
+
 // Ângulos de Euler que controlam a rotação de um dos cubos da cena virtual
 float g_AngleX = 0.0f;
 float g_AngleY = 0.0f;
@@ -345,28 +604,43 @@ bool g_UsePerspectiveProjection = true;
 // Variável que controla se o texto informativo será mostrado na tela.
 bool g_ShowInfoText = true;
 
-// Variáveis que definem um programa de GPU (shaders). Veja função LoadShadersFromFiles().
-GLuint g_GpuProgramID = 0;
-GLint g_model_uniform;
-GLint g_view_uniform;
-GLint g_projection_uniform;
-GLint g_object_id_uniform;
-GLint g_bbox_min_uniform;
-GLint g_bbox_max_uniform;
-// Variáveis que eu criei para enviar para o fragment shader
-GLint lanterna_ligada_uniform;
-GLint smoke_life_uniform;
-GLint nozzle_flash_uniform;
-GLint tronco_uniform;
-GLint parte_carro_uniform;
-GLint tela_de_menu_uniform;
-GLint alpha_uniform;
-
-// Número de texturas carregadas pela função LoadTextureImage()
+// Se true, os shaders invertem as matrizes na GPU, como antes de
+// Matrix_Camera_Position() e Matrix_Normal(). Definida pela opção
+// "--gpu-inverses", para comparação com RunFillRateBenchmark().
+bool g_GpuInverses = false;
+
+// Programas de GPU (shaders) que desenham os objetos, um por material. Veja
+// função SetupMainProgram(). As variáveis usadas no desenho dos objetos
+// ("model", "view", "lanterna_ligada", etc.) são enviadas por g_RenderQueue
+// em blocos de uniforms (veja "renderqueue.h").
+GLuint g_MaterialProgramIDs[NUM_MATERIALS];
+
+// Programa de GPU que desenha o céu (veja DrawSky()).
+GLuint g_SkyProgramID = 0;
+GLint g_sky_inverse_view_projection_uniform;
+GLint g_sky_color_uniform;
+
+// Número de unidades de textura já reservadas (veja AddTextureAsset())
 GLuint g_NumLoadedTextures = 0;
 
 int main(int argc, char* argv[])
 {
+    // Opções da linha de comando: "--fillrate" mede o custo por pixel da
+    // cena e encerra (veja RunFillRateBenchmark()), "--gpu-inverses" volta a
+    // inverter as matrizes nos shaders, e um nome de arquivo ".obj" é
+    // carregado junto com os modelos do jogo.
+    bool fillrate_benchmark = false;
+    const char* extra_model = NULL;
+    for (int i = 1; i < argc; ++i)
+    {
+        if ( strcmp(argv[i], "--fillrate") == 0 )
+            fillrate_benchmark = true;
+        else if ( strcmp(argv[i], "--gpu-inverses") == 0 )
+            g_GpuInverses = true;
+        else
+            extra_model = argv[i];
+    }
+
     // Inicializamos a biblioteca GLFW, utilizada para criar uma janela do
     // sistema operacional, onde poderemos renderizar com OpenGL.
     int success = glfwInit();
@@ -435,110 +709,107 @@ int main(int argc, char* argv[])
 
     printf("GPU: %s, %s, OpenGL %s, GLSL %s\n", vendor, renderer, glversion, glslversion);
 
-    // Carregamos os shaders de vértices e de fragmentos que serão utilizados
-    // para renderização. Veja slides 180-200 do documento Aula_03_Rendering_Pipeline_Grafico.pdf.
+    // Os programas de GPU são criados a partir dos binários guardados na
+    // execução anterior, quando o driver oferece suporte.
+    ProgramCache_Init((GLADloadproc) glfwGetProcAddress);
+    ShaderManager_Init((GLADloadproc) glfwGetProcAddress);
+
+    // Submetemos a compilação dos shaders de vértices e de fragmentos que
+    // serão utilizados para renderização. Os programas ficam prontos durante
+    // o carregamento dos assets (veja LoadAssets()). Veja slides 180-200 do
+    // documento Aula_03_Rendering_Pipeline_Grafico.pdf.
     //
     LoadShadersFromFiles();
 
+    // Inicializamos o código para renderização de texto, usado também pela
+    // tela de carregamento.
+    TextRendering_Init();
+
+    // Os níveis maiores de cada textura são enviados de forma gradual, a
+    // partir do primeiro quadro do menu.
+    TextureStreamer_Init(TEXTURE_STREAM_BYTES_PER_FRAME, TEXTURE_MEMORY_BUDGET, TEXTURE_COMPRESSION);
+
+    // Listamos as imagens de textura e os modelos utilizados pelo jogo, que
+    // são carregados em paralelo por LoadAssets(). As unidades de textura
+    // seguem a ordem desta lista (veja LoadShadersFromFiles()). Cada textura
+    // declara o seu formato e a sua prioridade no orçamento de memória.
+    AssetList assets;
+
     // Carregamos duas imagens para serem utilizadas como textura
-    LoadTextureImage("../../data/Textures/chao.jpg");                         // chao_diff
-    LoadTextureImage("../../data/Textures/ceu.hdr");                          // ceu
-    LoadTextureImage("../../data/Textures/flashlight_H.jpg");                 // lanterna
-    LoadTextureImage("../../data/Textures/CrossHair.png");                    // crosshair
-    LoadTextureImage("../../data/Textures/chao_normal.jpg");                  // chao_normal
+    AddTextureAsset(&assets, "../../data/Textures/chao.jpg",             TEXTURE_SRGB,       TEXTURE_TIER_COLOR);  // chao_diff
+    AddSkyAsset(&assets, "../../data/Textures/ceu.hdr");                                                             // ceu
+    AddTextureAsset(&assets, "../../data/Textures/flashlight_H.jpg",     TEXTURE_SRGB,       TEXTURE_TIER_COLOR);  // lanterna
+    AddTextureAsset(&assets, "../../data/Textures/CrossHair.png",        TEXTURE_SRGB,       TEXTURE_TIER_UI);     // crosshair
+    AddTextureAsset(&assets, "../../data/Textures/chao_normal.jpg",      TEXTURE_NORMAL_MAP, TEXTURE_TIER_DETAIL); // chao_normal
 
     // Fantasmas
-    LoadTextureImage("../../data/Textures/skull_diff.png");                   // skull_diff
-    LoadTextureImage("../../data/Textures/skull_nm.png");                     // skull_normal
+    AddTextureAsset(&assets, "../../data/Textures/skull_diff.png",       TEXTURE_SRGB,       TEXTURE_TIER_COLOR);  // skull_diff
+    AddTextureAsset(&assets, "../../data/Textures/skull_nm.png",         TEXTURE_NORMAL_MAP, TEXTURE_TIER_DETAIL); // skull_normal
 
-    // Partículas de fumaça
-    LoadTextureImage("../../data/Textures/smoke.png");                        // smoke
+    // Partículas de fumaça. A imagem é colorida e o fundo é descartado pela
+    // cor no shader, portanto ela não pode ser reduzida a uma máscara.
+    AddTextureAsset(&assets, "../../data/Textures/smoke.png",            TEXTURE_SRGB,       TEXTURE_TIER_COLOR);  // smoke
 
     // Árvores
-    LoadTextureImage("../../data/Textures/bark1.jpg");                        // bark
-    LoadTextureImage("../../data/Textures/leaf.png");                         // folhas
+    AddTextureAsset(&assets, "../../data/Textures/bark1.jpg",            TEXTURE_SRGB,       TEXTURE_TIER_COLOR);  // bark
+    AddTextureAsset(&assets, "../../data/Textures/leaf.png",             TEXTURE_SRGB_ALPHA, TEXTURE_TIER_COLOR);  // folhas
 
     // Cabine
-    LoadTextureImage("../../data/Textures/WoodCabin.jpg");                    // cabin_diff
-    LoadTextureImage("../../data/Textures/WoodCabinNM.jpg");                  // cabin_normal
-    LoadTextureImage("../../data/Textures/WoodCabinSM.jpg");                  // cabin_spec
-
-    // Texturas do carro
-    LoadTextureImage("../../data/Textures/car_tex/Backlight1.jpg");           // car_BL1
-    LoadTextureImage("../../data/Textures/car_tex/Backlight2.jpg");           // car_BL2
-    LoadTextureImage("../../data/Textures/car_tex/GuidLight.jpg");            // car_GL
-    LoadTextureImage("../../data/Textures/car_tex/Headlight.jpg");            // car_HL
-    LoadTextureImage("../../data/Textures/car_tex/LightBelow.jpg");           // car_BL
-    LoadTextureImage("../../data/Textures/car_tex/Plaque.png");               // car_Plaque
-    LoadTextureImage("../../data/Textures/car_tex/SamandLogo.png");           // car_Logo
-    LoadTextureImage("../../data/Textures/car_tex/Tire.png");                 // car_Tire
+    AddTextureAsset(&assets, "../../data/Textures/WoodCabin.jpg",        TEXTURE_SRGB,       TEXTURE_TIER_COLOR);  // cabin_diff
+    AddTextureAsset(&assets, "../../data/Textures/WoodCabinNM.jpg",      TEXTURE_NORMAL_MAP, TEXTURE_TIER_DETAIL); // cabin_normal
+    AddTextureAsset(&assets, "../../data/Textures/WoodCabinSM.jpg",      TEXTURE_MASK,       TEXTURE_TIER_DETAIL); // cabin_spec
+
+    // Texturas do carro, reunidas em um único atlas junto com as cores da
+    // lataria e dos vidros. Cada imagem é usada pelos objetos listados.
+    AddAtlasAsset(&assets);                                                   // car_atlas
+    AddAtlasColor(&assets, glm::vec3(0.2f,0.2f,0.9f), {"Body1", "Steel", "UnderCar", "Hood", "Body"});
+    AddAtlasColor(&assets, glm::vec3(0.0f,0.0f,0.0f), {"Glass", "Plastik", "Light1", "Light2", "Light3"});
+    AddAtlasImage(&assets, "../../data/Textures/car_tex/SamandLogo.png", {"Logo"});
+    AddAtlasImage(&assets, "../../data/Textures/car_tex/Plaque.png",     {"Plaque", "Plaque1"});
+    AddAtlasImage(&assets, "../../data/Textures/car_tex/GuidLight.jpg",  {"GuidLight1", "GuidLight"});
+    AddAtlasImage(&assets, "../../data/Textures/car_tex/Backlight1.jpg", {"Light"});
+    AddAtlasImage(&assets, "../../data/Textures/car_tex/Tire.png",       {"Tire", "Tire1", "Tire2", "Tire3"});
 
     // Tela de fim de jogo
-    LoadTextureImage("../../data/Textures/tela_fim_de_jogo.png");             // tela final
-    LoadTextureImage("../../data/Textures/tela_game_over.png");
-
-    // Construímos a representação de objetos geométricos através de malhas de triângulos
-    ObjModel spheremodel("../../data/Objects/sphere.obj");
-   // PrintObjModelInfo(&spheremodel);
-    ComputeNormals(&spheremodel);
-    BuildTrianglesAndAddToVirtualScene(&spheremodel);
-
-    ObjModel planemodel("../../data/Objects/plane.obj");
-  //  PrintObjModelInfo(&planemodel);
-    ComputeNormals(&planemodel);
-    BuildTrianglesAndAddToVirtualScene(&planemodel);
-
-    ObjModel flashlightmodel("../../data/Objects/flashlight.obj");
-   // PrintObjModelInfo(&flashlightmodel);
-    ComputeNormals(&flashlightmodel);
-    BuildTrianglesAndAddToVirtualScene(&flashlightmodel);
-
-    ObjModel revolvermodel("../../data/Objects/revolver.obj");
-    ComputeNormals(&revolvermodel);
-    BuildTrianglesAndAddToVirtualScene(&revolvermodel);
-
-    ObjModel screenmodel("../../data/Objects/screen.obj");
-    //PrintObjModelInfo(&screenmodel);
-    ComputeNormals(&screenmodel);
-    BuildTrianglesAndAddToVirtualScene(&screenmodel);
-
-    ObjModel skullmodel("../../data/Objects/skull.obj");
-    //PrintObjModelInfo(&skullmodel);
-    ComputeNormals(&skullmodel);
-    BuildTrianglesAndAddToVirtualScene(&skullmodel);
-
-    ObjModel eyemodel("../../data/Objects/eye.obj");
-    ComputeNormals(&eyemodel);
-    BuildTrianglesAndAddToVirtualScene(&eyemodel);
-
-    ObjModel bulletmodel("../../data/Objects/bullet.obj");
-    ComputeNormals(&bulletmodel);
-    BuildTrianglesAndAddToVirtualScene(&bulletmodel);
-
-    ObjModel treesmodel("../../data/Objects/trees.obj");
-    ComputeNormals(&treesmodel);
-    BuildTrianglesAndAddToVirtualScene(&treesmodel);
-
-    ObjModel cabinmodel("../../data/Objects/cabin.obj");
-    ComputeNormals(&cabinmodel);
-    BuildTrianglesAndAddToVirtualScene(&cabinmodel);
-
-    ObjModel carmodel("../../data/Objects/car.obj");
-    ComputeNormals(&carmodel);
-    BuildTrianglesAndAddToVirtualScene(&carmodel);
-
-    ObjModel tela_final("../../data/Objects/tela_fim_de_jogo.obj");
-    ComputeNormals(&tela_final);
-    BuildTrianglesAndAddToVirtualScene(&tela_final);
-
-    if ( argc > 1 )
+    AddTextureAsset(&assets, "../../data/Textures/tela_fim_de_jogo.png", TEXTURE_SRGB,       TEXTURE_TIER_UI);     // tela final
+    AddTextureAsset(&assets, "../../data/Textures/tela_game_over.png",   TEXTURE_SRGB,       TEXTURE_TIER_UI);
+
+    // Construímos a representação de objetos geométricos através de malhas de
+    // triângulos. Na primeira execução os modelos são lidos dos arquivos
+    // ".obj" e gravados em um cache binário, que é usado nas execuções
+    // seguintes. Veja ReadModel(). Todos os modelos são
+    // armazenados nos mesmos buffers da GPU (veja "scenegeometry.h").
+    SceneGeometry_Init(&g_SceneGeometry);
+    RenderQueue_Init(&g_RenderQueue);
+    LightClusters_Init(&g_LightClusters);
+    RenderQueue_Init(&g_ShadowQueue);
+    ShadowMap_Init(&g_ShadowMap, SHADOW_MAP_SIZE);
+
+    AddModelAsset(&assets, "../../data/Objects/plane.obj");
+    AddModelAsset(&assets, "../../data/Objects/flashlight.obj");
+    AddModelAsset(&assets, "../../data/Objects/revolver.obj");
+    AddModelAsset(&assets, "../../data/Objects/screen.obj");
+    AddModelAsset(&assets, "../../data/Objects/skull.obj");
+    AddModelAsset(&assets, "../../data/Objects/eye.obj");
+    AddModelAsset(&assets, "../../data/Objects/bullet.obj");
+    AddModelAsset(&assets, "../../data/Objects/trees.obj");
+    AddModelAsset(&assets, "../../data/Objects/cabin.obj");
+    AddModelAsset(&assets, "../../data/Objects/car.obj");
+    AddModelAsset(&assets, "../../data/Objects/tela_fim_de_jogo.obj");
+
+    LoadAssets(window, &assets);
+
+    if ( extra_model != NULL )
     {
-        ObjModel model(argv[1]);
+        ObjModel model(extra_model);
         BuildTrianglesAndAddToVirtualScene(&model);
     }
 
-    // Inicializamos o código para renderização de texto.
-    TextRendering_Init();
+    ResolveSceneObjects();
+
+    printf("Geometria da cena: %u vértices (%.1f KB), %u índices (%.1f KB).\n",
+        (unsigned)g_SceneGeometry.num_vertices, g_SceneGeometry.num_vertices * sizeof(PackedVertex) / 1024.0,
+        (unsigned)g_SceneGeometry.num_indices, g_SceneGeometry.num_indices * sizeof(GLuint) / 1024.0);
 
     // Habilitamos o Z-buffer. Veja slides 104-116 do documento Aula_09_Projecoes.pdf.
     glEnable(GL_DEPTH_TEST);
@@ -569,9 +840,8 @@ int main(int argc, char* argv[])
     Plano chao(glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, 0.0f, 0.0f));
 
 
-   /* for (const auto& entry : g_VirtualScene) {
-        const std::string& objectName = entry.first;
-        const SceneObject& sceneObject = entry.second;
+   /* for (const SceneObject& sceneObject : g_VirtualScene.objects) {
+        const std::string& objectName = sceneObject.name;
 
         std::cout << "Object Name: " << objectName << std::endl;
         std::cout << "First Index: " << sceneObject.first_index << std::endl;
@@ -636,6 +906,16 @@ int main(int argc, char* argv[])
 
     //jogador.pos = arvores[0].pos;
 
+    // Cenário estático, descartado pela BVH quando fora do campo de visão
+    BuildStaticScene(arvores, NUM_ARVORES, carro);
+
+    if ( fillrate_benchmark )
+    {
+        RunFillRateBenchmark();
+        glfwTerminate();
+        return 0;
+    }
+
     // Carro
     cenario.push_back(AABB(glm::vec3(5.0f, 0.0f, -2.5f), glm::vec3(7.0f, 1.0f, 2.75f)));
     // Casa parede direita >
@@ -683,7 +963,7 @@ int main(int argc, char* argv[])
     // Ficamos em um loop infinito, renderizando, até que o usuário feche a janela
     while (!glfwWindowShouldClose(window))
     {
-        glUniform1i(tela_de_menu_uniform, true);
+        g_RenderQueue.frame.tela_de_menu = 1;
         if (tecla_SPACE_pressionada)       // Pressionar espaço p sair do menu e começar o jogo
             sair_menu = true;
 
@@ -699,10 +979,6 @@ int main(int argc, char* argv[])
         // e também resetamos todos os pixels do Z-buffer (depth buffer).
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        // Pedimos para a GPU utilizar o programa de GPU criado acima (contendo
-        // os shaders de vértice e fragmentos).
-        glUseProgram(g_GpuProgramID);
-
         // Computamos a posição da câmera utilizando coordenadas esféricas.  As
         // variáveis g_CameraDistance, g_CameraPhi, e g_CameraTheta são
         // controladas pelo mouse do usuário. Veja as funções CursorPosCallback()
@@ -725,120 +1001,48 @@ int main(int argc, char* argv[])
 
         // Computamos a matriz "View" utilizando os parâmetros da câmera para definir o sistema de coordenadas da câmera.
         glm::mat4 view = Matrix_Camera_View(camera_position_c, camera_view_vector, camera_up_vector);
-        glUniformMatrix4fv(g_view_uniform       , 1 , GL_FALSE , glm::value_ptr(view));
 
         // Definimos a matriz de projeção como perspectiva
         float field_of_view = PI / 3.0f;
         float nearplane = -0.1f;  // Posição do "near plane"
         float farplane  = -30.0f; // Posição do "far plane"
         glm::mat4 perspective = Matrix_Perspective(field_of_view, g_ScreenRatio, nearplane, farplane);
-        glUniformMatrix4fv(g_projection_uniform , 1 , GL_FALSE , glm::value_ptr(perspective));
 
-        glm::mat4 model = Matrix_Identity(); // Transformação identidade de modelagem
+        // Os objetos são submetidos para g_RenderQueue e desenhados, ordenados
+        // por estado, por RenderQueue_Flush().
+        RenderQueue_SetPass(&g_RenderQueue, PASS_OPAQUE, view, perspective, Matrix_Camera_Position(view), RENDER_PASS_DEPTH_TEST | RENDER_PASS_CULL_FACE);
+
+        // Apenas os objetos dentro do campo de visão são submetidos
+        Frustum frustum = Culling_ExtractFrustum(perspective * view);
+        g_CullStats = CullStats();
 
-        #define SPHERE 0
         #define BULLET 1
         #define PLANE  2
         #define ARVORE  9
         #define CABINE  10
         #define CARRO  11
+        #define TRONCO 14
 
-        // SPHERE
-        glDisable(GL_DEPTH_TEST);
-        glDisable(GL_CULL_FACE);
-        model = Matrix_Translate(camera_position_c[0], camera_position_c[1], camera_position_c[2]);
-        glUniformMatrix4fv(g_model_uniform, 1 , GL_FALSE , glm::value_ptr(model));
-        glUniform1i(g_object_id_uniform, SPHERE);
-        DrawVirtualObject("the_sphere");
-        glEnable(GL_CULL_FACE);
-        glEnable(GL_DEPTH_TEST);
-
-        // PLANE
-        model = Matrix_Translate(0.0f, 0.0f, 0.0f)
-              * Matrix_Scale(350.0f,1.0f,350.0f);
-        glUniformMatrix4fv(g_model_uniform, 1 , GL_FALSE , glm::value_ptr(model));
-        glUniform1i(g_object_id_uniform, PLANE);
-        DrawVirtualObject("the_plane");
-
-        // CABINE
-        model = Matrix_Translate(0.0f, 0.0f, 0.0f)
-              * Matrix_Scale(0.1f,0.1f,0.1f);
-        glUniformMatrix4fv(g_model_uniform, 1 , GL_FALSE , glm::value_ptr(model));
-        glUniform1i(g_object_id_uniform, CABINE);
-        DrawVirtualObject("WoodCabin");
-        DrawVirtualObject("Roof");
-
-        // CARRO & VIDROS
-        model = Matrix_Translate(carro.pos[0], 0.0f, carro.pos[2])
-              * Matrix_Scale(0.01f,0.01f,0.01f);
-        glUniformMatrix4fv(g_model_uniform, 1 , GL_FALSE , glm::value_ptr(model));
-        glUniform1i(g_object_id_uniform, CARRO);
-        // Body
-        glUniform1i(parte_carro_uniform, 1);
-        DrawVirtualObject("Body1");
-        DrawVirtualObject("Steel");
-        DrawVirtualObject("UnderCar");
-        DrawVirtualObject("Hood");
-        DrawVirtualObject("Body");
-        // Vidros
-        glUniform1i(parte_carro_uniform, 2);
-        DrawVirtualObject("Glass");
-        DrawVirtualObject("Plastik");
-
-        DrawVirtualObject("Light1");
-        DrawVirtualObject("Light2");
-        DrawVirtualObject("Light3");
-        // Logo
-        glUniform1i(parte_carro_uniform, 3);
-        DrawVirtualObject("Logo");
-        // Placa
-        glUniform1i(parte_carro_uniform, 4);
-        DrawVirtualObject("Plaque");
-        DrawVirtualObject("Plaque1");
-        // Pisca
-        glUniform1i(parte_carro_uniform, 5);
-        DrawVirtualObject("GuidLight1");
-        DrawVirtualObject("GuidLight");
-        // Faróis
-        glUniform1i(parte_carro_uniform, 6);
-        DrawVirtualObject("Light");
-
-        glUniform1i(parte_carro_uniform, 7);
-        // Pneus
-        glUniform1i(parte_carro_uniform, 8);
-        DrawVirtualObject("Tire");
-        DrawVirtualObject("Tire1");
-        DrawVirtualObject("Tire2");
-        DrawVirtualObject("Tire3");
-
-        // ARVORES
-        glEnable(GL_BLEND);
-        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-        for(int i=0; i<NUM_ARVORES; i++)
-        {
-            // TRONCO
-            model = Matrix_Translate(arvores[i].pos.x,0.0f,arvores[i].pos.z)
-                * Matrix_Scale(1.0f,1.0f,1.0f)
-                * Matrix_Rotate_Y(arvores[i].rotacao);
-            //std::cout << glm::value_ptr(model) << std::endl;
-            glUniformMatrix4fv(g_model_uniform, 1 , GL_FALSE , glm::value_ptr(model));
-            glUniform1i(g_object_id_uniform, ARVORE);
-            glUniform1i(tronco_uniform, true);
-            DrawVirtualObject("bark1");
-            // FOLHAS
-            glUniformMatrix4fv(g_model_uniform, 1 , GL_FALSE , glm::value_ptr(model));
-            glUniform1i(g_object_id_uniform, ARVORE);
-            glUniform1i(tronco_uniform, false);
-            DrawVirtualObject("leaves1");
-        }
-        // Resetamos a matriz View para que os objetos carregados a partir daqui não se movimentem na tela.
-        glUniformMatrix4fv(g_view_uniform       , 1 , GL_FALSE , glm::value_ptr(Matrix_Identity()));
+        // CÉU
+        DrawSky(view, perspective, true);
+
+        // PLANE, CABINE, CARRO & VIDROS e ARVORES (veja BuildStaticScene())
+        QueueStaticObjects(PASS_OPAQUE, frustum);
+
+        // O menu não tem luzes dinâmicas
+        LightClusters_Clear(&g_LightClusters);
+        LightClusters_Build(&g_LightClusters, view, perspective, -nearplane, -farplane, g_ScreenWidth, g_ScreenHeight);
+
+        RenderQueue_Flush(&g_RenderQueue);
 
         //texto do menu
 
         TextRendering_Menu(window, mov_escrita);
         mov_escrita++;
 
+        // Enviamos para a GPU mais alguns níveis de mipmap das texturas
+        TextureStreamer_Update();
+
         glfwSwapBuffers(window);
 
         TextRendering_ShowSecondsEllapsed(window);
@@ -862,7 +1066,7 @@ int main(int argc, char* argv[])
         glfwSetWindowMonitor(window, _fullscreen ? glfwGetPrimaryMonitor() : NULL, 0, 0, 4000, 4000, GLFW_DONT_CARE);
 
         // Serve para mudar a iluminação global durante a gameplay
-        glUniform1i(tela_de_menu_uniform, false);
+        g_RenderQueue.frame.tela_de_menu = 0;
         // Variáveis de tempo
         float current_time = (float)glfwGetTime();
         delta_t = current_time - prev_time;
@@ -882,10 +1086,6 @@ int main(int argc, char* argv[])
         // e também resetamos todos os pixels do Z-buffer (depth buffer).
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        // Pedimos para a GPU utilizar o programa de GPU criado acima (contendo
-        // os shaders de vértice e fragmentos).
-        glUseProgram(g_GpuProgramID);
-
         // Computamos a posição da câmera utilizando coordenadas esféricas.  As
         // variáveis g_CameraDistance, g_CameraPhi, e g_CameraTheta são
         // controladas pelo mouse do usuário. Veja as funções CursorPosCallback()
@@ -1027,7 +1227,7 @@ int main(int argc, char* argv[])
                 lanterna_ligada = true;
 
             // Envia a informação da lanterna para o Fragment Shader, para ligar ou desligar a luz.
-            glUniform1i(lanterna_ligada_uniform, lanterna_ligada ? 1 : 0);
+            g_RenderQueue.frame.lanterna_ligada = lanterna_ligada ? 1 : 0;
 
             // O eixo z da câmera sempre é igual ao eixo da posição do jogador
             jogador.camera[0] = jogador.pos[0];
@@ -1092,9 +1292,9 @@ int main(int argc, char* argv[])
                 }
 
             if(cooldown_tiro <= 0.1)
-                glUniform1i(nozzle_flash_uniform, 1);
+                g_RenderQueue.frame.nozzle_flash = 1;
             else
-                glUniform1i(nozzle_flash_uniform, 0);
+                g_RenderQueue.frame.nozzle_flash = 0;
 
             // Para cada bala, testa se está ativa, se sim, incrementa seu timer e sua posicao e testa se seu tempo de atividade expirou, se estiver inativa, reseta seus
             // parâmetros, testando a colisão com os monstros
@@ -1256,13 +1456,34 @@ int main(int argc, char* argv[])
 
         glm::mat4 model = Matrix_Identity(); // Transformação identidade de modelagem
 
-        // Enviamos as matrizes "view" e "projection" para a placa de vídeo
-        // (GPU). Veja o arquivo "shader_vertex.glsl", onde estas são
-        // efetivamente aplicadas em todos os pontos.
-        glUniformMatrix4fv(g_view_uniform       , 1 , GL_FALSE , glm::value_ptr(view));
-        glUniformMatrix4fv(g_projection_uniform , 1 , GL_FALSE , glm::value_ptr(perspective));
+        // Passos de renderização do quadro. Os monstros não são ordenados por
+        // distância, portanto o seu passo é ordenado por estado: todas as
+        // caveiras (SKULL) são desenhadas antes de todos os olhos (EYE), e
+        // cada tipo com uma única chamada instanciada. As matrizes "view" e "projection"
+        // de cada passo são enviadas para a placa de vídeo (GPU) por
+        // RenderQueue_Flush(). Veja o arquivo "shader_vertex.glsl", onde estas
+        // são efetivamente aplicadas em todos os pontos. Os objetos segurados
+        // pelo jogador e a mira usam a matriz View identidade, para que não se
+        // movimentem na tela.
+        const unsigned scene_state = RENDER_PASS_DEPTH_TEST | RENDER_PASS_CULL_FACE;
+
+        // Apenas os objetos dentro do campo de visão são submetidos. Os
+        // objetos segurados pelo jogador e a mira estão sempre visíveis.
+        Frustum frustum = Culling_ExtractFrustum(perspective * view);
+        g_CullStats = CullStats();
+
+        // Os objetos segurados pelo jogador e as telas são desenhados com a
+        // câmera na origem.
+        glm::vec4 camera_position = Matrix_Camera_Position(view);
+        glm::vec4 origin = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+
+        RenderQueue_SetPass(&g_RenderQueue, PASS_OPAQUE, view, perspective, camera_position, scene_state);
+        RenderQueue_SetPass(&g_RenderQueue, PASS_TRANSLUCENT, view, perspective, camera_position, scene_state | RENDER_PASS_BLEND);
+        RenderQueue_SetPass(&g_RenderQueue, PASS_HELD_OPAQUE, Matrix_Identity(), perspective, origin, scene_state | RENDER_PASS_CLEAR_DEPTH);
+        RenderQueue_SetPass(&g_RenderQueue, PASS_HELD_TRANSLUCENT, Matrix_Identity(), perspective, origin, scene_state | RENDER_PASS_BLEND | RENDER_PASS_ORDERED);
+        RenderQueue_SetPass(&g_RenderQueue, PASS_SCREEN, Matrix_Identity(), orthographic, origin, RENDER_PASS_CULL_FACE | RENDER_PASS_BLEND | RENDER_PASS_ORDERED);
+        RenderQueue_SetPass(&g_RenderQueue, PASS_END_SCREEN, Matrix_Identity(), perspective, origin, RENDER_PASS_BLEND | RENDER_PASS_ORDERED);
 
-        #define SPHERE 0
         #define BULLET 1
         #define PLANE  2
         #define FLASHLIGHT  3
@@ -1276,74 +1497,37 @@ int main(int argc, char* argv[])
         #define CARRO  11
         #define TELA_FINAL 12
         #define TELA_FINAL2 13
+        #define TRONCO 14
+
+        // Luzes dinâmicas do quadro. Os olhos de cada monstro são
+        // adicionados por QueueMonster().
+        LightClusters_Clear(&g_LightClusters);
+        AddDynamicLights(view, g_RenderQueue.frame.nozzle_flash != 0);
+
+        // SOMBRAS DA LANTERNA
+        // A luz sai da lanterna segurada pelo jogador, e não do centro da
+        // câmera: vistas do ponto de onde a luz sai, as sombras ficariam
+        // escondidas atrás dos próprios objetos. A camada estática do mapa
+        // de sombras é redesenhada apenas quando a lanterna se move o
+        // suficiente; as caveiras são desenhadas sobre ela por QueueMonster().
+        Frustum shadow_frustum;
+        if (lanterna_ligada)
+        {
+            // Posição da lanterna no sistema da câmera (veja FLASHLIGHT
+            // abaixo), levada ao sistema global pela inversa da rotação de
+            // "view", que é a sua transposta.
+            glm::vec3 flashlight_offset = glm::vec3(lanterna_pos[0]-0.6f, lanterna_pos[1]-0.4f, lanterna_pos[2]);
+            glm::vec4 flashlight_position = camera_position + glm::vec4(glm::transpose(glm::mat3(view)) * flashlight_offset, 0.0f);
+            glm::vec4 flashlight_direction = -glm::vec4(view[0][2], view[1][2], view[2][2], 0.0f);
+            shadow_frustum = UpdateFlashlightShadows(flashlight_position, flashlight_direction);
+        }
+        const Frustum* shadow_casters = lanterna_ligada ? &shadow_frustum : NULL;
+
+        // CÉU
+        DrawSky(view, perspective, false);
 
-        // SPHERE
-        glDisable(GL_DEPTH_TEST);
-        glDisable(GL_CULL_FACE);
-        model = Matrix_Translate(jogador.camera[0], jogador.camera[1], jogador.camera[2]);
-        glUniformMatrix4fv(g_model_uniform, 1 , GL_FALSE , glm::value_ptr(model));
-        glUniform1i(g_object_id_uniform, SPHERE);
-        DrawVirtualObject("the_sphere");
-        glEnable(GL_CULL_FACE);
-        glEnable(GL_DEPTH_TEST);
-
-        // PLANE
-        model = Matrix_Translate(0.0f, 0.0f, 0.0f)
-              * Matrix_Scale(350.0f,1.0f,350.0f);
-        glUniformMatrix4fv(g_model_uniform, 1 , GL_FALSE , glm::value_ptr(model));
-        glUniform1i(g_object_id_uniform, PLANE);
-        DrawVirtualObject("the_plane");
-
-        // CABINE
-        model = Matrix_Translate(0.0f, 0.0f, 0.0f)
-              * Matrix_Scale(0.1f,0.1f,0.1f);
-        glUniformMatrix4fv(g_model_uniform, 1 , GL_FALSE , glm::value_ptr(model));
-        glUniform1i(g_object_id_uniform, CABINE);
-        DrawVirtualObject("WoodCabin");
-        DrawVirtualObject("Roof");
-
-        // CARRO & VIDROS
-        model = Matrix_Translate(carro.pos[0], 0.0f, carro.pos[2])
-              * Matrix_Scale(0.01f,0.01f,0.01f);
-        glUniformMatrix4fv(g_model_uniform, 1 , GL_FALSE , glm::value_ptr(model));
-        glUniform1i(g_object_id_uniform, CARRO);
-        // Body
-        glUniform1i(parte_carro_uniform, 1);
-        DrawVirtualObject("Body1");
-        DrawVirtualObject("Steel");
-        DrawVirtualObject("UnderCar");
-        DrawVirtualObject("Hood");
-        DrawVirtualObject("Body");
-        // Vidros
-        glUniform1i(parte_carro_uniform, 2);
-        DrawVirtualObject("Glass");
-        DrawVirtualObject("Plastik");
-
-        DrawVirtualObject("Light1");
-        DrawVirtualObject("Light2");
-        DrawVirtualObject("Light3");
-        // Logo
-        glUniform1i(parte_carro_uniform, 3);
-        DrawVirtualObject("Logo");
-        // Placa
-        glUniform1i(parte_carro_uniform, 4);
-        DrawVirtualObject("Plaque");
-        DrawVirtualObject("Plaque1");
-        // Pisca
-        glUniform1i(parte_carro_uniform, 5);
-        DrawVirtualObject("GuidLight1");
-        DrawVirtualObject("GuidLight");
-        // Faróis
-        glUniform1i(parte_carro_uniform, 6);
-        DrawVirtualObject("Light");
-
-        glUniform1i(parte_carro_uniform, 7);
-        // Pneus
-        glUniform1i(parte_carro_uniform, 8);
-        DrawVirtualObject("Tire");
-        DrawVirtualObject("Tire1");
-        DrawVirtualObject("Tire2");
-        DrawVirtualObject("Tire3");
+        // PLANE, CABINE, CARRO & VIDROS e ARVORES (veja BuildStaticScene())
+        QueueStaticObjects(PASS_OPAQUE, frustum);
 
         // BULLET
         for(int i=0; i<N_AMMO; i++)
@@ -1353,127 +1537,79 @@ int main(int argc, char* argv[])
                       * Matrix_Scale(0.04f,0.04f,0.04f)
                       * Matrix_Rotate_Y(ammo[i].rotacao)
                       * Matrix_Rotate_X(PI/2);
-                glUniformMatrix4fv(g_model_uniform, 1 , GL_FALSE , glm::value_ptr(model));
-                glUniform1i(g_object_id_uniform, BULLET);
-                DrawVirtualObject("45_ACP_Low_Poly");
+                if ( CullDynamicObject(frustum, ObjectBox(g_Objects.bullet, model)) )
+                    QueueVirtualObject(PASS_OPAQUE, g_Objects.bullet, BULLET, model);
             }
 
-        // ARVORES
-        glEnable(GL_BLEND);
-        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-        for(int i=0; i<NUM_ARVORES; i++)
-        {
-            // TRONCO
-            model = Matrix_Translate(arvores[i].pos.x,0.0f,arvores[i].pos.z)
-                * Matrix_Scale(1.0f,1.0f,1.0f)
-                * Matrix_Rotate_Y(arvores[i].rotacao);
-            glUniformMatrix4fv(g_model_uniform, 1 , GL_FALSE , glm::value_ptr(model));
-            glUniform1i(g_object_id_uniform, ARVORE);
-            glUniform1i(tronco_uniform, true);
-            DrawVirtualObject("bark1");
-            // FOLHAS
-            glUniformMatrix4fv(g_model_uniform, 1 , GL_FALSE , glm::value_ptr(model));
-            glUniform1i(g_object_id_uniform, ARVORE);
-            glUniform1i(tronco_uniform, false);
-            DrawVirtualObject("leaves1");
-        }
-
         // SKULL & EYE
         for(int i=0; i<N_MONSTROS; i++)
         {
             model = Matrix_Translate(monstro[i].pos[0], monstro[i].pos[1], monstro[i].pos[2])
                   * Matrix_Rotate_Y(monstro[i].rotacao)
                   * Matrix_Scale(0.02f, 0.02f, 0.02f);
-            glUniformMatrix4fv(g_model_uniform, 1 , GL_FALSE , glm::value_ptr(model));
-            glUniform1i(g_object_id_uniform, SKULL);
-            DrawVirtualObject("skull");
-            PushMatrix(model);
-                model = model * Matrix_Translate(-3.2f, 1.4f, 9.0f)
-                              * Matrix_Rotate_X(PI/2);
-                glUniformMatrix4fv(g_model_uniform, 1 , GL_FALSE , glm::value_ptr(model));
-                glUniform1i(g_object_id_uniform, EYE);
-                DrawVirtualObject("eye");
-                model = model * Matrix_Translate(6.4f, 0.0f, 0.f);
-                glUniformMatrix4fv(g_model_uniform, 1 , GL_FALSE , glm::value_ptr(model));
-                glUniform1i(g_object_id_uniform, EYE);
-                DrawVirtualObject("eye");
-            PopMatrix(model);
+            QueueMonster(frustum, shadow_casters, model, PI/2);
         }
 
         model = Matrix_Translate(monstro_bezier.pos[0], monstro_bezier.pos[1], monstro_bezier.pos[2])
                       * Matrix_Rotate_Y(monstro_bezier.rotacao)
                       * Matrix_Scale(0.06f, 0.06f, 0.06f);
-                glUniformMatrix4fv(g_model_uniform, 1 , GL_FALSE , glm::value_ptr(model));
-                glUniform1i(g_object_id_uniform, SKULL);
-                DrawVirtualObject("skull");
-                PushMatrix(model);
-                    model = model * Matrix_Translate(-3.2f, 1.4f, 9.0f)
-                                  * Matrix_Rotate_X(3.14/2);
-                    glUniformMatrix4fv(g_model_uniform, 1 , GL_FALSE , glm::value_ptr(model));
-                    glUniform1i(g_object_id_uniform, EYE);
-                    DrawVirtualObject("eye");
-                    model = model * Matrix_Translate(6.4f, 0.0f, 0.f);
-                    glUniformMatrix4fv(g_model_uniform, 1 , GL_FALSE , glm::value_ptr(model));
-                    glUniform1i(g_object_id_uniform, EYE);
-                    DrawVirtualObject("eye");
-                PopMatrix(model);
-
-        // Resetamos a matriz View para que os objetos carregados a partir daqui não se movimentem na tela.
-        glUniformMatrix4fv(g_view_uniform       , 1 , GL_FALSE , glm::value_ptr(Matrix_Identity()));
-
-        // SMOKE
-        glClear(GL_DEPTH_BUFFER_BIT);
-        if(smoke_active)
-            for(int i=0; i<SMOKE_P_COUNT; i++)
-            {
-                model = Matrix_Translate(smoke[i].pos[0],smoke[i].pos[1]+recoil,-2.0f)
-                      * Matrix_Scale(smoke[i].scale,smoke[i].scale,1.0f)
-                      * Matrix_Scale(0.1f,0.1f,1.0f)
-                      * Matrix_Rotate_X(PI/2);
-                glUniformMatrix4fv(g_model_uniform, 1 , GL_FALSE , glm::value_ptr(model));
-                glUniform1i(g_object_id_uniform, SMOKE);
-                glUniform1i(smoke_life_uniform, smoke[i].life);
-                DrawVirtualObject("the_screen");
-            }
+        QueueMonster(frustum, shadow_casters, model, 3.14/2);
 
         // FLASHLIGHT
         model = Matrix_Translate(lanterna_pos[0]-0.6f, lanterna_pos[1]-0.4f, lanterna_pos[2])
             * Matrix_Scale(0.01f,0.01f,0.01f)
             * Matrix_Rotate_X(PI);
-        glUniformMatrix4fv(g_model_uniform, 1 , GL_FALSE , glm::value_ptr(model));
-        glUniform1i(g_object_id_uniform, FLASHLIGHT);
-        DrawVirtualObject("the_light");
+        QueueVirtualObject(PASS_HELD_OPAQUE, g_Objects.light, FLASHLIGHT, model);
 
         // REVOLVER
         model = Matrix_Translate(revolver_pos[0], revolver_pos[1], revolver_pos[2])
             * Matrix_Scale(0.002f,0.002f,0.002f)
             * Matrix_Rotate_X(reload_move*2+recoil*2)
             * Matrix_Rotate_Y(-PI/2);
-        glUniformMatrix4fv(g_model_uniform, 1 , GL_FALSE , glm::value_ptr(model));
-        glUniform1i(g_object_id_uniform, REVOLVER);
-        DrawVirtualObject("Handle");
-        DrawVirtualObject("BodyR");
-        DrawVirtualObject("Back_Trigger");
-        DrawVirtualObject("Trigger");
-        DrawVirtualObject("Chamber_Holder");
-        DrawVirtualObject("Chamber");
-        DrawVirtualObject("Barrel");
-
-
+        QueueVirtualObjects(PASS_HELD_OPAQUE, g_Objects.revolver, REVOLVER, model);
 
+        // SMOKE
+        if(smoke_active)
+            for(int i=0; i<SMOKE_P_COUNT; i++)
+            {
+                model = Matrix_Translate(smoke[i].pos[0],smoke[i].pos[1]+recoil,-2.0f)
+                      * Matrix_Scale(smoke[i].scale,smoke[i].scale,1.0f)
+                      * Matrix_Scale(0.1f,0.1f,1.0f)
+                      * Matrix_Rotate_X(PI/2);
+                QueueVirtualObject(PASS_HELD_TRANSLUCENT, g_Objects.screen, SMOKE, model, smoke[i].life);
+            }
 
         if (final_de_jogo == 0){
             // SCREEN
-            glUniformMatrix4fv(g_projection_uniform , 1 , GL_FALSE , glm::value_ptr(orthographic));
-            glDisable(GL_DEPTH_TEST);
             model = Matrix_Translate(0.0f,0.0f,-2.0f)
                 * Matrix_Scale(0.1f,0.1f,1.0f)
                 * Matrix_Rotate_X(PI/2);
-            glUniformMatrix4fv(g_model_uniform, 1 , GL_FALSE , glm::value_ptr(model));
-            glUniform1i(g_object_id_uniform, SCREEN);
-            DrawVirtualObject("the_screen");
-            glEnable(GL_DEPTH_TEST);
+            QueueVirtualObject(PASS_SCREEN, g_Objects.screen, SCREEN, model);
+        }
+        else {
+            //Tela final
+            model = Matrix_Translate(lanterna_pos[0], lanterna_pos[1], lanterna_pos[2]);
+            if (jogador.vidas > 0)
+                QueueVirtualObject(PASS_END_SCREEN, g_Objects.end_screen, TELA_FINAL, model, incremento_alpha);
+            else
+                QueueVirtualObject(PASS_END_SCREEN, g_Objects.end_screen, TELA_FINAL2, model, incremento_alpha);
+        }
+
+        // Camada final do mapa de sombras: cópia da camada estática com as
+        // caveiras por cima.
+        if (lanterna_ligada)
+        {
+            ShadowMap_BeginDynamic(g_ShadowMap);
+            RenderQueue_Flush(&g_ShadowQueue);
+            ShadowMap_End(g_ScreenWidth, g_ScreenHeight);
+        }
+        g_RenderQueue.frame.sombra_lanterna = lanterna_ligada ? 1 : 0;
+        g_RenderQueue.frame.shadow_matrix   = ShadowMap_Matrix(g_ShadowMap);
+
+        LightClusters_Build(&g_LightClusters, view, perspective, -nearplane, -farplane, g_ScreenWidth, g_ScreenHeight);
+        RenderQueue_Flush(&g_RenderQueue);
 
+        if (final_de_jogo == 0){
             // Desenhamos uma instrução para o jogador se ele estiver próximo do carro
             if(jogador_proximo_do_carro)
                 TextRendering_ShowCarTip(window, carro.estado);
@@ -1488,6 +1624,16 @@ int main(int argc, char* argv[])
             // por segundo (frames per second).
             TextRendering_ShowFramesPerSecond(window);
 
+            // Imprimimos na tela quantos desenhos e trocas de estado a fila
+            // de desenhos fez neste quadro, quantos objetos foram
+            // descartados por estarem fora do campo de visão, quantas luzes
+            // dinâmicas foram distribuídas nos clusters e quantas vezes a
+            // camada estática do mapa de sombras foi redesenhada.
+            TextRendering_ShowRenderQueueStats(window);
+            TextRendering_ShowCullingStats(window);
+            TextRendering_ShowLightStats(window);
+            TextRendering_ShowShadowStats(window);
+
             // Imprimimos na tela quandos segundos se passaram desde o início
             TextRendering_ShowSecondsEllapsed(window);
 
@@ -1500,28 +1646,12 @@ int main(int argc, char* argv[])
 
         }
         else {
-            //Tela final
-            glDisable(GL_DEPTH_TEST);
-            glDisable(GL_CULL_FACE);
-            glUniform1i(alpha_uniform, incremento_alpha);
-            model = Matrix_Translate(lanterna_pos[0], lanterna_pos[1], lanterna_pos[2]);
-            glUniformMatrix4fv(g_model_uniform, 1 , GL_FALSE , glm::value_ptr(model));
-            if (jogador.vidas > 0){
-                glUniform1i(g_object_id_uniform, TELA_FINAL);
-                DrawVirtualObject("tela_fim_de_jogo");
-            }
-            else {
-                glUniform1i(g_object_id_uniform, TELA_FINAL2);
-                DrawVirtualObject("tela_fim_de_jogo");
-
-            }
-
-            glEnable(GL_CULL_FACE);
-            glEnable(GL_DEPTH_TEST);
             incremento_alpha = incremento_alpha + 1;
-
         }
 
+        // Enviamos para a GPU mais alguns níveis de mipmap das texturas
+        TextureStreamer_Update();
+
         glfwSwapBuffers(window);
 
         // Verificamos com o sistema operacional se houve alguma interação do
@@ -1560,25 +1690,59 @@ glm::vec4 calculateBezierPoint(const glm::vec4& P0, const glm::vec4& P1, const g
 }
 
 
-// Função que carrega uma imagem para ser utilizada como textura
-void LoadTextureImage(const char* filename)
+// Primeira etapa do carregamento de uma textura, seguida de
+// UploadTextureImage(): leitura da imagem e da sua cadeia de mipmaps. Se
+// existir um cache válido para a imagem (veja "texturecache.h"), ele é
+// apenas mapeado em memória. Caso contrário, a imagem é decodificada, os
+// mipmaps são calculados e o cache é gravado. Não faz chamadas OpenGL,
+// podendo ser executada em uma thread de trabalho.
+void DecodeTextureImage(TextureAsset* asset)
 {
-    printf("Carregando imagem \"%s\"... ", filename);
+    double start_time = glfwGetTime();
+    const char* filename = asset->filename.c_str();
 
-    // Primeiro fazemos a leitura da imagem do disco
-    stbi_set_flip_vertically_on_load(true);
-    int width;
-    int height;
-    int channels;
-    unsigned char *data = stbi_load(filename, &width, &height, &channels, 3); // 4 canais para transparencia
+    asset->levels.num_levels = 0;
+    asset->from_cache = TextureCache_Load(filename, asset->format, &asset->cache);
 
-    if ( data == NULL )
+    if ( asset->from_cache )
     {
-        fprintf(stderr, "ERROR: Cannot open image file \"%s\".\n", filename);
-        std::exit(EXIT_FAILURE);
+        asset->levels = asset->cache.levels;
+    }
+    else
+    {
+        int width;
+        int height;
+        int channels;
+        int components = (asset->format == TEXTURE_NORMAL_MAP) ? 3 : TextureChannels(asset->format);
+        unsigned char *data = stbi_load(filename, &width, &height, &channels, components);
+
+        if ( data != NULL )
+        {
+            BuildMipChain(data, width, height, asset->format, &asset->storage, &asset->levels);
+            stbi_image_free(data);
+
+            if ( !TextureCache_Save(filename, asset->levels) )
+                fprintf(stderr, "WARNING: Cannot write texture cache \"%s\".\n", TextureCache_Filename(filename).c_str());
+        }
     }
 
-    printf("OK (%dx%d).\n", width, height);
+    asset->decode_time = glfwGetTime() - start_time;
+}
+
+// Segunda etapa do carregamento de uma textura: envio da imagem lida por
+// DecodeTextureImage() e dos seus mipmaps para a GPU, na unidade de textura
+// asset->textureunit. Deve ser executada na thread do contexto OpenGL.
+void UploadTextureImage(TextureAsset* asset)
+{
+    double start_time = glfwGetTime();
+
+    printf("Carregando imagem \"%s\"%s... ", asset->filename.c_str(), asset->from_cache ? " (cache)" : "");
+
+    if ( asset->levels.num_levels == 0 )
+    {
+        fprintf(stderr, "ERROR: Cannot open image file \"%s\".\n", asset->filename.c_str());
+        std::exit(EXIT_FAILURE);
+    }
 
     // Agora criamos objetos na GPU com OpenGL para armazenar a textura
     GLuint texture_id;
@@ -1600,245 +1764,1345 @@ void LoadTextureImage(const char* filename)
     glPixelStorei(GL_UNPACK_SKIP_PIXELS, 0);
     glPixelStorei(GL_UNPACK_SKIP_ROWS, 0);
 
-    GLuint textureunit = g_NumLoadedTextures;
+    GLuint textureunit = asset->textureunit;
     glActiveTexture(GL_TEXTURE0 + textureunit);
     glBindTexture(GL_TEXTURE_2D, texture_id);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_SRGB8, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data); // Usar GL_RGBA para transparencia
-    glGenerateMipmap(GL_TEXTURE_2D);
     glBindSampler(textureunit, sampler_id);
 
-    stbi_image_free(data);
+    // Os mipmaps já foram calculados por BuildMipChain(), portanto não
+    // precisamos chamar glGenerateMipmap(). Aqui são enviados apenas os
+    // níveis pequenos (até TEXTURE_RESIDENT_SIZE texels de lado); os níveis
+    // maiores que cabem no orçamento de memória são enviados durante os
+    // quadros seguintes por TextureStreamer_Update(). O streamer assume a
+    // posse dos texels.
+    const TextureLevels& levels = asset->levels;
+    printf("OK (%dx%d, leitura %.1f ms", levels.width[0], levels.height[0], 1000.0*asset->decode_time);
 
-    g_NumLoadedTextures += 1;
+    TextureStreamer_Add(texture_id, levels, asset->tier, TEXTURE_RESIDENT_SIZE, asset->from_cache, &asset->cache, &asset->storage);
+
+    printf(", envio %.1f ms).\n", 1000.0*(glfwGetTime() - start_time));
 }
 
-// Função que desenha um objeto armazenado em g_VirtualScene. Veja definição
-// dos objetos na função BuildTrianglesAndAddToVirtualScene().
-void DrawVirtualObject(const char* object_name)
-{
-    // "Ligamos" o VAO. Informamos que queremos utilizar os atributos de
-    // vértices apontados pelo VAO criado pela função BuildTrianglesAndAddToVirtualScene(). Veja
-    // comentários detalhados dentro da definição de BuildTrianglesAndAddToVirtualScene().
-    glBindVertexArray(g_VirtualScene[object_name].vertex_array_object_id);
-
-    // Setamos as variáveis "bbox_min" e "bbox_max" do fragment shader
-    // com os parâmetros da axis-aligned bounding box (AABB) do modelo.
-    glm::vec3 bbox_min = g_VirtualScene[object_name].bbox_min;
-    glm::vec3 bbox_max = g_VirtualScene[object_name].bbox_max;
-    glUniform4f(g_bbox_min_uniform, bbox_min.x, bbox_min.y, bbox_min.z, 1.0f);
-    glUniform4f(g_bbox_max_uniform, bbox_max.x, bbox_max.y, bbox_max.z, 1.0f);
-
-    // Pedimos para a GPU rasterizar os vértices dos eixos XYZ
-    // apontados pelo VAO como linhas. Veja a definição de
-    // g_VirtualScene[""] dentro da função BuildTrianglesAndAddToVirtualScene(), e veja
-    // a documentação da função glDrawElements() em
-    // http://docs.gl/gl3/glDrawElements.
-    glDrawElements(
-        g_VirtualScene[object_name].rendering_mode,
-        g_VirtualScene[object_name].num_indices,
-        GL_UNSIGNED_INT,
-        (void*)(g_VirtualScene[object_name].first_index * sizeof(GLuint))
-    );
+// Reserva a próxima unidade de textura e adiciona a imagem "filename", no
+// formato "format", na lista de assets. A imagem é efetivamente carregada por
+// LoadAssets().
+void AddTextureAsset(AssetList* assets, const char* filename, TextureFormat format, TextureTier tier)
+{
+    TextureAsset asset;
+    asset.filename    = filename;
+    asset.textureunit = g_NumLoadedTextures;
+    asset.format      = format;
+    asset.tier        = tier;
+    asset.from_cache  = false;
+    asset.ready       = false;
+    assets->textures.push_back(asset);
 
-    // "Desligamos" o VAO, evitando assim que operações posteriores venham a
-    // alterar o mesmo. Isso evita bugs.
-    glBindVertexArray(0);
+    g_NumLoadedTextures += 1;
 }
 
-// Função que carrega os shaders de vértices e de fragmentos que serão
-// utilizados para renderização. Veja slides 180-200 do documento Aula_03_Rendering_Pipeline_Grafico.pdf.
-//
-void LoadShadersFromFiles()
+// Adiciona o modelo "filename" na lista de assets. O modelo é efetivamente
+// carregado por LoadAssets().
+void AddModelAsset(AssetList* assets, const char* filename)
 {
-    // Note que o caminho para os arquivos "shader_vertex.glsl" e
-    // "shader_fragment.glsl" estão fixados, sendo que assumimos a existência
-    // da seguinte estrutura no sistema de arquivos:
-    //
-    //    + FCG_Lab_01/
-    //    |
-    //    +--+ bin/
-    //    |  |
-    //    |  +--+ Release/  (ou Debug/ ou Linux/)
-    //    |     |
-    //    |     o-- main.exe
-    //    |
-    //    +--+ src/
-    //       |
-    //       o-- shader_vertex.glsl
-    //       |
-    //       o-- shader_fragment.glsl
-    //
-    GLuint vertex_shader_id = LoadShader_Vertex("../../src/shader_vertex.glsl");
-    GLuint fragment_shader_id = LoadShader_Fragment("../../src/shader_fragment.glsl");
+    ModelAsset asset;
+    asset.filename   = filename;
+    asset.from_cache = false;
+    asset.ready      = false;
+    assets->models.push_back(asset);
+}
 
-    // Deletamos o programa de GPU anterior, caso ele exista.
-    if ( g_GpuProgramID != 0 )
-        glDeleteProgram(g_GpuProgramID);
-
-    // Criamos um programa de GPU utilizando os shaders carregados acima.
-    g_GpuProgramID = CreateGpuProgram(vertex_shader_id, fragment_shader_id);
-
-    // Buscamos o endereço das variáveis definidas dentro do Vertex Shader.
-    // Utilizaremos estas variáveis para enviar dados para a placa de vídeo
-    // (GPU)! Veja arquivo "shader_vertex.glsl" e "shader_fragment.glsl".
-    g_model_uniform      = glGetUniformLocation(g_GpuProgramID, "model"); // Variável da matriz "model"
-    g_view_uniform       = glGetUniformLocation(g_GpuProgramID, "view"); // Variável da matriz "view" em shader_vertex.glsl
-    g_projection_uniform = glGetUniformLocation(g_GpuProgramID, "projection"); // Variável da matriz "projection" em shader_vertex.glsl
-    g_object_id_uniform  = glGetUniformLocation(g_GpuProgramID, "object_id"); // Variável "object_id" em shader_fragment.glsl
-    g_bbox_min_uniform   = glGetUniformLocation(g_GpuProgramID, "bbox_min");
-    g_bbox_max_uniform   = glGetUniformLocation(g_GpuProgramID, "bbox_max");
-    lanterna_ligada_uniform = glGetUniformLocation(g_GpuProgramID, "lanterna_ligada"); // Variável usada para ligar ou desligar a lanterna
-    smoke_life_uniform = glGetUniformLocation(g_GpuProgramID, "smoke_life"); // Variável usada para definir a textura das partículas de fumaça
-    nozzle_flash_uniform = glGetUniformLocation(g_GpuProgramID, "nozzle_flash"); // Variável usada para dizer se é para desenhar o flash do tiro da arma
-    tronco_uniform = glGetUniformLocation(g_GpuProgramID, "tronco"); // Variável usada para dizer se é para desenhar o tronco ou as folhas da árvore
-    parte_carro_uniform = glGetUniformLocation(g_GpuProgramID, "parte_carro"); // Variável usada para definir a textura de cada parte do carro
-    tela_de_menu_uniform = glGetUniformLocation(g_GpuProgramID, "tela_de_menu"); // Variável usada para indicar quando está no menu
-    alpha_uniform = glGetUniformLocation(g_GpuProgramID, "alpha");
-
-    // Variáveis em "shader_fragment.glsl" para acesso das imagens de textura
-    glUseProgram(g_GpuProgramID);
-    glUniform1i(glGetUniformLocation(g_GpuProgramID, "chao"), 0);
-    glUniform1i(glGetUniformLocation(g_GpuProgramID, "ceu"), 1);
-    glUniform1i(glGetUniformLocation(g_GpuProgramID, "lanterna"), 2);
-    glUniform1i(glGetUniformLocation(g_GpuProgramID, "crosshair"), 3);
-    glUniform1i(glGetUniformLocation(g_GpuProgramID, "chao_normal"), 4);
-    glUniform1i(glGetUniformLocation(g_GpuProgramID, "skull_diff"), 5);
-    glUniform1i(glGetUniformLocation(g_GpuProgramID, "skull_normal"), 6);
-    glUniform1i(glGetUniformLocation(g_GpuProgramID, "smoke"), 7);
-    glUniform1i(glGetUniformLocation(g_GpuProgramID, "bark"), 8);
-    glUniform1i(glGetUniformLocation(g_GpuProgramID, "folhas"), 9);
-    glUniform1i(glGetUniformLocation(g_GpuProgramID, "cabine_diff"), 10);
-    glUniform1i(glGetUniformLocation(g_GpuProgramID, "cabine_normal"), 11);
-    glUniform1i(glGetUniformLocation(g_GpuProgramID, "cabine_spec"), 12);
-    glUniform1i(glGetUniformLocation(g_GpuProgramID, "car_BL1"), 13);
-    glUniform1i(glGetUniformLocation(g_GpuProgramID, "car_BL2"), 14);
-    glUniform1i(glGetUniformLocation(g_GpuProgramID, "car_GL"), 15);
-    glUniform1i(glGetUniformLocation(g_GpuProgramID, "car_HL"), 16);
-    glUniform1i(glGetUniformLocation(g_GpuProgramID, "car_BL"), 17);
-    glUniform1i(glGetUniformLocation(g_GpuProgramID, "car_Plaque"), 18);
-    glUniform1i(glGetUniformLocation(g_GpuProgramID, "car_Logo"), 19);
-    glUniform1i(glGetUniformLocation(g_GpuProgramID, "car_Tire"), 20);
-    glUniform1i(glGetUniformLocation(g_GpuProgramID, "tela_fim_de_jogo"), 21);
-    glUniform1i(glGetUniformLocation(g_GpuProgramID, "tela_game_over"), 22);
+// Reserva a próxima unidade de textura para um novo atlas, que recebe as
+// imagens e cores adicionadas em seguida por AddAtlasImage() e
+// AddAtlasColor(). O atlas é montado por LoadAssets().
+void AddAtlasAsset(AssetList* assets)
+{
+    AtlasAsset asset;
+    asset.textureunit = g_NumLoadedTextures;
+    asset.built       = false;
+    assets->atlases.push_back(asset);
 
-    glUseProgram(0);
+    g_NumLoadedTextures += 1;
 }
 
-// Função que pega a matriz M e guarda a mesma no topo da pilha
-void PushMatrix(glm::mat4 M)
+// Adiciona a imagem "filename", usada pelos objetos "objects", ao último
+// atlas da lista.
+void AddAtlasImage(AssetList* assets, const char* filename, std::initializer_list<const char*> objects)
 {
-    g_MatrixStack.push(M);
+    AtlasSource source;
+    source.image.filename    = filename;
+    source.image.textureunit = assets->atlases.back().textureunit;
+    source.image.format      = TEXTURE_SRGB;
+    source.image.tier        = TEXTURE_TIER_COLOR;
+    source.image.from_cache  = false;
+    source.image.ready       = false;
+    source.color             = glm::vec3(0.0f);
+    source.objects.assign(objects.begin(), objects.end());
+    assets->atlases.back().sources.push_back(source);
 }
 
-// Função que remove a matriz atualmente no topo da pilha e armazena a mesma na variável M
-void PopMatrix(glm::mat4& M)
+// Adiciona uma região de cor sólida "color" (em espaço linear), usada pelos
+// objetos "objects", ao último atlas da lista.
+void AddAtlasColor(AssetList* assets, const glm::vec3& color, std::initializer_list<const char*> objects)
 {
-    if ( g_MatrixStack.empty() )
-    {
-        M = Matrix_Identity();
-    }
-    else
-    {
-        M = g_MatrixStack.top();
-        g_MatrixStack.pop();
-    }
+    AtlasSource source;
+    source.image.format     = TEXTURE_SRGB;
+    source.image.tier       = TEXTURE_TIER_COLOR;
+    source.image.from_cache = false;
+    source.image.ready      = true;
+    source.color            = color;
+    source.objects.assign(objects.begin(), objects.end());
+    assets->atlases.back().sources.push_back(source);
 }
 
-// Função que computa as normais de um ObjModel, caso elas não tenham sido
-// especificadas dentro do arquivo ".obj"
-void ComputeNormals(ObjModel* model)
+// Monta o atlas a partir das imagens já lidas pelas threads de trabalho (veja
+// "textureatlas.h"), envia o atlas para a GPU e registra a região
+// de cada objeto em g_AtlasRegions. Deve ser executada na thread do contexto
+// OpenGL.
+void BuildAndUploadAtlas(AtlasAsset* asset)
 {
-    if ( !model->attrib.normals.empty() )
-        return;
+    double start_time = glfwGetTime();
+
+    // Imagens maiores que ATLAS_MAX_IMAGE_SIZE são substituídas por um nível
+    // menor da cadeia de mipmaps, já calculada em espaço linear.
+    std::vector<AtlasImage> images(asset->sources.size());
+    std::vector<unsigned char> colors(3*asset->sources.size());
+    for (size_t i = 0; i < asset->sources.size(); ++i)
+    {
+        const AtlasSource& source = asset->sources[i];
+        if ( source.image.filename.empty() )
+        {
+            for (int c = 0; c < 3; ++c)
+                colors[3*i + c] = LinearToSrgb(source.color[c]);
+            images[i].pixels = &colors[3*i];
+            images[i].width  = 1;
+            images[i].height = 1;
+            continue;
+        }
+
+        const TextureLevels& levels = source.image.levels;
+        if ( levels.num_levels == 0 )
+        {
+            fprintf(stderr, "ERROR: Cannot open image file \"%s\".\n", source.image.filename.c_str());
+            std::exit(EXIT_FAILURE);
+        }
 
-    // Primeiro computamos as normais para todos os TRIÂNGULOS.
-    // Segundo, computamos as normais dos VÉRTICES através do método proposto
-    // por Gouraud, onde a normal de cada vértice vai ser a média das normais de
-    // todas as faces que compartilham este vértice.
+        int level = 0;
+        while ( level + 1 < levels.num_levels && std::max(levels.width[level], levels.height[level]) > ATLAS_MAX_IMAGE_SIZE )
+            level += 1;
 
-    size_t num_vertices = model->attrib.vertices.size() / 3;
+        images[i].pixels = levels.pixels[level];
+        images[i].width  = levels.width[level];
+        images[i].height = levels.height[level];
+    }
 
-    std::vector<int> num_triangles_per_vertex(num_vertices, 0);
-    std::vector<glm::vec4> vertex_normals(num_vertices, glm::vec4(0.0f,0.0f,0.0f,0.0f));
+    BuildTextureAtlas(images, &asset->atlas);
 
-    for (size_t shape = 0; shape < model->shapes.size(); ++shape)
+    for (size_t i = 0; i < asset->sources.size(); ++i)
     {
-        size_t num_triangles = model->shapes[shape].mesh.num_face_vertices.size();
+        TextureAsset& image = asset->sources[i].image;
+        if ( image.from_cache )
+            TextureCache_Close(&image.cache);
+        image.storage = std::vector<unsigned char>();
 
-        for (size_t triangle = 0; triangle < num_triangles; ++triangle)
-        {
-            assert(model->shapes[shape].mesh.num_face_vertices[triangle] == 3);
+        for (size_t k = 0; k < asset->sources[i].objects.size(); ++k)
+            g_AtlasRegions[asset->sources[i].objects[k]] = asset->atlas.regions[i];
+    }
 
-            glm::vec4  vertices[3];
-            for (size_t vertex = 0; vertex < 3; ++vertex)
-            {
-                tinyobj::index_t idx = model->shapes[shape].mesh.indices[3*triangle + vertex];
-                const float vx = model->attrib.vertices[3*idx.vertex_index + 0];
-                const float vy = model->attrib.vertices[3*idx.vertex_index + 1];
-                const float vz = model->attrib.vertices[3*idx.vertex_index + 2];
-                vertices[vertex] = glm::vec4(vx,vy,vz,1.0);
-            }
+    GLuint texture_id;
+    GLuint sampler_id;
+    glGenTextures(1, &texture_id);
+    glGenSamplers(1, &sampler_id);
 
-            const glm::vec4  a = vertices[0];
-            const glm::vec4  b = vertices[1];
-            const glm::vec4  c = vertices[2];
+    // As bordas das regiões já repetem os texels das imagens, como
+    // GL_CLAMP_TO_EDGE faria com as texturas separadas.
+    glSamplerParameteri(sampler_id, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glSamplerParameteri(sampler_id, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glSamplerParameteri(sampler_id, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glSamplerParameteri(sampler_id, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
-            const glm::vec4  n = crossproduct(b-a,c-a);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    glPixelStorei(GL_UNPACK_SKIP_PIXELS, 0);
+    glPixelStorei(GL_UNPACK_SKIP_ROWS, 0);
 
-            for (size_t vertex = 0; vertex < 3; ++vertex)
-            {
-                tinyobj::index_t idx = model->shapes[shape].mesh.indices[3*triangle + vertex];
-                num_triangles_per_vertex[idx.vertex_index] += 1;
-                vertex_normals[idx.vertex_index] += n;
-                model->shapes[shape].mesh.indices[3*triangle + vertex].normal_index = idx.vertex_index;
-            }
-        }
-    }
+    glActiveTexture(GL_TEXTURE0 + asset->textureunit);
+    glBindTexture(GL_TEXTURE_2D, texture_id);
+    glBindSampler(asset->textureunit, sampler_id);
 
-    model->attrib.normals.resize( 3*num_vertices );
+    // Os níveis além de ATLAS_PADDING_LEVELS misturariam as imagens e já
+    // foram descartados. O atlas é enviado como as demais texturas: os
+    // níveis maiores ficam com o streamer, que assume a posse dos texels.
+    const TextureLevels& levels = asset->atlas.levels;
+    printf("Atlas de texturas com %u imagens: %dx%d, %d níveis, %.1f ms.\n", (unsigned)asset->sources.size(),
+        levels.width[0], levels.height[0], levels.num_levels, 1000.0*(glfwGetTime() - start_time));
 
-    for (size_t i = 0; i < vertex_normals.size(); ++i)
+    TextureStreamer_Add(texture_id, levels, TEXTURE_TIER_COLOR, TEXTURE_RESIDENT_SIZE, false, NULL, &asset->atlas.storage);
+
+    asset->built = true;
+}
+
+// Retorna true se algum objeto do modelo "model" usa uma região de um atlas
+// que ainda não foi montado por BuildAndUploadAtlas().
+bool ModelWaitsForAtlas(const AssetList& assets, const ModelAsset& model)
+{
+    MeshView view = model.from_cache ? model.cache.view : MeshData_View(model.mesh);
+
+    for (size_t a = 0; a < assets.atlases.size(); ++a)
     {
-        glm::vec4 n = vertex_normals[i] / (float)num_triangles_per_vertex[i];
-        n /= norm(n);
-        model->attrib.normals[3*i + 0] = n.x;
-        model->attrib.normals[3*i + 1] = n.y;
-        model->attrib.normals[3*i + 2] = n.z;
+        const AtlasAsset& atlas = assets.atlases[a];
+        if ( atlas.built )
+            continue;
+
+        for (size_t i = 0; i < atlas.sources.size(); ++i)
+            for (size_t k = 0; k < atlas.sources[i].objects.size(); ++k)
+                for (size_t o = 0; o < view.num_objects; ++o)
+                    if ( view.objects[o].name == atlas.sources[i].objects[k] )
+                        return true;
     }
+    return false;
 }
 
-// Constrói triângulos para futura renderização a partir de um ObjModel.
-void BuildTrianglesAndAddToVirtualScene(ObjModel* model)
+// Reserva a próxima unidade de textura e adiciona o céu HDR "filename" na
+// lista de assets. O céu é efetivamente carregado por LoadAssets().
+void AddSkyAsset(AssetList* assets, const char* filename)
 {
-    GLuint vertex_array_object_id;
-    glGenVertexArrays(1, &vertex_array_object_id);
-    glBindVertexArray(vertex_array_object_id);
+    SkyAsset asset;
+    asset.filename    = filename;
+    asset.textureunit = g_NumLoadedTextures;
+    asset.from_cache  = false;
+    asset.ready       = false;
+    assets->skies.push_back(asset);
 
-    std::vector<GLuint> indices;
-    std::vector<float>  model_coefficients;
-    std::vector<float>  normal_coefficients;
-    std::vector<float>  texture_coefficients;
+    g_NumLoadedTextures += 1;
+}
 
-    for (size_t shape = 0; shape < model->shapes.size(); ++shape)
-    {
-        size_t first_index = indices.size();
-        size_t num_triangles = model->shapes[shape].mesh.num_face_vertices.size();
+// Lê o cubemap do céu do cache (veja "environmentmap.h") ou, se necessário,
+// decodifica a imagem HDR em float, converte-a em cubemap e grava o cache.
+// Não faz chamadas OpenGL, podendo ser executada em uma thread de trabalho.
+void DecodeSkyImage(SkyAsset* asset)
+{
+    double start_time = glfwGetTime();
+    const char* filename = asset->filename.c_str();
 
-        const float minval = std::numeric_limits<float>::min();
-        const float maxval = std::numeric_limits<float>::max();
+    asset->levels.num_levels = 0;
+    asset->from_cache = EnvironmentCache_Load(filename, &asset->cache);
 
-        glm::vec3 bbox_min = glm::vec3(maxval,maxval,maxval);
-        glm::vec3 bbox_max = glm::vec3(minval,minval,minval);
+    if ( asset->from_cache )
+    {
+        asset->levels = asset->cache.levels;
+    }
+    else
+    {
+        // stbi_loadf() mantém a faixa dinâmica da imagem HDR, em espaço linear
+        int width;
+        int height;
+        int channels;
+        float* data = stbi_loadf(filename, &width, &height, &channels, 3);
 
-        for (size_t triangle = 0; triangle < num_triangles; ++triangle)
+        if ( data != NULL )
         {
-            assert(model->shapes[shape].mesh.num_face_vertices[triangle] == 3);
+            BuildEnvironmentMap(data, width, height, &asset->storage, &asset->levels);
+            stbi_image_free(data);
 
-            for (size_t vertex = 0; vertex < 3; ++vertex)
-            {
-                tinyobj::index_t idx = model->shapes[shape].mesh.indices[3*triangle + vertex];
+            if ( !EnvironmentCache_Save(filename, asset->levels) )
+                fprintf(stderr, "WARNING: Cannot write environment cache \"%s\".\n", EnvironmentCache_Filename(filename).c_str());
+        }
+    }
 
-                indices.push_back(first_index + 3*triangle + vertex);
+    asset->decode_time = glfwGetTime() - start_time;
+}
+
+// Envia todos os níveis do cubemap do céu para a GPU, na unidade de textura
+// asset->textureunit. Deve ser executada na thread do contexto OpenGL.
+void UploadSky(SkyAsset* asset)
+{
+    double start_time = glfwGetTime();
+
+    printf("Carregando céu \"%s\"%s... ", asset->filename.c_str(), asset->from_cache ? " (cache)" : "");
+
+    if ( asset->levels.num_levels == 0 )
+    {
+        fprintf(stderr, "ERROR: Cannot open image file \"%s\".\n", asset->filename.c_str());
+        std::exit(EXIT_FAILURE);
+    }
+
+    GLuint texture_id;
+    GLuint sampler_id;
+    glGenTextures(1, &texture_id);
+    glGenSamplers(1, &sampler_id);
+
+    glSamplerParameteri(sampler_id, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glSamplerParameteri(sampler_id, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glSamplerParameteri(sampler_id, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    glSamplerParameteri(sampler_id, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glSamplerParameteri(sampler_id, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    // Filtragem entre as faces do cubemap, sem costuras nas arestas
+    glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    glPixelStorei(GL_UNPACK_SKIP_PIXELS, 0);
+    glPixelStorei(GL_UNPACK_SKIP_ROWS, 0);
+
+    glActiveTexture(GL_TEXTURE0 + asset->textureunit);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, texture_id);
+
+    // Os texels já estão no formato da GPU (GL_RGB9_E5, 4 bytes por texel)
+    const EnvironmentLevels& levels = asset->levels;
+    size_t bytes = 0;
+    for (int level = 0; level < levels.num_levels; ++level)
+    {
+        for (int face = 0; face < 6; ++face)
+        {
+            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, level, GL_RGB9_E5, levels.size[level], levels.size[level], 0,
+                         GL_RGB, GL_UNSIGNED_INT_5_9_9_9_REV, levels.faces[level][face]);
+            bytes += (size_t)levels.size[level] * levels.size[level] * sizeof(uint32_t);
+        }
+    }
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_BASE_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAX_LEVEL, levels.num_levels - 1);
+    glBindSampler(asset->textureunit, sampler_id);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+    TextureStreamer_AddResidentBytes(bytes);
+
+    printf("OK (6x%dx%d, leitura %.1f ms, envio %.1f ms).\n", levels.size[0], levels.size[0],
+        1000.0*asset->decode_time, 1000.0*(glfwGetTime() - start_time));
+
+    if ( asset->from_cache )
+        EnvironmentCache_Close(&asset->cache);
+    asset->storage = std::vector<uint32_t>();
+}
+
+// Carrega todos os assets da lista. A leitura das imagens e dos modelos é
+// feita por um conjunto de threads de trabalho (veja "threadpool.h"),
+// enquanto esta thread, dona do contexto OpenGL, envia para a GPU os assets
+// que ficam prontos e mostra uma tela de progresso, mantendo a janela
+// responsiva. Os modelos são enviados na ordem da lista, para que a
+// disposição de g_SceneGeometry não dependa da ordem em que as threads
+// terminam.
+void LoadAssets(GLFWwindow* window, AssetList* assets)
+{
+    double start_time = glfwGetTime();
+
+    // A stb_image guarda esta opção em uma variável global, portanto ela é
+    // definida antes de iniciarmos as threads.
+    stbi_set_flip_vertically_on_load(true);
+
+    std::mutex              ready_mutex;
+    std::condition_variable ready_condition;
+
+    ThreadPool* pool = ThreadPool_Create(0);
+
+    // Enviamos primeiro os modelos, que costumam demorar mais na primeira
+    // execução (sem cache), e depois as imagens.
+    for (size_t i = 0; i < assets->models.size(); ++i)
+    {
+        ModelAsset* asset = &assets->models[i];
+        ThreadPool_Submit(pool, [asset, &ready_mutex, &ready_condition]()
+        {
+            ReadModel(asset);
+
+            std::lock_guard<std::mutex> lock(ready_mutex);
+            asset->ready = true;
+            ready_condition.notify_one();
+        });
+    }
+
+    std::vector<TextureAsset*> decode;
+    for (size_t i = 0; i < assets->textures.size(); ++i)
+        decode.push_back(&assets->textures[i]);
+    for (size_t a = 0; a < assets->atlases.size(); ++a)
+        for (size_t i = 0; i < assets->atlases[a].sources.size(); ++i)
+            if ( !assets->atlases[a].sources[i].image.filename.empty() )
+                decode.push_back(&assets->atlases[a].sources[i].image);
+
+    for (size_t i = 0; i < decode.size(); ++i)
+    {
+        TextureAsset* asset = decode[i];
+        ThreadPool_Submit(pool, [asset, &ready_mutex, &ready_condition]()
+        {
+            DecodeTextureImage(asset);
+
+            std::lock_guard<std::mutex> lock(ready_mutex);
+            asset->ready = true;
+            ready_condition.notify_one();
+        });
+    }
+
+    for (size_t i = 0; i < assets->skies.size(); ++i)
+    {
+        SkyAsset* asset = &assets->skies[i];
+        ThreadPool_Submit(pool, [asset, &ready_mutex, &ready_condition]()
+        {
+            DecodeSkyImage(asset);
+
+            std::lock_guard<std::mutex> lock(ready_mutex);
+            asset->ready = true;
+            ready_condition.notify_one();
+        });
+    }
+
+    size_t total = assets->textures.size() + assets->atlases.size() + assets->skies.size() + assets->models.size();
+    size_t loaded = 0;
+    size_t next_model = 0;
+    std::vector<bool> texture_uploaded(assets->textures.size(), false);
+    std::vector<bool> atlas_started(assets->atlases.size(), false);
+    std::vector<bool> sky_uploaded(assets->skies.size(), false);
+
+    // Os programas de GPU submetidos por LoadShadersFromFiles() são
+    // finalizados neste mesmo laço, à medida que o driver os compila.
+    while ( loaded < total || ShaderManager_Busy() )
+    {
+        std::vector<TextureAsset*> textures;
+        std::vector<AtlasAsset*>   atlases;
+        std::vector<SkyAsset*>     skies;
+        std::vector<ModelAsset*>   models;
+        {
+            // Esperamos algum asset ficar pronto, mas sem deixar de
+            // redesenhar a tela de carregamento.
+            std::unique_lock<std::mutex> lock(ready_mutex);
+            ready_condition.wait_for(lock, std::chrono::milliseconds(16));
+
+            for (size_t i = 0; i < assets->textures.size(); ++i)
+            {
+                if ( assets->textures[i].ready && !texture_uploaded[i] )
+                {
+                    textures.push_back(&assets->textures[i]);
+                    texture_uploaded[i] = true;
+                }
+            }
+
+            // Um atlas é montado quando todas as suas imagens estão prontas
+            for (size_t a = 0; a < assets->atlases.size(); ++a)
+            {
+                const std::vector<AtlasSource>& sources = assets->atlases[a].sources;
+                bool ready = !atlas_started[a];
+                for (size_t i = 0; ready && i < sources.size(); ++i)
+                    ready = sources[i].image.ready;
+                if ( ready )
+                {
+                    atlases.push_back(&assets->atlases[a]);
+                    atlas_started[a] = true;
+                }
+            }
+
+            for (size_t i = 0; i < assets->skies.size(); ++i)
+            {
+                if ( assets->skies[i].ready && !sky_uploaded[i] )
+                {
+                    skies.push_back(&assets->skies[i]);
+                    sky_uploaded[i] = true;
+                }
+            }
+
+            // Modelos cujos objetos usam um atlas esperam ele ser montado,
+            // para que as suas coordenadas de textura sejam transformadas.
+            while ( next_model < assets->models.size() && assets->models[next_model].ready
+                 && !ModelWaitsForAtlas(*assets, assets->models[next_model]) )
+                models.push_back(&assets->models[next_model++]);
+        }
+
+        for (size_t i = 0; i < textures.size(); ++i)
+            UploadTextureImage(textures[i]);
+        for (size_t i = 0; i < atlases.size(); ++i)
+            BuildAndUploadAtlas(atlases[i]);
+        for (size_t i = 0; i < skies.size(); ++i)
+            UploadSky(skies[i]);
+        for (size_t i = 0; i < models.size(); ++i)
+            UploadModel(models[i]);
+        loaded += textures.size() + atlases.size() + skies.size() + models.size();
+
+        ShaderManager_Update();
+
+        glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        TextRendering_ShowLoadingProgress(window, loaded, total);
+        glfwSwapBuffers(window);
+        glfwPollEvents();
+    }
+
+    int num_threads = ThreadPool_Size(pool);
+    ThreadPool_Destroy(pool);
+
+    printf("Assets carregados em %.1f ms (%d threads).\n", 1000.0*(glfwGetTime() - start_time), num_threads);
+    printf("Memória de texturas: %.1f MB residentes, %.1f MB após o envio gradual (orçamento de %.1f MB).\n",
+        TextureStreamer_ResidentBytes() / (1024.0*1024.0), TextureStreamer_PlannedBytes() / (1024.0*1024.0),
+        TEXTURE_MEMORY_BUDGET / (1024.0*1024.0));
+}
+
+// Encerra o programa se um objeto desenhado pelo jogo não existir na cena,
+// em vez de desenhar um objeto vazio. Veja ResolveSceneObjects().
+SceneObjectHandle FindSceneObject(uint64_t name, const char* literal)
+{
+    SceneObjectHandle object = SceneRegistry_Find(g_VirtualScene, name);
+    if ( object == INVALID_SCENE_OBJECT )
+    {
+        fprintf(stderr, "ERROR: Scene object \"%s\" not found.\n", literal);
+        std::exit(EXIT_FAILURE);
+    }
+    return object;
+}
+
+#define SCENE_OBJECT(literal) FindSceneObject(SCENE_NAME(literal), literal)
+
+// Converte os nomes dos objetos desenhados pelo jogo em identificadores de
+// g_VirtualScene. Deve ser chamada após o carregamento de todos os modelos.
+void ResolveSceneObjects()
+{
+    g_Objects.plane      = SCENE_OBJECT("the_plane");
+    g_Objects.screen     = SCENE_OBJECT("the_screen");
+    g_Objects.light      = SCENE_OBJECT("the_light");
+    g_Objects.bullet     = SCENE_OBJECT("45_ACP_Low_Poly");
+    g_Objects.bark       = SCENE_OBJECT("bark1");
+    g_Objects.leaves     = SCENE_OBJECT("leaves1");
+    g_Objects.skull      = SCENE_OBJECT("skull");
+    g_Objects.eye        = SCENE_OBJECT("eye");
+    g_Objects.end_screen = SCENE_OBJECT("tela_fim_de_jogo");
+
+    g_Objects.cabin = MergeSceneObjects("static_cabin", { SCENE_OBJECT("WoodCabin"), SCENE_OBJECT("Roof") });
+
+    g_Objects.car = MergeSceneObjects("static_car", {
+                      SCENE_OBJECT("Body1"), SCENE_OBJECT("Steel"), SCENE_OBJECT("UnderCar"), SCENE_OBJECT("Hood"),
+                      SCENE_OBJECT("Body"), SCENE_OBJECT("Glass"), SCENE_OBJECT("Plastik"), SCENE_OBJECT("Light1"),
+                      SCENE_OBJECT("Light2"), SCENE_OBJECT("Light3"), SCENE_OBJECT("Logo"), SCENE_OBJECT("Plaque"),
+                      SCENE_OBJECT("Plaque1"), SCENE_OBJECT("GuidLight1"), SCENE_OBJECT("GuidLight"), SCENE_OBJECT("Light"),
+                      SCENE_OBJECT("Tire"), SCENE_OBJECT("Tire1"), SCENE_OBJECT("Tire2"), SCENE_OBJECT("Tire3") });
+
+    g_Objects.revolver = { SCENE_OBJECT("Handle"), SCENE_OBJECT("BodyR"), SCENE_OBJECT("Back_Trigger"), SCENE_OBJECT("Trigger"),
+                           SCENE_OBJECT("Chamber_Holder"), SCENE_OBJECT("Chamber"), SCENE_OBJECT("Barrel") };
+}
+
+// Junta os objetos "parts" de g_VirtualScene, que devem pertencer a um mesmo
+// modelo e ser sempre desenhados juntos, com a mesma matriz de modelagem e o
+// mesmo material, em um novo objeto "name". Os índices de cada nível de
+// detalhe das partes são copiados para um único intervalo de g_SceneGeometry
+// (uma parte sem aquele nível contribui com o seu nível mais simplificado),
+// de forma que o grupo é desenhado com uma única chamada
+// glDrawElementsBaseVertex() em vez de um intervalo por parte.
+SceneObjectHandle MergeSceneObjects(const char* name, const std::vector<SceneObjectHandle>& parts)
+{
+    SceneObject merged = g_VirtualScene.objects[parts[0]];
+    merged.name = name;
+
+    for (size_t i = 1; i < parts.size(); ++i)
+    {
+        const SceneObject& part = g_VirtualScene.objects[parts[i]];
+        assert(part.base_vertex == merged.base_vertex);
+        merged.bbox_min = glm::min(merged.bbox_min, part.bbox_min);
+        merged.bbox_max = glm::max(merged.bbox_max, part.bbox_max);
+        merged.num_lods = std::max(merged.num_lods, part.num_lods);
+    }
+
+    std::vector<GLuint> indices;
+    for (int lod = 0; lod < merged.num_lods; ++lod)
+    {
+        indices.clear();
+        float error = 0.0f;
+        for (size_t i = 0; i < parts.size(); ++i)
+        {
+            const SceneObject& part = g_VirtualScene.objects[parts[i]];
+            const MeshLod& part_lod = part.lods[std::min(lod, part.num_lods - 1)];
+            size_t offset = indices.size();
+            indices.resize(offset + part_lod.num_indices);
+            SceneGeometry_ReadIndices(g_SceneGeometry, part_lod.first_index, part_lod.num_indices, indices.data() + offset);
+            error = std::max(error, part_lod.error);
+        }
+
+        merged.lods[lod].num_indices = indices.size();
+        merged.lods[lod].error       = error;
+        SceneGeometry_AppendIndices(&g_SceneGeometry, indices.data(), indices.size(), &merged.lods[lod].first_index);
+    }
+
+    merged.first_index = merged.lods[0].first_index;
+    merged.num_indices = merged.lods[0].num_indices;
+
+    return SceneRegistry_Add(&g_VirtualScene, merged);
+}
+
+// Submete para g_RenderQueue os objetos "objects" de g_VirtualScene, que
+// serão desenhados no passo "pass" com uma única chamada. Todos devem
+// pertencer ao mesmo modelo (mesma quantização das posições); "bbox_min" e
+// "bbox_max" são os do primeiro objeto. Objetos iguais submetidos com o
+// mesmo estado são desenhados juntos, como instâncias (veja "renderqueue.h").
+void SubmitVirtualObjects(int pass, const SceneObjectHandle* objects, size_t num_objects, int material, const glm::mat4& model,
+                          float instance_data)
+{
+    // Reusado entre as chamadas, para não alocar memória a cada desenho
+    static std::vector<DrawRange> ranges;
+    ranges.resize(num_objects);
+
+    const RenderPassState& state = g_RenderQueue.passes[pass];
+    glm::mat4 model_view = state.view * model;
+
+    for (size_t i = 0; i < num_objects; ++i)
+    {
+        // Escolhemos a versão simplificada do objeto adequada ao seu tamanho
+        // na tela (veja "meshlod.h").
+        const SceneObject& object = g_VirtualScene.objects[objects[i]];
+        const MeshLod& lod = object.lods[SelectLod(object, model_view, state.projection, g_ScreenHeight)];
+        ranges[i].count       = lod.num_indices;
+        ranges[i].first_index = lod.first_index;
+        ranges[i].base_vertex = object.base_vertex;
+    }
+
+    DrawPacket packet;
+    packet.pass          = pass;
+    packet.program       = g_MaterialPrograms[material];
+    packet.material      = material;
+    packet.mesh          = &g_VirtualScene.objects[objects[0]];
+    packet.model         = model;
+    packet.normal_matrix = glm::mat3(Matrix_Normal(model));
+    packet.instance_data = instance_data;
+    RenderQueue_Submit(&g_RenderQueue, packet, ranges.data(), num_objects);
+}
+
+// Submete um objeto armazenado em g_VirtualScene para ser desenhado no passo
+// "pass", com a variável "object_id" do shader igual a "material" e o
+// atributo "instance_data" (veja "shader_vertex.glsl") igual a
+// "instance_data". As matrizes do passo devem ter sido definidas com
+// RenderQueue_SetPass().
+void QueueVirtualObject(int pass, SceneObjectHandle object, int material, const glm::mat4& model, float instance_data)
+{
+    SubmitVirtualObjects(pass, &object, 1, material, model, instance_data);
+}
+
+// Submete vários objetos de um mesmo modelo, desenhados com uma única chamada
+// glMultiDrawElementsBaseVertex().
+void QueueVirtualObjects(int pass, const std::vector<SceneObjectHandle>& objects, int material, const glm::mat4& model)
+{
+    SubmitVirtualObjects(pass, objects.data(), objects.size(), material, model, 0.0f);
+}
+
+// Caixa global de um objeto de g_VirtualScene desenhado com a matriz "model"
+CullBox ObjectBox(SceneObjectHandle object, const glm::mat4& model)
+{
+    const SceneObject& scene_object = g_VirtualScene.objects[object];
+    return Culling_TransformBox(scene_object.bbox_min, scene_object.bbox_max, model);
+}
+
+// Adiciona um objeto em g_StaticObjects e a sua caixa global em "boxes"
+void AddStaticObject(SceneObjectHandle object, int material, const glm::mat4& model, float instance_data,
+                     std::vector<CullBox>* boxes)
+{
+    StaticObject static_object;
+    static_object.object        = object;
+    static_object.material      = material;
+    static_object.model         = model;
+    static_object.instance_data = instance_data;
+    g_StaticObjects.push_back(static_object);
+
+    boxes->push_back(ObjectBox(object, model));
+}
+
+// Monta g_StaticObjects com o cenário que não se move (chão, cabine, carro e
+// árvores) e constrói a BVH das suas caixas globais, calculadas a partir das
+// bounding boxes dos objetos e das matrizes de modelagem.
+void BuildStaticScene(const arvore* arvores, int num_arvores, const CAR& carro)
+{
+    std::vector<CullBox> boxes;
+    glm::mat4 model;
+
+    // PLANE
+    model = Matrix_Translate(0.0f, 0.0f, 0.0f)
+          * Matrix_Scale(350.0f,1.0f,350.0f);
+    AddStaticObject(g_Objects.plane, PLANE, model, 0.0f, &boxes);
+
+    // CABINE
+    model = Matrix_Translate(0.0f, 0.0f, 0.0f)
+          * Matrix_Scale(0.1f,0.1f,0.1f);
+    AddStaticObject(g_Objects.cabin, CABINE, model, 0.0f, &boxes);
+
+    // CARRO & VIDROS
+    model = Matrix_Translate(carro.pos[0], 0.0f, carro.pos[2])
+          * Matrix_Scale(0.01f,0.01f,0.01f);
+    // Todas as partes usam o atlas "car_atlas" (lataria, vidros, logo,
+    // placa, piscas, faróis e pneus), portanto foram juntadas em um único
+    // objeto (veja ResolveSceneObjects()).
+    AddStaticObject(g_Objects.car, CARRO, model, 0.0f, &boxes);
+
+    // Faróis: na frente ("Light1" ocupa toda a largura da dianteira, no
+    // sentido +z do modelo), perto das laterais e apontados um pouco para
+    // baixo.
+    const SceneObject& headlights = g_VirtualScene.objects[SCENE_OBJECT("Light1")];
+    glm::vec3 headlight = glm::vec3(0.8f * headlights.bbox_max.x, 0.5f * (headlights.bbox_min.y + headlights.bbox_max.y), headlights.bbox_max.z);
+    g_CarHeadlights[0] = model * glm::vec4(headlight, 1.0f);
+    g_CarHeadlights[1] = model * glm::vec4(-headlight.x, headlight.y, headlight.z, 1.0f);
+    g_CarHeadlightDirection = glm::vec4(0.0f, -0.15f, 1.0f, 0.0f);
+
+    // ARVORES
+    // Troncos e folhas são opacos (veja "shader_fragment.glsl"); a fila
+    // desenha todos os troncos com uma chamada instanciada e depois todas
+    // as folhas com outra.
+    for(int i=0; i<num_arvores; i++)
+    {
+        model = Matrix_Translate(arvores[i].pos.x,0.0f,arvores[i].pos.z)
+            * Matrix_Scale(1.0f,1.0f,1.0f)
+            * Matrix_Rotate_Y(arvores[i].rotacao);
+        // TRONCO
+        AddStaticObject(g_Objects.bark, TRONCO, model, 0.0f, &boxes);
+        // FOLHAS
+        AddStaticObject(g_Objects.leaves, ARVORE, model, 0.0f, &boxes);
+    }
+
+    Culling_BuildBvh(&g_StaticBvh, boxes);
+
+    // A camada estática do mapa de sombras foi desenhada com os objetos
+    // anteriores
+    ShadowMap_Invalidate(&g_ShadowMap);
+}
+
+// Submete para o passo "pass" os objetos estáticos que estão, ao menos em
+// parte, dentro de "frustum".
+void QueueStaticObjects(int pass, const Frustum& frustum)
+{
+    Culling_CullBvh(&g_StaticBvh, frustum, &g_StaticVisible, &g_CullStats);
+
+    for (size_t i = 0; i < g_StaticObjects.size(); ++i)
+    {
+        if ( !g_StaticVisible[i] )
+            continue;
+
+        const StaticObject& object = g_StaticObjects[i];
+        QueueVirtualObject(pass, object.object, object.material, object.model, object.instance_data);
+    }
+}
+
+// Testa a caixa global de um objeto que se move contra o frustum, contando-o
+// em g_CullStats. Retorna true se o objeto deve ser desenhado.
+bool CullDynamicObject(const Frustum& frustum, const CullBox& box)
+{
+    unsigned plane_mask = CULL_ALL_PLANES;
+    g_CullStats.boxes_tested += 1;
+    if ( Culling_TestBox(frustum, box, &plane_mask, NULL) == CULL_OUTSIDE )
+    {
+        g_CullStats.culled += 1;
+        return false;
+    }
+    g_CullStats.visible += 1;
+    return true;
+}
+
+// Submete a caveira de um monstro, com matriz de modelagem "model", e os seus
+// dois olhos. O monstro é descartado como um todo, pela caixa que envolve a
+// caveira e os olhos. O brilho dos olhos é uma luz dinâmica, adicionada mesmo
+// quando o monstro está fora do campo de visão, pois ela pode iluminar
+// objetos visíveis. Pelo mesmo motivo, se "shadow_frustum" não for NULL, a
+// caveira é submetida para o mapa de sombras da lanterna quando está dentro
+// do frustum da luz, mesmo fora do campo de visão.
+void QueueMonster(const Frustum& frustum, const Frustum* shadow_frustum, glm::mat4 model, float eye_rotation)
+{
+    glm::mat4 left_eye  = model * Matrix_Translate(-3.2f, 1.4f, 9.0f)
+                                * Matrix_Rotate_X(eye_rotation);
+    glm::mat4 right_eye = left_eye * Matrix_Translate(6.4f, 0.0f, 0.f);
+
+    // Luz entre os olhos, com alcance proporcional ao tamanho do monstro
+    glm::vec4 eyes_center = model * glm::vec4(0.0f, 1.4f, 10.0f, 1.0f);
+    LightClusters_AddPoint(&g_LightClusters, eyes_center, 100.0f * norm(model[0]), glm::vec3(0.9f, 0.9f, 0.0f) * 1.5f);
+
+    CullBox box = Culling_MergeBoxes(ObjectBox(g_Objects.skull, model),
+                                     Culling_MergeBoxes(ObjectBox(g_Objects.eye, left_eye), ObjectBox(g_Objects.eye, right_eye)));
+
+    if ( shadow_frustum != NULL )
+    {
+        unsigned plane_mask = CULL_ALL_PLANES;
+        if ( Culling_TestBox(*shadow_frustum, box, &plane_mask, NULL) != CULL_OUTSIDE )
+            QueueShadowCaster(g_Objects.skull, g_ShadowPrograms[SHADOW_PROGRAM_OPACO], model);
+    }
+
+    if ( !CullDynamicObject(frustum, box) )
+        return;
+
+    QueueVirtualObject(PASS_TRANSLUCENT, g_Objects.skull, SKULL, model);
+    QueueVirtualObject(PASS_TRANSLUCENT, g_Objects.eye, EYE, left_eye);
+    QueueVirtualObject(PASS_TRANSLUCENT, g_Objects.eye, EYE, right_eye);
+}
+
+// Submete um objeto de g_VirtualScene para o passo único de g_ShadowQueue,
+// desenhado com a permutação "program" do programa do mapa de sombras. O
+// nível de detalhe é escolhido pelo tamanho do objeto no mapa.
+void QueueShadowCaster(SceneObjectHandle object, int program, const glm::mat4& model)
+{
+    const RenderPassState& state = g_ShadowQueue.passes[0];
+    const SceneObject& scene_object = g_VirtualScene.objects[object];
+    const MeshLod& lod = scene_object.lods[SelectLod(scene_object, state.view * model, state.projection, g_ShadowMap.size)];
+
+    DrawRange range;
+    range.count       = lod.num_indices;
+    range.first_index = lod.first_index;
+    range.base_vertex = scene_object.base_vertex;
+
+    // Apenas as posições (e, nas folhas, as coordenadas de textura) são
+    // usadas; a matriz das normais não é calculada.
+    DrawPacket packet;
+    packet.pass          = 0;
+    packet.program       = program;
+    packet.material      = program;
+    packet.mesh          = &scene_object;
+    packet.model         = model;
+    packet.normal_matrix = glm::mat3(1.0f);
+    packet.instance_data = 0.0f;
+    RenderQueue_Submit(&g_ShadowQueue, packet, &range, 1);
+}
+
+// Informa a g_ShadowMap a posição e a direção da lanterna, redesenhando a
+// camada estática, com os objetos estáticos (exceto o chão, que não faz
+// sombra) dentro do frustum da luz, quando ela se moveu o suficiente. Define
+// o passo de g_ShadowQueue com a câmera da luz e retorna o seu frustum, que
+// descarta os objetos que se movem submetidos em seguida.
+Frustum UpdateFlashlightShadows(const glm::vec4& position, const glm::vec4& direction)
+{
+    // O campo de visão da luz é mais largo que o cone da lanterna, de forma
+    // que a camada estática continue cobrindo o cone enquanto é reusada.
+    glm::vec4 up = (fabs(direction.y) < 0.99f * norm(direction)) ? glm::vec4(0.0f, 1.0f, 0.0f, 0.0f) : glm::vec4(1.0f, 0.0f, 0.0f, 0.0f);
+    glm::mat4 light_view = Matrix_Camera_View(position, direction, up);
+    glm::mat4 light_projection = Matrix_Perspective(2.0f * (FLASHLIGHT_CONE_ANGLE + SHADOW_MAP_MAX_ANGLE), 1.0f, -0.1f, -25.0f);
+
+    bool redraw = ShadowMap_Update(&g_ShadowMap, position, direction, light_view, light_projection);
+
+    RenderQueue_SetPass(&g_ShadowQueue, 0, g_ShadowMap.view, g_ShadowMap.projection, Matrix_Camera_Position(g_ShadowMap.view),
+                        RENDER_PASS_DEPTH_TEST);
+    Frustum frustum = Culling_ExtractFrustum(g_ShadowMap.projection * g_ShadowMap.view);
+
+    if ( redraw )
+    {
+        CullStats stats;
+        Culling_CullBvh(&g_StaticBvh, frustum, &g_ShadowVisible, &stats);
+
+        for (size_t i = 0; i < g_StaticObjects.size(); ++i)
+        {
+            const StaticObject& object = g_StaticObjects[i];
+            if ( !g_ShadowVisible[i] || object.material == PLANE )
+                continue;
+
+            int program = (object.material == ARVORE) ? SHADOW_PROGRAM_RECORTE : SHADOW_PROGRAM_OPACO;
+            QueueShadowCaster(object.object, g_ShadowPrograms[program], object.model);
+        }
+
+        ShadowMap_BeginStatic(&g_ShadowMap);
+        RenderQueue_Flush(&g_ShadowQueue);
+        ShadowMap_End(g_ScreenWidth, g_ScreenHeight);
+    }
+
+    return frustum;
+}
+
+// Adiciona a g_LightClusters as luzes dinâmicas que não pertencem aos
+// monstros: o clarão do tiro, logo à frente da câmera "view", e os faróis do
+// carro.
+void AddDynamicLights(const glm::mat4& view, bool nozzle_flash)
+{
+    if ( nozzle_flash )
+    {
+        glm::vec4 camera_forward = -glm::vec4(view[0][2], view[1][2], view[2][2], 0.0f);
+        LightClusters_AddPoint(&g_LightClusters, Matrix_Camera_Position(view) + 0.5f * camera_forward, 12.0f,
+                               glm::vec3(1.0f, 0.6f, 0.3f) * 6.0f);
+    }
+
+    for (int i = 0; i < 2; ++i)
+        LightClusters_AddSpot(&g_LightClusters, g_CarHeadlights[i], g_CarHeadlightDirection, 0.35f, 15.0f,
+                              glm::vec3(1.0f, 0.95f, 0.8f) * 10.0f);
+}
+
+// Desenha o céu atrás de toda a cena: um triângulo que cobre a tela, onde cada
+// pixel consulta o cubemap na sua direção de visualização (veja
+// "shader_sky_vertex.glsl"). Deve ser chamada antes dos demais objetos, com
+// o programa do céu em uso ao final.
+void DrawSky(const glm::mat4& view, const glm::mat4& projection, bool menu)
+{
+    // Apenas a rotação da câmera: o céu está infinitamente distante
+    glm::mat4 rotation = view;
+    rotation[3] = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+    glm::mat4 inverse_view_projection = glm::inverse(projection * rotation);
+
+    // Mesma intensidade que o céu tinha quando era desenhado pelo shader dos
+    // objetos: duas vezes o termo ambiente Ka*Ia, ampliado na tela de menu.
+    glm::vec3 sky_color = 2.0f * glm::vec3(0.2f, 0.02f, 0.02f) * 0.1f;
+    if ( menu )
+        sky_color *= 1000.0f;
+
+    glUseProgram(g_SkyProgramID);
+    glUniformMatrix4fv(g_sky_inverse_view_projection_uniform, 1, GL_FALSE, glm::value_ptr(inverse_view_projection));
+    glUniform3f(g_sky_color_uniform, sky_color.x, sky_color.y, sky_color.z);
+
+    // O triângulo não usa atributos de vértice, mas o perfil core exige
+    // que algum VAO esteja ligado.
+    glDisable(GL_DEPTH_TEST);
+    glBindVertexArray(g_SceneGeometry.vertex_array_object_id);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    glEnable(GL_DEPTH_TEST);
+}
+
+// Escolhe o nível de detalhe com que um objeto será desenhado com as matrizes
+// "model_view" e "projection" em um alvo com "target_height" pixels de altura
+// (a janela ou o mapa de sombras): o nível mais simples cujo erro
+// geométrico, projetado no alvo, não passa de LOD_MAX_PIXEL_ERROR pixels. O
+// tamanho projetado é estimado pela esfera que envolve a bounding box do
+// objeto.
+int SelectLod(const SceneObject& object, const glm::mat4& model_view, const glm::mat4& projection, int target_height)
+{
+    if ( object.num_lods <= 1 )
+        return 0;
+
+    // Maior fator de escala da matriz de modelagem (a matriz View é rígida)
+    float scale = std::max(norm(model_view[0]), std::max(norm(model_view[1]), norm(model_view[2])));
+
+    glm::vec4 center = model_view * glm::vec4(0.5f*(object.bbox_min + object.bbox_max), 1.0f);
+    float radius = 0.5f * scale * glm::length(object.bbox_max - object.bbox_min);
+
+    // Na projeção perspectiva a coordenada w é a distância até a câmera; na
+    // ortográfica ela vale sempre 1.
+    float w = fabs((projection * center).w);
+    bool perspective = projection[3][3] == 0.0f;
+    if ( perspective && w <= radius )
+        return 0;
+
+    // Pixels na tela por unidade de comprimento do modelo
+    float pixels_per_unit = 0.5f * target_height * fabs(projection[1][1]) * scale / w;
+
+    int lod = 0;
+    while ( lod + 1 < object.num_lods && object.lods[lod + 1].error * pixels_per_unit <= LOD_MAX_PIXEL_ERROR )
+        lod += 1;
+
+    return lod;
+}
+
+// Mede o custo por pixel dos shaders (opção "--fillrate" da linha de
+// comando). A cena estática é desenhada de uma câmera fixa em framebuffers
+// fora da tela, de 1200x800 e de 3840x2160 pixels, e o tempo de GPU de cada
+// quadro é medido com consultas GL_TIME_ELAPSED. Rodando uma vez com e outra
+// sem "--gpu-inverses", compara-se na mesma máquina o custo das inversas de
+// matrizes nos shaders:
+//
+//    make fillrate
+//
+void RunFillRateBenchmark()
+{
+    const int sizes[2][2] = { { 1200, 800 }, { 3840, 2160 } };
+    const int NUM_WARMUP_FRAMES = 10;
+    const int NUM_FRAMES = 100;
+
+    // Os níveis de mipmap maiores são enviados antes das medidas
+    while ( TextureStreamer_Busy() )
+        TextureStreamer_Update();
+
+    // Câmera fixa, vendo a cabine e o carro de dentro do círculo de árvores,
+    // com a iluminação do jogo e a lanterna ligada, com sombras
+    glm::vec4 camera_position_c  = glm::vec4(8.0f, 3.0f, 8.0f, 1.0f);
+    glm::vec4 camera_lookat_l    = glm::vec4(2.0f, 0.5f, 0.0f, 1.0f);
+    glm::vec4 camera_up_vector   = glm::vec4(0.0f, 1.0f, 0.0f, 0.0f);
+    glm::mat4 view = Matrix_Camera_View(camera_position_c, camera_lookat_l - camera_position_c, camera_up_vector);
+
+    g_RenderQueue.frame.lanterna_ligada = 1;
+    g_RenderQueue.frame.nozzle_flash    = 0;
+    g_RenderQueue.frame.tela_de_menu    = 0;
+
+    // Mapa de sombras da lanterna, saindo da câmera, desenhado uma única vez
+    UpdateFlashlightShadows(camera_position_c, camera_lookat_l - camera_position_c);
+    ShadowMap_BeginDynamic(g_ShadowMap);
+    RenderQueue_Flush(&g_ShadowQueue);
+    ShadowMap_End(g_ScreenWidth, g_ScreenHeight);
+    g_RenderQueue.frame.sombra_lanterna = 1;
+    g_RenderQueue.frame.shadow_matrix   = ShadowMap_Matrix(g_ShadowMap);
+
+    printf("Fill rate (%s):\n", g_GpuInverses ? "inversas na GPU" : "inversas na CPU");
+
+    for (int s = 0; s < 2; ++s)
+    {
+        int width  = sizes[s][0];
+        int height = sizes[s][1];
+
+        GLuint framebuffer_id, renderbuffer_ids[2];
+        glGenFramebuffers(1, &framebuffer_id);
+        glGenRenderbuffers(2, renderbuffer_ids);
+        glBindRenderbuffer(GL_RENDERBUFFER, renderbuffer_ids[0]);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+        glBindRenderbuffer(GL_RENDERBUFFER, renderbuffer_ids[1]);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_id);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, renderbuffer_ids[0]);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, renderbuffer_ids[1]);
+        if ( glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE )
+        {
+            fprintf(stderr, "ERROR: framebuffer de %dx%d incompleto.\n", width, height);
+            std::exit(EXIT_FAILURE);
+        }
+        glViewport(0, 0, width, height);
+
+        // SelectLod() escolhe os níveis de detalhe para esta resolução
+        g_ScreenWidth  = width;
+        g_ScreenHeight = height;
+        g_ScreenRatio  = (float)width / height;
+        float nearplane = -0.1f;
+        float farplane  = -30.0f;
+        glm::mat4 perspective = Matrix_Perspective(PI / 3.0f, g_ScreenRatio, nearplane, farplane);
+        Frustum frustum = Culling_ExtractFrustum(perspective * view);
+
+        // Os faróis do carro, as luzes dinâmicas presentes em todo quadro
+        LightClusters_Clear(&g_LightClusters);
+        AddDynamicLights(view, false);
+        LightClusters_Build(&g_LightClusters, view, perspective, -nearplane, -farplane, width, height);
+
+        std::vector<GLuint> queries(NUM_FRAMES);
+        glGenQueries(NUM_FRAMES, queries.data());
+
+        for (int frame = -NUM_WARMUP_FRAMES; frame < NUM_FRAMES; ++frame)
+        {
+            if ( frame >= 0 )
+                glBeginQuery(GL_TIME_ELAPSED, queries[frame]);
+
+            glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+            RenderQueue_SetPass(&g_RenderQueue, PASS_OPAQUE, view, perspective, Matrix_Camera_Position(view), RENDER_PASS_DEPTH_TEST | RENDER_PASS_CULL_FACE);
+            DrawSky(view, perspective, false);
+            QueueStaticObjects(PASS_OPAQUE, frustum);
+            RenderQueue_Flush(&g_RenderQueue);
+
+            if ( frame >= 0 )
+                glEndQuery(GL_TIME_ELAPSED);
+        }
+
+        // Aguarda os resultados e reporta a média e o menor tempo
+        double total_ms = 0.0;
+        double min_ms = std::numeric_limits<double>::max();
+        for (int frame = 0; frame < NUM_FRAMES; ++frame)
+        {
+            GLuint64 elapsed_ns;
+            glGetQueryObjectui64v(queries[frame], GL_QUERY_RESULT, &elapsed_ns);
+            double ms = elapsed_ns / 1e6;
+            total_ms += ms;
+            min_ms = std::min(min_ms, ms);
+        }
+        double mean_ms = total_ms / NUM_FRAMES;
+        printf("  %4dx%-4d: %7.3f ms/quadro (mínimo %7.3f ms), %8.1f Mpixels/s\n",
+            width, height, mean_ms, min_ms, (double)width * height / (mean_ms * 1e3));
+
+        glDeleteQueries(NUM_FRAMES, queries.data());
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glDeleteFramebuffers(1, &framebuffer_id);
+        glDeleteRenderbuffers(2, renderbuffer_ids);
+    }
+}
+
+// Função que submete a compilação dos shaders de vértices e de fragmentos que
+// serão utilizados para renderização. Veja slides 180-200 do documento Aula_03_Rendering_Pipeline_Grafico.pdf.
+//
+void LoadShadersFromFiles()
+{
+    // Note que o caminho para os arquivos "shader_vertex.glsl" e
+    // "shader_fragment.glsl" estão fixados, sendo que assumimos a existência
+    // da seguinte estrutura no sistema de arquivos:
+    //
+    //    + FCG_Lab_01/
+    //    |
+    //    +--+ bin/
+    //    |  |
+    //    |  +--+ Release/  (ou Debug/ ou Linux/)
+    //    |     |
+    //    |     o-- main.exe
+    //    |
+    //    +--+ src/
+    //       |
+    //       o-- shader_vertex.glsl
+    //       |
+    //       o-- shader_fragment.glsl
+    //
+    // Uma permutação por material, compilada com "#define MATERIAL" para que
+    // cada fragmento execute apenas o código do seu material. Os programas
+    // são registrados em g_RenderQueue desde já; os identificadores OpenGL
+    // são definidos por SetupMainProgram().
+    for (int material = 1; material < NUM_MATERIALS; ++material)
+    {
+        RenderProgram program;
+        program.program_id = 0;
+        g_MaterialPrograms[material] = RenderQueue_AddProgram(&g_RenderQueue, program);
+
+        char name[48];
+        snprintf(name, 48, "shader_material_%d%s", material, g_GpuInverses ? "_gpu_inverses" : "");
+        char defines[64];
+        snprintf(defines, 64, "#define MATERIAL %d\n%s", material, g_GpuInverses ? "#define INVERSAS_NA_GPU\n" : "");
+        LoadGpuProgram(name, "../../src/shader_vertex.glsl", "../../src/shader_fragment.glsl", SetupMainProgram, defines, material);
+    }
+
+    // Programa do céu (veja DrawSky())
+    LoadGpuProgram("shader_sky", "../../src/shader_sky_vertex.glsl", "../../src/shader_sky_fragment.glsl", SetupSkyProgram);
+
+    // Programa do mapa de sombras da lanterna (veja UpdateFlashlightShadows()),
+    // com uma permutação que recorta as folhas das árvores
+    const char* shadow_defines[NUM_SHADOW_PROGRAMS] = { "", "#define RECORTE\n" };
+    for (int permutation = 0; permutation < NUM_SHADOW_PROGRAMS; ++permutation)
+    {
+        RenderProgram program;
+        program.program_id = 0;
+        g_ShadowPrograms[permutation] = RenderQueue_AddProgram(&g_ShadowQueue, program);
+
+        char name[32];
+        snprintf(name, 32, "shader_shadow_%d", permutation);
+        LoadGpuProgram(name, "../../src/shader_shadow_vertex.glsl", "../../src/shader_shadow_fragment.glsl", SetupShadowProgram,
+                       shadow_defines[permutation], permutation);
+    }
+}
+
+// Chamada por ShaderManager_Update() quando a permutação do programa
+// principal do material "material" fica pronta.
+void SetupMainProgram(GLuint program_id, int material)
+{
+    // Deletamos o programa de GPU anterior, caso ele exista.
+    if ( g_MaterialProgramIDs[material] != 0 )
+        glDeleteProgram(g_MaterialProgramIDs[material]);
+
+    g_MaterialProgramIDs[material] = program_id;
+
+    // As variáveis "view", "projection", etc. estão nos blocos de uniforms
+    // de g_RenderQueue. Veja arquivo "shader_vertex.glsl" e
+    // "shader_fragment.glsl".
+    RenderQueue_BindUniformBlocks(program_id);
+
+    // Luzes dinâmicas (veja "lightclusters.h")
+    LightClusters_BindProgram(program_id);
+
+    // Os objetos são desenhados por g_RenderQueue (veja "renderqueue.h")
+    RenderProgram program;
+    program.program_id = program_id;
+    RenderQueue_SetProgram(&g_RenderQueue, g_MaterialPrograms[material], program);
+
+    // Variáveis em "shader_fragment.glsl" para acesso das imagens de textura.
+    // As texturas que o material não usa não existem no programa e são
+    // ignoradas (glGetUniformLocation() retorna -1).
+    glUseProgram(program_id);
+    glUniform1i(glGetUniformLocation(program_id, "chao"), 0);
+    glUniform1i(glGetUniformLocation(program_id, "lanterna"), 2);
+    glUniform1i(glGetUniformLocation(program_id, "crosshair"), 3);
+    glUniform1i(glGetUniformLocation(program_id, "chao_normal"), 4);
+    glUniform1i(glGetUniformLocation(program_id, "skull_diff"), 5);
+    glUniform1i(glGetUniformLocation(program_id, "skull_normal"), 6);
+    glUniform1i(glGetUniformLocation(program_id, "smoke"), 7);
+    glUniform1i(glGetUniformLocation(program_id, "bark"), 8);
+    glUniform1i(glGetUniformLocation(program_id, "folhas"), 9);
+    glUniform1i(glGetUniformLocation(program_id, "cabine_diff"), 10);
+    glUniform1i(glGetUniformLocation(program_id, "cabine_normal"), 11);
+    glUniform1i(glGetUniformLocation(program_id, "cabine_spec"), 12);
+    glUniform1i(glGetUniformLocation(program_id, "car_atlas"), 13);
+    glUniform1i(glGetUniformLocation(program_id, "tela_fim_de_jogo"), 14);
+    glUniform1i(glGetUniformLocation(program_id, "tela_game_over"), 15);
+    glUniform1i(glGetUniformLocation(program_id, "mapa_de_sombra"), SHADOW_MAP_TEXTURE_UNIT);
+
+    glUseProgram(0);
+}
+
+// Chamada por ShaderManager_Update() quando o programa do céu fica pronto.
+void SetupSkyProgram(GLuint program_id, int /*permutation*/)
+{
+    if ( g_SkyProgramID != 0 )
+        glDeleteProgram(g_SkyProgramID);
+
+    g_SkyProgramID = program_id;
+    g_sky_inverse_view_projection_uniform = glGetUniformLocation(g_SkyProgramID, "inverse_view_projection");
+    g_sky_color_uniform = glGetUniformLocation(g_SkyProgramID, "sky_color");
+
+    glUseProgram(g_SkyProgramID);
+    glUniform1i(glGetUniformLocation(g_SkyProgramID, "ceu"), 1);
+
+    glUseProgram(0);
+}
+
+// Chamada por ShaderManager_Update() quando a permutação "permutation" do
+// programa do mapa de sombras fica pronta.
+void SetupShadowProgram(GLuint program_id, int permutation)
+{
+    if ( g_ShadowProgramIDs[permutation] != 0 )
+        glDeleteProgram(g_ShadowProgramIDs[permutation]);
+
+    g_ShadowProgramIDs[permutation] = program_id;
+
+    RenderQueue_BindUniformBlocks(program_id);
+
+    RenderProgram program;
+    program.program_id = program_id;
+    RenderQueue_SetProgram(&g_ShadowQueue, g_ShadowPrograms[permutation], program);
+
+    // A camada estática pode ter sido desenhada antes de o programa ficar
+    // pronto (sem os objetos que ele desenha) ou com a versão anterior
+    ShadowMap_Invalidate(&g_ShadowMap);
+
+    glUseProgram(program_id);
+    glUniform1i(glGetUniformLocation(program_id, "folhas"), 9);
+
+    glUseProgram(0);
+}
+
+// Função que pega a matriz M e guarda a mesma no topo da pilha
+void PushMatrix(glm::mat4 M)
+{
+    g_MatrixStack.push(M);
+}
+
+// Função que remove a matriz atualmente no topo da pilha e armazena a mesma na variável M
+void PopMatrix(glm::mat4& M)
+{
+    if ( g_MatrixStack.empty() )
+    {
+        M = Matrix_Identity();
+    }
+    else
+    {
+        M = g_MatrixStack.top();
+        g_MatrixStack.pop();
+    }
+}
+
+// Função que computa as normais de um ObjModel, caso elas não tenham sido
+// especificadas dentro do arquivo ".obj"
+void ComputeNormals(ObjModel* model)
+{
+    if ( !model->attrib.normals.empty() )
+        return;
+
+    // As normais dos VÉRTICES são computadas através do método proposto por
+    // Gouraud, onde a normal de cada vértice vai ser a média das normais de
+    // todas as faces que compartilham este vértice, ponderada pela área de
+    // cada face. Veja ComputeVertexNormals() em "normals.h".
+
+    size_t num_vertices = model->attrib.vertices.size() / 3;
+
+    // Índices de vértice de todos os triângulos, de todas as shapes. Cada
+    // vértice passa a usar a normal de mesmo índice.
+    std::vector<unsigned int> triangles;
+    for (size_t shape = 0; shape < model->shapes.size(); ++shape)
+    {
+        std::vector<tinyobj::index_t>& indices = model->shapes[shape].mesh.indices;
+        assert(indices.size() == 3*model->shapes[shape].mesh.num_face_vertices.size());
+
+        for (size_t i = 0; i < indices.size(); ++i)
+        {
+            triangles.push_back(indices[i].vertex_index);
+            indices[i].normal_index = indices[i].vertex_index;
+        }
+    }
+
+    model->attrib.normals.resize( 3*num_vertices );
+
+    ComputeVertexNormals(model->attrib.vertices.data(), num_vertices,
+                         triangles.data(), triangles.size() / 3,
+                         model->attrib.normals.data(), 0);
+}
+
+// Primeira etapa do carregamento de um modelo geométrico, seguida de
+// UploadModel(), que adiciona seus objetos na cena virtual. Se existir um
+// cache binário válido para o arquivo (veja "meshcache.h"), ele é apenas
+// mapeado em memória, sem passar por ReadObj(), ComputeNormals() e
+// BuildTriangles(). Caso contrário, o modelo é lido do arquivo ".obj" e o
+// cache é (re)gravado. Não faz chamadas OpenGL, podendo ser executada em uma
+// thread de trabalho.
+void ReadModel(ModelAsset* asset)
+{
+    double start_time = glfwGetTime();
+    const char* filename = asset->filename.c_str();
+
+    asset->from_cache = MeshCache_Load(filename, &asset->cache);
+    if ( !asset->from_cache )
+    {
+        ObjModel model(filename);
+        ComputeNormals(&model);
+        BuildTriangles(&model, &asset->mesh, &asset->stats);
+
+        if ( !MeshCache_Save(filename, MeshData_View(asset->mesh)) )
+            fprintf(stderr, "WARNING: Cannot write mesh cache \"%s\".\n", MeshCache_Filename(filename).c_str());
+    }
+
+    asset->read_time = glfwGetTime() - start_time;
+}
+
+// Segunda etapa do carregamento de um modelo geométrico: envia para a GPU o
+// modelo lido por ReadModel(). Deve ser executada na thread do contexto OpenGL.
+void UploadModel(ModelAsset* asset)
+{
+    double start_time = glfwGetTime();
+
+    MeshView view = asset->from_cache ? asset->cache.view : MeshData_View(asset->mesh);
+
+    // Objetos que usam um atlas de texturas recebem as coordenadas de textura
+    // da sua região (veja BuildAndUploadAtlas()).
+    std::vector<const AtlasRegion*> regions(view.num_objects, NULL);
+    bool uses_atlas = false;
+    for (size_t i = 0; i < view.num_objects; ++i)
+    {
+        std::map<std::string, AtlasRegion>::const_iterator it = g_AtlasRegions.find(view.objects[i].name);
+        if ( it != g_AtlasRegions.end() )
+        {
+            regions[i] = &it->second;
+            uses_atlas = true;
+        }
+    }
+
+    if ( uses_atlas )
+    {
+        MeshData remapped;
+        RemapMeshToAtlas(view, regions.data(), &remapped);
+        AddMeshToVirtualScene(MeshData_View(remapped));
+    }
+    else
+    {
+        AddMeshToVirtualScene(view);
+    }
+
+    if ( asset->from_cache )
+        MeshCache_Close(&asset->cache);
+
+    printf("Modelo \"%s\"%s: leitura %.1f ms, envio %.1f ms.\n",
+        asset->filename.c_str(), asset->from_cache ? " (cache)" : "",
+        1000.0*asset->read_time, 1000.0*(glfwGetTime() - start_time));
+
+    if ( !asset->from_cache )
+    {
+        PrintMeshStats(asset->mesh, asset->stats);
+        asset->mesh = MeshData();
+    }
+}
+
+// Constrói triângulos para futura renderização a partir de um ObjModel.
+void BuildTrianglesAndAddToVirtualScene(ObjModel* model)
+{
+    MeshData mesh;
+    MeshOptimizationStats stats;
+    BuildTriangles(model, &mesh, &stats);
+    AddMeshToVirtualScene(MeshData_View(mesh));
+    PrintMeshStats(mesh, stats);
+}
+
+// Constrói os vetores de índices, vértices, normais e coordenadas de textura
+// de um ObjModel, além da lista de objetos nomeados, já otimizados por
+// OptimizeMesh(). Nenhuma chamada OpenGL é feita aqui; veja
+// AddMeshToVirtualScene().
+void BuildTriangles(ObjModel* model, MeshData* mesh, MeshOptimizationStats* stats)
+{
+    std::vector<GLuint>& indices              = mesh->indices;
+    std::vector<float>&  model_coefficients   = mesh->model_coefficients;
+    std::vector<float>&  normal_coefficients  = mesh->normal_coefficients;
+    std::vector<float>&  texture_coefficients = mesh->texture_coefficients;
+
+    for (size_t shape = 0; shape < model->shapes.size(); ++shape)
+    {
+        size_t first_index = indices.size();
+        size_t num_triangles = model->shapes[shape].mesh.num_face_vertices.size();
+
+        const float minval = std::numeric_limits<float>::min();
+        const float maxval = std::numeric_limits<float>::max();
+
+        glm::vec3 bbox_min = glm::vec3(maxval,maxval,maxval);
+        glm::vec3 bbox_max = glm::vec3(minval,minval,minval);
+
+        for (size_t triangle = 0; triangle < num_triangles; ++triangle)
+        {
+            assert(model->shapes[shape].mesh.num_face_vertices[triangle] == 3);
+
+            for (size_t vertex = 0; vertex < 3; ++vertex)
+            {
+                tinyobj::index_t idx = model->shapes[shape].mesh.indices[3*triangle + vertex];
+
+                indices.push_back(first_index + 3*triangle + vertex);
 
                 const float vx = model->attrib.vertices[3*idx.vertex_index + 0];
                 const float vy = model->attrib.vertices[3*idx.vertex_index + 1];
@@ -1861,6 +3125,12 @@ void BuildTrianglesAndAddToVirtualScene(ObjModel* model)
                 // existem normais e coordenadas de textura no ObjModel é
                 // comparando se o índice retornado é -1. Fazemos isso abaixo.
 
+                //
+                // Como os atributos são intercalados em um único VBO (veja
+                // "vertexformat.h"), vértices sem normal ou sem coordenada de
+                // textura em um modelo que as possui recebem zeros, mantendo
+                // os vetores alinhados com model_coefficients.
+
                 if ( idx.normal_index != -1 )
                 {
                     const float nx = model->attrib.normals[3*idx.normal_index + 0];
@@ -1871,6 +3141,10 @@ void BuildTrianglesAndAddToVirtualScene(ObjModel* model)
                     normal_coefficients.push_back( nz ); // Z
                     normal_coefficients.push_back( 0.0f ); // W
                 }
+                else if ( !model->attrib.normals.empty() )
+                {
+                    normal_coefficients.insert(normal_coefficients.end(), 4, 0.0f);
+                }
 
                 if ( idx.texcoord_index != -1 )
                 {
@@ -1879,113 +3153,121 @@ void BuildTrianglesAndAddToVirtualScene(ObjModel* model)
                     texture_coefficients.push_back( u );
                     texture_coefficients.push_back( v );
                 }
+                else if ( !model->attrib.texcoords.empty() )
+                {
+                    texture_coefficients.insert(texture_coefficients.end(), 2, 0.0f);
+                }
             }
         }
 
         size_t last_index = indices.size() - 1;
 
-        SceneObject theobject;
-        theobject.name           = model->shapes[shape].name;
-        theobject.first_index    = first_index; // Primeiro índice
-        theobject.num_indices    = last_index - first_index + 1; // Número de indices
-        theobject.rendering_mode = GL_TRIANGLES;       // Índices correspondem ao tipo de rasterização GL_TRIANGLES.
-        theobject.vertex_array_object_id = vertex_array_object_id;
-
-        theobject.bbox_min = bbox_min;
-        theobject.bbox_max = bbox_max;
+        MeshObject theobject;
+        theobject.name        = model->shapes[shape].name;
+        theobject.first_index = first_index; // Primeiro índice
+        theobject.num_indices = last_index - first_index + 1; // Número de indices
+        theobject.bbox_min    = bbox_min;
+        theobject.bbox_max    = bbox_max;
 
-        g_VirtualScene[model->shapes[shape].name] = theobject;
+        mesh->objects.push_back(theobject);
     }
 
-    GLuint VBO_model_coefficients_id;
-    glGenBuffers(1, &VBO_model_coefficients_id);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO_model_coefficients_id);
-    glBufferData(GL_ARRAY_BUFFER, model_coefficients.size() * sizeof(float), NULL, GL_STATIC_DRAW);
-    glBufferSubData(GL_ARRAY_BUFFER, 0, model_coefficients.size() * sizeof(float), model_coefficients.data());
-    GLuint location = 0; // "(location = 0)" em "shader_vertex.glsl"
-    GLint  number_of_dimensions = 4; // vec4 em "shader_vertex.glsl"
-    glVertexAttribPointer(location, number_of_dimensions, GL_FLOAT, GL_FALSE, 0, 0);
-    glEnableVertexAttribArray(location);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    // Os triângulos acima não compartilham vértices. Soldamos os vértices
+    // repetidos e reordenamos os triângulos para a cache de vértices da GPU.
+    OptimizeMesh(mesh, stats);
 
-    if ( !normal_coefficients.empty() )
-    {
-        GLuint VBO_normal_coefficients_id;
-        glGenBuffers(1, &VBO_normal_coefficients_id);
-        glBindBuffer(GL_ARRAY_BUFFER, VBO_normal_coefficients_id);
-        glBufferData(GL_ARRAY_BUFFER, normal_coefficients.size() * sizeof(float), NULL, GL_STATIC_DRAW);
-        glBufferSubData(GL_ARRAY_BUFFER, 0, normal_coefficients.size() * sizeof(float), normal_coefficients.data());
-        location = 1; // "(location = 1)" em "shader_vertex.glsl"
-        number_of_dimensions = 4; // vec4 em "shader_vertex.glsl"
-        glVertexAttribPointer(location, number_of_dimensions, GL_FLOAT, GL_FALSE, 0, 0);
-        glEnableVertexAttribArray(location);
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
-    }
-
-    if ( !texture_coefficients.empty() )
-    {
-        GLuint VBO_texture_coefficients_id;
-        glGenBuffers(1, &VBO_texture_coefficients_id);
-        glBindBuffer(GL_ARRAY_BUFFER, VBO_texture_coefficients_id);
-        glBufferData(GL_ARRAY_BUFFER, texture_coefficients.size() * sizeof(float), NULL, GL_STATIC_DRAW);
-        glBufferSubData(GL_ARRAY_BUFFER, 0, texture_coefficients.size() * sizeof(float), texture_coefficients.data());
-        location = 2; // "(location = 1)" em "shader_vertex.glsl"
-        number_of_dimensions = 2; // vec2 em "shader_vertex.glsl"
-        glVertexAttribPointer(location, number_of_dimensions, GL_FLOAT, GL_FALSE, 0, 0);
-        glEnableVertexAttribArray(location);
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
-    }
-
-    GLuint indices_id;
-    glGenBuffers(1, &indices_id);
-
-    // "Ligamos" o buffer. Note que o tipo agora é GL_ELEMENT_ARRAY_BUFFER.
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indices_id);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint), NULL, GL_STATIC_DRAW);
-    glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, indices.size() * sizeof(GLuint), indices.data());
-    // glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0); // XXX Errado!
-    //
+    // Versões simplificadas dos objetos, desenhadas quando eles ocupam
+    // poucos pixels na tela. Veja SelectLod().
+    GenerateMeshLods(mesh);
 
-    // "Desligamos" o VAO, evitando assim que operações posteriores venham a
-    // alterar o mesmo. Isso evita bugs.
-    glBindVertexArray(0);
+    // Por fim, geramos os vértices compactados que serão enviados à GPU
+    MeshData_Pack(mesh);
 }
 
-// Carrega um Vertex Shader de um arquivo GLSL. Veja definição de LoadShader() abaixo.
-GLuint LoadShader_Vertex(const char* filename)
+// Imprime as estatísticas de uma malha construída por BuildTriangles().
+void PrintMeshStats(const MeshData& mesh, const MeshOptimizationStats& stats)
 {
-    // Criamos um identificador (ID) para este shader, informando que o mesmo
-    // será aplicado nos vértices.
-    GLuint vertex_shader_id = glCreateShader(GL_VERTEX_SHADER);
+    if ( stats.optimized )
+        printf("Malha otimizada: %u triângulos, %u -> %u vértices, ACMR %.3f -> %.3f.\n",
+            (unsigned)stats.num_triangles, (unsigned)stats.vertices_before, (unsigned)stats.vertices_after,
+            stats.acmr_before, stats.acmr_after);
+    else
+        fprintf(stderr, "WARNING: Mesh not optimized: some vertices lack normals or texture coordinates.\n");
 
-    // Carregamos e compilamos o shader
-    LoadShader(filename, vertex_shader_id);
+    size_t float_bytes = (mesh.model_coefficients.size() + mesh.normal_coefficients.size() + mesh.texture_coefficients.size()) * sizeof(float);
+    size_t packed_bytes = mesh.vertices.size() * sizeof(PackedVertex);
+    printf("Vértices compactados: %.1f KB -> %.1f KB (%.0f%%).\n",
+        float_bytes / 1024.0, packed_bytes / 1024.0, float_bytes > 0 ? 100.0 * packed_bytes / float_bytes : 0.0);
 
-    // Retorna o ID gerado acima
-    return vertex_shader_id;
+    for (size_t i = 0; i < mesh.objects.size(); ++i)
+    {
+        const MeshObject& object = mesh.objects[i];
+        if ( object.num_lods <= 1 )
+            continue;
+
+        printf("Níveis de detalhe de \"%s\": %u", object.name.c_str(), (unsigned)(object.lods[0].num_indices / 3));
+        for (int lod = 1; lod < object.num_lods; ++lod)
+            printf(" -> %u", (unsigned)(object.lods[lod].num_indices / 3));
+        printf(" triângulos (erro %.4f).\n", object.lods[object.num_lods - 1].error);
+    }
 }
 
-// Carrega um Fragment Shader de um arquivo GLSL . Veja definição de LoadShader() abaixo.
-GLuint LoadShader_Fragment(const char* filename)
+// Envia para a GPU os vértices de uma malha (construída por BuildTriangles()
+// ou lida do cache binário) e adiciona seus objetos em g_VirtualScene.
+void AddMeshToVirtualScene(const MeshView& mesh)
 {
-    // Criamos um identificador (ID) para este shader, informando que o mesmo
-    // será aplicado nos fragmentos.
-    GLuint fragment_shader_id = glCreateShader(GL_FRAGMENT_SHADER);
+    // Os vértices e índices da malha são copiados para o final dos buffers
+    // compartilhados. Os índices continuam relativos ao primeiro vértice da
+    // malha, que é informado no desenho através de "base_vertex".
+    GLint  base_vertex;
+    size_t first_index;
+    SceneGeometry_Append(&g_SceneGeometry, mesh, &base_vertex, &first_index);
+
+    for (size_t i = 0; i < mesh.num_objects; ++i)
+    {
+        SceneObject theobject;
+        theobject.name           = mesh.objects[i].name;
+        theobject.first_index    = first_index + mesh.objects[i].first_index; // Primeiro índice
+        theobject.num_indices    = mesh.objects[i].num_indices; // Número de indices
+        theobject.rendering_mode = GL_TRIANGLES;       // Índices correspondem ao tipo de rasterização GL_TRIANGLES.
+        theobject.vertex_array_object_id = g_SceneGeometry.vertex_array_object_id;
+        theobject.base_vertex    = base_vertex;
 
-    // Carregamos e compilamos o shader
-    LoadShader(filename, fragment_shader_id);
+        theobject.bbox_min = mesh.objects[i].bbox_min;
+        theobject.bbox_max = mesh.objects[i].bbox_max;
 
-    // Retorna o ID gerado acima
-    return fragment_shader_id;
+        theobject.position_offset = mesh.quantization.offset;
+        theobject.position_scale  = mesh.quantization.scale;
+
+        theobject.num_lods = mesh.objects[i].num_lods;
+        for (int lod = 0; lod < theobject.num_lods; ++lod)
+        {
+            theobject.lods[lod] = mesh.objects[i].lods[lod];
+            theobject.lods[lod].first_index += first_index;
+        }
+
+        SceneRegistry_Add(&g_VirtualScene, theobject);
+    }
 }
 
-// Função auxilar, utilizada pelas duas funções acima. Carrega código de GPU de
-// um arquivo GLSL e faz sua compilação.
-void LoadShader(const char* filename, GLuint shader_id)
+// Submete a criação de um programa de GPU com os shaders dos arquivos
+// "vertex_filename" e "fragment_filename" (veja "shadermanager.h"), com as
+// linhas "defines" inseridas no início dos dois códigos. A função "on_ready"
+// é chamada, recebendo "permutation", quando o programa estiver pronto para
+// uso.
+int LoadGpuProgram(const char* name, const char* vertex_filename, const char* fragment_filename, ShaderProgramReady on_ready,
+                   const std::string& defines, int permutation)
+{
+    std::string vertex_source   = ShaderManager_AddDefines(LoadShaderSource(vertex_filename), defines);
+    std::string fragment_source = ShaderManager_AddDefines(LoadShaderSource(fragment_filename), defines);
+
+    return ShaderManager_Submit(name, vertex_filename, vertex_source, fragment_filename, fragment_source, on_ready, permutation);
+}
+
+// Lê o código de um arquivo GLSL. O programa é encerrado se o arquivo não
+// puder ser aberto.
+std::string LoadShaderSource(const char* filename)
 {
-    // Lemos o arquivo de texto indicado pela variável "filename"
-    // e colocamos seu conteúdo em memória, apontado pela variável
-    // "shader_string".
     std::ifstream file;
     try {
         file.exceptions(std::ifstream::failbit);
@@ -1996,108 +3278,7 @@ void LoadShader(const char* filename, GLuint shader_id)
     }
     std::stringstream shader;
     shader << file.rdbuf();
-    std::string str = shader.str();
-    const GLchar* shader_string = str.c_str();
-    const GLint   shader_string_length = static_cast<GLint>( str.length() );
-
-    // Define o código do shader GLSL, contido na string "shader_string"
-    glShaderSource(shader_id, 1, &shader_string, &shader_string_length);
-
-    // Compila o código do shader GLSL (em tempo de execução)
-    glCompileShader(shader_id);
-
-    // Verificamos se ocorreu algum erro ou "warning" durante a compilação
-    GLint compiled_ok;
-    glGetShaderiv(shader_id, GL_COMPILE_STATUS, &compiled_ok);
-
-    GLint log_length = 0;
-    glGetShaderiv(shader_id, GL_INFO_LOG_LENGTH, &log_length);
-
-    // Alocamos memória para guardar o log de compilação.
-    // A chamada "new" em C++ é equivalente ao "malloc()" do C.
-    GLchar* log = new GLchar[log_length];
-    glGetShaderInfoLog(shader_id, log_length, &log_length, log);
-
-    // Imprime no terminal qualquer erro ou "warning" de compilação
-    if ( log_length != 0 )
-    {
-        std::string  output;
-
-        if ( !compiled_ok )
-        {
-            output += "ERROR: OpenGL compilation of \"";
-            output += filename;
-            output += "\" failed.\n";
-            output += "== Start of compilation log\n";
-            output += log;
-            output += "== End of compilation log\n";
-        }
-        else
-        {
-            output += "WARNING: OpenGL compilation of \"";
-            output += filename;
-            output += "\".\n";
-            output += "== Start of compilation log\n";
-            output += log;
-            output += "== End of compilation log\n";
-        }
-
-        fprintf(stderr, "%s", output.c_str());
-    }
-
-    // A chamada "delete" em C++ é equivalente ao "free()" do C
-    delete [] log;
-}
-
-// Esta função cria um programa de GPU, o qual contém obrigatoriamente um
-// Vertex Shader e um Fragment Shader.
-GLuint CreateGpuProgram(GLuint vertex_shader_id, GLuint fragment_shader_id)
-{
-    // Criamos um identificador (ID) para este programa de GPU
-    GLuint program_id = glCreateProgram();
-
-    // Definição dos dois shaders GLSL que devem ser executados pelo programa
-    glAttachShader(program_id, vertex_shader_id);
-    glAttachShader(program_id, fragment_shader_id);
-
-    // Linkagem dos shaders acima ao programa
-    glLinkProgram(program_id);
-
-    // Verificamos se ocorreu algum erro durante a linkagem
-    GLint linked_ok = GL_FALSE;
-    glGetProgramiv(program_id, GL_LINK_STATUS, &linked_ok);
-
-    // Imprime no terminal qualquer erro de linkagem
-    if ( linked_ok == GL_FALSE )
-    {
-        GLint log_length = 0;
-        glGetProgramiv(program_id, GL_INFO_LOG_LENGTH, &log_length);
-
-        // Alocamos memória para guardar o log de compilação.
-        // A chamada "new" em C++ é equivalente ao "malloc()" do C.
-        GLchar* log = new GLchar[log_length];
-
-        glGetProgramInfoLog(program_id, log_length, &log_length, log);
-
-        std::string output;
-
-        output += "ERROR: OpenGL linking of program failed.\n";
-        output += "== Start of link log\n";
-        output += log;
-        output += "\n== End of link log\n";
-
-        // A chamada "delete" em C++ é equivalente ao "free()" do C
-        delete [] log;
-
-        fprintf(stderr, "%s", output.c_str());
-    }
-
-    // Os "Shader Objects" podem ser marcados para deleção após serem linkados
-    glDeleteShader(vertex_shader_id);
-    glDeleteShader(fragment_shader_id);
-
-    // Retornamos o ID gerado acima
-    return program_id;
+    return shader.str();
 }
 
 // Definição da função que será chamada sempre que a janela do sistema
@@ -2119,6 +3300,8 @@ void FramebufferSizeCallback(GLFWwindow* window, int width, int height)
     // O cast para float é necessário pois números inteiros são arredondados ao
     // serem divididos!
     g_ScreenRatio = (float)width / height;
+    g_ScreenWidth = width;
+    g_ScreenHeight = height;
 }
 
 // Variáveis globais que armazenam a última posição do cursor do mouse, para
@@ -2421,6 +3604,77 @@ void TextRendering_ShowFramesPerSecond(GLFWwindow* window)
     TextRendering_PrintString(window, buffer, 1.0f-(numchars + 1)*charwidth, 1.0f-lineheight, 1.0f);
 }
 
+// Escrevemos na tela o número de objetos e de desenhos da fila de desenhos no
+// último quadro, quantos objetos foram desenhados como instâncias de outros e
+// quantas trocas de estado do OpenGL ela fez e evitou.
+void TextRendering_ShowRenderQueueStats(GLFWwindow* window)
+{
+    if ( !g_ShowInfoText )
+        return;
+
+    const RenderQueueStats& stats = g_RenderQueue.stats;
+
+    char buffer[100];
+    int numchars = snprintf(buffer, 100, "%zu objects (%zu instanced), %zu draws, %zu state changes (%zu saved)",
+                            stats.packets, stats.instanced_packets, stats.draw_calls, stats.state_changes, stats.state_changes_saved);
+
+    float lineheight = TextRendering_LineHeight(window);
+    float charwidth = TextRendering_CharWidth(window);
+
+    TextRendering_PrintString(window, buffer, 1.0f-(numchars + 1)*charwidth, 1.0f-2*lineheight, 1.0f);
+}
+
+// Escrevemos na tela quantos objetos foram desenhados e quantos foram
+// descartados por estarem fora do campo de visão no último quadro.
+void TextRendering_ShowCullingStats(GLFWwindow* window)
+{
+    if ( !g_ShowInfoText )
+        return;
+
+    char buffer[80];
+    int numchars = snprintf(buffer, 80, "%zu visible, %zu culled (%zu boxes tested)",
+                            g_CullStats.visible, g_CullStats.culled, g_CullStats.boxes_tested);
+
+    float lineheight = TextRendering_LineHeight(window);
+    float charwidth = TextRendering_CharWidth(window);
+
+    TextRendering_PrintString(window, buffer, 1.0f-(numchars + 1)*charwidth, 1.0f-3*lineheight, 1.0f);
+}
+
+// Escrevemos na tela quantas luzes dinâmicas foram distribuídas nos clusters,
+// quantos clusters elas alcançam e o tamanho total das listas de luzes.
+void TextRendering_ShowLightStats(GLFWwindow* window)
+{
+    if ( !g_ShowInfoText )
+        return;
+
+    char buffer[80];
+    int numchars = snprintf(buffer, 80, "%zu lights, %zu lit clusters (%zu indices)",
+                            g_LightClusters.stats.lights, g_LightClusters.stats.lit_clusters, g_LightClusters.stats.indices);
+
+    float lineheight = TextRendering_LineHeight(window);
+    float charwidth = TextRendering_CharWidth(window);
+
+    TextRendering_PrintString(window, buffer, 1.0f-(numchars + 1)*charwidth, 1.0f-4*lineheight, 1.0f);
+}
+
+// Escrevemos na tela quantas vezes a camada estática do mapa de sombras da
+// lanterna foi redesenhada desde o início. Enquanto a lanterna se move pouco
+// o número não muda: a camada é reusada e apenas as caveiras são desenhadas.
+void TextRendering_ShowShadowStats(GLFWwindow* window)
+{
+    if ( !g_ShowInfoText )
+        return;
+
+    char buffer[80];
+    int numchars = snprintf(buffer, 80, "%zu static shadow layer renders", g_ShadowMap.static_renders);
+
+    float lineheight = TextRendering_LineHeight(window);
+    float charwidth = TextRendering_CharWidth(window);
+
+    TextRendering_PrintString(window, buffer, 1.0f-(numchars + 1)*charwidth, 1.0f-5*lineheight, 1.0f);
+}
+
 // Escrevemos na tela o número de segundos passados desde o início.
 void TextRendering_ShowSecondsEllapsed(GLFWwindow* window)
 {
@@ -2475,6 +3729,24 @@ void TextRendering_ShowCarTip(GLFWwindow* window, float estado_carro)
     TextRendering_PrintString(window, buffer, 0.0f-(numchars + 1)*charwidth, -0.2f+lineheight, 2.0f);
 }
 
+// Tela mostrada durante o carregamento dos assets. Veja LoadAssets().
+void TextRendering_ShowLoadingProgress(GLFWwindow* window, size_t loaded, size_t total)
+{
+    const int bar_length = 30;
+    int filled = total > 0 ? (int)(bar_length * loaded / total) : bar_length;
+
+    char buffer[200];
+    int numchars = snprintf(buffer, 200, "Carregando... %u/%u", (unsigned)loaded, (unsigned)total);
+
+    float lineheight = TextRendering_LineHeight(window);
+    float charwidth = TextRendering_CharWidth(window);
+
+    TextRendering_PrintString(window, buffer, -numchars*charwidth, lineheight, 2.0f);
+
+    std::string bar = "[" + std::string(filled, '#') + std::string(bar_length - filled, '.') + "]";
+    TextRendering_PrintString(window, bar, -(bar_length + 2)*charwidth, -lineheight, 2.0f);
+}
+
 // escrevendo na tela o menu
 
 void TextRendering_Menu(GLFWwindow* window, int mov_escrita){
@@ -0,0 +1,121 @@
+#include <cstdio>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
+#include "mappedfile.h"
+
+bool MapFile(const char* filename, MappedFile* file)
+{
+    *file = MappedFile();
+
+#ifdef _WIN32
+    HANDLE fh = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if ( fh == INVALID_HANDLE_VALUE )
+        return false;
+
+    LARGE_INTEGER size;
+    if ( !GetFileSizeEx(fh, &size) || size.QuadPart == 0 )
+    {
+        CloseHandle(fh);
+        return false;
+    }
+
+    HANDLE mapping = CreateFileMappingA(fh, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(fh);
+    if ( mapping == NULL )
+        return false;
+
+    void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if ( data == NULL )
+    {
+        CloseHandle(mapping);
+        return false;
+    }
+
+    file->data   = (const unsigned char*)data;
+    file->size   = (size_t)size.QuadPart;
+    file->handle = mapping;
+#else
+    int fd = open(filename, O_RDONLY);
+    if ( fd < 0 )
+        return false;
+
+    struct stat st;
+    if ( fstat(fd, &st) != 0 || st.st_size == 0 )
+    {
+        close(fd);
+        return false;
+    }
+
+    void* data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd); // O mapeamento continua válido após fecharmos o descritor
+    if ( data == MAP_FAILED )
+        return false;
+
+    file->data = (const unsigned char*)data;
+    file->size = (size_t)st.st_size;
+#endif
+
+    return true;
+}
+
+void UnmapFile(MappedFile* file)
+{
+    if ( file->data == NULL )
+        return;
+
+#ifdef _WIN32
+    UnmapViewOfFile(file->data);
+    CloseHandle((HANDLE)file->handle);
+#else
+    munmap((void*)file->data, file->size);
+#endif
+
+    *file = MappedFile();
+}
+
+bool GetFileStamp(const char* filename, FileStamp* stamp)
+{
+    struct stat st;
+    if ( stat(filename, &st) != 0 )
+        return false;
+
+    stamp->size  = (uint64_t)st.st_size;
+    stamp->mtime = (int64_t)st.st_mtime;
+    return true;
+}
+
+bool WriteFileAtomically(const std::string& filename, const void* const* chunks, const size_t* sizes, int count)
+{
+    // Escrevemos em um arquivo temporário e depois o renomeamos, para que uma
+    // execução interrompida nunca deixe um cache pela metade no disco.
+    std::string tmpname = filename + ".tmp";
+
+    FILE* f = fopen(tmpname.c_str(), "wb");
+    if ( f == NULL )
+        return false;
+
+    bool ok = true;
+    for (int i = 0; ok && i < count; ++i)
+        ok = sizes[i] == 0 || fwrite(chunks[i], 1, sizes[i], f) == sizes[i];
+    ok = (fclose(f) == 0) && ok;
+
+    if ( ok )
+    {
+        remove(filename.c_str());
+        ok = rename(tmpname.c_str(), filename.c_str()) == 0;
+    }
+    if ( !ok )
+        remove(tmpname.c_str());
+
+    return ok;
+}
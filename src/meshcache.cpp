@@ -0,0 +1,241 @@
+// Cache binário de malhas. O arquivo ".meshcache" guarda exatamente os
+// vetores produzidos por BuildTriangles() (índices e vértices compactados,
+// veja "vertexformat.h") e a lista de objetos nomeados, de forma
+// que nas execuções seguintes não é necessário interpretar o arquivo OBJ,
+// nem calcular normais ou triângulos: o arquivo é mapeado em memória e seus
+// dados são enviados diretamente para os VBOs.
+//
+// Layout do arquivo:
+//
+//    MeshCacheHeader
+//    MeshCacheObject[num_objects]
+//    GLuint       indices[num_indices]    (alinhado em 16 bytes)
+//    PackedVertex vertices[num_vertices]  (alinhado em 16 bytes)
+//
+#include <cstring>
+
+#include "meshcache.h"
+
+namespace
+{
+    const char MESHCACHE_MAGIC[8] = "FCGMESH";
+
+    struct MeshCacheHeader
+    {
+        char     magic[8];
+        uint32_t version;
+        uint32_t num_objects;
+        uint64_t source_size;  // Carimbo do arquivo OBJ de origem
+        int64_t  source_mtime;
+        uint64_t num_indices;
+        uint64_t num_vertices;
+        uint64_t objects_offset;
+        uint64_t indices_offset;
+        uint64_t vertices_offset;
+        float    quantization_offset[3];
+        float    quantization_scale[3];
+    };
+
+    struct MeshCacheObject
+    {
+        char     name[64];
+        uint64_t first_index;
+        uint64_t num_indices;
+        float    bbox_min[3];
+        float    bbox_max[3];
+        uint32_t num_lods;
+        uint64_t lod_first_index[MESH_MAX_LODS];
+        uint64_t lod_num_indices[MESH_MAX_LODS];
+        float    lod_error[MESH_MAX_LODS];
+    };
+
+    uint64_t Align16(uint64_t offset)
+    {
+        return (offset + 15) & ~(uint64_t)15;
+    }
+
+    // Verifica se o intervalo [offset, offset+count*elem) está dentro do arquivo
+    bool InsideFile(const MappedFile& file, uint64_t offset, uint64_t count, uint64_t elem)
+    {
+        if ( offset > file.size )
+            return false;
+        return count <= (file.size - offset) / elem;
+    }
+}
+
+void MeshData_Pack(MeshData* mesh)
+{
+    size_t num_vertices = mesh->model_coefficients.size() / 4;
+
+    // Normais e coordenadas de textura só são usadas se existirem para todos
+    // os vértices; veja BuildTriangles().
+    const float* normals   = (mesh->normal_coefficients.size() == 4*num_vertices) ? mesh->normal_coefficients.data() : NULL;
+    const float* texcoords = (mesh->texture_coefficients.size() == 2*num_vertices) ? mesh->texture_coefficients.data() : NULL;
+
+    mesh->quantization = ComputePositionQuantization(mesh->model_coefficients.data(), num_vertices);
+    mesh->vertices.resize(num_vertices);
+    PackVertices(mesh->model_coefficients.data(), normals, texcoords, num_vertices, mesh->quantization, mesh->vertices.data());
+}
+
+MeshView MeshData_View(const MeshData& mesh)
+{
+    MeshView view;
+    view.indices      = mesh.indices.data();
+    view.num_indices  = mesh.indices.size();
+    view.vertices     = mesh.vertices.data();
+    view.num_vertices = mesh.vertices.size();
+    view.quantization = mesh.quantization;
+    view.objects      = mesh.objects.data();
+    view.num_objects  = mesh.objects.size();
+    return view;
+}
+
+std::string MeshCache_Filename(const char* obj_filename)
+{
+    return std::string(obj_filename) + ".meshcache";
+}
+
+bool MeshCache_Load(const char* obj_filename, MeshCache* cache)
+{
+    FileStamp stamp;
+    if ( !GetFileStamp(obj_filename, &stamp) )
+        return false;
+
+    std::string filename = MeshCache_Filename(obj_filename);
+    if ( !MapFile(filename.c_str(), &cache->file) )
+        return false;
+
+    const MappedFile& file = cache->file;
+    const MeshCacheHeader* header = (const MeshCacheHeader*)file.data;
+
+    bool valid = file.size >= sizeof(MeshCacheHeader)
+              && memcmp(header->magic, MESHCACHE_MAGIC, sizeof(header->magic)) == 0
+              && header->version == MESHCACHE_VERSION
+              && header->source_size == stamp.size
+              && header->source_mtime == stamp.mtime
+              && InsideFile(file, header->objects_offset, header->num_objects, sizeof(MeshCacheObject))
+              && InsideFile(file, header->indices_offset, header->num_indices, sizeof(GLuint))
+              && InsideFile(file, header->vertices_offset, header->num_vertices, sizeof(PackedVertex));
+
+    if ( !valid )
+    {
+        MeshCache_Close(cache);
+        return false;
+    }
+
+    const MeshCacheObject* objects = (const MeshCacheObject*)(file.data + header->objects_offset);
+    cache->objects.resize(header->num_objects);
+    for (size_t i = 0; i < header->num_objects; ++i)
+    {
+        MeshObject& object = cache->objects[i];
+        object.name        = std::string(objects[i].name, strnlen(objects[i].name, sizeof(objects[i].name)));
+        object.first_index = objects[i].first_index;
+        object.num_indices = objects[i].num_indices;
+        object.bbox_min    = glm::vec3(objects[i].bbox_min[0], objects[i].bbox_min[1], objects[i].bbox_min[2]);
+        object.bbox_max    = glm::vec3(objects[i].bbox_max[0], objects[i].bbox_max[1], objects[i].bbox_max[2]);
+        object.num_lods    = objects[i].num_lods;
+
+        bool valid_object = object.first_index + object.num_indices <= header->num_indices
+                         && object.num_lods >= 1 && object.num_lods <= MESH_MAX_LODS;
+
+        for (int lod = 0; valid_object && lod < object.num_lods; ++lod)
+        {
+            object.lods[lod].first_index = objects[i].lod_first_index[lod];
+            object.lods[lod].num_indices = objects[i].lod_num_indices[lod];
+            object.lods[lod].error       = objects[i].lod_error[lod];
+            valid_object = object.lods[lod].first_index + object.lods[lod].num_indices <= header->num_indices;
+        }
+
+        if ( !valid_object )
+        {
+            MeshCache_Close(cache);
+            return false;
+        }
+    }
+
+    MeshView& view = cache->view;
+    view.indices      = (const GLuint*)(file.data + header->indices_offset);
+    view.num_indices  = header->num_indices;
+    view.vertices     = (const PackedVertex*)(file.data + header->vertices_offset);
+    view.num_vertices = header->num_vertices;
+    view.objects      = cache->objects.data();
+    view.num_objects  = cache->objects.size();
+    for (int k = 0; k < 3; ++k)
+    {
+        view.quantization.offset[k] = header->quantization_offset[k];
+        view.quantization.scale[k]  = header->quantization_scale[k];
+    }
+
+    return true;
+}
+
+void MeshCache_Close(MeshCache* cache)
+{
+    UnmapFile(&cache->file);
+    cache->objects.clear();
+    memset(&cache->view, 0, sizeof(cache->view));
+}
+
+bool MeshCache_Save(const char* obj_filename, const MeshView& mesh)
+{
+    FileStamp stamp;
+    if ( !GetFileStamp(obj_filename, &stamp) )
+        return false;
+
+    MeshCacheHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, MESHCACHE_MAGIC, sizeof(header.magic));
+    header.version                  = MESHCACHE_VERSION;
+    header.num_objects              = (uint32_t)mesh.num_objects;
+    header.source_size              = stamp.size;
+    header.source_mtime             = stamp.mtime;
+    header.num_indices              = mesh.num_indices;
+    header.num_vertices             = mesh.num_vertices;
+    header.objects_offset           = sizeof(MeshCacheHeader);
+    header.indices_offset           = Align16(header.objects_offset + mesh.num_objects * sizeof(MeshCacheObject));
+    header.vertices_offset          = Align16(header.indices_offset + mesh.num_indices * sizeof(GLuint));
+    uint64_t file_size              = header.vertices_offset + mesh.num_vertices * sizeof(PackedVertex);
+    for (int k = 0; k < 3; ++k)
+    {
+        header.quantization_offset[k] = mesh.quantization.offset[k];
+        header.quantization_scale[k]  = mesh.quantization.scale[k];
+    }
+
+    std::vector<unsigned char> buffer(file_size, 0);
+    memcpy(&buffer[0], &header, sizeof(header));
+
+    MeshCacheObject* objects = (MeshCacheObject*)&buffer[header.objects_offset];
+    for (size_t i = 0; i < mesh.num_objects; ++i)
+    {
+        const MeshObject& object = mesh.objects[i];
+
+        // Nomes que não cabem no registro de tamanho fixo não são suportados
+        if ( object.name.size() >= sizeof(objects[i].name) )
+            return false;
+
+        memcpy(objects[i].name, object.name.c_str(), object.name.size());
+        objects[i].first_index = object.first_index;
+        objects[i].num_indices = object.num_indices;
+        for (int k = 0; k < 3; ++k)
+        {
+            objects[i].bbox_min[k] = object.bbox_min[k];
+            objects[i].bbox_max[k] = object.bbox_max[k];
+        }
+        objects[i].num_lods = object.num_lods;
+        for (int lod = 0; lod < object.num_lods; ++lod)
+        {
+            objects[i].lod_first_index[lod] = object.lods[lod].first_index;
+            objects[i].lod_num_indices[lod] = object.lods[lod].num_indices;
+            objects[i].lod_error[lod]       = object.lods[lod].error;
+        }
+    }
+
+    if ( mesh.num_indices > 0 )
+        memcpy(&buffer[header.indices_offset], mesh.indices, mesh.num_indices * sizeof(GLuint));
+    if ( mesh.num_vertices > 0 )
+        memcpy(&buffer[header.vertices_offset], mesh.vertices, mesh.num_vertices * sizeof(PackedVertex));
+
+    const void* chunks[1] = { buffer.data() };
+    size_t      sizes[1]  = { buffer.size() };
+    return WriteFileAtomically(MeshCache_Filename(obj_filename), chunks, sizes, 1);
+}
@@ -0,0 +1,415 @@
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+#include <unordered_map>
+
+#include <glm/geometric.hpp>
+
+#include "meshlod.h"
+#include "meshoptimizer.h"
+
+namespace
+{
+    // Quádrica de erro: soma dos quadrados das distâncias a um conjunto de
+    // planos, ponderados pela área dos triângulos, guardada como a matriz
+    // simétrica 4x4 A = sum(w * p * p^T) com p = (a,b,c,d) (10 coeficientes).
+    struct Quadric
+    {
+        double a00, a01, a02, a03;
+        double      a11, a12, a13;
+        double           a22, a23;
+        double                a33;
+        double weight; // Soma das áreas, para que o erro seja uma distância média
+    };
+
+    void AddPlane(Quadric* q, double a, double b, double c, double d, double w)
+    {
+        q->a00 += w*a*a; q->a01 += w*a*b; q->a02 += w*a*c; q->a03 += w*a*d;
+        q->a11 += w*b*b; q->a12 += w*b*c; q->a13 += w*b*d;
+        q->a22 += w*c*c; q->a23 += w*c*d;
+        q->a33 += w*d*d;
+        q->weight += w;
+    }
+
+    void AddQuadric(Quadric* q, const Quadric& r)
+    {
+        q->a00 += r.a00; q->a01 += r.a01; q->a02 += r.a02; q->a03 += r.a03;
+        q->a11 += r.a11; q->a12 += r.a12; q->a13 += r.a13;
+        q->a22 += r.a22; q->a23 += r.a23;
+        q->a33 += r.a33;
+        q->weight += r.weight;
+    }
+
+    // v^T A v para v = (x,y,z,1)
+    double Evaluate(const Quadric& q, const glm::vec3& p)
+    {
+        double x = p.x, y = p.y, z = p.z;
+        return q.a00*x*x + 2*q.a01*x*y + 2*q.a02*x*z + 2*q.a03*x
+             + q.a11*y*y + 2*q.a12*y*z + 2*q.a13*y
+             + q.a22*z*z + 2*q.a23*z
+             + q.a33;
+    }
+
+    // Erro (distância quadrática média aos planos) de mover u para v
+    double CollapseCost(const Quadric& qu, const Quadric& qv, const glm::vec3& pv)
+    {
+        double weight = qu.weight + qv.weight;
+        double error  = Evaluate(qu, pv) + Evaluate(qv, pv);
+        return weight > 0.0 ? std::max(error, 0.0) / weight : 0.0;
+    }
+
+    struct PositionKey
+    {
+        float x, y, z;
+        bool operator==(const PositionKey& other) const { return memcmp(this, &other, sizeof(*this)) == 0; }
+    };
+
+    struct PositionKeyHash
+    {
+        size_t operator()(const PositionKey& key) const
+        {
+            uint32_t bits[3];
+            memcpy(bits, &key, sizeof(bits));
+            return (size_t)(bits[0] * 73856093u ^ bits[1] * 19349663u ^ bits[2] * 83492791u);
+        }
+    };
+
+    struct Collapse
+    {
+        GLuint r0; // Posição removida
+        GLuint r1; // Posição que a substitui
+        double cost;
+
+        bool operator<(const Collapse& other) const { return cost < other.cost; }
+    };
+}
+
+size_t SimplifyMesh(GLuint* destination, const GLuint* indices, size_t num_indices,
+                    const float* positions, size_t position_stride,
+                    size_t target_num_indices, float target_error, float* result_error)
+{
+    *result_error = 0.0f;
+    if ( num_indices == 0 )
+        return 0;
+
+    // Os vértices usados são renumerados localmente a partir do menor índice
+    GLuint first_vertex = *std::min_element(indices, indices + num_indices);
+    GLuint last_vertex  = *std::max_element(indices, indices + num_indices);
+    size_t num_vertices = last_vertex - first_vertex + 1;
+
+    std::vector<GLuint> current(num_indices);
+    for (size_t i = 0; i < num_indices; ++i)
+        current[i] = indices[i] - first_vertex;
+
+    std::vector<glm::vec3> position(num_vertices);
+    for (size_t v = 0; v < num_vertices; ++v)
+    {
+        const float* p = positions + (first_vertex + v) * position_stride;
+        position[v] = glm::vec3(p[0], p[1], p[2]);
+    }
+
+    // 1. Vértices com a mesma posição (costuras de normal ou de textura)
+    // compartilham um representante; a topologia e as quádricas são
+    // calculadas sobre os representantes. "wedge_list" guarda, para cada
+    // representante, os vértices usados naquela posição.
+    std::vector<GLuint> representative(num_vertices);
+    std::vector<size_t> wedge_offset(num_vertices + 1, 0);
+    std::vector<GLuint> wedge_list;
+    {
+        std::unordered_map<PositionKey, GLuint, PositionKeyHash> unique;
+        for (size_t v = 0; v < num_vertices; ++v)
+        {
+            PositionKey key = { position[v].x, position[v].y, position[v].z };
+            representative[v] = unique.insert(std::make_pair(key, (GLuint)v)).first->second;
+        }
+
+        std::vector<bool> used(num_vertices, false);
+        for (size_t i = 0; i < num_indices; ++i)
+            used[current[i]] = true;
+        for (size_t v = 0; v < num_vertices; ++v)
+            if ( used[v] )
+                wedge_offset[representative[v] + 1] += 1;
+        for (size_t v = 0; v < num_vertices; ++v)
+            wedge_offset[v + 1] += wedge_offset[v];
+        wedge_list.resize(wedge_offset[num_vertices]);
+        std::vector<size_t> fill(wedge_offset.begin(), wedge_offset.end() - 1);
+        for (size_t v = 0; v < num_vertices; ++v)
+            if ( used[v] )
+                wedge_list[fill[representative[v]]++] = (GLuint)v;
+    }
+
+    // 2. Arestas de borda (usadas por um único triângulo) e arestas
+    // não-manifold (usadas por mais de dois) travam os seus vértices.
+    std::vector<bool> locked(num_vertices, false);
+    {
+        std::unordered_map<uint64_t, int> edge_count;
+        for (size_t i = 0; i < num_indices; i += 3)
+        {
+            for (int k = 0; k < 3; ++k)
+            {
+                uint64_t a = representative[current[i + k]];
+                uint64_t b = representative[current[i + (k+1)%3]];
+                edge_count[std::min(a,b) << 32 | std::max(a,b)] += 1;
+            }
+        }
+        for (std::unordered_map<uint64_t, int>::const_iterator it = edge_count.begin(); it != edge_count.end(); ++it)
+        {
+            if ( it->second != 2 )
+            {
+                locked[it->first >> 32] = true;
+                locked[it->first & 0xffffffffu] = true;
+            }
+        }
+    }
+
+    // 3. Quádricas dos planos dos triângulos, acumuladas por posição
+    std::vector<Quadric> quadric(num_vertices);
+    memset(quadric.data(), 0, quadric.size() * sizeof(Quadric));
+    for (size_t i = 0; i < num_indices; i += 3)
+    {
+        const glm::vec3& a = position[current[i + 0]];
+        const glm::vec3& b = position[current[i + 1]];
+        const glm::vec3& c = position[current[i + 2]];
+
+        glm::vec3 n = glm::cross(b - a, c - a);
+        float length = glm::length(n);
+        if ( length == 0.0f )
+            continue;
+
+        n /= length;
+        double area = 0.5 * length;
+        for (int k = 0; k < 3; ++k)
+            AddPlane(&quadric[representative[current[i + k]]], n.x, n.y, n.z, -glm::dot(n, a), area);
+    }
+
+    // 4. Colapsos em passadas: a cada passada os colapsos candidatos são
+    // ordenados pelo custo e aplicados do mais barato para o mais caro, sem
+    // tocar duas vezes na mesma vizinhança, até atingir o número de índices
+    // desejado ou o erro máximo.
+    double max_cost = (double)target_error * (double)target_error;
+    double worst_cost = 0.0;
+
+    std::vector<size_t>   adjacency_offset(num_vertices + 1);
+    std::vector<size_t>   adjacency;
+    std::vector<Collapse> collapses;
+    std::vector<GLuint>   remap(num_vertices);
+    std::vector<GLuint>   partner(num_vertices);
+    std::vector<bool>     touched(num_vertices);
+
+    while ( current.size() > target_num_indices )
+    {
+        size_t num_triangles = current.size() / 3;
+
+        // Lista de adjacência vértice -> triângulos
+        std::fill(adjacency_offset.begin(), adjacency_offset.end(), 0);
+        for (size_t i = 0; i < current.size(); ++i)
+            adjacency_offset[current[i] + 1] += 1;
+        for (size_t v = 0; v < num_vertices; ++v)
+            adjacency_offset[v + 1] += adjacency_offset[v];
+        adjacency.resize(current.size());
+        std::vector<size_t> fill(adjacency_offset.begin(), adjacency_offset.end() - 1);
+        for (size_t t = 0; t < num_triangles; ++t)
+            for (int k = 0; k < 3; ++k)
+                adjacency[fill[current[3*t + k]]++] = t;
+
+        // Candidatos: arestas (entre posições) cuja origem pode ser removida
+        collapses.clear();
+        for (size_t i = 0; i < current.size(); i += 3)
+        {
+            for (int k = 0; k < 3; ++k)
+            {
+                for (int direction = 0; direction < 2; ++direction)
+                {
+                    GLuint r0 = representative[current[i + (direction == 0 ? k : (k+1)%3)]];
+                    GLuint r1 = representative[current[i + (direction == 0 ? (k+1)%3 : k)]];
+                    if ( locked[r0] )
+                        continue;
+
+                    Collapse collapse;
+                    collapse.r0   = r0;
+                    collapse.r1   = r1;
+                    collapse.cost = CollapseCost(quadric[r0], quadric[r1], position[r1]);
+                    collapses.push_back(collapse);
+                }
+            }
+        }
+        std::sort(collapses.begin(), collapses.end());
+
+        // Cada colapso interior remove cerca de dois triângulos
+        size_t needed = (num_triangles - target_num_indices / 3 + 1) / 2;
+        size_t performed = 0;
+
+        for (size_t v = 0; v < num_vertices; ++v)
+            remap[v] = (GLuint)v;
+        std::fill(touched.begin(), touched.end(), false);
+
+        for (size_t c = 0; c < collapses.size() && performed < needed; ++c)
+        {
+            const Collapse& collapse = collapses[c];
+            if ( collapse.cost > max_cost )
+                break;
+
+            GLuint r0 = collapse.r0;
+            GLuint r1 = collapse.r1;
+            if ( touched[r0] || touched[r1] )
+                continue;
+
+            // Todos os vértices na posição r0 são movidos juntos. Cada um
+            // deles passa a ser o único vértice da posição r1 com que ele
+            // compartilha algum triângulo, preservando assim os atributos
+            // (normais e coordenadas de textura) de cada lado de uma costura.
+            bool valid = true;
+            for (size_t w = wedge_offset[r0]; valid && w < wedge_offset[r0 + 1]; ++w)
+            {
+                GLuint v0 = wedge_list[w];
+                partner[v0] = v0;
+
+                for (size_t a = adjacency_offset[v0]; valid && a < adjacency_offset[v0 + 1]; ++a)
+                {
+                    const GLuint* tri = &current[3*adjacency[a]];
+                    for (int k = 0; k < 3; ++k)
+                    {
+                        if ( representative[tri[k]] != r1 )
+                            continue;
+                        if ( partner[v0] != v0 && partner[v0] != tri[k] )
+                            valid = false;
+                        partner[v0] = tri[k];
+                    }
+                }
+
+                // Vértices já removidos não possuem triângulos; os demais
+                // precisam de um vértice correspondente em r1.
+                if ( partner[v0] == v0 && adjacency_offset[v0] != adjacency_offset[v0 + 1] )
+                    valid = false;
+            }
+
+            // Os triângulos que não são eliminados não podem inverter a sua
+            // orientação
+            for (size_t w = wedge_offset[r0]; valid && w < wedge_offset[r0 + 1]; ++w)
+            {
+                GLuint v0 = wedge_list[w];
+                for (size_t a = adjacency_offset[v0]; valid && a < adjacency_offset[v0 + 1]; ++a)
+                {
+                    const GLuint* tri = &current[3*adjacency[a]];
+
+                    glm::vec3 p[3], q[3];
+                    bool has_r1 = false;
+                    for (int k = 0; k < 3; ++k)
+                    {
+                        p[k] = position[tri[k]];
+                        q[k] = (tri[k] == v0) ? position[r1] : p[k];
+                        has_r1 = has_r1 || representative[tri[k]] == r1;
+                    }
+                    if ( has_r1 )
+                        continue;
+
+                    glm::vec3 n_before = glm::cross(p[1] - p[0], p[2] - p[0]);
+                    glm::vec3 n_after  = glm::cross(q[1] - q[0], q[2] - q[0]);
+                    if ( glm::dot(n_before, n_after) <= 0.0f )
+                        valid = false;
+                }
+            }
+            if ( !valid )
+                continue;
+
+            for (size_t w = wedge_offset[r0]; w < wedge_offset[r0 + 1]; ++w)
+            {
+                GLuint v0 = wedge_list[w];
+                remap[v0] = partner[v0];
+
+                // A vizinhança de r0 só volta a ser considerada na próxima passada
+                for (size_t a = adjacency_offset[v0]; a < adjacency_offset[v0 + 1]; ++a)
+                    for (int k = 0; k < 3; ++k)
+                        touched[representative[current[3*adjacency[a] + k]]] = true;
+            }
+
+            AddQuadric(&quadric[r1], quadric[r0]);
+            worst_cost = std::max(worst_cost, collapse.cost);
+            performed += 1;
+        }
+
+        if ( performed == 0 )
+            break;
+
+
+        // Aplicamos os colapsos e removemos os triângulos degenerados
+        size_t write = 0;
+        for (size_t i = 0; i < current.size(); i += 3)
+        {
+            GLuint a = remap[current[i + 0]];
+            GLuint b = remap[current[i + 1]];
+            GLuint c = remap[current[i + 2]];
+            if ( representative[a] == representative[b]
+              || representative[b] == representative[c]
+              || representative[c] == representative[a] )
+                continue;
+
+            current[write++] = a;
+            current[write++] = b;
+            current[write++] = c;
+        }
+        current.resize(write);
+    }
+
+    for (size_t i = 0; i < current.size(); ++i)
+        destination[i] = current[i] + first_vertex;
+
+    *result_error = (float)sqrt(worst_cost);
+    return current.size();
+}
+
+void GenerateMeshLods(MeshData* mesh)
+{
+    std::vector<GLuint> lod_indices;
+
+    for (size_t o = 0; o < mesh->objects.size(); ++o)
+    {
+        MeshObject& object = mesh->objects[o];
+        object.num_lods = 1;
+        object.lods[0].first_index = object.first_index;
+        object.lods[0].num_indices = object.num_indices;
+        object.lods[0].error       = 0.0f;
+
+        if ( object.num_indices / 3 < MESH_LOD_MIN_TRIANGLES )
+            continue;
+
+        const GLuint* source = &mesh->indices[object.first_index];
+        float max_error = MESH_LOD_MAX_ERROR * glm::length(object.bbox_max - object.bbox_min);
+        std::vector<GLuint> simplified(object.num_indices);
+
+        for (int lod = 1; lod < MESH_MAX_LODS; ++lod)
+        {
+            // Sempre a partir da malha original, para que os erros não se acumulem
+            size_t target = (object.num_indices >> lod) / 3 * 3;
+            float  error;
+            size_t count = SimplifyMesh(simplified.data(), source, object.num_indices,
+                                        mesh->model_coefficients.data(), 4, target, max_error, &error);
+
+            // Níveis que quase não reduzem o número de triângulos não compensam
+            const MeshLod& previous = object.lods[lod - 1];
+            if ( count == 0 || count > previous.num_indices * 3 / 4 )
+                break;
+
+            // Ordenação dos triângulos para a cache de vértices, sobre os
+            // vértices do objeto renumerados a partir de zero
+            GLuint first_vertex = *std::min_element(simplified.begin(), simplified.begin() + count);
+            GLuint last_vertex  = *std::max_element(simplified.begin(), simplified.begin() + count);
+            for (size_t i = 0; i < count; ++i)
+                simplified[i] -= first_vertex;
+            OptimizeVertexCache(simplified.data(), count, last_vertex - first_vertex + 1);
+            for (size_t i = 0; i < count; ++i)
+                simplified[i] += first_vertex;
+
+            MeshLod& level = object.lods[lod];
+            level.first_index = mesh->indices.size() + lod_indices.size();
+            level.num_indices = count;
+            level.error       = error;
+            lod_indices.insert(lod_indices.end(), simplified.begin(), simplified.begin() + count);
+            object.num_lods = lod + 1;
+        }
+    }
+
+    mesh->indices.insert(mesh->indices.end(), lod_indices.begin(), lod_indices.end());
+}
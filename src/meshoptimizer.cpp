@@ -0,0 +1,348 @@
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#include <unordered_map>
+
+#include "meshoptimizer.h"
+
+namespace
+{
+    // Parâmetros do algoritmo de Forsyth, com os valores sugeridos no artigo.
+    const int   FORSYTH_CACHE_SIZE = 32;
+    const float FORSYTH_CACHE_DECAY_POWER = 1.5f;
+    const float FORSYTH_LAST_TRI_SCORE = 0.75f;
+    const float FORSYTH_VALENCE_BOOST_SCALE = 2.0f;
+    const float FORSYTH_VALENCE_BOOST_POWER = 0.5f;
+    const int   FORSYTH_MAX_VALENCE = 64; // Valências maiores usam o valor da última entrada da tabela
+
+    // Tabelas de pontuação por posição na cache e por número de triângulos
+    // restantes do vértice
+    struct ScoreTables
+    {
+        float cache[FORSYTH_CACHE_SIZE];
+        float valence[FORSYTH_MAX_VALENCE];
+
+        ScoreTables()
+        {
+            for (int i = 0; i < FORSYTH_CACHE_SIZE; ++i)
+            {
+                // Os três vértices do último triângulo recebem um valor fixo, para
+                // não favorecer a ordem em que foram inseridos na cache.
+                if ( i < 3 )
+                    cache[i] = FORSYTH_LAST_TRI_SCORE;
+                else
+                    cache[i] = powf(1.0f - (i - 3) / (float)(FORSYTH_CACHE_SIZE - 3), FORSYTH_CACHE_DECAY_POWER);
+            }
+
+            valence[0] = 0.0f;
+            for (int i = 1; i < FORSYTH_MAX_VALENCE; ++i)
+                valence[i] = FORSYTH_VALENCE_BOOST_SCALE * powf((float)i, -FORSYTH_VALENCE_BOOST_POWER);
+        }
+    };
+
+    float VertexScore(const ScoreTables& tables, int cache_position, int remaining_triangles)
+    {
+        // Vértices sem triângulos restantes não influenciam mais a escolha
+        if ( remaining_triangles == 0 )
+            return -1.0f;
+
+        float score = 0.0f;
+        if ( cache_position >= 0 )
+            score = tables.cache[cache_position];
+
+        score += tables.valence[std::min(remaining_triangles, FORSYTH_MAX_VALENCE - 1)];
+        return score;
+    }
+
+    // Chave usada na soldagem: bits da posição, da normal e da coordenada de
+    // textura de um vértice.
+    struct VertexKey
+    {
+        uint32_t bits[8];
+
+        bool operator==(const VertexKey& other) const
+        {
+            return memcmp(bits, other.bits, sizeof(bits)) == 0;
+        }
+    };
+
+    struct VertexKeyHash
+    {
+        size_t operator()(const VertexKey& key) const
+        {
+            // FNV-1a sobre as oito palavras da chave
+            uint32_t hash = 2166136261u;
+            for (int i = 0; i < 8; ++i)
+            {
+                hash ^= key.bits[i];
+                hash *= 16777619u;
+            }
+            return hash;
+        }
+    };
+
+    uint32_t FloatBits(float value)
+    {
+        // -0.0 e +0.0 representam o mesmo vértice
+        if ( value == 0.0f )
+            value = 0.0f;
+
+        uint32_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        return bits;
+    }
+}
+
+float ComputeACMR(const GLuint* indices, size_t num_indices, size_t num_vertices)
+{
+    if ( num_indices < 3 )
+        return 0.0f;
+
+    // Cache FIFO simulada com "carimbos": um vértice está na cache se foi
+    // inserido há menos de MESHOPT_ACMR_CACHE_SIZE inserções.
+    std::vector<size_t> timestamp(num_vertices, 0);
+    size_t time = MESHOPT_ACMR_CACHE_SIZE + 1;
+    size_t misses = 0;
+
+    for (size_t i = 0; i < num_indices; ++i)
+    {
+        GLuint v = indices[i];
+        if ( time - timestamp[v] > MESHOPT_ACMR_CACHE_SIZE )
+        {
+            timestamp[v] = time++;
+            misses += 1;
+        }
+    }
+
+    return (float)misses / (float)(num_indices / 3);
+}
+
+void OptimizeVertexCache(GLuint* indices, size_t num_indices, size_t num_vertices)
+{
+    // Variável local estática: inicializada uma única vez, mesmo que várias
+    // threads de trabalho chamem esta função ao mesmo tempo.
+    static const ScoreTables tables;
+
+    size_t num_triangles = num_indices / 3;
+    if ( num_triangles == 0 )
+        return;
+
+    // Lista de adjacência vértice -> triângulos. Os primeiros
+    // remaining[v] triângulos de cada vértice são os ainda não emitidos.
+    std::vector<size_t> adjacency_offset(num_vertices + 1, 0);
+    std::vector<int>    remaining(num_vertices, 0);
+    for (size_t i = 0; i < num_indices; ++i)
+        remaining[indices[i]] += 1;
+    for (size_t v = 0; v < num_vertices; ++v)
+        adjacency_offset[v+1] = adjacency_offset[v] + remaining[v];
+
+    std::vector<size_t> adjacency(num_indices);
+    std::vector<size_t> fill(adjacency_offset.begin(), adjacency_offset.end() - 1);
+    for (size_t t = 0; t < num_triangles; ++t)
+        for (size_t k = 0; k < 3; ++k)
+            adjacency[fill[indices[3*t + k]]++] = t;
+
+    std::vector<int>   cache_position(num_vertices, -1);
+    std::vector<float> vertex_score(num_vertices);
+    for (size_t v = 0; v < num_vertices; ++v)
+        vertex_score[v] = VertexScore(tables, -1, remaining[v]);
+
+    std::vector<float> triangle_score(num_triangles);
+    std::vector<bool>  triangle_added(num_triangles, false);
+    for (size_t t = 0; t < num_triangles; ++t)
+        triangle_score[t] = vertex_score[indices[3*t + 0]]
+                          + vertex_score[indices[3*t + 1]]
+                          + vertex_score[indices[3*t + 2]];
+
+    std::vector<GLuint> output;
+    output.reserve(num_indices);
+
+    std::vector<GLuint> cache, new_cache;
+    cache.reserve(FORSYTH_CACHE_SIZE + 3);
+    new_cache.reserve(FORSYTH_CACHE_SIZE + 3);
+
+    long   best_triangle = 0;
+    size_t cursor = 0; // Usado para recomeçar quando não há candidatos na cache
+    for (size_t t = 1; t < num_triangles; ++t)
+        if ( triangle_score[t] > triangle_score[best_triangle] )
+            best_triangle = t;
+
+    for (size_t emitted = 0; emitted < num_triangles; ++emitted)
+    {
+        if ( best_triangle < 0 )
+        {
+            // "Beco sem saída": nenhum triângulo adjacente à cache. Seguimos
+            // para o próximo triângulo ainda não emitido.
+            while ( triangle_added[cursor] )
+                cursor += 1;
+            best_triangle = cursor;
+        }
+
+        const GLuint* tri = &indices[3*best_triangle];
+        output.push_back(tri[0]);
+        output.push_back(tri[1]);
+        output.push_back(tri[2]);
+        triangle_added[best_triangle] = true;
+
+        // Removemos o triângulo da lista de triângulos restantes dos vértices
+        for (size_t k = 0; k < 3; ++k)
+        {
+            GLuint v = tri[k];
+            size_t* list = &adjacency[adjacency_offset[v]];
+            for (int j = 0; j < remaining[v]; ++j)
+            {
+                if ( list[j] == (size_t)best_triangle )
+                {
+                    std::swap(list[j], list[remaining[v] - 1]);
+                    break;
+                }
+            }
+            remaining[v] -= 1;
+        }
+
+        // Atualizamos a cache LRU: os vértices do triângulo vão para o início
+        new_cache.clear();
+        new_cache.push_back(tri[0]);
+        new_cache.push_back(tri[1]);
+        new_cache.push_back(tri[2]);
+        for (size_t i = 0; i < cache.size(); ++i)
+            if ( cache[i] != tri[0] && cache[i] != tri[1] && cache[i] != tri[2] )
+                new_cache.push_back(cache[i]);
+
+        for (size_t i = 0; i < new_cache.size(); ++i)
+        {
+            GLuint v = new_cache[i];
+            cache_position[v] = (i < (size_t)FORSYTH_CACHE_SIZE) ? (int)i : -1;
+            vertex_score[v] = VertexScore(tables, cache_position[v], remaining[v]);
+        }
+
+        // Recalculamos os valores dos triângulos afetados e escolhemos o
+        // próximo triângulo entre eles.
+        best_triangle = -1;
+        float best_score = -1.0f;
+        for (size_t i = 0; i < new_cache.size(); ++i)
+        {
+            GLuint v = new_cache[i];
+            const size_t* list = &adjacency[adjacency_offset[v]];
+            for (int j = 0; j < remaining[v]; ++j)
+            {
+                size_t t = list[j];
+                float score = vertex_score[indices[3*t + 0]]
+                            + vertex_score[indices[3*t + 1]]
+                            + vertex_score[indices[3*t + 2]];
+                triangle_score[t] = score;
+                if ( score > best_score )
+                {
+                    best_score = score;
+                    best_triangle = t;
+                }
+            }
+        }
+
+        if ( new_cache.size() > (size_t)FORSYTH_CACHE_SIZE )
+            new_cache.resize(FORSYTH_CACHE_SIZE);
+        cache.swap(new_cache);
+    }
+
+    std::copy(output.begin(), output.end(), indices);
+}
+
+void OptimizeMesh(MeshData* mesh, MeshOptimizationStats* stats)
+{
+    size_t num_vertices = mesh->model_coefficients.size() / 4;
+    bool has_normals  = mesh->normal_coefficients.size()  == 4*num_vertices;
+    bool has_texcoords = mesh->texture_coefficients.size() == 2*num_vertices;
+
+    stats->optimized       = false;
+    stats->num_triangles   = mesh->indices.size() / 3;
+    stats->vertices_before = num_vertices;
+    stats->acmr_before     = ComputeACMR(mesh->indices.data(), mesh->indices.size(), num_vertices);
+
+    // Malhas onde só parte dos vértices possui normais ou coordenadas de
+    // textura não podem ser soldadas; estas são mantidas como estão.
+    if ( (!has_normals && !mesh->normal_coefficients.empty())
+      || (!has_texcoords && !mesh->texture_coefficients.empty()) )
+    {
+        stats->vertices_after = stats->vertices_before;
+        stats->acmr_after     = stats->acmr_before;
+        return;
+    }
+
+    std::vector<GLuint> indices;
+    std::vector<float>  model_coefficients;
+    std::vector<float>  normal_coefficients;
+    std::vector<float>  texture_coefficients;
+    indices.reserve(mesh->indices.size());
+
+    for (size_t o = 0; o < mesh->objects.size(); ++o)
+    {
+        MeshObject& object = mesh->objects[o];
+
+        // 1. Soldagem: cada combinação distinta de atributos vira um único
+        // vértice local do objeto.
+        std::unordered_map<VertexKey, GLuint, VertexKeyHash> unique;
+        unique.reserve(object.num_indices);
+        std::vector<GLuint> source_vertex; // Vértice original de cada vértice local
+        std::vector<GLuint> local_indices(object.num_indices);
+
+        for (size_t i = 0; i < object.num_indices; ++i)
+        {
+            GLuint v = mesh->indices[object.first_index + i];
+
+            VertexKey key;
+            memset(&key, 0, sizeof(key));
+            for (int k = 0; k < 3; ++k)
+                key.bits[k] = FloatBits(mesh->model_coefficients[4*v + k]);
+            if ( has_normals )
+                for (int k = 0; k < 3; ++k)
+                    key.bits[3 + k] = FloatBits(mesh->normal_coefficients[4*v + k]);
+            if ( has_texcoords )
+                for (int k = 0; k < 2; ++k)
+                    key.bits[6 + k] = FloatBits(mesh->texture_coefficients[2*v + k]);
+
+            std::pair<std::unordered_map<VertexKey, GLuint, VertexKeyHash>::iterator, bool> inserted =
+                unique.insert(std::make_pair(key, (GLuint)source_vertex.size()));
+            if ( inserted.second )
+                source_vertex.push_back(v);
+
+            local_indices[i] = inserted.first->second;
+        }
+
+        // 2. Ordem dos triângulos para a cache pós-transformação
+        OptimizeVertexCache(local_indices.data(), local_indices.size(), source_vertex.size());
+
+        // 3. Vértices renumerados na ordem de primeiro uso
+        const GLuint unused = (GLuint)-1;
+        std::vector<GLuint> remap(source_vertex.size(), unused);
+        GLuint base_vertex = model_coefficients.size() / 4;
+        GLuint next_vertex = 0;
+
+        object.first_index = indices.size();
+        for (size_t i = 0; i < local_indices.size(); ++i)
+        {
+            GLuint local = local_indices[i];
+            if ( remap[local] == unused )
+            {
+                remap[local] = next_vertex++;
+
+                GLuint v = source_vertex[local];
+                model_coefficients.insert(model_coefficients.end(), &mesh->model_coefficients[4*v], &mesh->model_coefficients[4*v] + 4);
+                if ( has_normals )
+                    normal_coefficients.insert(normal_coefficients.end(), &mesh->normal_coefficients[4*v], &mesh->normal_coefficients[4*v] + 4);
+                if ( has_texcoords )
+                    texture_coefficients.insert(texture_coefficients.end(), &mesh->texture_coefficients[2*v], &mesh->texture_coefficients[2*v] + 2);
+            }
+            indices.push_back(base_vertex + remap[local]);
+        }
+    }
+
+    stats->optimized = true;
+
+    mesh->indices.swap(indices);
+    mesh->model_coefficients.swap(model_coefficients);
+    mesh->normal_coefficients.swap(normal_coefficients);
+    mesh->texture_coefficients.swap(texture_coefficients);
+
+    stats->vertices_after = mesh->model_coefficients.size() / 4;
+    stats->acmr_after     = ComputeACMR(mesh->indices.data(), mesh->indices.size(), stats->vertices_after);
+}
@@ -0,0 +1,186 @@
+#include <cmath>
+#include <thread>
+#include <functional>
+#include <vector>
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define NORMALS_USE_SSE 1
+#else
+#define NORMALS_USE_SSE 0
+#endif
+
+#include "normals.h"
+
+namespace
+{
+    // Vetores SoA com uma componente por vértice
+    struct Vec3Array
+    {
+        std::vector<float> x, y, z;
+
+        void Resize(size_t n)
+        {
+            x.assign(n, 0.0f);
+            y.assign(n, 0.0f);
+            z.assign(n, 0.0f);
+        }
+    };
+
+    // Soma em "sum" as normais (não normalizadas) dos triângulos [begin, end)
+    void AccumulateFaceNormals(const Vec3Array& p, const unsigned int* triangles, size_t begin, size_t end, Vec3Array* sum)
+    {
+        const float* px = p.x.data();
+        const float* py = p.y.data();
+        const float* pz = p.z.data();
+        float* nx = sum->x.data();
+        float* ny = sum->y.data();
+        float* nz = sum->z.data();
+
+        size_t t = begin;
+
+#if NORMALS_USE_SSE
+        // Quatro triângulos por iteração: cada registrador guarda a mesma
+        // componente de quatro triângulos diferentes.
+        for (; t + 4 <= end; t += 4)
+        {
+            const unsigned int* tri = triangles + 3*t;
+
+            __m128 ax = _mm_setr_ps(px[tri[0]], px[tri[3]], px[tri[6]], px[tri[9]]);
+            __m128 ay = _mm_setr_ps(py[tri[0]], py[tri[3]], py[tri[6]], py[tri[9]]);
+            __m128 az = _mm_setr_ps(pz[tri[0]], pz[tri[3]], pz[tri[6]], pz[tri[9]]);
+
+            __m128 ux = _mm_sub_ps(_mm_setr_ps(px[tri[1]], px[tri[4]], px[tri[7]], px[tri[10]]), ax);
+            __m128 uy = _mm_sub_ps(_mm_setr_ps(py[tri[1]], py[tri[4]], py[tri[7]], py[tri[10]]), ay);
+            __m128 uz = _mm_sub_ps(_mm_setr_ps(pz[tri[1]], pz[tri[4]], pz[tri[7]], pz[tri[10]]), az);
+
+            __m128 vx = _mm_sub_ps(_mm_setr_ps(px[tri[2]], px[tri[5]], px[tri[8]], px[tri[11]]), ax);
+            __m128 vy = _mm_sub_ps(_mm_setr_ps(py[tri[2]], py[tri[5]], py[tri[8]], py[tri[11]]), ay);
+            __m128 vz = _mm_sub_ps(_mm_setr_ps(pz[tri[2]], pz[tri[5]], pz[tri[8]], pz[tri[11]]), az);
+
+            // Produto vetorial u x v
+            float cx[4], cy[4], cz[4];
+            _mm_storeu_ps(cx, _mm_sub_ps(_mm_mul_ps(uy, vz), _mm_mul_ps(uz, vy)));
+            _mm_storeu_ps(cy, _mm_sub_ps(_mm_mul_ps(uz, vx), _mm_mul_ps(ux, vz)));
+            _mm_storeu_ps(cz, _mm_sub_ps(_mm_mul_ps(ux, vy), _mm_mul_ps(uy, vx)));
+
+            for (int k = 0; k < 4; ++k)
+            {
+                for (int vertex = 0; vertex < 3; ++vertex)
+                {
+                    unsigned int i = tri[3*k + vertex];
+                    nx[i] += cx[k];
+                    ny[i] += cy[k];
+                    nz[i] += cz[k];
+                }
+            }
+        }
+#endif
+
+        for (; t < end; ++t)
+        {
+            const unsigned int* tri = triangles + 3*t;
+            unsigned int a = tri[0], b = tri[1], c = tri[2];
+
+            float ux = px[b] - px[a], uy = py[b] - py[a], uz = pz[b] - pz[a];
+            float vx = px[c] - px[a], vy = py[c] - py[a], vz = pz[c] - pz[a];
+
+            float cx = uy*vz - uz*vy;
+            float cy = uz*vx - ux*vz;
+            float cz = ux*vy - uy*vx;
+
+            for (int vertex = 0; vertex < 3; ++vertex)
+            {
+                unsigned int i = tri[vertex];
+                nx[i] += cx;
+                ny[i] += cy;
+                nz[i] += cz;
+            }
+        }
+    }
+
+    // Soma as normais acumuladas por cada thread para os vértices
+    // [begin, end), normaliza o resultado e o escreve em "normals".
+    void ReduceAndNormalize(const std::vector<Vec3Array>& sums, size_t begin, size_t end, float* normals)
+    {
+        for (size_t i = begin; i < end; ++i)
+        {
+            float x = 0.0f, y = 0.0f, z = 0.0f;
+            for (size_t s = 0; s < sums.size(); ++s)
+            {
+                x += sums[s].x[i];
+                y += sums[s].y[i];
+                z += sums[s].z[i];
+            }
+
+            float length = sqrtf(x*x + y*y + z*z);
+            float scale  = (length > 0.0f) ? 1.0f / length : 0.0f;
+            normals[3*i + 0] = x * scale;
+            normals[3*i + 1] = y * scale;
+            normals[3*i + 2] = z * scale;
+        }
+    }
+}
+
+void ComputeVertexNormals(const float* positions, size_t num_vertices,
+                          const unsigned int* triangles, size_t num_triangles,
+                          float* normals, int num_threads)
+{
+    if ( num_threads <= 0 )
+        num_threads = (int)std::thread::hardware_concurrency();
+    size_t max_threads = std::max<size_t>(1, num_triangles / NORMALS_MIN_TRIANGLES_PER_THREAD);
+    size_t threads = std::max<size_t>(1, std::min<size_t>((size_t)std::max(num_threads, 1), max_threads));
+
+    // Conversão das posições para o layout SoA
+    Vec3Array p;
+    p.x.resize(num_vertices);
+    p.y.resize(num_vertices);
+    p.z.resize(num_vertices);
+    for (size_t i = 0; i < num_vertices; ++i)
+    {
+        p.x[i] = positions[3*i + 0];
+        p.y[i] = positions[3*i + 1];
+        p.z[i] = positions[3*i + 2];
+    }
+
+    std::vector<Vec3Array> sums(threads);
+    for (size_t s = 0; s < threads; ++s)
+        sums[s].Resize(num_vertices);
+
+    if ( threads == 1 )
+    {
+        AccumulateFaceNormals(p, triangles, 0, num_triangles, &sums[0]);
+        ReduceAndNormalize(sums, 0, num_vertices, normals);
+        return;
+    }
+
+    // 1. Cada thread acumula as normais de uma faixa de triângulos nos seus
+    // próprios vetores. A thread que chamou a função processa a última faixa.
+    std::vector<std::thread> workers;
+    for (size_t s = 0; s < threads; ++s)
+    {
+        size_t begin = num_triangles * s / threads;
+        size_t end   = num_triangles * (s + 1) / threads;
+        if ( s + 1 < threads )
+            workers.push_back(std::thread(AccumulateFaceNormals, std::cref(p), triangles, begin, end, &sums[s]));
+        else
+            AccumulateFaceNormals(p, triangles, begin, end, &sums[s]);
+    }
+    for (size_t s = 0; s < workers.size(); ++s)
+        workers[s].join();
+    workers.clear();
+
+    // 2. Cada thread soma e normaliza uma faixa de vértices.
+    for (size_t s = 0; s < threads; ++s)
+    {
+        size_t begin = num_vertices * s / threads;
+        size_t end   = num_vertices * (s + 1) / threads;
+        if ( s + 1 < threads )
+            workers.push_back(std::thread(ReduceAndNormalize, std::cref(sums), begin, end, normals));
+        else
+            ReduceAndNormalize(sums, begin, end, normals);
+    }
+    for (size_t s = 0; s < workers.size(); ++s)
+        workers[s].join();
+}
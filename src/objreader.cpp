@@ -0,0 +1,855 @@
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <map>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+#include <algorithm>
+
+#include "objreader.h"
+#include "mappedfile.h"
+
+namespace
+{
+    // Índice de um vértice de face como aparece no arquivo. Índices positivos
+    // já são convertidos para base zero. Índices negativos são relativos ao
+    // número de elementos definidos antes da linha, mas cada trecho só
+    // conhece os seus próprios elementos: o bit correspondente em "relative"
+    // indica que o índice ainda precisa ser somado ao número de elementos
+    // definidos pelos trechos anteriores.
+    struct RawIndex
+    {
+        int           v, vt, vn;
+        unsigned char relative;
+    };
+
+    enum
+    {
+        RELATIVE_V  = 1,
+        RELATIVE_VT = 2,
+        RELATIVE_VN = 4
+    };
+
+    // Comandos que definem a divisão em shapes, os materiais e os grupos de
+    // suavização. São aplicados na segunda etapa de ReadObj(), na ordem do
+    // arquivo, antes da face de número "face" do trecho.
+    enum CommandType
+    {
+        COMMAND_OBJECT,    // "o nome"
+        COMMAND_GROUP,     // "g nome [nome ...]"
+        COMMAND_USEMTL,    // "usemtl material"
+        COMMAND_MTLLIB,    // "mtllib arquivo [arquivo ...]"
+        COMMAND_SMOOTHING  // "s id" ou "s off"
+    };
+
+    struct Command
+    {
+        CommandType  type;
+        size_t       face;
+        std::string  argument;
+        unsigned int smoothing_id;
+    };
+
+    // Resultado da leitura de um trecho do arquivo
+    struct Chunk
+    {
+        const char* begin;
+        const char* end;
+
+        std::vector<float>    v;  // 3 floats por posição
+        std::vector<float>    vc; // 3 floats (cor) por posição
+        std::vector<float>    vn; // 3 floats por normal
+        std::vector<float>    vt; // 2 floats por coordenada de textura
+        std::vector<RawIndex> face_vertices;
+        std::vector<int>      face_sizes;
+        std::vector<Command>  commands;
+
+        size_t      num_lines;
+        size_t      num_zero_indices; // Índices "0" de normal ou textura
+        const char* error;            // Mensagem de erro, ou NULL
+    };
+
+    inline bool IsSpace(char c)
+    {
+        return c == ' ' || c == '\t';
+    }
+
+    inline bool IsDigit(char c)
+    {
+        return c >= '0' && c <= '9';
+    }
+
+    inline void SkipSpaces(const char*& p, const char* end)
+    {
+        while ( p < end && IsSpace(*p) )
+            ++p;
+    }
+
+    inline void SkipToken(const char*& p, const char* end)
+    {
+        while ( p < end && !IsSpace(*p) )
+            ++p;
+    }
+
+    // Equivalente a atoi(): lê um inteiro com sinal opcional, ou retorna 0
+    // se não houver dígitos.
+    inline int ParseInt(const char*& p, const char* end)
+    {
+        bool negative = false;
+        if ( p < end && (*p == '-' || *p == '+') )
+        {
+            negative = (*p == '-');
+            ++p;
+        }
+
+        int value = 0;
+        while ( p < end && IsDigit(*p) )
+        {
+            value = 10*value + (*p - '0');
+            ++p;
+        }
+        return negative ? -value : value;
+    }
+
+    const double POWERS_OF_10[] =
+    {
+        1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+
+    // Lê um número real no formato [+-]ddd[.ddd][(e|E)[+-]ddd]. Os dígitos
+    // significativos (até 19) são acumulados em um inteiro, que é escalado
+    // por uma única multiplicação ou divisão por potência de 10; para os
+    // números de um arquivo OBJ (até ~15 dígitos e expoentes pequenos) o
+    // resultado é o mesmo de strtod(). Como na tinyobjloader, o token
+    // inteiro é consumido, e se ele não for um número válido retornamos false
+    // e "value" não é alterado.
+    inline bool ParseFloat(const char*& p, const char* end, float* value)
+    {
+        SkipSpaces(p, end);
+        const char* token_end = p;
+        SkipToken(token_end, end);
+
+        const char* s = p;
+        p = token_end;
+
+        bool negative = false;
+        if ( s < token_end && (*s == '-' || *s == '+') )
+        {
+            negative = (*s == '-');
+            ++s;
+        }
+
+        uint64_t mantissa   = 0;
+        int      num_digits = 0; // Dígitos significativos em "mantissa"
+        int      exponent   = 0;
+        bool     has_digits = false;
+
+        for (; s < token_end && IsDigit(*s); ++s)
+        {
+            has_digits = true;
+            if ( num_digits < 19 )
+            {
+                mantissa = 10*mantissa + (uint64_t)(*s - '0');
+                if ( mantissa != 0 )
+                    ++num_digits;
+            }
+            else
+                ++exponent;
+        }
+
+        if ( s < token_end && *s == '.' )
+        {
+            for (++s; s < token_end && IsDigit(*s); ++s)
+            {
+                has_digits = true;
+                if ( num_digits < 19 )
+                {
+                    mantissa = 10*mantissa + (uint64_t)(*s - '0');
+                    if ( mantissa != 0 )
+                        ++num_digits;
+                    --exponent;
+                }
+            }
+        }
+
+        if ( !has_digits )
+            return false;
+
+        if ( s < token_end && (*s == 'e' || *s == 'E') )
+        {
+            ++s;
+            bool negative_exponent = false;
+            if ( s < token_end && (*s == '-' || *s == '+') )
+            {
+                negative_exponent = (*s == '-');
+                ++s;
+            }
+            if ( s == token_end || !IsDigit(*s) )
+                return false;
+
+            int e = 0;
+            for (; s < token_end && IsDigit(*s); ++s)
+                if ( e < 10000 )
+                    e = 10*e + (*s - '0');
+            exponent += negative_exponent ? -e : e;
+        }
+
+        if ( s != token_end )
+            return false;
+
+        double result = (double)mantissa;
+        if ( mantissa != 0 )
+        {
+            if ( exponent >= 0 && exponent <= 22 )
+                result *= POWERS_OF_10[exponent];
+            else if ( exponent < 0 && exponent >= -22 )
+                result /= POWERS_OF_10[-exponent];
+            else
+                result *= pow(10.0, (double)exponent);
+        }
+
+        *value = (float)(negative ? -result : result);
+        return true;
+    }
+
+    // Lê um dos índices de um vértice de face. "count" é o número de
+    // elementos já definidos no trecho, usado para os índices relativos.
+    inline bool ParseIndex(const char*& p, const char* end, size_t count, bool allow_zero,
+                           int* index, unsigned char relative_bit, RawIndex* raw, Chunk* chunk)
+    {
+        int value = ParseInt(p, end);
+        while ( p < end && *p != '/' && !IsSpace(*p) )
+            ++p;
+
+        if ( value > 0 )
+        {
+            *index = value - 1;
+            return true;
+        }
+
+        if ( value == 0 )
+        {
+            // Índice zero não é permitido pela especificação
+            chunk->num_zero_indices += 1;
+            *index = -1;
+            return allow_zero;
+        }
+
+        *index = (int)count + value;
+        raw->relative |= relative_bit;
+        return true;
+    }
+
+    // Lê um vértice de face nos formatos "v", "v/vt", "v//vn" ou "v/vt/vn".
+    inline bool ParseFaceVertex(const char*& p, const char* end, Chunk* chunk, RawIndex* raw)
+    {
+        raw->v = raw->vt = raw->vn = -1;
+        raw->relative = 0;
+
+        if ( !ParseIndex(p, end, chunk->v.size() / 3, false, &raw->v, RELATIVE_V, raw, chunk) )
+            return false;
+        if ( p == end || *p != '/' )
+            return true;
+        ++p;
+
+        if ( p < end && *p == '/' )
+        {
+            ++p;
+            return ParseIndex(p, end, chunk->vn.size() / 3, true, &raw->vn, RELATIVE_VN, raw, chunk);
+        }
+
+        if ( !ParseIndex(p, end, chunk->vt.size() / 2, true, &raw->vt, RELATIVE_VT, raw, chunk) )
+            return false;
+        if ( p == end || *p != '/' )
+            return true;
+        ++p;
+
+        return ParseIndex(p, end, chunk->vn.size() / 3, true, &raw->vn, RELATIVE_VN, raw, chunk);
+    }
+
+    inline bool StartsWith(const char* p, const char* end, const char* keyword, size_t length)
+    {
+        return (size_t)(end - p) >= length && memcmp(p, keyword, length) == 0;
+    }
+
+    void AddCommand(Chunk* chunk, CommandType type, const char* begin, const char* end, unsigned int smoothing_id = 0)
+    {
+        Command command;
+        command.type         = type;
+        command.face         = chunk->face_sizes.size();
+        command.argument     = std::string(begin, end);
+        command.smoothing_id = smoothing_id;
+        chunk->commands.push_back(command);
+    }
+
+    // Interpreta uma linha (sem a quebra de linha). Retorna false em caso de
+    // erro, descrito em chunk->error.
+    bool ParseLine(const char* p, const char* end, Chunk* chunk)
+    {
+        SkipSpaces(p, end);
+        if ( p == end || *p == '#' )
+            return true;
+
+        size_t length = end - p;
+
+        if ( p[0] == 'v' && length > 1 )
+        {
+            // Posição, com cor opcional: "v x y z [r g b]"
+            if ( IsSpace(p[1]) )
+            {
+                p += 2;
+                float xyz[3] = { 0.0f, 0.0f, 0.0f };
+                float rgb[3] = { 1.0f, 1.0f, 1.0f };
+                for (int i = 0; i < 3; ++i)
+                    ParseFloat(p, end, &xyz[i]);
+                float color[3];
+                if ( ParseFloat(p, end, &color[0]) && ParseFloat(p, end, &color[1]) && ParseFloat(p, end, &color[2]) )
+                    std::copy(color, color + 3, rgb);
+
+                chunk->v.insert(chunk->v.end(), xyz, xyz + 3);
+                chunk->vc.insert(chunk->vc.end(), rgb, rgb + 3);
+                return true;
+            }
+
+            // Normal: "vn x y z"
+            if ( p[1] == 'n' && length > 2 && IsSpace(p[2]) )
+            {
+                p += 3;
+                float xyz[3] = { 0.0f, 0.0f, 0.0f };
+                for (int i = 0; i < 3; ++i)
+                    ParseFloat(p, end, &xyz[i]);
+                chunk->vn.insert(chunk->vn.end(), xyz, xyz + 3);
+                return true;
+            }
+
+            // Coordenada de textura: "vt u v [w]"
+            if ( p[1] == 't' && length > 2 && IsSpace(p[2]) )
+            {
+                p += 3;
+                float uv[2] = { 0.0f, 0.0f };
+                for (int i = 0; i < 2; ++i)
+                    ParseFloat(p, end, &uv[i]);
+                chunk->vt.insert(chunk->vt.end(), uv, uv + 2);
+                return true;
+            }
+
+            return true;
+        }
+
+        if ( p[0] == 'f' && length > 1 && IsSpace(p[1]) )
+        {
+            p += 2;
+            int size = 0;
+            for (;;)
+            {
+                SkipSpaces(p, end);
+                if ( p == end )
+                    break;
+
+                RawIndex raw;
+                if ( !ParseFaceVertex(p, end, chunk, &raw) )
+                {
+                    chunk->error = "Failed to parse `f' line (e.g. a zero value for vertex index)";
+                    return false;
+                }
+                chunk->face_vertices.push_back(raw);
+                ++size;
+            }
+            chunk->face_sizes.push_back(size);
+            return true;
+        }
+
+        if ( StartsWith(p, end, "usemtl", 6) )
+        {
+            p += 6;
+            SkipSpaces(p, end);
+            const char* name = p;
+            SkipToken(p, end);
+            AddCommand(chunk, COMMAND_USEMTL, name, p);
+            return true;
+        }
+
+        if ( StartsWith(p, end, "mtllib", 6) && length > 6 && IsSpace(p[6]) )
+        {
+            AddCommand(chunk, COMMAND_MTLLIB, p + 7, end);
+            return true;
+        }
+
+        if ( p[0] == 'g' && length > 1 && IsSpace(p[1]) )
+        {
+            AddCommand(chunk, COMMAND_GROUP, p + 2, end);
+            return true;
+        }
+
+        if ( p[0] == 'o' && length > 1 && IsSpace(p[1]) )
+        {
+            AddCommand(chunk, COMMAND_OBJECT, p + 2, end);
+            return true;
+        }
+
+        if ( p[0] == 's' && length > 1 && IsSpace(p[1]) )
+        {
+            p += 2;
+            SkipSpaces(p, end);
+            if ( p == end )
+                return true;
+
+            unsigned int smoothing_id = 0;
+            if ( !StartsWith(p, end, "off", 3) )
+            {
+                int id = ParseInt(p, end);
+                smoothing_id = (id < 0) ? 0 : (unsigned int)id;
+            }
+            AddCommand(chunk, COMMAND_SMOOTHING, p, p, smoothing_id);
+            return true;
+        }
+
+        // Linhas ("l"), pontos ("p"), tags ("t"), pesos ("vw") e comandos
+        // desconhecidos são ignorados.
+        return true;
+    }
+
+    void ParseChunk(Chunk* chunk)
+    {
+        const char* p   = chunk->begin;
+        const char* end = chunk->end;
+
+        while ( p < end )
+        {
+            const char* line_end = (const char*)memchr(p, '\n', end - p);
+            const char* next     = line_end ? line_end + 1 : end;
+            if ( line_end == NULL )
+                line_end = end;
+            if ( line_end > p && line_end[-1] == '\r' )
+                --line_end;
+
+            chunk->num_lines += 1;
+            if ( !ParseLine(p, line_end, chunk) )
+                return;
+
+            p = next;
+        }
+    }
+
+    // Monta os shapes a partir das faces e comandos de todos os trechos,
+    // reproduzindo o comportamento da tinyobjloader.
+    struct ShapeBuilder
+    {
+        std::vector<tinyobj::shape_t>*    shapes;
+        std::vector<tinyobj::material_t>* materials;
+        const std::vector<float>*         v;
+        std::string*                      warn;
+
+        tinyobj::MaterialFileReader* material_reader;
+        std::map<std::string, int>   material_map;
+        std::set<std::string>        material_filenames;
+
+        tinyobj::shape_t shape;
+        std::string      name;
+        int              material_id;
+        unsigned int     smoothing_id;
+
+        // Faces lidas desde a última troca de shape ou material
+        std::vector<tinyobj::index_t> face_vertices;
+        std::vector<int>              face_sizes;
+        std::vector<unsigned int>     face_smoothing_ids;
+
+        void AddTriangle(const tinyobj::index_t& a, const tinyobj::index_t& b, const tinyobj::index_t& c, unsigned int smoothing)
+        {
+            shape.mesh.indices.push_back(a);
+            shape.mesh.indices.push_back(b);
+            shape.mesh.indices.push_back(c);
+            shape.mesh.num_face_vertices.push_back(3);
+            shape.mesh.material_ids.push_back(material_id);
+            shape.mesh.smoothing_group_ids.push_back(smoothing);
+        }
+
+        float SquaredDistance(int i, int j) const
+        {
+            const float* a = &(*v)[3*(size_t)i];
+            const float* b = &(*v)[3*(size_t)j];
+            float dx = b[0] - a[0], dy = b[1] - a[1], dz = b[2] - a[2];
+            return dx*dx + dy*dy + dz*dz;
+        }
+
+        // Equivalente a exportGroupsToShape() da tinyobjloader: triangula as
+        // faces pendentes e as adiciona ao shape atual.
+        bool ExportFaces()
+        {
+            if ( face_sizes.empty() )
+                return false;
+
+            shape.name = name;
+
+            size_t num_positions = v->size() / 3;
+            size_t first = 0;
+            for (size_t face = 0; face < face_sizes.size(); ++face)
+            {
+                size_t size = (size_t)face_sizes[face];
+                const tinyobj::index_t* idx = &face_vertices[first];
+                unsigned int smoothing = face_smoothing_ids[face];
+                first += size;
+
+                if ( size < 3 )
+                {
+                    if ( warn )
+                        (*warn) += "Degenerated face found\n.";
+                    continue;
+                }
+
+                if ( size == 3 )
+                {
+                    AddTriangle(idx[0], idx[1], idx[2], smoothing);
+                }
+                else if ( size == 4 )
+                {
+                    bool valid = true;
+                    for (int k = 0; k < 4; ++k)
+                        valid = valid && (size_t)idx[k].vertex_index < num_positions;
+                    if ( !valid )
+                    {
+                        if ( warn )
+                            (*warn) += "Face with invalid vertex index found.\n";
+                        continue;
+                    }
+
+                    // Dividimos o quadrilátero pela diagonal mais curta
+                    float d02 = SquaredDistance(idx[0].vertex_index, idx[2].vertex_index);
+                    float d13 = SquaredDistance(idx[1].vertex_index, idx[3].vertex_index);
+                    if ( d02 < d13 )
+                    {
+                        AddTriangle(idx[0], idx[1], idx[2], smoothing);
+                        AddTriangle(idx[0], idx[2], idx[3], smoothing);
+                    }
+                    else
+                    {
+                        AddTriangle(idx[0], idx[1], idx[3], smoothing);
+                        AddTriangle(idx[1], idx[2], idx[3], smoothing);
+                    }
+                }
+                else
+                {
+                    for (size_t k = 1; k + 1 < size; ++k)
+                        AddTriangle(idx[0], idx[k], idx[k+1], smoothing);
+                }
+            }
+            return true;
+        }
+
+        void ClearFaces()
+        {
+            face_vertices.clear();
+            face_sizes.clear();
+            face_smoothing_ids.clear();
+        }
+
+        // Termina o shape atual e começa um novo
+        void FlushShape()
+        {
+            ExportFaces();
+            if ( !shape.mesh.indices.empty() )
+                shapes->push_back(shape);
+            shape = tinyobj::shape_t();
+            ClearFaces();
+        }
+
+        void LoadMaterials(const std::string& argument, std::string* err)
+        {
+            std::vector<std::string> filenames;
+            const char* p   = argument.c_str();
+            const char* end = p + argument.size();
+            for (;;)
+            {
+                SkipSpaces(p, end);
+                if ( p == end )
+                    break;
+                const char* filename = p;
+                SkipToken(p, end);
+                filenames.push_back(std::string(filename, p));
+            }
+
+            if ( filenames.empty() )
+            {
+                if ( warn )
+                    (*warn) += "Looks like empty filename for mtllib. Use default material.\n";
+                return;
+            }
+
+            bool found = false;
+            for (size_t i = 0; i < filenames.size(); ++i)
+            {
+                if ( material_filenames.count(filenames[i]) > 0 )
+                {
+                    found = true;
+                    continue;
+                }
+
+                std::string warn_mtl;
+                std::string err_mtl;
+                bool ok = (*material_reader)(filenames[i], materials, &material_map, &warn_mtl, &err_mtl);
+                if ( warn )
+                    (*warn) += warn_mtl;
+                if ( err )
+                    (*err) += err_mtl;
+
+                if ( ok )
+                {
+                    found = true;
+                    material_filenames.insert(filenames[i]);
+                    break;
+                }
+            }
+
+            if ( !found && warn )
+                (*warn) += "Failed to load material file(s). Use default material.\n";
+        }
+
+        void Apply(const Command& command, std::string* err)
+        {
+            switch ( command.type )
+            {
+            case COMMAND_OBJECT:
+                FlushShape();
+                name = command.argument;
+                break;
+
+            case COMMAND_GROUP:
+            {
+                FlushShape();
+
+                // Vários nomes de grupo são concatenados com espaços
+                name.clear();
+                const char* p   = command.argument.c_str();
+                const char* end = p + command.argument.size();
+                for (;;)
+                {
+                    SkipSpaces(p, end);
+                    if ( p == end )
+                        break;
+                    const char* group = p;
+                    SkipToken(p, end);
+                    if ( !name.empty() )
+                        name += ' ';
+                    name.append(group, p);
+                }
+                if ( name.empty() && warn )
+                    (*warn) += "Empty group name.\n";
+                break;
+            }
+
+            case COMMAND_USEMTL:
+            {
+                int new_material_id = -1;
+                std::map<std::string, int>::const_iterator it = material_map.find(command.argument);
+                if ( it != material_map.end() )
+                    new_material_id = it->second;
+                else if ( warn )
+                    (*warn) += "material [ '" + command.argument + "' ] not found in .mtl\n";
+
+                // Cada material gera um novo conjunto de faces no mesmo shape
+                if ( new_material_id != material_id )
+                {
+                    ExportFaces();
+                    ClearFaces();
+                    material_id = new_material_id;
+                }
+                break;
+            }
+
+            case COMMAND_MTLLIB:
+                LoadMaterials(command.argument, err);
+                break;
+
+            case COMMAND_SMOOTHING:
+                smoothing_id = command.smoothing_id;
+                break;
+            }
+        }
+    };
+
+    // Divide [0, size) em até "count" trechos que terminam em quebras de linha
+    std::vector<size_t> SplitAtLines(const char* data, size_t size, size_t count)
+    {
+        std::vector<size_t> bounds(1, 0);
+        for (size_t i = 1; i < count; ++i)
+        {
+            size_t pos = std::max(bounds.back(), size * i / count);
+            const char* newline = (const char*)memchr(data + pos, '\n', size - pos);
+            if ( newline == NULL )
+                break;
+            pos = (size_t)(newline - data) + 1;
+            if ( pos > bounds.back() && pos < size )
+                bounds.push_back(pos);
+        }
+        bounds.push_back(size);
+        return bounds;
+    }
+}
+
+bool ReadObj(const char* filename, const char* mtl_basedir,
+             tinyobj::attrib_t* attrib, std::vector<tinyobj::shape_t>* shapes,
+             std::vector<tinyobj::material_t>* materials,
+             std::string* warn, std::string* err, int num_threads)
+{
+    *attrib = tinyobj::attrib_t();
+    shapes->clear();
+
+    MappedFile file;
+    if ( !MapFile(filename, &file) )
+    {
+        // MapFile() falha também para arquivos vazios, que são válidos
+        FileStamp stamp;
+        if ( GetFileStamp(filename, &stamp) && stamp.size == 0 )
+            return true;
+
+        if ( err )
+            (*err) += std::string("Cannot open file [") + filename + "]\n";
+        return false;
+    }
+
+    const char* data = (const char*)file.data;
+
+    // 1. Cada trecho do arquivo é lido de forma independente. A thread que
+    // chamou a função processa o último trecho.
+    if ( num_threads <= 0 )
+        num_threads = (int)std::thread::hardware_concurrency();
+    size_t max_threads = std::max<size_t>(1, file.size / OBJ_MIN_BYTES_PER_THREAD);
+    size_t threads = std::max<size_t>(1, std::min<size_t>((size_t)std::max(num_threads, 1), max_threads));
+
+    std::vector<size_t> bounds = SplitAtLines(data, file.size, threads);
+    std::vector<Chunk> chunks(bounds.size() - 1);
+    for (size_t c = 0; c < chunks.size(); ++c)
+    {
+        chunks[c].begin            = data + bounds[c];
+        chunks[c].end              = data + bounds[c+1];
+        chunks[c].num_lines        = 0;
+        chunks[c].num_zero_indices = 0;
+        chunks[c].error            = NULL;
+    }
+
+    std::vector<std::thread> workers;
+    for (size_t c = 0; c + 1 < chunks.size(); ++c)
+        workers.push_back(std::thread(ParseChunk, &chunks[c]));
+    ParseChunk(&chunks.back());
+    for (size_t i = 0; i < workers.size(); ++i)
+        workers[i].join();
+
+    UnmapFile(&file);
+
+    // 2. Concatenamos os atributos e reproduzimos, em ordem, os comandos e as
+    // faces de cada trecho, corrigindo os índices relativos.
+    size_t line_offset = 0;
+    size_t num_zero_indices = 0;
+    for (size_t c = 0; c < chunks.size(); ++c)
+    {
+        if ( chunks[c].error != NULL )
+        {
+            if ( err )
+            {
+                char location[64];
+                snprintf(location, sizeof(location), " (line %zu).\n", line_offset + chunks[c].num_lines);
+                (*err) += chunks[c].error + std::string(location);
+            }
+            return false;
+        }
+        line_offset += chunks[c].num_lines;
+        num_zero_indices += chunks[c].num_zero_indices;
+    }
+
+    if ( num_zero_indices > 0 && warn )
+    {
+        char message[128];
+        snprintf(message, sizeof(message), "%zu zero value indices found (will have a value of -1 for normal and tex indices).\n", num_zero_indices);
+        (*warn) += message;
+    }
+
+    for (size_t c = 0; c < chunks.size(); ++c)
+    {
+        attrib->vertices.insert(attrib->vertices.end(), chunks[c].v.begin(), chunks[c].v.end());
+        attrib->colors.insert(attrib->colors.end(), chunks[c].vc.begin(), chunks[c].vc.end());
+        attrib->normals.insert(attrib->normals.end(), chunks[c].vn.begin(), chunks[c].vn.end());
+        attrib->texcoords.insert(attrib->texcoords.end(), chunks[c].vt.begin(), chunks[c].vt.end());
+    }
+
+    std::string basedir = mtl_basedir ? mtl_basedir : "";
+    if ( !basedir.empty() && basedir[basedir.size() - 1] != '/' )
+        basedir += '/';
+    tinyobj::MaterialFileReader material_reader(basedir);
+
+    ShapeBuilder builder;
+    builder.shapes          = shapes;
+    builder.materials       = materials;
+    builder.v               = &attrib->vertices;
+    builder.warn            = warn;
+    builder.material_reader = &material_reader;
+    builder.material_id     = -1;
+    builder.smoothing_id    = 0;
+
+    int v_offset = 0, vn_offset = 0, vt_offset = 0;
+    int max_v = -1, max_vn = -1, max_vt = -1;
+    for (size_t c = 0; c < chunks.size(); ++c)
+    {
+        const Chunk& chunk = chunks[c];
+        size_t command = 0;
+        size_t first = 0;
+
+        for (size_t face = 0; face <= chunk.face_sizes.size(); ++face)
+        {
+            while ( command < chunk.commands.size() && chunk.commands[command].face == face )
+                builder.Apply(chunk.commands[command++], err);
+
+            if ( face == chunk.face_sizes.size() )
+                break;
+
+            int size = chunk.face_sizes[face];
+            for (int k = 0; k < size; ++k)
+            {
+                const RawIndex& raw = chunk.face_vertices[first + k];
+                tinyobj::index_t idx;
+                idx.vertex_index   = raw.v  + ((raw.relative & RELATIVE_V)  ? v_offset  : 0);
+                idx.normal_index   = raw.vn + ((raw.relative & RELATIVE_VN) ? vn_offset : 0);
+                idx.texcoord_index = raw.vt + ((raw.relative & RELATIVE_VT) ? vt_offset : 0);
+
+                if ( (raw.relative & RELATIVE_V  && idx.vertex_index   < 0)
+                  || (raw.relative & RELATIVE_VN && idx.normal_index   < 0)
+                  || (raw.relative & RELATIVE_VT && idx.texcoord_index < 0) )
+                {
+                    if ( err )
+                        (*err) += "Failed to parse `f' line (invalid relative vertex index).\n";
+                    return false;
+                }
+
+                max_v  = std::max(max_v, idx.vertex_index);
+                max_vn = std::max(max_vn, idx.normal_index);
+                max_vt = std::max(max_vt, idx.texcoord_index);
+                builder.face_vertices.push_back(idx);
+            }
+            builder.face_sizes.push_back(size);
+            builder.face_smoothing_ids.push_back(builder.smoothing_id);
+            first += size;
+        }
+
+        v_offset  += (int)(chunk.v.size() / 3);
+        vn_offset += (int)(chunk.vn.size() / 3);
+        vt_offset += (int)(chunk.vt.size() / 2);
+    }
+
+    if ( warn )
+    {
+        if ( max_v >= (int)(attrib->vertices.size() / 3) )
+            (*warn) += "Vertex indices out of bounds.\n";
+        if ( max_vn >= (int)(attrib->normals.size() / 3) )
+            (*warn) += "Vertex normal indices out of bounds.\n";
+        if ( max_vt >= (int)(attrib->texcoords.size() / 2) )
+            (*warn) += "Vertex texcoord indices out of bounds.\n";
+    }
+
+    if ( builder.ExportFaces() || !builder.shape.mesh.indices.empty() )
+        shapes->push_back(builder.shape);
+
+    return true;
+}
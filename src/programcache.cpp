@@ -0,0 +1,220 @@
+// Cache binário de programas de GPU. Layout do arquivo ".progcache":
+//
+//    ProgCacheHeader
+//    identificação do driver  (driver_length bytes, veja DriverString())
+//    binário do programa      (binary_length bytes, no formato binary_format)
+//
+#include <cstring>
+#include <vector>
+
+#include "programcache.h"
+#include "mappedfile.h"
+
+namespace
+{
+    // Constantes e funções de ARB_get_program_binary, ausentes do cabeçalho
+    // do OpenGL 3.3.
+    const GLenum PROGRAM_BINARY_RETRIEVABLE_HINT = 0x8257;
+    const GLenum PROGRAM_BINARY_LENGTH           = 0x8741;
+    const GLenum NUM_PROGRAM_BINARY_FORMATS      = 0x87FE;
+    const GLenum PROGRAM_BINARY_FORMATS          = 0x87FF;
+
+    typedef void (APIENTRYP GetProgramBinaryProc)(GLuint program, GLsizei buf_size, GLsizei* length, GLenum* binary_format, void* binary);
+    typedef void (APIENTRYP ProgramBinaryProc)(GLuint program, GLenum binary_format, const void* binary, GLsizei length);
+    typedef void (APIENTRYP ProgramParameteriProc)(GLuint program, GLenum pname, GLint value);
+
+    GetProgramBinaryProc  g_GetProgramBinary  = NULL;
+    ProgramBinaryProc     g_ProgramBinary     = NULL;
+    ProgramParameteriProc g_ProgramParameteri = NULL;
+
+    std::vector<GLenum> g_BinaryFormats; // Vazio se o cache estiver desativado
+
+    const char PROGCACHE_MAGIC[8] = "FCGPRG";
+
+    struct ProgCacheHeader
+    {
+        char     magic[8];
+        uint32_t version;
+        uint32_t binary_format;
+        uint64_t source_hash;   // Hash do código-fonte dos dois shaders
+        uint32_t driver_length;
+        uint32_t binary_length;
+    };
+
+    // Hash FNV-1a de 64 bits do código dos shaders. O tamanho do primeiro
+    // entra no hash para que a fronteira entre os dois também seja levada em
+    // conta.
+    uint64_t HashSources(const std::string& vertex_source, const std::string& fragment_source)
+    {
+        uint64_t h = 14695981039346656037ull;
+        uint64_t vertex_length = vertex_source.size();
+        const std::string* sources[2] = { &vertex_source, &fragment_source };
+        for (int s = 0; s < 2; ++s)
+        {
+            for (size_t i = 0; i < sources[s]->size(); ++i)
+            {
+                h ^= (unsigned char)(*sources[s])[i];
+                h *= 1099511628211ull;
+            }
+            for (int i = 0; s == 0 && i < 8; ++i)
+            {
+                h ^= (vertex_length >> (8*i)) & 0xFF;
+                h *= 1099511628211ull;
+            }
+        }
+        return h;
+    }
+
+    std::string DriverString()
+    {
+        std::string driver;
+        GLenum names[3] = { GL_VENDOR, GL_RENDERER, GL_VERSION };
+        for (int i = 0; i < 3; ++i)
+        {
+            const GLubyte* value = glGetString(names[i]);
+            if ( value != NULL )
+                driver += (const char*)value;
+            driver += '\n';
+        }
+        return driver;
+    }
+
+    bool IsSupportedFormat(GLenum format)
+    {
+        for (size_t i = 0; i < g_BinaryFormats.size(); ++i)
+            if ( g_BinaryFormats[i] == format )
+                return true;
+        return false;
+    }
+}
+
+bool HasGLExtension(const char* name)
+{
+    GLint num_extensions = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &num_extensions);
+    for (GLint i = 0; i < num_extensions; ++i)
+    {
+        const GLubyte* extension = glGetStringi(GL_EXTENSIONS, i);
+        if ( extension != NULL && strcmp((const char*)extension, name) == 0 )
+            return true;
+    }
+    return false;
+}
+
+void ProgramCache_Init(GLADloadproc load)
+{
+    g_BinaryFormats.clear();
+
+    bool core = GLVersion.major > 4 || (GLVersion.major == 4 && GLVersion.minor >= 1);
+    if ( !core && !HasGLExtension("GL_ARB_get_program_binary") )
+        return;
+
+    g_GetProgramBinary  = (GetProgramBinaryProc) load("glGetProgramBinary");
+    g_ProgramBinary     = (ProgramBinaryProc) load("glProgramBinary");
+    g_ProgramParameteri = (ProgramParameteriProc) load("glProgramParameteri");
+    if ( g_GetProgramBinary == NULL || g_ProgramBinary == NULL || g_ProgramParameteri == NULL )
+        return;
+
+    // Alguns drivers oferecem a extensão sem nenhum formato de binário
+    GLint num_formats = 0;
+    glGetIntegerv(NUM_PROGRAM_BINARY_FORMATS, &num_formats);
+    if ( num_formats <= 0 )
+        return;
+
+    std::vector<GLint> formats(num_formats);
+    glGetIntegerv(PROGRAM_BINARY_FORMATS, formats.data());
+    g_BinaryFormats.assign(formats.begin(), formats.end());
+}
+
+std::string ProgramCache_Filename(const char* name)
+{
+    return std::string(name) + ".progcache";
+}
+
+bool ProgramCache_Load(const char* name, const std::string& vertex_source, const std::string& fragment_source, GLuint* program_id)
+{
+    if ( g_BinaryFormats.empty() )
+        return false;
+
+    MappedFile file;
+    if ( !MapFile(ProgramCache_Filename(name).c_str(), &file) )
+        return false;
+
+    ProgCacheHeader header;
+    std::string driver = DriverString();
+    bool valid = file.size >= sizeof(header);
+    if ( valid )
+    {
+        memcpy(&header, file.data, sizeof(header));
+        valid = memcmp(header.magic, PROGCACHE_MAGIC, sizeof(header.magic)) == 0
+             && header.version == PROGRAMCACHE_VERSION
+             && header.source_hash == HashSources(vertex_source, fragment_source)
+             && header.driver_length == driver.size()
+             && file.size == sizeof(header) + (size_t)header.driver_length + header.binary_length
+             && memcmp(file.data + sizeof(header), driver.data(), driver.size()) == 0
+             && IsSupportedFormat(header.binary_format);
+    }
+
+    // Mesmo com cabeçalho válido, o driver pode recusar o binário (por
+    // exemplo depois de uma atualização que não mudou GL_VERSION). Neste caso
+    // a linkagem falha e o programa é compilado normalmente.
+    GLint linked_ok = GL_FALSE;
+    GLuint program = 0;
+    if ( valid )
+    {
+        program = glCreateProgram();
+        g_ProgramBinary(program, header.binary_format, file.data + sizeof(header) + header.driver_length, (GLsizei)header.binary_length);
+        glGetProgramiv(program, GL_LINK_STATUS, &linked_ok);
+        if ( linked_ok == GL_FALSE )
+            glDeleteProgram(program);
+    }
+
+    UnmapFile(&file);
+
+    if ( linked_ok == GL_FALSE )
+        return false;
+
+    *program_id = program;
+    return true;
+}
+
+void ProgramCache_PrepareLink(GLuint program_id)
+{
+    if ( !g_BinaryFormats.empty() )
+        g_ProgramParameteri(program_id, PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+}
+
+bool ProgramCache_Save(const char* name, const std::string& vertex_source, const std::string& fragment_source, GLuint program_id)
+{
+    if ( g_BinaryFormats.empty() )
+        return false;
+
+    GLint linked_ok = GL_FALSE;
+    glGetProgramiv(program_id, GL_LINK_STATUS, &linked_ok);
+    GLint binary_length = 0;
+    glGetProgramiv(program_id, PROGRAM_BINARY_LENGTH, &binary_length);
+    if ( linked_ok == GL_FALSE || binary_length <= 0 )
+        return false;
+
+    std::vector<unsigned char> binary(binary_length);
+    GLsizei length = 0;
+    GLenum  binary_format = 0;
+    g_GetProgramBinary(program_id, binary_length, &length, &binary_format, binary.data());
+    if ( length <= 0 )
+        return false;
+
+    std::string driver = DriverString();
+
+    ProgCacheHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, PROGCACHE_MAGIC, sizeof(header.magic));
+    header.version       = PROGRAMCACHE_VERSION;
+    header.binary_format = binary_format;
+    header.source_hash   = HashSources(vertex_source, fragment_source);
+    header.driver_length = (uint32_t)driver.size();
+    header.binary_length = (uint32_t)length;
+
+    const void* chunks[3] = { &header, driver.data(), binary.data() };
+    size_t      sizes[3]  = { sizeof(header), driver.size(), (size_t)length };
+    return WriteFileAtomically(ProgramCache_Filename(name), chunks, sizes, 3);
+}
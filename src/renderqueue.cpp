@@ -0,0 +1,535 @@
+// Fila de desenhos ordenada por estado. Chave de ordenação de um pacote:
+//
+//    bits 60-63  passo
+//    bits 52-59  programa
+//    bits 44-51  material (define as texturas amostradas)
+//    bits 36-43  VAO
+//    bits  0-35  primeiro índice desenhado (identifica o objeto e o nível de
+//                detalhe, agrupando os pacotes que podem ser instanciados)
+//
+// Nos passos com RENDER_PASS_ORDERED apenas o passo e a ordem de submissão
+// fazem parte da chave. Os empates são desfeitos pela ordem de submissão, o
+// que mantém a ordenação estável.
+//
+// Região de um quadro no buffer de uniforms, com cada bloco alinhado a
+// GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT:
+//
+//    FrameUniforms
+//    PassUniforms x RENDER_QUEUE_MAX_PASSES
+//    DrawUniforms x RENDER_QUEUE_DRAWS_PER_BLOCK, uma janela para cada
+//                   RENDER_QUEUE_DRAWS_PER_BLOCK desenhos do quadro
+#include <cstddef>
+#include <cstring>
+#include <algorithm>
+#include <utility>
+
+#include <glm/gtc/type_ptr.hpp>
+
+#include "renderqueue.h"
+
+namespace
+{
+    // Posições dos atributos por instância em "shader_vertex.glsl". A matriz
+    // ocupa quatro posições, uma por coluna.
+    const GLuint INSTANCE_MODEL_LOCATION = 3;
+    const GLuint INSTANCE_DATA_LOCATION  = 7;
+    const GLuint INSTANCE_DRAW_LOCATION  = 8;
+    const GLuint INSTANCE_NORMAL_LOCATION = 9;  // Três posições, uma por coluna
+    const GLuint INSTANCE_LAST_LOCATION   = 11;
+
+    // Capacidade mínima, em instâncias, do buffer de atributos por instância
+    const size_t MIN_INSTANCE_CAPACITY = 1024;
+
+    // Tempo máximo, em nanossegundos, de espera pela GPU antes de reescrever
+    // uma região do buffer de uniforms
+    const GLuint64 UNIFORM_FENCE_TIMEOUT = 1000000000;
+
+    // Estado do OpenGL conhecido durante RenderQueue_Flush(); -1 se desconhecido
+    struct GlState
+    {
+        int    program;
+        GLuint vertex_array_object_id;
+        bool   has_vertex_array;
+        long   first_instance;   // Instância para onde apontam os atributos por instância do VAO
+        long   draw_window;      // Janela do bloco "DrawUniforms" ligada
+        int    depth_test;
+        int    cull_face;
+        int    blend;
+    };
+
+    // Vetores usados por glMultiDrawElementsBaseVertex()
+    std::vector<GLsizei>     g_Counts;
+    std::vector<const void*> g_Offsets;
+    std::vector<GLint>       g_BaseVertices;
+
+    // Número de pacotes de cada desenho, na ordem de desenho
+    std::vector<size_t>      g_DrawSizes;
+
+    size_t AlignUp(size_t size, size_t alignment)
+    {
+        return (size + alignment - 1) / alignment * alignment;
+    }
+
+    // Deslocamentos, dentro da região de um quadro, dos blocos de uniforms
+    struct UniformLayout
+    {
+        size_t pass_offset;
+        size_t pass_stride;
+        size_t draw_offset;
+        size_t draw_stride;   // Distância entre duas janelas de "DrawUniforms"
+        size_t size;
+    };
+
+    UniformLayout ComputeUniformLayout(const RenderQueue& queue, size_t num_draws)
+    {
+        size_t alignment   = (size_t)queue.uniform_alignment;
+        size_t num_windows = (num_draws + RENDER_QUEUE_DRAWS_PER_BLOCK - 1) / RENDER_QUEUE_DRAWS_PER_BLOCK;
+
+        UniformLayout layout;
+        layout.pass_offset = AlignUp(sizeof(FrameUniforms), alignment);
+        layout.pass_stride = AlignUp(sizeof(PassUniforms), alignment);
+        layout.draw_offset = layout.pass_offset + RENDER_QUEUE_MAX_PASSES * layout.pass_stride;
+        layout.draw_stride = AlignUp(RENDER_QUEUE_DRAWS_PER_BLOCK * sizeof(DrawUniforms), alignment);
+        layout.size        = layout.draw_offset + std::max(num_windows, (size_t)1) * layout.draw_stride;
+        return layout;
+    }
+
+    uint64_t SortKey(const RenderQueue& queue, size_t packet_index)
+    {
+        const DrawPacket& packet = queue.packets[packet_index];
+
+        uint64_t key = (uint64_t)(packet.pass & 0xF) << 60;
+        if ( queue.passes[packet.pass].flags & RENDER_PASS_ORDERED )
+            return key | (packet_index & 0xFFFFFFFFFull);
+
+        uint64_t first_index = (queue.num_ranges[packet_index] > 0) ? queue.ranges[queue.first_range[packet_index]].first_index : 0;
+        key |= (uint64_t)(packet.program & 0xFF) << 52;
+        key |= (uint64_t)(packet.material & 0xFF) << 44;
+        key |= (uint64_t)(packet.mesh->vertex_array_object_id & 0xFF) << 36;
+        return key | (first_index & 0xFFFFFFFFFull);
+    }
+
+    // Indica se os pacotes "a" e "b" desenham os mesmos intervalos com o
+    // mesmo estado, podendo ser instâncias de um mesmo desenho.
+    bool SameDraw(const RenderQueue& queue, size_t a, size_t b)
+    {
+        const DrawPacket& pa = queue.packets[a];
+        const DrawPacket& pb = queue.packets[b];
+        if ( pa.pass != pb.pass || pa.program != pb.program || pa.material != pb.material || pa.mesh != pb.mesh )
+            return false;
+
+        if ( queue.num_ranges[a] != queue.num_ranges[b] )
+            return false;
+
+        const DrawRange* ra = &queue.ranges[queue.first_range[a]];
+        const DrawRange* rb = &queue.ranges[queue.first_range[b]];
+        for (size_t r = 0; r < queue.num_ranges[a]; ++r)
+            if ( ra[r].count != rb[r].count || ra[r].first_index != rb[r].first_index || ra[r].base_vertex != rb[r].base_vertex )
+                return false;
+
+        return true;
+    }
+
+    // Habilita ou desabilita "capability" se o estado conhecido for outro.
+    // Retorna o número de chamadas feitas.
+    size_t SetCapability(GLenum capability, bool enable, int* current)
+    {
+        if ( *current == (int)enable )
+            return 0;
+
+        if ( enable )
+            glEnable(capability);
+        else
+            glDisable(capability);
+        *current = enable;
+        return 1;
+    }
+
+    // Habilita os atributos por instância no VAO ligado
+    void EnableInstanceAttributes()
+    {
+        for (GLuint location = INSTANCE_MODEL_LOCATION; location <= INSTANCE_LAST_LOCATION; ++location)
+        {
+            glEnableVertexAttribArray(location);
+            glVertexAttribDivisor(location, 1);
+        }
+    }
+
+    // Aponta os atributos por instância do VAO ligado para a instância
+    // "first_instance" do buffer ligado em GL_ARRAY_BUFFER. O OpenGL 3.3 não
+    // tem o parâmetro "baseinstance" nas chamadas de desenho.
+    void PointInstanceAttributes(size_t first_instance)
+    {
+        GLsizei stride = sizeof(InstanceData);
+        size_t  offset = first_instance * sizeof(InstanceData);
+        for (GLuint column = 0; column < 4; ++column)
+            glVertexAttribPointer(INSTANCE_MODEL_LOCATION + column, 4, GL_FLOAT, GL_FALSE, stride,
+                                  (void*)(offset + offsetof(InstanceData, model) + column * sizeof(glm::vec4)));
+        glVertexAttribPointer(INSTANCE_DATA_LOCATION, 1, GL_FLOAT, GL_FALSE, stride, (void*)(offset + offsetof(InstanceData, data)));
+        glVertexAttribIPointer(INSTANCE_DRAW_LOCATION, 1, GL_INT, stride, (void*)(offset + offsetof(InstanceData, draw)));
+        for (GLuint column = 0; column < 3; ++column)
+            glVertexAttribPointer(INSTANCE_NORMAL_LOCATION + column, 3, GL_FLOAT, GL_FALSE, stride,
+                                  (void*)(offset + offsetof(InstanceData, normal_matrix) + column * sizeof(glm::vec3)));
+    }
+
+    // Envia queue->instances para o buffer de instâncias, que é realocado a
+    // cada quadro para que o driver não precise esperar o quadro anterior.
+    void UploadInstances(RenderQueue* queue)
+    {
+        size_t count = queue->instances.size();
+        if ( count > queue->instance_capacity )
+            queue->instance_capacity = std::max(std::max(2*queue->instance_capacity, MIN_INSTANCE_CAPACITY), count);
+
+        glBindBuffer(GL_ARRAY_BUFFER, queue->instance_buffer_id);
+        glBufferData(GL_ARRAY_BUFFER, queue->instance_capacity * sizeof(InstanceData), NULL, GL_STREAM_DRAW);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, count * sizeof(InstanceData), queue->instances.data());
+    }
+
+    // Envia queue->uniforms para a região do quadro atual no buffer de
+    // uniforms, que é realocado se a região não for grande o suficiente. A
+    // região só é reescrita após a GPU terminar os desenhos que a leram,
+    // RENDER_QUEUE_UNIFORM_FRAMES quadros antes, portanto o mapeamento não
+    // precisa ser sincronizado pelo driver.
+    size_t UploadUniforms(RenderQueue* queue)
+    {
+        size_t size = queue->uniforms.size();
+        glBindBuffer(GL_UNIFORM_BUFFER, queue->uniform_buffer_id);
+
+        if ( size > queue->uniform_frame_size )
+        {
+            for (int i = 0; i < RENDER_QUEUE_UNIFORM_FRAMES; ++i)
+            {
+                if ( queue->uniform_fences[i] != 0 )
+                    glDeleteSync(queue->uniform_fences[i]);
+                queue->uniform_fences[i] = 0;
+            }
+            queue->uniform_frame_size = size;
+            queue->uniform_frame = 0;
+            glBufferData(GL_UNIFORM_BUFFER, RENDER_QUEUE_UNIFORM_FRAMES * size, NULL, GL_STREAM_DRAW);
+        }
+
+        GLsync& fence = queue->uniform_fences[queue->uniform_frame];
+        if ( fence != 0 )
+        {
+            glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, UNIFORM_FENCE_TIMEOUT);
+            glDeleteSync(fence);
+            fence = 0;
+        }
+
+        size_t offset = queue->uniform_frame * queue->uniform_frame_size;
+        void* data = glMapBufferRange(GL_UNIFORM_BUFFER, offset, size,
+                                      GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+        if ( data != NULL )
+        {
+            memcpy(data, queue->uniforms.data(), size);
+            glUnmapBuffer(GL_UNIFORM_BUFFER);
+        }
+        else
+        {
+            glBufferSubData(GL_UNIFORM_BUFFER, offset, size, queue->uniforms.data());
+        }
+
+        return offset;
+    }
+
+    // Número de trocas de estado de um desenho na ordem de submissão que
+    // definisse todo o estado de cada pacote: programa, VAO, material,
+    // bounding box, quantização e matriz de modelagem a cada pacote, e
+    // matrizes e estado do passo a cada troca de passo.
+    size_t NaiveStateChanges(const RenderQueue& queue)
+    {
+        size_t changes = 0;
+        int pass = -1;
+        for (size_t i = 0; i < queue.packets.size(); ++i)
+        {
+            const DrawPacket& packet = queue.packets[i];
+            if ( packet.pass != pass )
+            {
+                changes += 2 + 3 + ((queue.passes[packet.pass].flags & RENDER_PASS_CLEAR_DEPTH) ? 1 : 0);
+                pass = packet.pass;
+            }
+            changes += 8;
+        }
+        return changes;
+    }
+}
+
+void RenderQueue_Init(RenderQueue* queue)
+{
+    glGenBuffers(1, &queue->instance_buffer_id);
+    queue->instance_capacity = 0;
+
+    memset(&queue->frame, 0, sizeof(queue->frame));
+    glGenBuffers(1, &queue->uniform_buffer_id);
+    queue->uniform_frame_size = 0;
+    queue->uniform_frame = 0;
+    for (int i = 0; i < RENDER_QUEUE_UNIFORM_FRAMES; ++i)
+        queue->uniform_fences[i] = 0;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &queue->uniform_alignment);
+    if ( queue->uniform_alignment <= 0 )
+        queue->uniform_alignment = 256;
+
+    queue->stats.packets             = 0;
+    queue->stats.instanced_packets   = 0;
+    queue->stats.draw_calls          = 0;
+    queue->stats.state_changes       = 0;
+    queue->stats.state_changes_saved = 0;
+}
+
+void RenderQueue_BindUniformBlocks(GLuint program_id)
+{
+    const char* names[3]   = { "FrameUniforms", "PassUniforms", "DrawBlock" };
+    const GLuint bindings[3] = { RENDER_QUEUE_FRAME_BINDING, RENDER_QUEUE_PASS_BINDING, RENDER_QUEUE_DRAW_BINDING };
+
+    for (int i = 0; i < 3; ++i)
+    {
+        GLuint index = glGetUniformBlockIndex(program_id, names[i]);
+        if ( index != GL_INVALID_INDEX )
+            glUniformBlockBinding(program_id, index, bindings[i]);
+    }
+}
+
+int RenderQueue_AddProgram(RenderQueue* queue, const RenderProgram& program)
+{
+    queue->programs.push_back(program);
+    return (int)queue->programs.size() - 1;
+}
+
+void RenderQueue_SetProgram(RenderQueue* queue, int index, const RenderProgram& program)
+{
+    queue->programs[index] = program;
+}
+
+void RenderQueue_SetPass(RenderQueue* queue, int pass, const glm::mat4& view, const glm::mat4& projection,
+                         const glm::vec4& camera_position, unsigned flags)
+{
+    queue->passes[pass].view            = view;
+    queue->passes[pass].projection      = projection;
+    queue->passes[pass].camera_position = camera_position;
+    queue->passes[pass].flags           = flags;
+}
+
+void RenderQueue_Submit(RenderQueue* queue, const DrawPacket& packet, const DrawRange* ranges, size_t num_ranges)
+{
+    queue->packets.push_back(packet);
+    queue->first_range.push_back(queue->ranges.size());
+    queue->num_ranges.push_back(num_ranges);
+    queue->ranges.insert(queue->ranges.end(), ranges, ranges + num_ranges);
+}
+
+void RenderQueue_Flush(RenderQueue* queue)
+{
+    size_t num_packets = queue->packets.size();
+
+    std::vector<std::pair<uint64_t, size_t> > order(num_packets);
+    for (size_t i = 0; i < num_packets; ++i)
+        order[i] = std::make_pair(SortKey(*queue, i), i);
+    std::sort(order.begin(), order.end());
+
+    // Desenhos: pacotes consecutivos que são instâncias do primeiro
+    g_DrawSizes.clear();
+    for (size_t k = 0; k < num_packets; )
+    {
+        size_t num_instances = 1;
+        while ( k + num_instances < num_packets && SameDraw(*queue, order[k].second, order[k + num_instances].second) )
+            ++num_instances;
+        g_DrawSizes.push_back(num_instances);
+        k += num_instances;
+    }
+    size_t num_draws = g_DrawSizes.size();
+
+    // Blocos de uniforms do quadro: valores do quadro, matrizes dos passos e
+    // um elemento de "DrawUniforms" por desenho.
+    UniformLayout layout = ComputeUniformLayout(*queue, num_draws);
+    queue->uniforms.assign(layout.size, 0);
+    memcpy(&queue->uniforms[0], &queue->frame, sizeof(FrameUniforms));
+    for (int p = 0; p < RENDER_QUEUE_MAX_PASSES; ++p)
+    {
+        PassUniforms pass_uniforms;
+        pass_uniforms.view            = queue->passes[p].view;
+        pass_uniforms.projection      = queue->passes[p].projection;
+        pass_uniforms.camera_position = queue->passes[p].camera_position;
+        memcpy(&queue->uniforms[layout.pass_offset + p * layout.pass_stride], &pass_uniforms, sizeof(PassUniforms));
+    }
+
+    // Os atributos por instância de todos os pacotes são enviados de uma só
+    // vez, na ordem de desenho: as instâncias de um mesmo desenho ficam
+    // contíguas no buffer.
+    queue->instances.resize(num_packets);
+    for (size_t d = 0, k = 0; d < num_draws; ++d)
+    {
+        const DrawPacket&  first = queue->packets[order[k].second];
+        const SceneObject& mesh  = *first.mesh;
+
+        // Bounding box e quantização das posições (veja "vertexformat.h")
+        DrawUniforms draw;
+        draw.bbox_min        = glm::vec4(mesh.bbox_min, 1.0f);
+        draw.bbox_max        = glm::vec4(mesh.bbox_max, 1.0f);
+        draw.position_offset = glm::vec4(mesh.position_offset, 0.0f);
+        draw.position_scale  = glm::vec4(mesh.position_scale, 0.0f);
+
+        size_t window = d / RENDER_QUEUE_DRAWS_PER_BLOCK;
+        size_t index  = d % RENDER_QUEUE_DRAWS_PER_BLOCK;
+        memcpy(&queue->uniforms[layout.draw_offset + window * layout.draw_stride + index * sizeof(DrawUniforms)], &draw, sizeof(DrawUniforms));
+
+        for (size_t n = 0; n < g_DrawSizes[d]; ++n, ++k)
+        {
+            const DrawPacket& packet = queue->packets[order[k].second];
+            queue->instances[k].model         = packet.model;
+            queue->instances[k].data          = packet.instance_data;
+            queue->instances[k].draw          = (GLint)index;
+            queue->instances[k].normal_matrix = packet.normal_matrix;
+        }
+    }
+    if ( num_packets > 0 )
+        UploadInstances(queue);
+
+    size_t uniform_offset = UploadUniforms(queue);
+    glBindBufferRange(GL_UNIFORM_BUFFER, RENDER_QUEUE_FRAME_BINDING, queue->uniform_buffer_id,
+                      uniform_offset, sizeof(FrameUniforms));
+
+    GlState gl;
+    gl.program          = -1;
+    gl.has_vertex_array = false;
+    gl.first_instance   = -1;
+    gl.draw_window      = -1;
+    gl.depth_test       = -1;
+    gl.cull_face        = -1;
+    gl.blend            = -1;
+
+    size_t changes = 2; // Envio dos uniforms e ligação de "FrameUniforms"
+    if ( num_packets > 0 )
+        changes += 1;   // Envio das instâncias
+    size_t draw_calls = 0;
+    size_t instanced_packets = 0;
+    int pass = -1;
+
+    size_t k = 0;
+    for (size_t d = 0; d < num_draws; ++d)
+    {
+        size_t i = order[k].second;
+        const DrawPacket&      packet  = queue->packets[i];
+        const RenderPassState& state   = queue->passes[packet.pass];
+        const RenderProgram&   program = queue->programs[packet.program];
+        size_t num_instances = g_DrawSizes[d];
+
+        // Estado e matrizes do passo
+        if ( packet.pass != pass )
+        {
+            if ( state.flags & RENDER_PASS_CLEAR_DEPTH )
+            {
+                glClear(GL_DEPTH_BUFFER_BIT);
+                changes += 1;
+            }
+            bool blend = (state.flags & RENDER_PASS_BLEND) != 0;
+            changes += SetCapability(GL_DEPTH_TEST, (state.flags & RENDER_PASS_DEPTH_TEST) != 0, &gl.depth_test);
+            changes += SetCapability(GL_CULL_FACE, (state.flags & RENDER_PASS_CULL_FACE) != 0, &gl.cull_face);
+            if ( blend && gl.blend != 1 )
+                glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+            changes += SetCapability(GL_BLEND, blend, &gl.blend);
+
+            glBindBufferRange(GL_UNIFORM_BUFFER, RENDER_QUEUE_PASS_BINDING, queue->uniform_buffer_id,
+                              uniform_offset + layout.pass_offset + packet.pass * layout.pass_stride, sizeof(PassUniforms));
+            changes += 1;
+            pass = packet.pass;
+        }
+
+        if ( gl.program != packet.program )
+        {
+            glUseProgram(program.program_id);
+            gl.program = packet.program;
+            changes += 1;
+        }
+
+        long window = (long)(d / RENDER_QUEUE_DRAWS_PER_BLOCK);
+        if ( gl.draw_window != window )
+        {
+            glBindBufferRange(GL_UNIFORM_BUFFER, RENDER_QUEUE_DRAW_BINDING, queue->uniform_buffer_id,
+                              uniform_offset + layout.draw_offset + window * layout.draw_stride,
+                              RENDER_QUEUE_DRAWS_PER_BLOCK * sizeof(DrawUniforms));
+            gl.draw_window = window;
+            changes += 1;
+        }
+
+        const SceneObject& mesh = *packet.mesh;
+        if ( !gl.has_vertex_array || gl.vertex_array_object_id != mesh.vertex_array_object_id )
+        {
+            glBindVertexArray(mesh.vertex_array_object_id);
+            EnableInstanceAttributes();
+            gl.vertex_array_object_id = mesh.vertex_array_object_id;
+            gl.has_vertex_array = true;
+            gl.first_instance = -1;
+            changes += 1;
+        }
+
+        if ( gl.first_instance != (long)k )
+        {
+            PointInstanceAttributes(k);
+            gl.first_instance = (long)k;
+            changes += 1;
+        }
+
+        // Os índices são relativos ao primeiro vértice do modelo, informado
+        // em "basevertex" (veja glDrawElementsBaseVertex()). Um desenho não
+        // instanciado lê os atributos da instância 0.
+        const DrawRange* ranges = &queue->ranges[queue->first_range[i]];
+        size_t num_ranges = queue->num_ranges[i];
+        if ( num_instances > 1 )
+        {
+            for (size_t r = 0; r < num_ranges; ++r)
+                glDrawElementsInstancedBaseVertex(mesh.rendering_mode, ranges[r].count, GL_UNSIGNED_INT,
+                                                  (void*)(ranges[r].first_index * sizeof(GLuint)),
+                                                  (GLsizei)num_instances, ranges[r].base_vertex);
+            draw_calls += num_ranges;
+            instanced_packets += num_instances - 1;
+        }
+        else if ( num_ranges == 1 )
+        {
+            glDrawElementsBaseVertex(mesh.rendering_mode, ranges[0].count, GL_UNSIGNED_INT,
+                                     (void*)(ranges[0].first_index * sizeof(GLuint)), ranges[0].base_vertex);
+            draw_calls += 1;
+        }
+        else if ( num_ranges > 1 )
+        {
+            g_Counts.resize(num_ranges);
+            g_Offsets.resize(num_ranges);
+            g_BaseVertices.resize(num_ranges);
+            for (size_t r = 0; r < num_ranges; ++r)
+            {
+                g_Counts[r]       = ranges[r].count;
+                g_Offsets[r]      = (void*)(ranges[r].first_index * sizeof(GLuint));
+                g_BaseVertices[r] = ranges[r].base_vertex;
+            }
+            glMultiDrawElementsBaseVertex(mesh.rendering_mode, g_Counts.data(), GL_UNSIGNED_INT, g_Offsets.data(),
+                                          (GLsizei)num_ranges, g_BaseVertices.data());
+            draw_calls += 1;
+        }
+
+        k += num_instances;
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    // A região do quadro no buffer de uniforms pode ser reescrita quando a
+    // GPU passar deste ponto.
+    queue->uniform_fences[queue->uniform_frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    queue->uniform_frame = (queue->uniform_frame + 1) % RENDER_QUEUE_UNIFORM_FRAMES;
+
+    // Estado padrão do restante do quadro
+    changes += SetCapability(GL_DEPTH_TEST, true, &gl.depth_test);
+    changes += SetCapability(GL_CULL_FACE, true, &gl.cull_face);
+    changes += SetCapability(GL_BLEND, false, &gl.blend);
+
+    size_t naive = NaiveStateChanges(*queue);
+
+    queue->stats.packets             = num_packets;
+    queue->stats.instanced_packets   = instanced_packets;
+    queue->stats.draw_calls          = draw_calls;
+    queue->stats.state_changes       = changes;
+    queue->stats.state_changes_saved = (naive > changes) ? naive - changes : 0;
+
+    queue->packets.clear();
+    queue->first_range.clear();
+    queue->num_ranges.clear();
+    queue->ranges.clear();
+}
@@ -0,0 +1,145 @@
+#include <algorithm>
+
+#include "scenegeometry.h"
+
+namespace
+{
+    // Capacidades mínimas alocadas no primeiro crescimento dos buffers
+    const size_t MIN_VERTEX_CAPACITY = 64*1024;
+    const size_t MIN_INDEX_CAPACITY  = 256*1024;
+
+    // Troca "buffer" por um buffer maior, preservando os primeiros
+    // "used_bytes" bytes do conteúdo antigo.
+    void GrowBuffer(GLuint* buffer, size_t used_bytes, size_t new_size_bytes)
+    {
+        GLuint new_buffer;
+        glGenBuffers(1, &new_buffer);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, new_buffer);
+        glBufferData(GL_COPY_WRITE_BUFFER, new_size_bytes, NULL, GL_STATIC_DRAW);
+
+        if ( *buffer != 0 )
+        {
+            if ( used_bytes > 0 )
+            {
+                glBindBuffer(GL_COPY_READ_BUFFER, *buffer);
+                glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, used_bytes);
+                glBindBuffer(GL_COPY_READ_BUFFER, 0);
+            }
+            glDeleteBuffers(1, buffer);
+        }
+
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        *buffer = new_buffer;
+    }
+
+    // Aponta os atributos do VAO para os buffers atuais. Necessário sempre que
+    // um dos buffers é trocado por GrowBuffer().
+    void SetupVertexArray(const SceneGeometry& geometry)
+    {
+        glBindVertexArray(geometry.vertex_array_object_id);
+
+        glBindBuffer(GL_ARRAY_BUFFER, geometry.vertex_buffer_id);
+        GLsizei stride = sizeof(PackedVertex);
+        GLuint location = 0; // "(location = 0)" em "shader_vertex.glsl"
+        glVertexAttribPointer(location, 3, GL_UNSIGNED_SHORT, GL_TRUE, stride, (void*)offsetof(PackedVertex, position));
+        glEnableVertexAttribArray(location);
+        location = 1; // "(location = 1)" em "shader_vertex.glsl"
+        glVertexAttribPointer(location, 4, GL_INT_2_10_10_10_REV, GL_TRUE, stride, (void*)offsetof(PackedVertex, normal));
+        glEnableVertexAttribArray(location);
+        location = 2; // "(location = 2)" em "shader_vertex.glsl"
+        glVertexAttribPointer(location, 2, GL_HALF_FLOAT, GL_FALSE, stride, (void*)offsetof(PackedVertex, texcoords));
+        glEnableVertexAttribArray(location);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+        // O GL_ELEMENT_ARRAY_BUFFER faz parte do estado do VAO e não deve ser
+        // desligado enquanto o VAO estiver ligado.
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, geometry.index_buffer_id);
+
+        glBindVertexArray(0);
+    }
+
+    // Garante espaço para mais "count" índices no buffer de índices. Retorna
+    // true se o buffer foi trocado.
+    bool ReserveIndices(SceneGeometry* geometry, size_t count)
+    {
+        if ( geometry->num_indices + count <= geometry->index_capacity )
+            return false;
+
+        size_t capacity = std::max(std::max(2*geometry->index_capacity, MIN_INDEX_CAPACITY), geometry->num_indices + count);
+        GrowBuffer(&geometry->index_buffer_id, geometry->num_indices * sizeof(GLuint), capacity * sizeof(GLuint));
+        geometry->index_capacity = capacity;
+        return true;
+    }
+
+    // Copia "count" índices para o final do buffer de índices, que deve ter
+    // espaço para eles.
+    void WriteIndices(SceneGeometry* geometry, const GLuint* indices, size_t count)
+    {
+        // Usamos GL_COPY_WRITE_BUFFER para não alterar o GL_ELEMENT_ARRAY_BUFFER
+        // de um VAO que esteja ligado.
+        glBindBuffer(GL_COPY_WRITE_BUFFER, geometry->index_buffer_id);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, geometry->num_indices * sizeof(GLuint), count * sizeof(GLuint), indices);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    }
+}
+
+void SceneGeometry_Init(SceneGeometry* geometry)
+{
+    geometry->vertex_buffer_id = 0;
+    geometry->index_buffer_id  = 0;
+    geometry->num_vertices     = 0;
+    geometry->vertex_capacity  = 0;
+    geometry->num_indices      = 0;
+    geometry->index_capacity   = 0;
+
+    glGenVertexArrays(1, &geometry->vertex_array_object_id);
+}
+
+void SceneGeometry_Append(SceneGeometry* geometry, const MeshView& mesh, GLint* base_vertex, size_t* first_index)
+{
+    bool buffers_changed = false;
+
+    if ( geometry->num_vertices + mesh.num_vertices > geometry->vertex_capacity )
+    {
+        size_t capacity = std::max(std::max(2*geometry->vertex_capacity, MIN_VERTEX_CAPACITY), geometry->num_vertices + mesh.num_vertices);
+        GrowBuffer(&geometry->vertex_buffer_id, geometry->num_vertices * sizeof(PackedVertex), capacity * sizeof(PackedVertex));
+        geometry->vertex_capacity = capacity;
+        buffers_changed = true;
+    }
+
+    if ( ReserveIndices(geometry, mesh.num_indices) )
+        buffers_changed = true;
+
+    if ( buffers_changed )
+        SetupVertexArray(*geometry);
+
+    glBindBuffer(GL_ARRAY_BUFFER, geometry->vertex_buffer_id);
+    glBufferSubData(GL_ARRAY_BUFFER, geometry->num_vertices * sizeof(PackedVertex), mesh.num_vertices * sizeof(PackedVertex), mesh.vertices);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    WriteIndices(geometry, mesh.indices, mesh.num_indices);
+
+    *base_vertex = (GLint)geometry->num_vertices;
+    *first_index = geometry->num_indices;
+
+    geometry->num_vertices += mesh.num_vertices;
+    geometry->num_indices  += mesh.num_indices;
+}
+
+void SceneGeometry_AppendIndices(SceneGeometry* geometry, const GLuint* indices, size_t count, size_t* first_index)
+{
+    if ( ReserveIndices(geometry, count) )
+        SetupVertexArray(*geometry);
+
+    WriteIndices(geometry, indices, count);
+
+    *first_index = geometry->num_indices;
+    geometry->num_indices += count;
+}
+
+void SceneGeometry_ReadIndices(const SceneGeometry& geometry, size_t first_index, size_t count, GLuint* indices)
+{
+    glBindBuffer(GL_COPY_READ_BUFFER, geometry.index_buffer_id);
+    glGetBufferSubData(GL_COPY_READ_BUFFER, first_index * sizeof(GLuint), count * sizeof(GLuint), indices);
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+}
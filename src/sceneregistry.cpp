@@ -0,0 +1,33 @@
+#include <cstdio>
+#include <cstdlib>
+
+#include "sceneregistry.h"
+
+SceneObjectHandle SceneRegistry_Add(SceneRegistry* registry, const SceneObject& object)
+{
+    uint64_t name = SceneName(object.name.c_str());
+
+    std::map<uint64_t, SceneObjectHandle>::const_iterator it = registry->names.find(name);
+    if ( it != registry->names.end() )
+    {
+        SceneObject& existing = registry->objects[it->second];
+        if ( existing.name != object.name )
+        {
+            fprintf(stderr, "ERROR: Scene objects \"%s\" and \"%s\" have the same name hash.\n", existing.name.c_str(), object.name.c_str());
+            std::exit(EXIT_FAILURE);
+        }
+        existing = object;
+        return it->second;
+    }
+
+    SceneObjectHandle handle = (SceneObjectHandle)registry->objects.size();
+    registry->objects.push_back(object);
+    registry->names[name] = handle;
+    return handle;
+}
+
+SceneObjectHandle SceneRegistry_Find(const SceneRegistry& registry, uint64_t name)
+{
+    std::map<uint64_t, SceneObjectHandle>::const_iterator it = registry.names.find(name);
+    return (it != registry.names.end()) ? it->second : INVALID_SCENE_OBJECT;
+}
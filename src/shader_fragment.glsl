@@ -16,13 +16,73 @@ in vec2 texcoords;
 // usando Gouraud Shading
 in vec4 cor_tiro;
 
-// Matrizes computadas no código C++ e enviadas para a GPU
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+// Matriz que transforma as normais do modelo para o sistema global e valor
+// adicional da instância (veja "shader_vertex.glsl"), que define "smoke_life"
+// e "alpha" abaixo.
+flat in mat4 normal_matrix;
+flat in float instance_value;
+flat in int draw_index;
+
+// Matrizes computadas no código C++ e enviadas para a GPU, uma vez por passo
+layout (std140) uniform PassUniforms
+{
+    mat4 view;
+    mat4 projection;
+    vec4 camera_position; // Igual a inverse(view)*[0,0,0,1], computada na CPU
+};
 
-// Identificador que define qual objeto está sendo desenhado no momento
-#define SPHERE 0
+// Valores do quadro (veja FrameUniforms em "renderqueue.h")
+layout (std140) uniform FrameUniforms
+{
+    int lanterna_ligada;
+    int nozzle_flash;
+    int tela_de_menu;
+    int sombra_lanterna; // Mapa de sombras da lanterna válido no quadro
+    mat4 shadow_matrix;  // Leva o sistema global ao mapa de sombras (veja ShadowMap_Matrix())
+};
+
+// Dados de cada desenho (veja "shader_vertex.glsl")
+#define MAX_DRAWS 128
+struct DrawUniforms
+{
+    vec4 bbox_min;
+    vec4 bbox_max;
+    vec4 position_offset;
+    vec4 position_scale;
+};
+layout (std140) uniform DrawBlock
+{
+    DrawUniforms draws[MAX_DRAWS];
+};
+
+// Luzes dinâmicas (veja "lightclusters.h"). MAX_LIGHTS e CLUSTERS_* devem
+// ser iguais a LIGHT_CLUSTERS_MAX_LIGHTS e LIGHT_CLUSTERS_*.
+#define MAX_LIGHTS 64
+#define CLUSTERS_X 16
+#define CLUSTERS_Y 9
+#define CLUSTERS_Z 24
+struct Luz
+{
+    vec4 position; // Posição (xyz) e alcance (w)
+    vec4 color;
+    vec4 spot;     // Direção do cone (xyz) e cosseno do seu ângulo (w); w < -1 em luzes pontuais
+};
+layout (std140) uniform LightBlock
+{
+    vec4 cluster_scale; // x,y: clusters por pixel; z,w: fatia = log(profundidade)*z + w
+    int  num_lights;
+    Luz  lights[MAX_LIGHTS];
+};
+
+// Listas de luzes dos clusters: "cluster_grid" guarda a posição da lista de
+// cada cluster em "cluster_lights" e o seu tamanho.
+uniform usamplerBuffer cluster_grid;
+uniform usamplerBuffer cluster_lights;
+
+// Materiais. Cada material é compilado em um programa separado, com
+// "#define MATERIAL <material>" inserido antes deste código (veja
+// LoadShadersFromFiles() em "main.cpp"), e executa apenas o seu próprio
+// código.
 #define BULLET 1
 #define PLANE  2
 #define FLASHLIGHT  3
@@ -36,16 +96,33 @@ uniform mat4 projection;
 #define CARRO 11
 #define TELA_FINAL 12
 #define TELA_FINAL2 13
-
-uniform int object_id;
-
-// Parâmetros da axis-aligned bounding box (AABB) do modelo
-uniform vec4 bbox_min;
-uniform vec4 bbox_max;
+#define TRONCO 14
+
+#ifndef MATERIAL
+#error "MATERIAL deve ser definido (veja LoadShadersFromFiles() em main.cpp)"
+#endif
+
+// Materiais que usam o modelo de iluminação (termos ambiente, difuso e
+// especular e a lanterna)
+#if MATERIAL != BULLET && MATERIAL != SCREEN && MATERIAL != SMOKE && MATERIAL != TELA_FINAL && MATERIAL != TELA_FINAL2
+#define ILUMINADO
+#endif
+
+// Materiais iluminados pelas luzes dinâmicas. Os objetos segurados pelo
+// jogador são desenhados com a câmera na origem e recebem apenas o flash do
+// tiro ("nozzle_flash").
+#if defined(ILUMINADO) && MATERIAL != FLASHLIGHT && MATERIAL != REVOLVER
+#define LUZES_DINAMICAS
+#endif
+
+// Materiais que recebem as sombras da lanterna. Os objetos segurados pelo
+// jogador ficam sempre iluminados.
+#if defined(ILUMINADO) && MATERIAL != FLASHLIGHT && MATERIAL != REVOLVER
+#define SOMBRA_LANTERNA
+#endif
 
 // Variáveis para acesso das imagens de textura
 uniform sampler2D chao;
-uniform sampler2D ceu;
 uniform sampler2D lanterna;
 uniform sampler2D crosshair;
 uniform sampler2D skull_diff;
@@ -53,42 +130,47 @@ uniform sampler2D smoke;
 uniform sampler2D bark;
 uniform sampler2D folhas;
 uniform sampler2D cabine_diff;
-uniform sampler2D car_BL1;
-uniform sampler2D car_BL2;
-uniform sampler2D car_GL;
-uniform sampler2D car_HL;
-uniform sampler2D car_BL;
-uniform sampler2D car_Plaque;
-uniform sampler2D car_Logo;
-uniform sampler2D car_Tire;
+uniform sampler2D car_atlas; // Todas as partes do carro (veja "textureatlas.h")
 uniform sampler2D tela_fim_de_jogo;
 uniform sampler2D tela_game_over;
 
 
-// Mapa de normais
+// Mapa de normais (apenas os componentes x e y, veja amostra_normal())
 uniform sampler2D chao_normal;
 uniform sampler2D skull_normal;
 uniform sampler2D cabine_normal;
 
-// Mapa de especular
+// Mapa de especular (um único canal)
 uniform sampler2D cabine_spec;
 
+// Mapa de sombras da lanterna (veja "shadowmap.h"), com comparação de
+// profundidade
+uniform sampler2DShadow mapa_de_sombra;
+
 // O valor de saída ("out") de um Fragment Shader é a cor final do fragmento.
 out vec4 color;
 
 // Função para a lanterna
 float luz_lanterna(vec4 l, vec4 sv, float potencia);
 
+#ifdef LUZES_DINAMICAS
+// Iluminação das luzes dinâmicas do cluster do fragmento
+vec3 luzes_dinamicas(vec4 p, vec4 n, vec4 v, vec3 Kd, vec3 Ks, float q);
+#endif
+
+#ifdef SOMBRA_LANTERNA
+// Fração da luz da lanterna que alcança o ponto p (0 na sombra)
+float sombra_da_lanterna(vec4 p);
+#endif
+
+// Amostra de um mapa de normais
+vec4 amostra_normal(sampler2D mapa, vec2 uv);
+
 // Parâmetros criados:
-uniform int lanterna_ligada;
-uniform int smoke_life;
+int smoke_life;
 int potencia_lanterna;
-uniform int nozzle_flash;
 bool opaco=false;
-uniform bool tronco;
-uniform int parte_carro;
-uniform bool tela_de_menu;
-uniform int alpha; // alpha da tela final q vai ficando deixando a tela escura aos poucos
+int alpha; // alpha da tela final q vai ficando deixando a tela escura aos poucos
 float alpha_float;
 
 // Constantes
@@ -97,10 +179,18 @@ float alpha_float;
 
 void main()
 {
-    // Obtemos a posição da câmera utilizando a inversa da matriz que define o
-    // sistema de coordenadas da câmera.
-    vec4 origin = vec4(0.0, 0.0, 0.0, 1.0);
-    vec4 camera_position = inverse(view) * origin;
+    // Parâmetros do objeto recebidos por instância
+    smoke_life = int(instance_value);
+    alpha = int(instance_value);
+
+    // A posição da câmera, "camera_position", é computada uma vez por passo
+    // na CPU (veja Matrix_Camera_Position() em "matrices.h").
+#ifdef INVERSAS_NA_GPU
+    // Versão anterior, com a inversa por fragmento, mantida apenas para a
+    // comparação da opção "--gpu-inverses" (veja RunFillRateBenchmark() em
+    // "main.cpp").
+    vec4 camera_position = inverse(view) * vec4(0.0, 0.0, 0.0, 1.0);
+#endif
     vec4 cameraForward = vec4(view[0][2], view[1][2], view[2][2], 0.0f);
 
     // O fragmento atual é coberto por um ponto que percente à superfície de um
@@ -141,183 +231,130 @@ void main()
     float theta, phi, px, py, pz;
 
     // == CENÁRIO ==
-    if ( object_id == SPHERE )
-    {
-        opaco = true;
-        vec4 bbox_center = (bbox_min + bbox_max) / 2.0;
-
-        vec4 r = position_model - bbox_center;
-
-        theta = atan(position_model.x,position_model.z);
-        phi   = asin(position_model.y/length(r));
-
-        U = (theta+M_PI)/(2*M_PI);
-        V = (phi+M_PI_2)/M_PI;
-
-        // Propriedades espectrais da esfera skybox
-        Kd = vec3(0.0,0.0,0.0);
-        Ks = vec3(0.0,0.0,0.0);
-        Ka = vec3(0.2,0.02,0.02);
-        q = 1.0;
-    }
-    else if ( object_id == PLANE )
-    {
-        opaco = true;
-        vec2 texcoordsRepetidas = fract(texcoords*250); // Coordenadas repetidas do plano de chao
-
-        // Coordenadas de textura do plano, obtidas do arquivo OBJ.
-        U = texcoordsRepetidas[0];
-        V = texcoordsRepetidas[1];
-
-        // Propriedades espectrais do chão
-        Kd = vec3(0.1,0.1,0.1);
-        Ks = vec3(0.5,0.5,0.5);
-        Ka = vec3(0.09,0.01,0.01);
-        q = 80.0;
-
-        n = normalize(inverse(transpose(model)) * texture(chao_normal, vec2(U,V)));
-    }
-    else if ( object_id == ARVORE )
-    {
-        opaco = true;
-        // Propriedades espectrais da lanterna
-        Kd = vec3(0.1,0.1,0.1);
-        Ks = vec3(0.5,0.5,0.5);
-        Ka = vec3(0.09,0.01,0.01);
-        q = 30.0;
-        U = texcoords.x;
-        V = texcoords.y;
-
-        if(tronco)
-        {
-            vec4 bbox_center = (bbox_min + bbox_max) / 2.0;
-
-            vec4 r = position_model - bbox_center;
-
-            theta = atan(position_model.x,position_model.z);
-            phi   = asin(position_model.y/length(r));
-
-            U = (theta+M_PI)/(2*M_PI);
-            V = (phi+M_PI_2)/M_PI;
-        }
-    }
-    else if ( object_id == CABINE )
-    {
-        opaco = true;
-        // Propriedades espectrais do chão
-        Kd = vec3(0.1,0.1,0.1);
-        Ks = texture(cabine_spec, vec2(U,V)).rgb;
-        Ka = vec3(0.09,0.01,0.01);
-        q = 30.0;
-
-        U = texcoords.x;
-        V = texcoords.y;
-    }
-    else if ( object_id == CARRO )
-    {
-        opaco = true;
-        // Propriedades espectrais do chão
-        Kd = vec3(0.1,0.1,0.1);
-        Ks = vec3(0.9,0.5,0.5);
-        Ka = vec3(0.09,0.01,0.01);
-        q = 30.0;
-
-        U = texcoords.x;
-        V = texcoords.y;
-    }
+    // (o céu é desenhado por "shader_sky_fragment.glsl")
+#if MATERIAL == PLANE
+    opaco = true;
+    vec2 texcoordsRepetidas = fract(texcoords*250); // Coordenadas repetidas do plano de chao
+
+    // Coordenadas de textura do plano, obtidas do arquivo OBJ.
+    U = texcoordsRepetidas[0];
+    V = texcoordsRepetidas[1];
+
+    // Propriedades espectrais do chão
+    Kd = vec3(0.1,0.1,0.1);
+    Ks = vec3(0.5,0.5,0.5);
+    Ka = vec3(0.09,0.01,0.01);
+    q = 80.0;
+
+    n = normalize(normal_matrix * amostra_normal(chao_normal, vec2(U,V)));
+#elif MATERIAL == ARVORE || MATERIAL == TRONCO
+    opaco = true;
+    // Propriedades espectrais da lanterna
+    Kd = vec3(0.1,0.1,0.1);
+    Ks = vec3(0.5,0.5,0.5);
+    Ka = vec3(0.09,0.01,0.01);
+    q = 30.0;
+    U = texcoords.x;
+    V = texcoords.y;
+
+  #if MATERIAL == TRONCO
+    // Parâmetros da axis-aligned bounding box (AABB) do modelo
+    vec4 bbox_min = draws[draw_index].bbox_min;
+    vec4 bbox_max = draws[draw_index].bbox_max;
+    vec4 bbox_center = (bbox_min + bbox_max) / 2.0;
+
+    vec4 raio = position_model - bbox_center;
+
+    theta = atan(position_model.x,position_model.z);
+    phi   = asin(position_model.y/length(raio));
+
+    U = (theta+M_PI)/(2*M_PI);
+    V = (phi+M_PI_2)/M_PI;
+  #endif
+#elif MATERIAL == CABINE
+    opaco = true;
+    // Propriedades espectrais do chão
+    Kd = vec3(0.1,0.1,0.1);
+    Ks = texture(cabine_spec, vec2(U,V)).rrr;
+    Ka = vec3(0.09,0.01,0.01);
+    q = 30.0;
+
+    U = texcoords.x;
+    V = texcoords.y;
+#elif MATERIAL == CARRO
+    opaco = true;
+    // Propriedades espectrais do chão
+    Kd = vec3(0.1,0.1,0.1);
+    Ks = vec3(0.9,0.5,0.5);
+    Ka = vec3(0.09,0.01,0.01);
+    q = 30.0;
+
+    U = texcoords.x;
+    V = texcoords.y;
     // == JOGADOR ==
-    else if ( object_id == FLASHLIGHT )
+#elif MATERIAL == FLASHLIGHT || MATERIAL == REVOLVER
+    opaco = true;
+    // Propriedades espectrais da lanterna e do revolver
+    Kd = vec3(0.0,0.0,0.0);
+    Ks = vec3(0.0,0.0,0.0);
+    Ka = vec3(1,1,1);
+    q = 1.0;
+    U = texcoords.x;
+    V = texcoords.y;
+#elif MATERIAL == SCREEN
+    // Coordenadas de textura da tela, obtidas do arquivo OBJ.
+    U = texcoords.x;
+    V = texcoords.y;
+#elif MATERIAL == BULLET
+    color = cor_tiro;
+#elif MATERIAL == SMOKE
+    // Seleciona qual textura da partícula de fumaça usar, baseado na sua vida
+    if(smoke_life <= 8)
     {
-        opaco = true;
-        // Propriedades espectrais da lanterna
-        Kd = vec3(0.0,0.0,0.0);
-        Ks = vec3(0.0,0.0,0.0);
-        Ka = vec3(1,1,1);
-        q = 1.0;
-        U = texcoords.x;
-        V = texcoords.y;
+        U = (texcoords.x/8)+smoke_life*0.125;
+        V = (texcoords.y/8)+0.875f;
     }
-    else if ( object_id == REVOLVER )
+    else if(smoke_life <= 16&&smoke_life > 8)
     {
-        opaco = true;
-        // Propriedades espectrais do revolver
-        Kd = vec3(0.0,0.0,0.0);
-        Ks = vec3(0.0,0.0,0.0);
-        Ka = vec3(1,1,1);
-        q = 1.0;
-        U = texcoords.x;
-        V = texcoords.y;
+        U = (texcoords.x/8)+(smoke_life-8)*0.125;
+        V = (texcoords.y/8)+0.75f;
     }
-    else if ( object_id == SCREEN )
+    else if(smoke_life <= 32&&smoke_life > 16)
     {
-        // Coordenadas de textura da tela, obtidas do arquivo OBJ.
-        U = texcoords.x;
-        V = texcoords.y;
+        U = (texcoords.x/8)+(smoke_life-16)*0.125;
+        V = (texcoords.y/8)+0.625f;
     }
-    else if ( object_id == BULLET )
+    else if(smoke_life <= 40&&smoke_life > 32)
     {
-        color = cor_tiro;
+        U = (texcoords.x/8)+(smoke_life-32)*0.125;
+        V = (texcoords.y/8)+0.5f;
     }
-    else if ( object_id == SMOKE )
+    else if(smoke_life > 40)
     {
-        // Seleciona qual textura da partícula de fumaça usar, baseado na sua vida
-        if(smoke_life <= 8)
-        {
-            U = (texcoords.x/8)+smoke_life*0.125;
-            V = (texcoords.y/8)+0.875f;
-        }
-        else if(smoke_life <= 16&&smoke_life > 8)
-        {
-            U = (texcoords.x/8)+(smoke_life-8)*0.125;
-            V = (texcoords.y/8)+0.75f;
-        }
-        else if(smoke_life <= 32&&smoke_life > 16)
-        {
-            U = (texcoords.x/8)+(smoke_life-16)*0.125;
-            V = (texcoords.y/8)+0.625f;
-        }
-        else if(smoke_life <= 40&&smoke_life > 32)
-        {
-            U = (texcoords.x/8)+(smoke_life-32)*0.125;
-            V = (texcoords.y/8)+0.5f;
-        }
-        else if(smoke_life > 40)
-        {
-            U = (texcoords.x/8)+(smoke_life-40)*0.125;
-            V = (texcoords.y/8)+0.375f;
-        }
+        U = (texcoords.x/8)+(smoke_life-40)*0.125;
+        V = (texcoords.y/8)+0.375f;
     }
     // == FANTASMAS ==
-    else if ( object_id == SKULL )
-    {
-        U = texcoords.x;
-        V = texcoords.y;
-        // Propriedades espectrais da caveira
-        Kd = vec3(0.8,0.8,0.8);
-        Ks = vec3(0.8,0.8,0.8);
-        Ka = vec3(1,1,1);
-        q = 25.0;
-    }
-    else if ( object_id == EYE )
-    {
-        // Propriedades espectrais dos olhos
-        Kd = vec3(0.3,0.3,0.3);
-        Ks = vec3(0.3,0.3,0.3);
-        Ka = vec3(0.01,0.01,0.01);
-        q = 25.0;
-    }
-    else if ( object_id == TELA_FINAL)
-    {
-        U = texcoords.x;
-        V = texcoords.y;
-    }
-
-    else if ( object_id == TELA_FINAL2)
-    {
-        U = texcoords.x;
-        V = texcoords.y;
-    }
-
+#elif MATERIAL == SKULL
+    U = texcoords.x;
+    V = texcoords.y;
+    // Propriedades espectrais da caveira
+    Kd = vec3(0.8,0.8,0.8);
+    Ks = vec3(0.8,0.8,0.8);
+    Ka = vec3(1,1,1);
+    q = 25.0;
+#elif MATERIAL == EYE
+    // Propriedades espectrais dos olhos
+    Kd = vec3(0.3,0.3,0.3);
+    Ks = vec3(0.3,0.3,0.3);
+    Ka = vec3(0.01,0.01,0.01);
+    q = 25.0;
+#elif MATERIAL == TELA_FINAL || MATERIAL == TELA_FINAL2
+    U = texcoords.x;
+    V = texcoords.y;
+#endif
+
+#ifdef ILUMINADO
     // Espectro da fonte de iluminação
     vec3 I = vec3(1.0,1.0,1.0); // Espectro da fonte de luz
 
@@ -338,106 +375,79 @@ void main()
     else
         potencia_lanterna = 0;
 
+#ifdef SOMBRA_LANTERNA
+    float sombra = sombra_da_lanterna(p);
+#else
+    float sombra = 1.0;
+#endif
+
     // Define a iluminação dos objetos pela lanterna (A = Ambiente, D = Difusa, S = Difusa + Especular)
     vec3 A = ambient_term;
-    vec3 D = lambert_diffuse_term * 0.5 * luz_lanterna(l, sv, potencia_lanterna);
-    vec3 S = (lambert_diffuse_term * 0.5 + phong_specular_term) * luz_lanterna(l, sv, potencia_lanterna);
+    vec3 D = lambert_diffuse_term * 0.5 * luz_lanterna(l, sv, potencia_lanterna) * sombra;
+    vec3 S = (lambert_diffuse_term * 0.5 + phong_specular_term) * luz_lanterna(l, sv, potencia_lanterna) * sombra;
+#ifdef LUZES_DINAMICAS
+    // Clarão dos tiros, olhos dos fantasmas e faróis do carro
+    vec3 NF = luzes_dinamicas(p, n, v, Kd, Ks, q);
+#else
     vec3 NF = ambient_term*nozzle_flash*5;
+#endif
 
-    if(tela_de_menu)
+    if(tela_de_menu != 0)
     {
         A = A*1000;
     }
+#endif
 
     // Define a textura dos objetos opacos
     if(opaco)
         color.a = 1;
 
     // == CENÁRIO ==
-    if( object_id == SPHERE )
-        color.rgb = texture(ceu, vec2(U,V)).rgb*(2*A);
-    else if( object_id == PLANE )
-        color.rgb = texture(chao, vec2(U,V)).rgb*(A+D+NF);
-    else if( object_id == CABINE )
-        color.rgb = texture(cabine_diff, vec2(U,V)).rgb*(A+D+S+NF);
-    else if( object_id == CARRO )
-        {
-            if(parte_carro == 1)
-                color.rgb = vec3(0.2,0.2,0.9).rgb;
-            else if(parte_carro == 2)
-                color.rgb = vec3(0.0,0.0,0.0).rgb;
-            else if(parte_carro == 3)
-                color.rgb = texture(car_Logo, vec2(U,V)).rgb;
-            else if(parte_carro == 4)
-                color.rgb = texture(car_Plaque, vec2(U,V)).rgb;
-            else if(parte_carro == 5)
-                color.rgb = texture(car_GL, vec2(U,V)).rgb;
-            else if(parte_carro == 6)
-                color.rgb = texture(car_BL1, vec2(U,V)).rgb;
-            else if(parte_carro == 7)
-                color.rgb = texture(car_BL2, vec2(U,V)).rgb;
-            else if(parte_carro == 8)
-                color.rgb = texture(car_Tire, vec2(U,V)).rgb;
-
-            color.rgb*=(A+D+S+NF);
-        }
-    else if( object_id == ARVORE && tronco )
-        color.rgb = texture(bark, vec2(U,V)).rgb*(A+D+NF);
-    else if( object_id == ARVORE && tronco == false )
-    {
-            color.rgb = texture(folhas, vec2(U,V)).rgb*(A+D+NF);
-            if(texture(folhas, vec2(U,V)).r > 0.3)
-                discard;
-    }
+#if MATERIAL == PLANE
+    color.rgb = texture(chao, vec2(U,V)).rgb*(A+D+NF);
+#elif MATERIAL == CABINE
+    color.rgb = texture(cabine_diff, vec2(U,V)).rgb*(A+D+S+NF);
+#elif MATERIAL == CARRO
+    color.rgb = texture(car_atlas, vec2(U,V)).rgb*(A+D+S+NF);
+#elif MATERIAL == TRONCO
+    color.rgb = texture(bark, vec2(U,V)).rgb*(A+D+NF);
+#elif MATERIAL == ARVORE
+    vec4 folha = texture(folhas, vec2(U,V));
+    color.rgb = folha.rgb*(A+D+NF);
+    if(folha.a < 0.5 || folha.r > 0.3)
+        discard;
 
     // == JOGADOR ==
-    else if( object_id == FLASHLIGHT )
-        color.rgb = texture(lanterna, vec2(U,V)).rgb*(3*A+NF);
-    else if( object_id == REVOLVER )
-        color.rgb = texture(lanterna, vec2(U,V)).rgb*(3*A+NF);
-    /*else if( object_id == BULLET )
-        color.rgb = vec3(1.0f,1.0f,0.0f)*(A+D+S);*/
-    else if( object_id == SMOKE )
-    {
-        color.rgb = texture(smoke, vec2(U,V)).rgb;
-        color.a = 0.2;
-        if(color.r > 0.2&&color.b < 0.1)
-            discard;
-    }
-    else if( object_id == SCREEN ){
-        color.rgb = texture(crosshair, vec2(U,V)).rgb;
-        if (color.r < 0.1f)
-            discard;
-    }
+#elif MATERIAL == FLASHLIGHT || MATERIAL == REVOLVER
+    color.rgb = texture(lanterna, vec2(U,V)).rgb*(3*A+NF);
+#elif MATERIAL == SMOKE
+    color.rgb = texture(smoke, vec2(U,V)).rgb;
+    color.a = 0.2;
+    if(color.r > 0.2&&color.b < 0.1)
+        discard;
+#elif MATERIAL == SCREEN
+    color.rgb = texture(crosshair, vec2(U,V)).rgb;
+    if (color.r < 0.1f)
+        discard;
 
     // == FANTASMAS ==
-    else if( object_id == SKULL )
-    {
-        color.rgb = texture(skull_diff, vec2(U,V)).rgb*(S+D+NF);
-        color.a = nozzle_flash+0.2*luz_lanterna(l, sv, potencia_lanterna);
-    }
-    else if( object_id == EYE )
-    {
-        color.rgb = vec3(0.9f,0.9f,0.0f)*(0.1-S-D);
-        color.a = 0.2+luz_lanterna(l, sv, potencia_lanterna);
-    }
-
-    else if ( object_id == TELA_FINAL)
-    {
-        color.rgb = texture(tela_fim_de_jogo, vec2(U,V)).rgb;
-        alpha_float = float(alpha*0.002);
-        color.a = alpha_float;
-
-    }
-
-    else if ( object_id == TELA_FINAL2)
-    {
-        color.rgb = texture(tela_game_over, vec2(U,V)).rgb;
-        alpha_float = float(alpha*0.002);
-        color.a = alpha_float;
-
-    }
-
+#elif MATERIAL == SKULL
+    color.rgb = texture(skull_diff, vec2(U,V)).rgb*(S+D+NF);
+    color.a = nozzle_flash+0.2*luz_lanterna(l, sv, potencia_lanterna)*sombra;
+#elif MATERIAL == EYE
+    color.rgb = vec3(0.9f,0.9f,0.0f)*(0.1-S-D);
+    color.a = 0.2+luz_lanterna(l, sv, potencia_lanterna);
+
+#elif MATERIAL == TELA_FINAL
+    color.rgb = texture(tela_fim_de_jogo, vec2(U,V)).rgb;
+    alpha_float = float(alpha*0.002);
+    color.a = alpha_float;
+
+#elif MATERIAL == TELA_FINAL2
+    color.rgb = texture(tela_game_over, vec2(U,V)).rgb;
+    alpha_float = float(alpha*0.002);
+    color.a = alpha_float;
+#endif
     // Cor final com correção gamma, considerando monitor sRGB.
     // Veja https://en.wikipedia.org/w/index.php?title=Gamma_correction&oldid=751281772#Windows.2C_Mac.2C_sRGB_and_TV.2Fvideo_standard_gammas
     color.rgb = pow(color.rgb, vec3(1.0,1.0,1.0)/2.2);
@@ -458,3 +468,72 @@ float luz_lanterna(vec4 l, vec4 sv, float potencia)
 
     return resultado * potencia;
 }
+
+#ifdef SOMBRA_LANTERNA
+float sombra_da_lanterna(vec4 p)
+{
+    if (sombra_lanterna == 0)
+        return 1.0;
+
+    // Pontos atrás da lanterna ou fora do mapa não recebem sombra
+    vec4 q = shadow_matrix * p;
+    if (q.w <= 0.0)
+        return 1.0;
+    q.xyz /= q.w;
+    if (any(lessThan(q.xyz, vec3(0.0))) || any(greaterThan(q.xyz, vec3(1.0))))
+        return 1.0;
+
+    // A filtragem linear da textura compara os quatro texels vizinhos
+    return texture(mapa_de_sombra, q.xyz);
+}
+#endif
+
+#ifdef LUZES_DINAMICAS
+// Largura da transição entre o interior e o exterior do cone das luzes spot,
+// em cosseno do ângulo
+#define SPOT_SUAVIZACAO 0.05
+
+// Soma, para as luzes que alcançam o cluster do fragmento, dos termos difuso
+// de Lambert e especular de Phong. O cluster é dado pela posição do
+// fragmento na tela e pela sua profundidade (veja "lightclusters.cpp").
+vec3 luzes_dinamicas(vec4 p, vec4 n, vec4 v, vec3 Kd, vec3 Ks, float q)
+{
+    float profundidade = -(view * p).z;
+    int fatia = int(floor(log(max(profundidade, 1e-4)) * cluster_scale.z + cluster_scale.w));
+    ivec3 c = clamp(ivec3(ivec2(gl_FragCoord.xy * cluster_scale.xy), fatia), ivec3(0), ivec3(CLUSTERS_X-1, CLUSTERS_Y-1, CLUSTERS_Z-1));
+    uvec2 lista = texelFetch(cluster_grid, (c.z * CLUSTERS_Y + c.y) * CLUSTERS_X + c.x).rg;
+
+    vec3 resultado = vec3(0.0);
+    for (uint i = 0u; i < lista.y; ++i)
+    {
+        Luz luz = lights[int(texelFetch(cluster_lights, int(lista.x + i)).r)];
+
+        vec4 d = vec4(luz.position.xyz, 1.0) - p;
+        float distancia = length(d);
+        vec4 l = d / distancia;
+
+        // Decaimento com o quadrado da distância, levado suavemente a zero
+        // no alcance da luz
+        float x = distancia / luz.position.w;
+        float atenuacao = pow(clamp(1.0 - x*x*x*x, 0.0, 1.0), 2.0) / (distancia*distancia + 1.0);
+        if (luz.spot.w >= -1.0)
+            atenuacao *= smoothstep(luz.spot.w, luz.spot.w + SPOT_SUAVIZACAO, dot(-l.xyz, luz.spot.xyz));
+
+        vec4 r = -l+2*n*(dot(n, l));
+        float lambert = max(0, dot(n,l));
+        resultado += luz.color.rgb * atenuacao * (Kd * lambert + Ks * pow(max(0,dot(r,v)), q) * lambert);
+    }
+    return resultado;
+}
+#endif
+
+// Os mapas de normais guardam apenas os componentes x e y (em [0,1]); o
+// componente z é reconstruído para que o vetor seja unitário. O resultado é
+// codificado como a textura RGB original, com todos os componentes em [0,1].
+vec4 amostra_normal(sampler2D mapa, vec2 uv)
+{
+    vec2 rg = texture(mapa, uv).rg;
+    vec2 xy = rg * 2.0 - 1.0;
+    float z = sqrt(max(0.0, 1.0 - dot(xy, xy)));
+    return vec4(rg, z * 0.5 + 0.5, 1.0);
+}
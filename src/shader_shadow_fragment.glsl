@@ -0,0 +1,20 @@
+#version 330 core
+
+// Fragment shader do mapa de sombras da lanterna. Apenas a profundidade é
+// gravada; com "#define RECORTE" (folhas das árvores) os fragmentos
+// transparentes da textura são descartados, com o mesmo teste de
+// "shader_fragment.glsl".
+in vec2 texcoords;
+
+#ifdef RECORTE
+uniform sampler2D folhas;
+#endif
+
+void main()
+{
+#ifdef RECORTE
+    vec4 folha = texture(folhas, texcoords);
+    if(folha.a < 0.5 || folha.r > 0.3)
+        discard;
+#endif
+}
@@ -0,0 +1,40 @@
+#version 330 core
+
+// Vertex shader do mapa de sombras da lanterna (veja "shadowmap.h"). Usa os
+// mesmos atributos de "shader_vertex.glsl", mas calcula apenas a posição do
+// vértice na câmera da luz e, para as folhas, as coordenadas de textura.
+layout (location = 0) in vec3 quantized_position;
+layout (location = 2) in vec2 texture_coefficients;
+layout (location = 3) in mat4 instance_model;
+layout (location = 8) in int instance_draw;
+
+// Câmera da luz (veja RenderQueue_SetPass() em "main.cpp")
+layout (std140) uniform PassUniforms
+{
+    mat4 view;
+    mat4 projection;
+    vec4 camera_position;
+};
+
+// Quantização das posições de cada desenho (veja "shader_vertex.glsl")
+#define MAX_DRAWS 128
+struct DrawUniforms
+{
+    vec4 bbox_min;
+    vec4 bbox_max;
+    vec4 position_offset;
+    vec4 position_scale;
+};
+layout (std140) uniform DrawBlock
+{
+    DrawUniforms draws[MAX_DRAWS];
+};
+
+out vec2 texcoords;
+
+void main()
+{
+    vec4 model_coefficients = vec4(draws[instance_draw].position_offset.xyz + quantized_position * draws[instance_draw].position_scale.xyz, 1.0);
+    gl_Position = projection * view * instance_model * model_coefficients;
+    texcoords = texture_coefficients;
+}
@@ -0,0 +1,21 @@
+#version 330 core
+
+// Fragment shader do céu: uma única consulta ao cubemap HDR (veja
+// "environmentmap.h").
+in vec3 direction;
+
+uniform samplerCube ceu;
+
+// Intensidade do céu, que depende da iluminação ambiente da cena
+uniform vec3 sky_color;
+
+out vec4 color;
+
+void main()
+{
+    color.rgb = texture(ceu, direction).rgb * sky_color;
+    color.a = 1.0;
+
+    // Cor final com correção gamma, considerando monitor sRGB.
+    color.rgb = pow(color.rgb, vec3(1.0,1.0,1.0)/2.2);
+}
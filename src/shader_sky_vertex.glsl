@@ -0,0 +1,24 @@
+#version 330 core
+
+// Vertex shader do céu. Desenha um único triângulo que cobre toda a tela,
+// sem atributos de vértice: as posições são geradas a partir de gl_VertexID.
+// Veja DrawSky() em "main.cpp".
+
+// Inversa de projection*view, sem a translação da câmera
+uniform mat4 inverse_view_projection;
+
+// Direção de visualização, no sistema de coordenadas global, interpolada
+// pelo rasterizador para cada fragmento.
+out vec3 direction;
+
+void main()
+{
+    // Vértices (-1,-1), (3,-1) e (-1,3) em NDC
+    vec2 ndc = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2) * 2.0 - 1.0;
+
+    // O céu fica no far plane
+    gl_Position = vec4(ndc, 1.0, 1.0);
+
+    vec4 far_point = inverse_view_projection * vec4(ndc, 1.0, 1.0);
+    direction = far_point.xyz / far_point.w;
+}
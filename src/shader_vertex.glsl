@@ -1,17 +1,45 @@
 #version 330 core
 
 // Atributos de vértice recebidos como entrada ("in") pelo Vertex Shader.
-// Veja a função BuildTrianglesAndAddToVirtualScene() em "main.cpp".
-layout (location = 0) in vec4 model_coefficients;
+// Veja a função AddMeshToVirtualScene() em "main.cpp" e o formato dos
+// vértices em "vertexformat.h": as posições chegam quantizadas em [0,1], as
+// normais em 10 bits por coordenada e as coordenadas de textura em half float.
+layout (location = 0) in vec3 quantized_position;
 layout (location = 1) in vec4 normal_coefficients;
 layout (location = 2) in vec2 texture_coefficients;
-// layout (location = 3) in vec4 normal_bitangente;
 
-// Matrizes computadas no código C++ e enviadas para a GPU
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
-uniform int object_id;
+// Atributos de cada instância (veja "renderqueue.h"): a matriz de modelagem,
+// que ocupa as posições 3 a 6, um valor adicional do objeto, repassado ao
+// Fragment Shader, o índice do desenho no bloco "DrawBlock" e a matriz que
+// transforma as normais, que ocupa as posições 9 a 11.
+layout (location = 3) in mat4 instance_model;
+layout (location = 7) in float instance_data;
+layout (location = 8) in int instance_draw;
+layout (location = 9) in mat3 instance_normal_matrix; // Inversa da transposta de "instance_model", computada na CPU
+
+// Matrizes computadas no código C++ e enviadas para a GPU, uma vez por passo
+layout (std140) uniform PassUniforms
+{
+    mat4 view;
+    mat4 projection;
+    vec4 camera_position; // Igual a inverse(view)*[0,0,0,1], computada na CPU
+};
+
+// Bounding box e intervalo de quantização das posições de cada
+// desenho (veja DrawUniforms em "renderqueue.h"). MAX_DRAWS deve ser igual a
+// RENDER_QUEUE_DRAWS_PER_BLOCK.
+#define MAX_DRAWS 128
+struct DrawUniforms
+{
+    vec4 bbox_min;
+    vec4 bbox_max;
+    vec4 position_offset;
+    vec4 position_scale;
+};
+layout (std140) uniform DrawBlock
+{
+    DrawUniforms draws[MAX_DRAWS];
+};
 
 // Atributos de vértice que serão gerados como saída ("out") pelo Vertex Shader.
 // ** Estes serão interpolados pelo rasterizador! ** gerando, assim, valores
@@ -21,11 +49,20 @@ out vec4 position_world;
 out vec4 position_model;
 out vec4 normal;
 out vec2 texcoords;
+flat out mat4 normal_matrix; // Transforma as normais do modelo para o sistema global
+flat out float instance_value;
+flat out int draw_index; // Índice do desenho em "draws"
 //
 out vec4 cor_tiro; // usando a modelo de Gouraud Shading
 
 void main()
 {
+    mat4 model = instance_model;
+
+    // Posição do vértice no sistema de coordenadas do modelo, decodificada a
+    // partir da posição quantizada.
+    vec4 model_coefficients = vec4(draws[instance_draw].position_offset.xyz + quantized_position * draws[instance_draw].position_scale.xyz, 1.0);
+
     // A variável gl_Position define a posição final de cada vértice
     // OBRIGATORIAMENTE em "normalized device coordinates" (NDC), onde cada
     // coeficiente estará entre -1 e 1 após divisão por w.
@@ -40,17 +77,25 @@ void main()
     // Posição do vértice atual no sistema de coordenadas local do modelo.
     position_model = model_coefficients;
 
-    normal = inverse(transpose(model)) * normal_coefficients;
+#ifdef INVERSAS_NA_GPU
+    // Versão anterior, mantida apenas para a comparação da opção
+    // "--gpu-inverses" (veja RunFillRateBenchmark() em "main.cpp").
+    normal_matrix = inverse(transpose(model));
+#else
+    normal_matrix = mat4(instance_normal_matrix);
+#endif
+    normal = normal_matrix * normal_coefficients;
     normal.w = 0.0;
     texcoords = texture_coefficients;
+    instance_value = instance_data;
+    draw_index = instance_draw;
 
+    // O material é definido por "#define MATERIAL" (veja "shader_fragment.glsl")
     #define BULLET 1
-    if ( object_id == BULLET )
+#if MATERIAL == BULLET
     {
         // Normal do vértice atual no sistema de coordenadas global (World).
         // Veja slides 123-151 do documento Aula_07_Transformacoes_Geometricas_3D.pdf.
-        vec4 origin = vec4(0.0, 0.0, 0.0, 1.0);
-        vec4 camera_position = inverse(view) * origin;
 
 
         // Coordenadas de textura obtidas do arquivo OBJ (se existirem!)
@@ -115,5 +160,5 @@ void main()
         cor_tiro.a = 1;
         cor_tiro.rgb = lambert_diffuse_term + ambient_term + phong_specular_term;
     }
+#endif
 }
-
@@ -0,0 +1,246 @@
+#include <cstdio>
+#include <vector>
+
+#include "shadermanager.h"
+#include "programcache.h"
+
+namespace
+{
+    // Constante e função de KHR_parallel_shader_compile (ou
+    // ARB_parallel_shader_compile, com os mesmos valores), ausentes do
+    // cabeçalho do OpenGL 3.3.
+    const GLenum COMPLETION_STATUS = 0x91B1;
+
+    typedef void (APIENTRYP MaxShaderCompilerThreadsProc)(GLuint count);
+
+    bool g_ParallelCompile = false;
+
+    // Programa submetido por ShaderManager_Submit()
+    struct ShaderProgram
+    {
+        std::string        name;
+        std::string        vertex_filename;
+        std::string        fragment_filename;
+        std::string        vertex_source;   // Mantidos até a finalização, para o cache
+        std::string        fragment_source;
+        GLuint             vertex_shader_id;
+        GLuint             fragment_shader_id;
+        GLuint             program_id;
+        bool               from_cache;      // Já linkado a partir do cache de binários
+        bool               ready;           // Finalizado
+        ShaderProgramReady on_ready;
+        int                permutation;
+    };
+
+    std::vector<ShaderProgram> g_Programs;
+
+    GLuint SubmitShader(GLenum type, const std::string& source)
+    {
+        GLuint shader_id = glCreateShader(type);
+
+        const GLchar* shader_string = source.c_str();
+        const GLint   shader_string_length = static_cast<GLint>( source.length() );
+        glShaderSource(shader_id, 1, &shader_string, &shader_string_length);
+        glCompileShader(shader_id);
+
+        return shader_id;
+    }
+
+    // Imprime no terminal qualquer erro ou "warning" de compilação
+    void PrintCompileLog(GLuint shader_id, const std::string& filename)
+    {
+        GLint compiled_ok;
+        glGetShaderiv(shader_id, GL_COMPILE_STATUS, &compiled_ok);
+
+        GLint log_length = 0;
+        glGetShaderiv(shader_id, GL_INFO_LOG_LENGTH, &log_length);
+        if ( log_length == 0 )
+            return;
+
+        std::vector<GLchar> log(log_length);
+        glGetShaderInfoLog(shader_id, log_length, &log_length, log.data());
+        if ( log_length == 0 )
+            return;
+
+        std::string output;
+        if ( !compiled_ok )
+            output += "ERROR: OpenGL compilation of \"" + filename + "\" failed.\n";
+        else
+            output += "WARNING: OpenGL compilation of \"" + filename + "\".\n";
+        output += "== Start of compilation log\n";
+        output += log.data();
+        output += "== End of compilation log\n";
+
+        fprintf(stderr, "%s", output.c_str());
+    }
+
+    // Imprime no terminal qualquer erro de linkagem. Retorna true se o
+    // programa foi linkado.
+    bool CheckLink(GLuint program_id)
+    {
+        GLint linked_ok = GL_FALSE;
+        glGetProgramiv(program_id, GL_LINK_STATUS, &linked_ok);
+        if ( linked_ok != GL_FALSE )
+            return true;
+
+        GLint log_length = 0;
+        glGetProgramiv(program_id, GL_INFO_LOG_LENGTH, &log_length);
+
+        std::vector<GLchar> log(log_length + 1, '\0');
+        glGetProgramInfoLog(program_id, log_length, &log_length, log.data());
+
+        std::string output;
+        output += "ERROR: OpenGL linking of program failed.\n";
+        output += "== Start of link log\n";
+        output += log.data();
+        output += "\n== End of link log\n";
+
+        fprintf(stderr, "%s", output.c_str());
+        return false;
+    }
+
+    // Verifica se a compilação e a linkagem do programa terminaram, sem
+    // bloquear.
+    bool IsComplete(const ShaderProgram& program)
+    {
+        if ( program.from_cache )
+            return true;
+
+        GLint complete = GL_FALSE;
+        glGetProgramiv(program.program_id, COMPLETION_STATUS, &complete);
+        return complete != GL_FALSE;
+    }
+
+    void Finalize(ShaderProgram* program)
+    {
+        if ( !program->from_cache )
+        {
+            PrintCompileLog(program->vertex_shader_id, program->vertex_filename);
+            PrintCompileLog(program->fragment_shader_id, program->fragment_filename);
+
+            if ( CheckLink(program->program_id) )
+                ProgramCache_Save(program->name.c_str(), program->vertex_source, program->fragment_source, program->program_id);
+
+            // Os "Shader Objects" podem ser deletados após serem linkados
+            glDetachShader(program->program_id, program->vertex_shader_id);
+            glDetachShader(program->program_id, program->fragment_shader_id);
+            glDeleteShader(program->vertex_shader_id);
+            glDeleteShader(program->fragment_shader_id);
+        }
+
+        program->vertex_source.clear();
+        program->vertex_source.shrink_to_fit();
+        program->fragment_source.clear();
+        program->fragment_source.shrink_to_fit();
+        program->ready = true;
+
+        if ( program->on_ready != NULL )
+            program->on_ready(program->program_id, program->permutation);
+    }
+}
+
+void ShaderManager_Init(GLADloadproc load)
+{
+    MaxShaderCompilerThreadsProc max_threads = NULL;
+    if ( HasGLExtension("GL_KHR_parallel_shader_compile") )
+        max_threads = (MaxShaderCompilerThreadsProc) load("glMaxShaderCompilerThreadsKHR");
+    else if ( HasGLExtension("GL_ARB_parallel_shader_compile") )
+        max_threads = (MaxShaderCompilerThreadsProc) load("glMaxShaderCompilerThreadsARB");
+
+    g_ParallelCompile = max_threads != NULL;
+
+    // 0xFFFFFFFF deixa o número de threads a critério do driver
+    if ( g_ParallelCompile )
+        max_threads(0xFFFFFFFF);
+}
+
+int ShaderManager_Submit(const char* name, const char* vertex_filename, const std::string& vertex_source,
+                         const char* fragment_filename, const std::string& fragment_source, ShaderProgramReady on_ready,
+                         int permutation)
+{
+    ShaderProgram program;
+    program.name               = name;
+    program.vertex_filename    = vertex_filename;
+    program.fragment_filename  = fragment_filename;
+    program.vertex_shader_id   = 0;
+    program.fragment_shader_id = 0;
+    program.program_id         = 0;
+    program.ready              = false;
+    program.on_ready           = on_ready;
+    program.permutation        = permutation;
+    program.from_cache         = ProgramCache_Load(name, vertex_source, fragment_source, &program.program_id);
+
+    if ( !program.from_cache )
+    {
+        program.vertex_source      = vertex_source;
+        program.fragment_source    = fragment_source;
+        program.vertex_shader_id   = SubmitShader(GL_VERTEX_SHADER, vertex_source);
+        program.fragment_shader_id = SubmitShader(GL_FRAGMENT_SHADER, fragment_source);
+
+        program.program_id = glCreateProgram();
+        glAttachShader(program.program_id, program.vertex_shader_id);
+        glAttachShader(program.program_id, program.fragment_shader_id);
+
+        // A linkagem é submetida logo em seguida: o driver a executa quando
+        // a compilação dos shaders terminar.
+        ProgramCache_PrepareLink(program.program_id);
+        glLinkProgram(program.program_id);
+    }
+
+    g_Programs.push_back(program);
+    return (int)g_Programs.size() - 1;
+}
+
+std::string ShaderManager_AddDefines(const std::string& source, const std::string& defines)
+{
+    // A diretiva "#version" deve ser a primeira do código
+    size_t version = source.find("#version");
+    if ( version == std::string::npos )
+        return defines + source;
+
+    size_t line_end = source.find('\n', version);
+    if ( line_end == std::string::npos )
+        return source + "\n" + defines;
+
+    return source.substr(0, line_end + 1) + defines + source.substr(line_end + 1);
+}
+
+void ShaderManager_Update()
+{
+    for (size_t i = 0; i < g_Programs.size(); ++i)
+    {
+        ShaderProgram* program = &g_Programs[i];
+        if ( program->ready )
+            continue;
+
+        // Sem compilação paralela não há como consultar o estado sem
+        // bloquear; finalizamos um programa por chamada.
+        if ( !g_ParallelCompile && !program->from_cache )
+        {
+            Finalize(program);
+            return;
+        }
+
+        if ( IsComplete(*program) )
+            Finalize(program);
+    }
+}
+
+void ShaderManager_Wait(int program)
+{
+    if ( !g_Programs[program].ready )
+        Finalize(&g_Programs[program]);
+}
+
+bool ShaderManager_Busy()
+{
+    for (size_t i = 0; i < g_Programs.size(); ++i)
+        if ( !g_Programs[i].ready )
+            return true;
+    return false;
+}
+
+GLuint ShaderManager_Program(int program)
+{
+    return g_Programs[program].ready ? g_Programs[program].program_id : 0;
+}
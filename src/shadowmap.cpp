@@ -0,0 +1,128 @@
+// Mapa de sombras da lanterna. As duas camadas são texturas de
+// profundidade, cada uma como único anexo de um framebuffer sem buffers de
+// cor. A camada final é montada copiando a profundidade da camada estática
+// com glBlitFramebuffer(), o que não passa pelos shaders.
+#include <cmath>
+
+#include <glm/geometric.hpp>
+
+#include "shadowmap.h"
+
+namespace
+{
+    void CreateDepthLayer(GLsizei size, bool compare, GLuint* texture, GLuint* framebuffer)
+    {
+        glGenTextures(1, texture);
+        glBindTexture(GL_TEXTURE_2D, *texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, size, size, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        if ( compare )
+        {
+            // Com comparação, a filtragem linear faz a média dos resultados
+            // dos quatro texels vizinhos (bordas das sombras mais suaves).
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+        }
+        else
+        {
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        }
+
+        glGenFramebuffers(1, framebuffer);
+        glBindFramebuffer(GL_FRAMEBUFFER, *framebuffer);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, *texture, 0);
+        glDrawBuffer(GL_NONE);
+        glReadBuffer(GL_NONE);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    void BeginLayer(GLuint framebuffer, GLsizei size)
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        glViewport(0, 0, size, size);
+        glEnable(GL_POLYGON_OFFSET_FILL);
+        glPolygonOffset(2.0f, 4.0f);
+    }
+}
+
+void ShadowMap_Init(ShadowMap* shadow_map, GLsizei size)
+{
+    shadow_map->size = size;
+    CreateDepthLayer(size, false, &shadow_map->static_texture_id, &shadow_map->static_framebuffer_id);
+
+    // A camada final fica ligada à sua unidade durante toda a execução
+    glActiveTexture(GL_TEXTURE0 + SHADOW_MAP_TEXTURE_UNIT);
+    CreateDepthLayer(size, true, &shadow_map->texture_id, &shadow_map->framebuffer_id);
+    glActiveTexture(GL_TEXTURE0);
+
+    shadow_map->view             = glm::mat4(1.0f);
+    shadow_map->projection       = glm::mat4(1.0f);
+    shadow_map->static_position  = glm::vec3(0.0f);
+    shadow_map->static_direction = glm::vec3(0.0f, 0.0f, -1.0f);
+    shadow_map->static_valid     = false;
+    shadow_map->static_renders   = 0;
+}
+
+bool ShadowMap_Update(ShadowMap* shadow_map, const glm::vec4& position, const glm::vec4& direction,
+                      const glm::mat4& view, const glm::mat4& projection)
+{
+    glm::vec3 p = glm::vec3(position);
+    glm::vec3 d = glm::normalize(glm::vec3(direction));
+
+    if ( shadow_map->static_valid )
+    {
+        float moved  = glm::length(p - shadow_map->static_position);
+        float turned = std::acos(glm::clamp(glm::dot(d, shadow_map->static_direction), -1.0f, 1.0f));
+        if ( moved <= SHADOW_MAP_MAX_DISTANCE && turned <= SHADOW_MAP_MAX_ANGLE )
+            return false;
+    }
+
+    shadow_map->static_position  = p;
+    shadow_map->static_direction = d;
+    shadow_map->static_valid     = true;
+    shadow_map->static_renders  += 1;
+    shadow_map->view             = view;
+    shadow_map->projection       = projection;
+    return true;
+}
+
+void ShadowMap_Invalidate(ShadowMap* shadow_map)
+{
+    shadow_map->static_valid = false;
+}
+
+void ShadowMap_BeginStatic(ShadowMap* shadow_map)
+{
+    BeginLayer(shadow_map->static_framebuffer_id, shadow_map->size);
+    glClear(GL_DEPTH_BUFFER_BIT);
+}
+
+void ShadowMap_BeginDynamic(const ShadowMap& shadow_map)
+{
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, shadow_map.static_framebuffer_id);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, shadow_map.framebuffer_id);
+    glBlitFramebuffer(0, 0, shadow_map.size, shadow_map.size, 0, 0, shadow_map.size, shadow_map.size,
+                      GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+    BeginLayer(shadow_map.framebuffer_id, shadow_map.size);
+}
+
+void ShadowMap_End(int width, int height)
+{
+    glDisable(GL_POLYGON_OFFSET_FILL);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(0, 0, width, height);
+}
+
+glm::mat4 ShadowMap_Matrix(const ShadowMap& shadow_map)
+{
+    // Leva as coordenadas NDC, em [-1,1], para [0,1]
+    const glm::mat4 bias = glm::mat4(0.5f, 0.0f, 0.0f, 0.0f,
+                                     0.0f, 0.5f, 0.0f, 0.0f,
+                                     0.0f, 0.0f, 0.5f, 0.0f,
+                                     0.5f, 0.5f, 0.5f, 1.0f);
+    return bias * shadow_map.projection * shadow_map.view;
+}
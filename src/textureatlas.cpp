@@ -0,0 +1,201 @@
+#include <cstring>
+#include <map>
+#include <utility>
+#include <algorithm>
+
+#include "textureatlas.h"
+
+namespace
+{
+    // Borda de cada imagem e alinhamento dos retângulos no atlas, em texels
+    const int PADDING = 1 << ATLAS_PADDING_LEVELS;
+
+    // Maior lado do atlas
+    const int MAX_ATLAS_SIZE = 16384;
+
+    int RoundUp(int value, int multiple)
+    {
+        return (value + multiple - 1) / multiple * multiple;
+    }
+
+    int NextPowerOfTwo(int value)
+    {
+        int p = 1;
+        while ( p < value )
+            p *= 2;
+        return p;
+    }
+
+    // Posiciona os retângulos em prateleiras de largura "width", na ordem
+    // "order". Retorna a altura ocupada.
+    int PackShelves(const std::vector<size_t>& order, const std::vector<int>& widths, const std::vector<int>& heights,
+                    int width, std::vector<int>* xs, std::vector<int>* ys)
+    {
+        int x = 0;
+        int y = 0;
+        int shelf_height = 0;
+        for (size_t k = 0; k < order.size(); ++k)
+        {
+            size_t i = order[k];
+            if ( x + widths[i] > width )
+            {
+                y += shelf_height;
+                x = 0;
+                shelf_height = 0;
+            }
+            (*xs)[i] = x;
+            (*ys)[i] = y;
+            x += widths[i];
+            shelf_height = std::max(shelf_height, heights[i]);
+        }
+        return y + shelf_height;
+    }
+
+    void TransformTexcoords(PackedVertex* vertex, const AtlasRegion& region)
+    {
+        for (int k = 0; k < 2; ++k)
+        {
+            float t = std::min(std::max(HalfToFloat(vertex->texcoords[k]), 0.0f), 1.0f);
+            vertex->texcoords[k] = FloatToHalf(region.offset[k] + t*region.scale[k]);
+        }
+    }
+}
+
+void BuildTextureAtlas(const std::vector<AtlasImage>& images, TextureAtlas* atlas)
+{
+    size_t num_images = images.size();
+
+    // Retângulos com borda, alinhados a PADDING texels
+    std::vector<int> widths(num_images);
+    std::vector<int> heights(num_images);
+    int max_width = PADDING;
+    for (size_t i = 0; i < num_images; ++i)
+    {
+        widths[i]  = RoundUp(images[i].width + 2*PADDING, PADDING);
+        heights[i] = RoundUp(images[i].height + 2*PADDING, PADDING);
+        max_width  = std::max(max_width, widths[i]);
+    }
+
+    std::vector<size_t> order(num_images);
+    for (size_t i = 0; i < num_images; ++i)
+        order[i] = i;
+    std::stable_sort(order.begin(), order.end(), [&heights](size_t a, size_t b) { return heights[a] > heights[b]; });
+
+    // Testamos todas as larguras possíveis e ficamos com a de menor área
+    // (em caso de empate, a mais próxima de um quadrado).
+    std::vector<int> xs(num_images), ys(num_images);
+    int atlas_width  = 0;
+    int atlas_height = 0;
+    for (int width = NextPowerOfTwo(max_width); width <= MAX_ATLAS_SIZE; width *= 2)
+    {
+        int height = NextPowerOfTwo(std::max(PADDING, PackShelves(order, widths, heights, width, &xs, &ys)));
+        size_t area = (size_t)width * height;
+        size_t best_area = (size_t)atlas_width * atlas_height;
+        if ( atlas_width == 0 || area < best_area || (area == best_area && std::max(width, height) < std::max(atlas_width, atlas_height)) )
+        {
+            atlas_width  = width;
+            atlas_height = height;
+        }
+    }
+    PackShelves(order, widths, heights, atlas_width, &xs, &ys);
+
+    // Cópia das imagens, repetindo os texels das bordas nos retângulos
+    std::vector<unsigned char> pixels((size_t)atlas_width * atlas_height * 3, 0);
+    atlas->regions.resize(num_images);
+    for (size_t i = 0; i < num_images; ++i)
+    {
+        const AtlasImage& image = images[i];
+        for (int y = 0; y < heights[i]; ++y)
+        {
+            int sy = std::min(std::max(y - PADDING, 0), image.height - 1);
+            const unsigned char* src = image.pixels + (size_t)sy * image.width * 3;
+            unsigned char*       dst = pixels.data() + ((size_t)(ys[i] + y) * atlas_width + xs[i]) * 3;
+            for (int x = 0; x < widths[i]; ++x)
+            {
+                int sx = std::min(std::max(x - PADDING, 0), image.width - 1);
+                memcpy(dst + 3*x, src + 3*sx, 3);
+            }
+        }
+
+        AtlasRegion& region = atlas->regions[i];
+        region.offset[0] = (float)(xs[i] + PADDING) / atlas_width;
+        region.offset[1] = (float)(ys[i] + PADDING) / atlas_height;
+        region.scale[0]  = (float)image.width / atlas_width;
+        region.scale[1]  = (float)image.height / atlas_height;
+    }
+
+    BuildMipChain(pixels.data(), atlas_width, atlas_height, TEXTURE_SRGB, &atlas->storage, &atlas->levels);
+    atlas->levels.num_levels = std::min(atlas->levels.num_levels, ATLAS_PADDING_LEVELS + 1);
+}
+
+void RemapMeshToAtlas(const MeshView& mesh, const AtlasRegion* const* object_regions, MeshData* remapped)
+{
+    *remapped = MeshData();
+    remapped->vertices.assign(mesh.vertices, mesh.vertices + mesh.num_vertices);
+    remapped->indices.assign(mesh.indices, mesh.indices + mesh.num_indices);
+    remapped->objects.assign(mesh.objects, mesh.objects + mesh.num_objects);
+    remapped->quantization = mesh.quantization;
+
+    // Regiões distintas (por valor) usadas pelos objetos; -1 indica que o
+    // objeto mantém as coordenadas originais.
+    std::vector<AtlasRegion> regions;
+    std::vector<int> object_region(mesh.num_objects, -1);
+    for (size_t i = 0; i < mesh.num_objects; ++i)
+    {
+        if ( object_regions[i] == NULL )
+            continue;
+
+        size_t r = 0;
+        while ( r < regions.size() && memcmp(&regions[r], object_regions[i], sizeof(AtlasRegion)) != 0 )
+            ++r;
+        if ( r == regions.size() )
+            regions.push_back(*object_regions[i]);
+        object_region[i] = (int)r;
+    }
+
+    // Região já aplicada a cada vértice (-2 enquanto nenhum objeto o usou) e
+    // cópias criadas para as outras regiões.
+    const int UNCLAIMED = -2;
+    std::vector<int> vertex_region(mesh.num_vertices, UNCLAIMED);
+    std::map<std::pair<GLuint, int>, GLuint> copies;
+
+    for (size_t i = 0; i < mesh.num_objects; ++i)
+    {
+        const MeshObject& object = mesh.objects[i];
+        int region = object_region[i];
+
+        for (int lod = 0; lod < std::max(object.num_lods, 1); ++lod)
+        {
+            size_t first = (object.num_lods > 0) ? object.lods[lod].first_index : object.first_index;
+            size_t count = (object.num_lods > 0) ? object.lods[lod].num_indices : object.num_indices;
+
+            for (size_t k = first; k < first + count; ++k)
+            {
+                GLuint v = remapped->indices[k];
+                if ( v >= mesh.num_vertices )
+                    continue; // Já aponta para uma cópia
+
+                if ( vertex_region[v] == UNCLAIMED )
+                {
+                    vertex_region[v] = region;
+                    if ( region >= 0 )
+                        TransformTexcoords(&remapped->vertices[v], regions[region]);
+                }
+                else if ( vertex_region[v] != region )
+                {
+                    std::pair<GLuint, int> key(v, region);
+                    std::map<std::pair<GLuint, int>, GLuint>::iterator it = copies.find(key);
+                    if ( it == copies.end() )
+                    {
+                        PackedVertex copy = mesh.vertices[v];
+                        if ( region >= 0 )
+                            TransformTexcoords(&copy, regions[region]);
+                        it = copies.insert(std::make_pair(key, (GLuint)remapped->vertices.size())).first;
+                        remapped->vertices.push_back(copy);
+                    }
+                    remapped->indices[k] = it->second;
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,345 @@
+// Cache binário de texturas. O arquivo ".texcache" guarda os texels já
+// decodificados de uma imagem, junto com a sua cadeia de mipmaps completa,
+// de forma que nas execuções seguintes não é necessário decodificar o
+// arquivo JPEG/PNG nem chamar glGenerateMipmap(): o arquivo é mapeado em
+// memória e cada nível é enviado diretamente com glTexImage2D().
+//
+// Layout do arquivo:
+//
+//    TexCacheHeader
+//    texels do nível 0     (no formato do cabeçalho, alinhado em 16 bytes)
+//    texels do nível 1     (no formato do cabeçalho, alinhado em 16 bytes)
+//    ...
+//
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+#include "texturecache.h"
+
+namespace
+{
+    const char TEXCACHE_MAGIC[8] = "FCGTEX";
+
+    struct TexCacheHeader
+    {
+        char     magic[8];
+        uint32_t version;
+        uint32_t format;     // TextureFormat
+        uint32_t num_levels;
+        uint64_t source_size; // Tamanho e hash do conteúdo da imagem original
+        uint64_t source_hash;
+        uint32_t width[TEXCACHE_MAX_LEVELS];
+        uint32_t height[TEXCACHE_MAX_LEVELS];
+        uint64_t offset[TEXCACHE_MAX_LEVELS];
+    };
+
+    uint64_t Align16(uint64_t offset)
+    {
+        return (offset + 15) & ~(uint64_t)15;
+    }
+
+    // Hash FNV-1a de 64 bits do conteúdo de um arquivo
+    bool HashFile(const char* filename, uint64_t* size, uint64_t* hash)
+    {
+        MappedFile file;
+        if ( !MapFile(filename, &file) )
+            return false;
+
+        uint64_t h = 14695981039346656037ull;
+        for (size_t i = 0; i < file.size; ++i)
+        {
+            h ^= file.data[i];
+            h *= 1099511628211ull;
+        }
+
+        *size = file.size;
+        *hash = h;
+
+        UnmapFile(&file);
+        return true;
+    }
+
+    // Conversão de sRGB (8 bits) para intensidade linear
+    struct SrgbToLinearTable
+    {
+        float value[256];
+
+        SrgbToLinearTable()
+        {
+            for (int i = 0; i < 256; ++i)
+            {
+                float c = i / 255.0f;
+                value[i] = (c <= 0.04045f) ? c / 12.92f : powf((c + 0.055f) / 1.055f, 2.4f);
+            }
+        }
+    };
+
+    size_t LevelSize(int width, int height, int channels)
+    {
+        return (size_t)width * (size_t)height * channels;
+    }
+
+    unsigned char UnitToByte(float c)
+    {
+        return (unsigned char)(std::min(std::max(c, 0.0f), 1.0f) * 255.0f + 0.5f);
+    }
+
+    // Componentes x e y de uma normal, codificados em [0,255], e o z
+    // correspondente a um vetor unitário.
+    void DecodeNormal(const unsigned char* texel, float* n)
+    {
+        n[0] = texel[0] * (2.0f / 255.0f) - 1.0f;
+        n[1] = texel[1] * (2.0f / 255.0f) - 1.0f;
+        n[2] = sqrtf(std::max(0.0f, 1.0f - n[0]*n[0] - n[1]*n[1]));
+    }
+
+    // Calcula um texel do nível seguinte a partir dos quatro texels "src" do
+    // nível anterior.
+    void FilterTexel(TextureFormat format, const unsigned char* const src[4], const float* to_linear, unsigned char* dst)
+    {
+        switch ( format )
+        {
+        case TEXTURE_SRGB:
+            for (int c = 0; c < 3; ++c)
+            {
+                float sum = to_linear[src[0][c]] + to_linear[src[1][c]] + to_linear[src[2][c]] + to_linear[src[3][c]];
+                dst[c] = LinearToSrgb(0.25f * sum);
+            }
+            break;
+
+        case TEXTURE_SRGB_ALPHA:
+        {
+            // Cores ponderadas pela opacidade, para que os texels
+            // transparentes não escureçam as bordas nos níveis menores.
+            int alpha_sum = src[0][3] + src[1][3] + src[2][3] + src[3][3];
+            for (int c = 0; c < 3; ++c)
+            {
+                float sum = 0.0f;
+                for (int i = 0; i < 4; ++i)
+                    sum += to_linear[src[i][c]] * (alpha_sum > 0 ? src[i][3] : 1);
+                dst[c] = LinearToSrgb(sum / (alpha_sum > 0 ? alpha_sum : 4));
+            }
+            dst[3] = (unsigned char)((alpha_sum + 2) / 4);
+            break;
+        }
+
+        case TEXTURE_NORMAL_MAP:
+        {
+            float sum[3] = { 0.0f, 0.0f, 0.0f };
+            for (int i = 0; i < 4; ++i)
+            {
+                float n[3];
+                DecodeNormal(src[i], n);
+                for (int c = 0; c < 3; ++c)
+                    sum[c] += n[c];
+            }
+            float length = sqrtf(sum[0]*sum[0] + sum[1]*sum[1] + sum[2]*sum[2]);
+            float scale  = (length > 0.0f) ? 1.0f / length : 0.0f;
+            for (int c = 0; c < 2; ++c)
+                dst[c] = UnitToByte(sum[c] * scale * 0.5f + 0.5f);
+            break;
+        }
+
+        case TEXTURE_MASK:
+            dst[0] = (unsigned char)((src[0][0] + src[1][0] + src[2][0] + src[3][0] + 2) / 4);
+            break;
+        }
+    }
+}
+
+int TextureChannels(TextureFormat format)
+{
+    switch ( format )
+    {
+    case TEXTURE_SRGB:       return 3;
+    case TEXTURE_SRGB_ALPHA: return 4;
+    case TEXTURE_NORMAL_MAP: return 2;
+    case TEXTURE_MASK:       return 1;
+    }
+    return 3;
+}
+
+unsigned char LinearToSrgb(float c)
+{
+    c = std::min(std::max(c, 0.0f), 1.0f);
+    float s = (c <= 0.0031308f) ? c * 12.92f : 1.055f * powf(c, 1.0f / 2.4f) - 0.055f;
+    return (unsigned char)(s * 255.0f + 0.5f);
+}
+
+void BuildMipChain(const unsigned char* pixels, int width, int height, TextureFormat format,
+                   std::vector<unsigned char>* storage, TextureLevels* levels)
+{
+    // Variável local estática: inicializada uma única vez, mesmo que várias
+    // threads de trabalho chamem esta função ao mesmo tempo.
+    static const SrgbToLinearTable srgb;
+    const float* to_linear = srgb.value;
+
+    int channels = TextureChannels(format);
+
+    // Dimensões de todos os níveis, seguindo a regra do OpenGL: cada nível
+    // tem metade do tamanho do anterior (arredondado para baixo), até 1x1.
+    levels->format = format;
+    levels->num_levels = 0;
+    size_t offsets[TEXCACHE_MAX_LEVELS];
+    size_t total_size = 0;
+    int w = width;
+    int h = height;
+    for (;;)
+    {
+        int level = levels->num_levels++;
+        levels->width[level]  = w;
+        levels->height[level] = h;
+        offsets[level] = total_size;
+        total_size += LevelSize(w, h, channels);
+
+        if ( (w == 1 && h == 1) || levels->num_levels == TEXCACHE_MAX_LEVELS )
+            break;
+
+        w = std::max(1, w / 2);
+        h = std::max(1, h / 2);
+    }
+
+    storage->resize(total_size);
+    unsigned char* data = storage->data();
+    if ( format == TEXTURE_NORMAL_MAP )
+    {
+        // Descartamos o componente z, que é reconstruído a partir de x e y
+        for (size_t i = 0; i < (size_t)width * height; ++i)
+        {
+            data[2*i + 0] = pixels[3*i + 0];
+            data[2*i + 1] = pixels[3*i + 1];
+        }
+    }
+    else
+    {
+        memcpy(data, pixels, LevelSize(width, height, channels));
+    }
+
+    for (int level = 1; level < levels->num_levels; ++level)
+    {
+        const unsigned char* src = data + offsets[level-1];
+        unsigned char*       dst = data + offsets[level];
+        int src_w = levels->width[level-1];
+        int src_h = levels->height[level-1];
+        int dst_w = levels->width[level];
+        int dst_h = levels->height[level];
+
+        for (int y = 0; y < dst_h; ++y)
+        {
+            int y0 = std::min(2*y, src_h - 1);
+            int y1 = std::min(2*y + 1, src_h - 1);
+
+            for (int x = 0; x < dst_w; ++x)
+            {
+                int x0 = std::min(2*x, src_w - 1);
+                int x1 = std::min(2*x + 1, src_w - 1);
+
+                const unsigned char* texels[4] = {
+                    src + (y0*src_w + x0)*channels,
+                    src + (y0*src_w + x1)*channels,
+                    src + (y1*src_w + x0)*channels,
+                    src + (y1*src_w + x1)*channels,
+                };
+                FilterTexel(format, texels, to_linear, dst + (y*dst_w + x)*channels);
+            }
+        }
+    }
+
+    for (int level = 0; level < levels->num_levels; ++level)
+        levels->pixels[level] = data + offsets[level];
+}
+
+std::string TextureCache_Filename(const char* image_filename)
+{
+    return std::string(image_filename) + ".texcache";
+}
+
+bool TextureCache_Load(const char* image_filename, TextureFormat format, TextureCache* cache)
+{
+    uint64_t source_size, source_hash;
+    if ( !HashFile(image_filename, &source_size, &source_hash) )
+        return false;
+
+    std::string filename = TextureCache_Filename(image_filename);
+    if ( !MapFile(filename.c_str(), &cache->file) )
+        return false;
+
+    const MappedFile& file = cache->file;
+    const TexCacheHeader* header = (const TexCacheHeader*)file.data;
+
+    bool valid = file.size >= sizeof(TexCacheHeader)
+              && memcmp(header->magic, TEXCACHE_MAGIC, sizeof(header->magic)) == 0
+              && header->version == TEXCACHE_VERSION
+              && header->format == (uint32_t)format
+              && header->source_size == source_size
+              && header->source_hash == source_hash
+              && header->num_levels >= 1
+              && header->num_levels <= TEXCACHE_MAX_LEVELS;
+
+    for (uint32_t level = 0; valid && level < header->num_levels; ++level)
+    {
+        uint64_t size = LevelSize(header->width[level], header->height[level], TextureChannels(format));
+        valid = header->offset[level] <= file.size && size <= file.size - header->offset[level];
+
+        cache->levels.width[level]  = header->width[level];
+        cache->levels.height[level] = header->height[level];
+        cache->levels.pixels[level] = file.data + header->offset[level];
+    }
+
+    if ( !valid )
+    {
+        TextureCache_Close(cache);
+        return false;
+    }
+
+    cache->levels.format     = format;
+    cache->levels.num_levels = header->num_levels;
+    return true;
+}
+
+void TextureCache_Close(TextureCache* cache)
+{
+    UnmapFile(&cache->file);
+    memset(&cache->levels, 0, sizeof(cache->levels));
+}
+
+bool TextureCache_Save(const char* image_filename, const TextureLevels& levels)
+{
+    TexCacheHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, TEXCACHE_MAGIC, sizeof(header.magic));
+    header.version    = TEXCACHE_VERSION;
+    header.format     = levels.format;
+    header.num_levels = levels.num_levels;
+
+    if ( !HashFile(image_filename, &header.source_size, &header.source_hash) )
+        return false;
+
+    uint64_t file_size = sizeof(TexCacheHeader);
+    for (int level = 0; level < levels.num_levels; ++level)
+    {
+        header.width[level]  = levels.width[level];
+        header.height[level] = levels.height[level];
+        header.offset[level] = Align16(file_size);
+        file_size = header.offset[level] + LevelSize(levels.width[level], levels.height[level], TextureChannels(levels.format));
+    }
+
+    // Cabeçalho seguido de cada nível, precedido do alinhamento até o seu
+    // deslocamento
+    static const unsigned char padding[16] = { 0 };
+    std::vector<const void*> chunks(1, &header);
+    std::vector<size_t>      sizes(1, sizeof(header));
+    uint64_t position = sizeof(header);
+    for (int level = 0; level < levels.num_levels; ++level)
+    {
+        size_t size = LevelSize(levels.width[level], levels.height[level], TextureChannels(levels.format));
+        chunks.push_back(padding);
+        sizes.push_back(header.offset[level] - position);
+        chunks.push_back(levels.pixels[level]);
+        sizes.push_back(size);
+        position = header.offset[level] + size;
+    }
+
+    return WriteFileAtomically(TextureCache_Filename(image_filename), chunks.data(), sizes.data(), (int)chunks.size());
+}
@@ -0,0 +1,433 @@
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <list>
+
+#include "texturestreamer.h"
+
+#include <GLFW/glfw3.h>
+
+namespace
+{
+    // Formatos S3TC em espaço sRGB (extensões EXT_texture_sRGB e
+    // EXT_texture_compression_s3tc), ausentes do cabeçalho do OpenGL 3.3.
+    const GLenum COMPRESSED_SRGB_S3TC_DXT1       = 0x8C4C;
+    const GLenum COMPRESSED_SRGB_ALPHA_S3TC_DXT5 = 0x8C4F;
+
+    // Formato de uma textura na GPU
+    struct GpuFormat
+    {
+        GLenum internal_format;
+        GLenum pixel_format;    // Formato dos texels enviados (não comprimidos)
+        int    block_bytes;     // Bytes por bloco de 4x4 texels (0 se não comprimido)
+        int    texel_bytes;     // Bytes por texel, se não comprimido
+    };
+
+    // Textura com níveis ainda não residentes
+    struct StreamedTexture
+    {
+        GLuint        texture_id;
+        TextureLevels levels;
+        GpuFormat     format;
+        TextureTier   tier;
+        int           next_level;     // Próximo nível a ser enviado
+        int           resident_level; // Valor atual de GL_TEXTURE_BASE_LEVEL
+        int           min_level;      // Níveis menores que este foram descartados pelo orçamento
+        bool          from_cache;
+        TextureCache  cache;
+        std::vector<unsigned char> storage;
+    };
+
+    // Envio de um nível em andamento
+    struct PendingUpload
+    {
+        StreamedTexture* texture;
+        int              level;
+        GLuint           pbo;
+        GLsync           fence;
+    };
+
+    std::list<StreamedTexture>  g_Textures;
+    std::vector<PendingUpload>  g_Pending;
+    std::vector<GLuint>         g_FreeBuffers; // PBOs disponíveis para reutilização
+
+    size_t g_BytesPerFrame = 0;
+    GLint  g_ScratchUnit   = 0; // Unidade de textura usada para alterar as texturas
+
+    // Orçamento de memória
+    size_t g_BudgetBytes   = 0;
+    size_t g_ResidentBytes = 0; // Níveis já enviados (ou com envio em andamento)
+    size_t g_DroppedBytes  = 0; // Níveis descartados para caber no orçamento
+    bool   g_BudgetDirty   = false;
+
+    // Formatos comprimidos disponíveis
+    bool g_Compression = false;
+    bool g_HasS3tc     = false;
+
+    // Estatísticas impressas quando o último nível fica residente
+    size_t g_BytesStreamed  = 0;
+    int    g_FramesStreaming = 0;
+    double g_StartTime       = -1.0;
+
+    GpuFormat ChooseFormat(TextureFormat format, TextureTier tier)
+    {
+        bool compress = g_Compression && tier != TEXTURE_TIER_UI;
+        switch ( format )
+        {
+        case TEXTURE_SRGB_ALPHA:
+            if ( compress && g_HasS3tc )
+                return { COMPRESSED_SRGB_ALPHA_S3TC_DXT5, GL_RGBA, 16, 0 };
+            return { GL_SRGB8_ALPHA8, GL_RGBA, 0, 4 };
+        case TEXTURE_NORMAL_MAP:
+            if ( compress )
+                return { GL_COMPRESSED_RG_RGTC2, GL_RG, 16, 0 };
+            return { GL_RG8, GL_RG, 0, 2 };
+        case TEXTURE_MASK:
+            if ( compress )
+                return { GL_COMPRESSED_RED_RGTC1, GL_RED, 8, 0 };
+            return { GL_R8, GL_RED, 0, 1 };
+        case TEXTURE_SRGB:
+        default:
+            if ( compress && g_HasS3tc )
+                return { COMPRESSED_SRGB_S3TC_DXT1, GL_RGB, 8, 0 };
+            return { GL_SRGB8, GL_RGB, 0, 4 };
+        }
+    }
+
+    // Bytes copiados da memória para a GPU
+    size_t LevelBytes(const TextureLevels& levels, int level)
+    {
+        return (size_t)levels.width[level] * (size_t)levels.height[level] * TextureChannels(levels.format);
+    }
+
+    // Bytes ocupados na GPU
+    size_t GpuLevelBytes(const StreamedTexture& texture, int level)
+    {
+        size_t width  = texture.levels.width[level];
+        size_t height = texture.levels.height[level];
+        if ( texture.format.block_bytes > 0 )
+            return ((width + 3) / 4) * ((height + 3) / 4) * texture.format.block_bytes;
+        return width * height * texture.format.texel_bytes;
+    }
+
+    void BindScratch(GLuint texture_id)
+    {
+        glActiveTexture(GL_TEXTURE0 + g_ScratchUnit);
+        glBindTexture(GL_TEXTURE_2D, texture_id);
+    }
+
+    void UnbindScratch()
+    {
+        glBindTexture(GL_TEXTURE_2D, 0);
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+    // Envia um nível para a textura ligada à unidade de trabalho. Com um PBO
+    // ligado, "pixels" é um deslocamento dentro do buffer.
+    void TexImage(const StreamedTexture& texture, int level, const void* pixels)
+    {
+        glTexImage2D(GL_TEXTURE_2D, level, texture.format.internal_format, texture.levels.width[level], texture.levels.height[level],
+                     0, texture.format.pixel_format, GL_UNSIGNED_BYTE, pixels);
+    }
+
+    // Copia um nível para um PBO e inicia o envio para a textura
+    void StartUpload(StreamedTexture* texture)
+    {
+        int level = texture->next_level--;
+        size_t size = LevelBytes(texture->levels, level);
+
+        GLuint pbo;
+        if ( g_FreeBuffers.empty() )
+        {
+            glGenBuffers(1, &pbo);
+        }
+        else
+        {
+            pbo = g_FreeBuffers.back();
+            g_FreeBuffers.pop_back();
+        }
+
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo);
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, size, NULL, GL_STREAM_DRAW);
+        void* dst = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+        if ( dst != NULL )
+        {
+            memcpy(dst, texture->levels.pixels[level], size);
+            glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        }
+
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        BindScratch(texture->texture_id);
+        if ( dst != NULL )
+        {
+            // Com um PBO ligado a cópia é feita pelo driver de forma assíncrona
+            TexImage(*texture, level, (void*)0);
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        }
+        else
+        {
+            // Não foi possível mapear o PBO: enviamos diretamente da memória
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+            TexImage(*texture, level, texture->levels.pixels[level]);
+        }
+        UnbindScratch();
+
+        PendingUpload upload;
+        upload.texture = texture;
+        upload.level   = level;
+        upload.pbo     = pbo;
+        upload.fence   = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        g_Pending.push_back(upload);
+
+        g_BytesStreamed += size;
+        g_ResidentBytes += GpuLevelBytes(*texture, level);
+    }
+
+    // Libera os texels de uma textura cujos níveis já foram todos enviados
+    void ReleaseSource(StreamedTexture* texture)
+    {
+        if ( texture->from_cache )
+            TextureCache_Close(&texture->cache);
+        texture->storage = std::vector<unsigned char>();
+    }
+
+    // Memória dos níveis ainda não enviados que cabem no orçamento
+    size_t ScheduledBytes()
+    {
+        size_t bytes = 0;
+        for (std::list<StreamedTexture>::iterator it = g_Textures.begin(); it != g_Textures.end(); ++it)
+            for (int level = it->min_level; level <= it->next_level; ++level)
+                bytes += GpuLevelBytes(*it, level);
+        return bytes;
+    }
+
+    // Descarta os maiores níveis ainda não enviados, das texturas de menor
+    // prioridade, até que a memória prevista caiba no orçamento.
+    void ApplyBudget()
+    {
+        g_BudgetDirty = false;
+
+        size_t planned = g_ResidentBytes + ScheduledBytes();
+        int    dropped = 0;
+        while ( planned > g_BudgetBytes )
+        {
+            StreamedTexture* best = NULL;
+            size_t best_size = 0;
+            for (std::list<StreamedTexture>::iterator it = g_Textures.begin(); it != g_Textures.end(); ++it)
+            {
+                if ( it->tier == TEXTURE_TIER_UI || it->min_level > it->next_level )
+                    continue;
+
+                size_t size = GpuLevelBytes(*it, it->min_level);
+                if ( best == NULL || it->tier < best->tier || (it->tier == best->tier && size > best_size) )
+                {
+                    best = &*it;
+                    best_size = size;
+                }
+            }
+
+            if ( best == NULL )
+                break;
+
+            best->min_level += 1;
+            planned        -= best_size;
+            g_DroppedBytes += best_size;
+            dropped        += 1;
+        }
+
+        if ( dropped > 0 )
+            printf("Orçamento de texturas: %d níveis descartados (%.1f MB).\n", dropped, g_DroppedBytes / (1024.0*1024.0));
+        if ( planned > g_BudgetBytes )
+            fprintf(stderr, "WARNING: Textures need %.1f MB, over the %.1f MB budget.\n", planned / (1024.0*1024.0), g_BudgetBytes / (1024.0*1024.0));
+    }
+}
+
+void TextureStreamer_Init(size_t bytes_per_frame, size_t budget_bytes, bool compression)
+{
+    g_BytesPerFrame = bytes_per_frame;
+    g_BudgetBytes   = budget_bytes;
+    g_Compression   = compression;
+
+    GLint max_units;
+    glGetIntegerv(GL_MAX_COMBINED_TEXTURE_IMAGE_UNITS, &max_units);
+    g_ScratchUnit = max_units - 1;
+
+    // Formatos que o driver comprime no envio
+    GLint num_formats = 0;
+    glGetIntegerv(GL_NUM_COMPRESSED_TEXTURE_FORMATS, &num_formats);
+    std::vector<GLint> formats(std::max(num_formats, 1));
+    glGetIntegerv(GL_COMPRESSED_TEXTURE_FORMATS, formats.data());
+
+    bool has_dxt1 = false;
+    bool has_dxt5 = false;
+    for (GLint i = 0; i < num_formats; ++i)
+    {
+        has_dxt1 = has_dxt1 || (GLenum)formats[i] == COMPRESSED_SRGB_S3TC_DXT1;
+        has_dxt5 = has_dxt5 || (GLenum)formats[i] == COMPRESSED_SRGB_ALPHA_S3TC_DXT5;
+    }
+    g_HasS3tc = has_dxt1 && has_dxt5;
+}
+
+void TextureStreamer_Add(GLuint texture_id, const TextureLevels& levels, TextureTier tier, int resident_size,
+                         bool from_cache, TextureCache* cache, std::vector<unsigned char>* storage)
+{
+    g_Textures.push_back(StreamedTexture());
+    StreamedTexture& texture = g_Textures.back();
+    texture.texture_id = texture_id;
+    texture.levels     = levels;
+    texture.format     = ChooseFormat(levels.format, tier);
+    texture.tier       = tier;
+    texture.min_level  = 0;
+    texture.from_cache = from_cache;
+    if ( from_cache )
+        texture.cache = *cache;
+    else
+        texture.storage.swap(*storage);
+
+    // Níveis pequenos (até "resident_size" texels de lado), enviados
+    // imediatamente, do menor para o maior. A textura passa a ser amostrada a
+    // partir do maior deles.
+    int base_level = levels.num_levels - 1;
+    while ( base_level > 0 && std::max(levels.width[base_level-1], levels.height[base_level-1]) <= resident_size )
+        base_level -= 1;
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    BindScratch(texture_id);
+    for (int level = levels.num_levels - 1; level >= base_level; --level)
+    {
+        TexImage(texture, level, levels.pixels[level]);
+        g_ResidentBytes += GpuLevelBytes(texture, level);
+    }
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, base_level);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels.num_levels - 1);
+    UnbindScratch();
+
+    texture.next_level     = base_level - 1;
+    texture.resident_level = base_level;
+
+    if ( base_level == 0 )
+    {
+        ReleaseSource(&texture);
+        g_Textures.pop_back();
+        return;
+    }
+
+    g_BudgetDirty = true;
+    if ( g_StartTime < 0.0 )
+        g_StartTime = glfwGetTime();
+}
+
+void TextureStreamer_Update()
+{
+    if ( !TextureStreamer_Busy() )
+        return;
+
+    if ( g_BudgetDirty )
+        ApplyBudget();
+
+    g_FramesStreaming += 1;
+
+    // 1. Níveis cuja cópia terminou passam a ser amostrados. As fences são
+    // sinalizadas na ordem em que foram criadas.
+    size_t completed = 0;
+    while ( completed < g_Pending.size() )
+    {
+        PendingUpload& upload = g_Pending[completed];
+        GLenum status = glClientWaitSync(upload.fence, 0, 0);
+        if ( status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED )
+            break;
+
+        glDeleteSync(upload.fence);
+        g_FreeBuffers.push_back(upload.pbo);
+
+        StreamedTexture* texture = upload.texture;
+        texture->resident_level = upload.level;
+        BindScratch(texture->texture_id);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, upload.level);
+        UnbindScratch();
+
+        completed += 1;
+    }
+    g_Pending.erase(g_Pending.begin(), g_Pending.begin() + completed);
+
+    // Texturas completas (todos os níveis que cabem no orçamento já
+    // residentes) saem da lista
+    for (std::list<StreamedTexture>::iterator it = g_Textures.begin(); it != g_Textures.end(); )
+    {
+        if ( it->resident_level == it->min_level )
+        {
+            ReleaseSource(&*it);
+            it = g_Textures.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+
+    // 2. Novos envios, sempre do menor nível pendente entre todas as
+    // texturas, até atingir o limite de bytes deste quadro.
+    size_t bytes = 0;
+    for (;;)
+    {
+        StreamedTexture* best = NULL;
+        size_t best_size = 0;
+        for (std::list<StreamedTexture>::iterator it = g_Textures.begin(); it != g_Textures.end(); ++it)
+        {
+            if ( it->next_level < it->min_level )
+                continue;
+
+            size_t size = LevelBytes(it->levels, it->next_level);
+            if ( best == NULL || size < best_size )
+            {
+                best = &*it;
+                best_size = size;
+            }
+        }
+
+        if ( best == NULL || (bytes > 0 && bytes + best_size > g_BytesPerFrame) )
+            break;
+
+        StartUpload(best);
+        bytes += best_size;
+    }
+
+    if ( !TextureStreamer_Busy() )
+    {
+        // Os PBOs só são necessários durante o envio
+        if ( !g_FreeBuffers.empty() )
+            glDeleteBuffers((GLsizei)g_FreeBuffers.size(), g_FreeBuffers.data());
+        g_FreeBuffers.clear();
+
+        printf("Texturas completas na GPU: %.1f MB enviados em %d quadros (%.1f ms), %.1f MB residentes.\n",
+            g_BytesStreamed / (1024.0*1024.0), g_FramesStreaming, 1000.0*(glfwGetTime() - g_StartTime),
+            g_ResidentBytes / (1024.0*1024.0));
+        g_BytesStreamed   = 0;
+        g_FramesStreaming = 0;
+        g_StartTime       = -1.0;
+    }
+}
+
+bool TextureStreamer_Busy()
+{
+    return !g_Textures.empty() || !g_Pending.empty();
+}
+
+size_t TextureStreamer_ResidentBytes()
+{
+    return g_ResidentBytes;
+}
+
+size_t TextureStreamer_PlannedBytes()
+{
+    if ( g_BudgetDirty )
+        ApplyBudget();
+
+    return g_ResidentBytes + ScheduledBytes();
+}
+
+void TextureStreamer_AddResidentBytes(size_t bytes)
+{
+    g_ResidentBytes += bytes;
+    g_BudgetDirty = true;
+}
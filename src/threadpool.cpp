@@ -0,0 +1,83 @@
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <condition_variable>
+
+#include "threadpool.h"
+
+struct ThreadPool
+{
+    std::vector<std::thread>          threads;
+    std::deque<std::function<void()>> tasks;
+    std::mutex                        mutex;
+    std::condition_variable           task_available;
+    bool                              stopping;
+};
+
+namespace
+{
+    void WorkerMain(ThreadPool* pool)
+    {
+        for (;;)
+        {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(pool->mutex);
+                while ( pool->tasks.empty() && !pool->stopping )
+                    pool->task_available.wait(lock);
+
+                // Ao destruir o pool as tarefas restantes ainda são executadas
+                if ( pool->tasks.empty() )
+                    return;
+
+                task = pool->tasks.front();
+                pool->tasks.pop_front();
+            }
+            task();
+        }
+    }
+}
+
+ThreadPool* ThreadPool_Create(int num_threads)
+{
+    if ( num_threads <= 0 )
+        num_threads = (int)std::thread::hardware_concurrency();
+    if ( num_threads <= 0 )
+        num_threads = 1;
+
+    ThreadPool* pool = new ThreadPool();
+    pool->stopping = false;
+    for (int i = 0; i < num_threads; ++i)
+        pool->threads.push_back(std::thread(WorkerMain, pool));
+
+    return pool;
+}
+
+int ThreadPool_Size(const ThreadPool* pool)
+{
+    return (int)pool->threads.size();
+}
+
+void ThreadPool_Submit(ThreadPool* pool, const std::function<void()>& task)
+{
+    {
+        std::lock_guard<std::mutex> lock(pool->mutex);
+        pool->tasks.push_back(task);
+    }
+    pool->task_available.notify_one();
+}
+
+void ThreadPool_Destroy(ThreadPool* pool)
+{
+    {
+        std::lock_guard<std::mutex> lock(pool->mutex);
+        pool->stopping = true;
+    }
+    pool->task_available.notify_all();
+
+    for (size_t i = 0; i < pool->threads.size(); ++i)
+        pool->threads[i].join();
+
+    delete pool;
+}
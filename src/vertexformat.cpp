@@ -0,0 +1,155 @@
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#include <limits>
+
+#include "vertexformat.h"
+
+namespace
+{
+    GLushort QuantizeUnorm16(float value, float offset, float scale)
+    {
+        if ( scale <= 0.0f )
+            return 0;
+
+        float t = (value - offset) / scale;
+        t = std::min(std::max(t, 0.0f), 1.0f);
+        return (GLushort)(t * 65535.0f + 0.5f);
+    }
+
+    GLuint QuantizeSnorm10(float value)
+    {
+        value = std::min(std::max(value, -1.0f), 1.0f);
+        int q = (int)lrintf(value * 511.0f);
+        return (GLuint)q & 0x3FF;
+    }
+}
+
+PositionQuantization ComputePositionQuantization(const float* model_coefficients, size_t num_vertices)
+{
+    const float maxval = std::numeric_limits<float>::max();
+
+    glm::vec3 pmin = glm::vec3( maxval,  maxval,  maxval);
+    glm::vec3 pmax = glm::vec3(-maxval, -maxval, -maxval);
+
+    for (size_t i = 0; i < num_vertices; ++i)
+    {
+        for (int k = 0; k < 3; ++k)
+        {
+            pmin[k] = std::min(pmin[k], model_coefficients[4*i + k]);
+            pmax[k] = std::max(pmax[k], model_coefficients[4*i + k]);
+        }
+    }
+
+    PositionQuantization quantization;
+    if ( num_vertices == 0 )
+    {
+        quantization.offset = glm::vec3(0.0f);
+        quantization.scale  = glm::vec3(0.0f);
+    }
+    else
+    {
+        quantization.offset = pmin;
+        quantization.scale  = pmax - pmin;
+    }
+    return quantization;
+}
+
+void PackVertices(const float* model_coefficients, const float* normal_coefficients, const float* texture_coefficients,
+                  size_t num_vertices, const PositionQuantization& quantization, PackedVertex* vertices)
+{
+    for (size_t i = 0; i < num_vertices; ++i)
+    {
+        PackedVertex& vertex = vertices[i];
+
+        for (int k = 0; k < 3; ++k)
+            vertex.position[k] = QuantizeUnorm16(model_coefficients[4*i + k], quantization.offset[k], quantization.scale[k]);
+        vertex.position[3] = 0;
+
+        vertex.normal = 0;
+        if ( normal_coefficients != NULL )
+        {
+            vertex.normal = QuantizeSnorm10(normal_coefficients[4*i + 0])
+                          | QuantizeSnorm10(normal_coefficients[4*i + 1]) << 10
+                          | QuantizeSnorm10(normal_coefficients[4*i + 2]) << 20;
+        }
+
+        vertex.texcoords[0] = 0;
+        vertex.texcoords[1] = 0;
+        if ( texture_coefficients != NULL )
+        {
+            vertex.texcoords[0] = FloatToHalf(texture_coefficients[2*i + 0]);
+            vertex.texcoords[1] = FloatToHalf(texture_coefficients[2*i + 1]);
+        }
+    }
+}
+
+GLushort FloatToHalf(float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+
+    uint32_t sign     = (bits >> 16) & 0x8000;
+    uint32_t exponent = (bits >> 23) & 0xFF;
+    uint32_t mantissa = bits & 0x7FFFFF;
+
+    // Infinito e NaN
+    if ( exponent == 0xFF )
+        return (GLushort)(sign | 0x7C00 | (mantissa != 0 ? 0x200 : 0));
+
+    int half_exponent = (int)exponent - 127 + 15;
+
+    // Valores grandes demais viram infinito
+    if ( half_exponent >= 31 )
+        return (GLushort)(sign | 0x7C00);
+
+    // Valores pequenos viram subnormais (ou zero)
+    if ( half_exponent <= 0 )
+    {
+        if ( half_exponent < -10 )
+            return (GLushort)sign;
+
+        mantissa |= 0x800000;
+        int shift = 14 - half_exponent;
+        uint32_t half      = mantissa >> shift;
+        uint32_t remainder = mantissa & ((1u << shift) - 1);
+        uint32_t halfway   = 1u << (shift - 1);
+        if ( remainder > halfway || (remainder == halfway && (half & 1)) )
+            half += 1;
+        return (GLushort)(sign | half);
+    }
+
+    uint32_t half      = ((uint32_t)half_exponent << 10) | (mantissa >> 13);
+    uint32_t remainder = mantissa & 0x1FFF;
+    if ( remainder > 0x1000 || (remainder == 0x1000 && (half & 1)) )
+        half += 1; // Um "vai um" para o expoente ainda produz o valor correto
+    return (GLushort)(sign | half);
+}
+
+float HalfToFloat(GLushort half)
+{
+    uint32_t sign     = (uint32_t)(half & 0x8000) << 16;
+    uint32_t exponent = (half >> 10) & 0x1F;
+    uint32_t mantissa = half & 0x3FF;
+
+    uint32_t bits;
+    if ( exponent == 0x1F )
+    {
+        // Infinito e NaN
+        bits = sign | 0x7F800000 | (mantissa << 13);
+    }
+    else if ( exponent == 0 )
+    {
+        // Zero e subnormais: valor exato em float
+        float value = ldexpf((float)mantissa, -24);
+        return (half & 0x8000) ? -value : value;
+    }
+    else
+    {
+        bits = sign | ((exponent - 15 + 127) << 23) | (mantissa << 13);
+    }
+
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}